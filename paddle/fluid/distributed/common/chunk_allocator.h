@@ -14,6 +14,7 @@
 
 #pragma once
 #include <glog/logging.h>
+#include <algorithm>
 
 namespace paddle {
 namespace distributed {
@@ -77,9 +78,11 @@ class ChunkAllocator {
 
   void create_new_chunk() {
     Chunk* chunk;
-    posix_memalign(reinterpret_cast<void**>(&chunk),
-                   std::max<size_t>(sizeof(void*), alignof(Chunk)),
-                   sizeof(Chunk) + sizeof(Node) * _chunk_size);
+    int ret = posix_memalign(reinterpret_cast<void**>(&chunk),
+                             std::max<size_t>(sizeof(void*), alignof(Chunk)),
+                             sizeof(Chunk) + sizeof(Node) * _chunk_size);
+    CHECK(ret == 0) << "ChunkAllocator fails to allocate a chunk, error "
+                    << ret;
     chunk->next = _chunks;
     _chunks = chunk;
 
@@ -91,5 +94,95 @@ class ChunkAllocator {
   }
 };
 
+// Same chunked free-list scheme as ChunkAllocator, but every node reserves
+// extra_size bytes right behind T. Objects whose variable-length payload has
+// a maximum size known only at runtime keep that payload inline, without a
+// separate heap allocation per object. T is constructed with extra_size as
+// its first argument, so it knows the capacity of its payload.
+template <class T>
+class SlabAllocator {
+ public:
+  explicit SlabAllocator(size_t chunk_size = 64) {
+    _chunk_size = chunk_size;
+    _chunks = NULL;
+    _free_nodes = NULL;
+    _counter = 0;
+    set_extra_size(0);
+  }
+  SlabAllocator(const SlabAllocator&) = delete;
+  ~SlabAllocator() {
+    while (_chunks != NULL) {
+      Chunk* x = _chunks;
+      _chunks = _chunks->next;
+      free(x);
+    }
+  }
+  // must be called before the first acquire
+  void set_extra_size(size_t extra_size) {
+    CHECK(_chunks == NULL) << "SlabAllocator extra size is fixed after use";
+    _extra_size = extra_size;
+    size_t node_size = std::max(sizeof(Node), sizeof(T) + extra_size);
+    _node_size = (node_size + kNodeAlign - 1) / kNodeAlign * kNodeAlign;
+  }
+  size_t extra_size() const { return _extra_size; }
+  template <class... ARGS>
+  T* acquire(ARGS&&... args) {
+    if (_free_nodes == NULL) {
+      create_new_chunk();
+    }
+
+    T* x = (T*)(void*)_free_nodes;  // NOLINT
+    _free_nodes = _free_nodes->next;
+    new (x) T(_extra_size, std::forward<ARGS>(args)...);
+    _counter++;
+    return x;
+  }
+  void release(T* x) {
+    x->~T();
+    Node* node = (Node*)(void*)x;  // NOLINT
+    node->next = _free_nodes;
+    _free_nodes = node;
+    _counter--;
+  }
+  size_t size() const { return _counter; }
+
+ private:
+  struct Node {
+    Node* next;
+  };
+  struct Chunk {
+    Chunk* next;
+  };
+  static constexpr size_t kNodeAlign =
+      alignof(T) > alignof(Node) ? alignof(T) : alignof(Node);
+  static constexpr size_t kHeaderSize =
+      (sizeof(Chunk) + kNodeAlign - 1) / kNodeAlign * kNodeAlign;
+
+  size_t _chunk_size;  // how many elements in one chunk
+  size_t _extra_size;  // inline payload bytes behind each T
+  size_t _node_size;   // stride of one element in a chunk
+  Chunk* _chunks;      // a list
+  Node* _free_nodes;   // a list
+  size_t _counter;     // how many elements are acquired
+
+  void create_new_chunk() {
+    Chunk* chunk;
+    int ret = posix_memalign(
+        reinterpret_cast<void**>(&chunk),
+        std::max(sizeof(void*), static_cast<size_t>(kNodeAlign)),
+        kHeaderSize + _node_size * _chunk_size);
+    CHECK(ret == 0) << "SlabAllocator fails to allocate a chunk, error " << ret;
+    chunk->next = _chunks;
+    _chunks = chunk;
+
+    char* nodes = reinterpret_cast<char*>(chunk) + kHeaderSize;
+    for (size_t i = 0; i < _chunk_size; i++) {
+      Node* node = reinterpret_cast<Node*>(nodes + i * _node_size);
+      node->next = _free_nodes;
+      _free_nodes = node;
+    }
+  }
+};
+
 }  // namespace distributed
 }  // namespace paddle
@@ -17,6 +17,7 @@
 #include <unordered_map>
 #include "butil/time.h"
 #include "bvar/latency_recorder.h"
+#include "bvar/reducer.h"
 #include "glog/logging.h"
 
 namespace paddle {
@@ -24,6 +25,7 @@ namespace distributed {
 
 struct CostProfilerNode {
   std::shared_ptr<bvar::LatencyRecorder> recorder;
+  std::shared_ptr<bvar::Adder<int64_t>> counter;
 };
 
 class CostProfiler {
@@ -44,6 +46,17 @@ class CostProfiler {
     _cost_profiler_map[label] = profiler_node;
   }
 
+  // 计数类指标(如缓存命中数), 通过profiler(label)->counter累加
+  void register_counter(const std::string& label) {
+    if (_cost_profiler_map.find(label) != _cost_profiler_map.end()) {
+      return;
+    }
+    auto profiler_node = std::make_shared<CostProfilerNode>();
+    profiler_node->counter.reset(
+        new bvar::Adder<int64_t>("cost_profiler", label));
+    _cost_profiler_map[label] = profiler_node;
+  }
+
   CostProfilerNode* profiler(const std::string& label) {
     auto itr = _cost_profiler_map.find(label);
     if (itr != _cost_profiler_map.end()) {
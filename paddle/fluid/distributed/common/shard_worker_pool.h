@@ -0,0 +1,226 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+#include "glog/logging.h"
+
+namespace paddle {
+namespace distributed {
+
+// Bounded multi-producer single-consumer ring buffer (Vyukov), every slot
+// carries a sequence number so producers never take a lock.
+template <class T>
+class MPSCRingBuffer {
+ public:
+  explicit MPSCRingBuffer(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    _mask = size - 1;
+    _slots.reset(new Slot[size]);
+    for (size_t i = 0; i < size; ++i) {
+      _slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+    _head.store(0, std::memory_order_relaxed);
+    _tail = 0;
+  }
+  MPSCRingBuffer(const MPSCRingBuffer&) = delete;
+
+  bool push(const T& item) {
+    size_t pos = _head.load(std::memory_order_relaxed);
+    while (true) {
+      Slot& slot = _slots[pos & _mask];
+      size_t seq = slot.seq.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          slot.item = item;
+          slot.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // full
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // only called by the single consumer
+  bool pop(T* item) {
+    Slot& slot = _slots[_tail & _mask];
+    size_t seq = slot.seq.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(_tail + 1) < 0) {
+      return false;  // empty
+    }
+    *item = slot.item;
+    slot.seq.store(_tail + _mask + 1, std::memory_order_release);
+    ++_tail;
+    return true;
+  }
+
+  bool empty() const {
+    const Slot& slot = _slots[_tail & _mask];
+    return static_cast<intptr_t>(slot.seq.load(std::memory_order_acquire)) -
+               static_cast<intptr_t>(_tail + 1) <
+           0;
+  }
+
+ private:
+  struct alignas(64) Slot {
+    std::atomic<size_t> seq;
+    T item;
+  };
+  size_t _mask;
+  std::unique_ptr<Slot[]> _slots;
+  alignas(64) std::atomic<size_t> _head;
+  alignas(64) size_t _tail;
+};
+
+// Fixed set of worker threads pinned to cpus. Worker w owns the shards with
+// shard_id % worker_num == w, so a shard is only touched by one thread and
+// needs no lock. Run() hands the same request to every worker through its
+// ring buffer and blocks until all shards are done; the request lives on the
+// caller's stack, so dispatch does not allocate.
+class ShardWorkerPool {
+ public:
+  ShardWorkerPool(size_t shard_num, size_t worker_num,
+                  size_t queue_capacity = 1024)
+      : _shard_num(shard_num) {
+    if (worker_num == 0) {
+      worker_num = std::thread::hardware_concurrency();
+    }
+    worker_num = std::max<size_t>(1, std::min(worker_num, shard_num));
+    size_t cpu_num = std::max<unsigned>(1, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < worker_num; ++i) {
+      _workers.emplace_back(new Worker(queue_capacity));
+    }
+    for (size_t i = 0; i < worker_num; ++i) {
+      _workers[i]->thread = std::thread([this, i] { WorkerLoop(i); });
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(i % cpu_num, &cpu_set);
+      if (pthread_setaffinity_np(_workers[i]->thread.native_handle(),
+                                 sizeof(cpu_set), &cpu_set) != 0) {
+        VLOG(1) << "ShardWorkerPool failed to pin worker " << i;
+      }
+    }
+  }
+  ShardWorkerPool(const ShardWorkerPool&) = delete;
+  ~ShardWorkerPool() {
+    _stop.store(true);
+    for (auto& worker : _workers) {
+      worker->Notify();
+    }
+    for (auto& worker : _workers) {
+      worker->thread.join();
+    }
+  }
+
+  size_t worker_num() const { return _workers.size(); }
+
+  // fn(shard_id) is called once for every shard in [0, shard_num)
+  template <class Fn>
+  void Run(Fn& fn) {  // NOLINT
+    Request request;
+    request.fn = &fn;
+    request.invoke = [](void* f, size_t shard_id) {
+      (*static_cast<Fn*>(f))(shard_id);
+    };
+    request.pending.store(_workers.size(), std::memory_order_relaxed);
+    for (auto& worker : _workers) {
+      while (!worker->queue.push(&request)) {
+        std::this_thread::yield();
+      }
+      worker->Notify();
+    }
+    while (request.pending.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+ private:
+  struct Request {
+    void* fn;
+    void (*invoke)(void*, size_t);
+    std::atomic<size_t> pending;
+  };
+  struct Worker {
+    explicit Worker(size_t capacity) : queue(capacity) {}
+    void Notify() {
+      if (sleeping.load()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cond.notify_one();
+      }
+    }
+    MPSCRingBuffer<Request*> queue;
+    std::atomic<bool> sleeping{false};
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::thread thread;
+  };
+
+  void WorkerLoop(size_t worker_id) {
+    auto& worker = *_workers[worker_id];
+    size_t worker_num = _workers.size();
+    Request* request = nullptr;
+    int idle_rounds = 0;
+    while (true) {
+      if (worker.queue.pop(&request)) {
+        idle_rounds = 0;
+        for (size_t shard_id = worker_id; shard_id < _shard_num;
+             shard_id += worker_num) {
+          request->invoke(request->fn, shard_id);
+        }
+        request->pending.fetch_sub(1, std::memory_order_release);
+        continue;
+      }
+      if (_stop.load()) {
+        break;
+      }
+      // spin a while before sleeping, requests usually come in bursts
+      if (++idle_rounds < 1024) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(worker.mutex);
+      worker.sleeping.store(true);
+      if (worker.queue.empty() && !_stop.load()) {
+        // bounded wait in case a notify races with going to sleep
+        worker.cond.wait_for(lock, std::chrono::milliseconds(1));
+      }
+      worker.sleeping.store(false);
+      idle_rounds = 0;
+    }
+  }
+
+  size_t _shard_num;
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::atomic<bool> _stop{false};
+};
+
+}  // namespace distributed
+}  // namespace paddle
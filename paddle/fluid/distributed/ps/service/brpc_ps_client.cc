@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <functional>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -57,6 +59,28 @@ DEFINE_int32(pserver_sparse_table_shard_num, 1000,
 
 DEFINE_int32(heter_world_size, 100, "group size");  // 可配置
 
+DEFINE_int32(pserver_client_sparse_cache_size, 0,
+             "max feasigns cached by worker for each sparse table pull, "
+             "0 means disable pull cache");
+
+DEFINE_int32(pserver_client_sparse_cache_max_staleness, 4,
+             "cached sparse value is reused for at most this many mini-batches");
+
+DEFINE_bool(pserver_client_sparse_cache_invalidate_on_push, true,
+            "drop cached sparse values when their keys are pushed, "
+            "false relaxes the cache to bounded staleness only");
+
+DEFINE_int32(pserver_pull_sparse_hash_dedup_threshold, 4096,
+             "pull sparse dedups keys by hash instead of sort when the batch "
+             "has at least this many keys");
+
+DEFINE_bool(pserver_push_sparse_adaptive_merge, false,
+            "tune async push_sparse merge limit and merge thread num by "
+            "queue depth, rpc latency and cpu headroom");
+
+DEFINE_int32(pserver_sparse_merge_thread_max, 8,
+             "max sparse merge thread num when adaptive merge is enabled");
+
 namespace paddle {
 namespace framework {
 class Scope;
@@ -209,6 +233,33 @@ int32_t BrpcPsClient::Initialize() {
       _push_sparse_task_queue_map[table_id] =
           paddle::framework::MakeChannel<SparseAsyncTask *>();
       _push_sparse_merge_count_map[table_id] = 0;
+      if (FLAGS_pserver_push_sparse_adaptive_merge) {
+        auto tuner = std::make_shared<PushSparseMergeTuner>(
+            FLAGS_pserver_push_sparse_merge_limit,
+            FLAGS_pserver_push_sparse_merge_limit,
+            FLAGS_pserver_sparse_merge_thread_max,
+            FLAGS_pserver_async_push_sparse_interval_ms);
+        tuner->Expose("pserver_client_push_sparse_table_" +
+                      std::to_string(table_id));
+        _push_sparse_merge_tuner_map[table_id] = tuner;
+      }
+      auto wire_type = worker_param.downpour_table_param(i).wire_type();
+      if (wire_type != WIRE_FP32) {
+        auto *accessor = GetTableAccessor(table_id);
+        _sparse_pull_codec_map[table_id] = std::make_shared<SparseValueCodec>(
+            wire_type, accessor->GetAccessorInfo().select_dim,
+            accessor->SelectEmbedxIndex());
+        _sparse_push_codec_map[table_id] = std::make_shared<SparseValueCodec>(
+            wire_type, accessor->GetAccessorInfo().update_dim,
+            accessor->UpdateEmbedxIndex());
+      }
+      if (FLAGS_pserver_client_sparse_cache_size > 0) {
+        auto *accessor = GetTableAccessor(table_id);
+        _sparse_pull_cache_map[table_id] = std::make_shared<SparsePullCache>(
+            FLAGS_pserver_client_sparse_cache_size,
+            accessor->GetAccessorInfo().select_size,
+            FLAGS_pserver_client_sparse_cache_max_staleness);
+      }
     }
   }
 
@@ -229,6 +280,13 @@ int32_t BrpcPsClient::Initialize() {
   profiler.register_profiler("pserver_client_push_dense_merge");
   profiler.register_profiler("pserver_client_push_dense_rpc");
   profiler.register_profiler("pserver_client_push_dense_send");
+  profiler.register_counter("pserver_client_pull_sparse_cache_hit");
+  profiler.register_counter("pserver_client_pull_sparse_cache_miss");
+  _pull_cache_hit_counter =
+      profiler.profiler("pserver_client_pull_sparse_cache_hit")->counter.get();
+  _pull_cache_miss_counter =
+      profiler.profiler("pserver_client_pull_sparse_cache_miss")
+          ->counter.get();
 
   _running = true;
   _flushing = false;
@@ -552,6 +610,7 @@ std::future<int32_t> BrpcPsClient::PushSparseParam(size_t table_id,
                                                    const uint64_t *keys,
                                                    const float **update_values,
                                                    size_t num, void *done) {
+  InvalidateSparsePullCache(table_id, keys, num);
   auto *accessor = GetTableAccessor(table_id);
   // 发送RPC请求
   DownpourBrpcClosure *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
@@ -757,6 +816,7 @@ std::future<int32_t> BrpcPsClient::PushDenseParam(const Region *regions,
 std::future<int32_t> BrpcPsClient::PushSparseRawGradient(
     size_t table_id, const uint64_t *keys, const float **update_values,
     size_t num, void *done) {
+  InvalidateSparsePullCache(table_id, keys, num);
   auto *accessor = GetTableAccessor(table_id);
   // 发送RPC请求
   DownpourBrpcClosure *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
@@ -791,7 +851,6 @@ std::future<int32_t> BrpcPsClient::PushSparseRawGradient(
     auto value_ptr = value_ptrs[shard_idx];
 
     size_t kv_size = kvs.size();
-    uint32_t value_size = accessor->GetAccessorInfo().update_size;
 
     // 发送RPC请求
     auto *push_request = closure->request(shard_idx);
@@ -799,16 +858,8 @@ std::future<int32_t> BrpcPsClient::PushSparseRawGradient(
     push_request->set_table_id(table_id);
     push_request->set_client_id(_client_id);
     push_request->add_params((char *)&kv_size, sizeof(uint32_t));  // NOLINT
-    auto *push_data = push_request->mutable_data();
-    push_data->resize(kv_size * (sizeof(uint64_t) + value_size));
-    char *push_data_ptr = const_cast<char *>(push_data->data());
-    memcpy(push_data_ptr, kvs.data(), kv_size * sizeof(uint64_t));
-    push_data_ptr += kv_size * sizeof(uint64_t);
-
-    for (int i = 0; i < kv_size; ++i) {
-      memcpy(push_data_ptr, value_ptr[i], value_size);
-      push_data_ptr += value_size;
-    }
+    SerializeSparsePushValues(table_id, accessor, kvs.data(), value_ptr.data(),
+                              kv_size, push_request);
     PsService_Stub rpc_stub(GetSparseChannel(shard_idx));
     closure->cntl(shard_idx)->set_request_compress_type(
         (brpc::CompressType)FLAGS_pserver_communicate_compress_type);
@@ -886,9 +937,12 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
       std::make_shared<CostTimer>("pserver_client_pull_sparse_local");
   size_t request_call_num = _server_channels.size();
 
-  auto shard_sorted_kvs = std::make_shared<
-      std::vector<std::vector<std::pair<uint64_t, float *>>>>();
-  shard_sorted_kvs->resize(request_call_num);
+  thread_local std::vector<std::vector<std::pair<uint64_t, float *>>>
+      shard_kvs;
+  shard_kvs.resize(request_call_num);
+  for (auto &x : shard_kvs) {
+    x.clear();
+  }
 
   const auto &server_param = _config.server_param().downpour_server_param();
   uint64_t shard_num = FLAGS_pserver_sparse_table_shard_num;
@@ -900,48 +954,97 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
     }
   }
 
+  // 命中缓存的key直接填充, 只向server请求未命中的key
+  std::shared_ptr<SparsePullCache> cache = GetSparsePullCache(table_id);
+  uint64_t cache_step = 0;
+  auto cache_epochs = std::make_shared<SparsePullCache::EpochSnapshot>();
+  if (cache) {
+    cache_step = cache->PullStep();
+    cache->SnapshotEpochs(cache_epochs.get());
+  }
+  size_t cache_hit = 0;
   for (size_t i = 0; i < num; ++i) {
+    if (cache && cache->Lookup(keys[i], cache_step,
+                               reinterpret_cast<char *>(select_values[i]))) {
+      ++cache_hit;
+      continue;
+    }
     size_t shard_id = get_sparse_shard(shard_num, request_call_num, keys[i]);
-    shard_sorted_kvs->at(shard_id).push_back({keys[i], select_values[i]});
+    shard_kvs[shard_id].push_back({keys[i], select_values[i]});
+  }
+  if (cache) {
+    *_pull_cache_hit_counter << cache_hit;
+    *_pull_cache_miss_counter << num - cache_hit;
+  }
+
+  // 每个pserver只请求去重后的key, 回包后再拷贝到重复的位置
+  auto shard_keys_list =
+      std::make_shared<std::vector<SparsePullShardKeys>>(request_call_num);
+  size_t hash_dedup_threshold = FLAGS_pserver_pull_sparse_hash_dedup_threshold;
+  bool hash_dedup = num >= hash_dedup_threshold;
+  for (size_t i = 0; i < request_call_num; ++i) {
+    if (hash_dedup) {
+      DedupSparseKeysByHash(shard_kvs[i], &shard_keys_list->at(i));
+    } else {
+      DedupSparseKeysBySort(&shard_kvs[i], &shard_keys_list->at(i));
+    }
   }
 
   auto *accessor = GetTableAccessor(table_id);
 
   size_t value_size = accessor->GetAccessorInfo().select_size;
+  auto pull_codec = GetSparseCodec(_sparse_pull_codec_map, table_id);
 
   DownpourBrpcClosure *closure = new DownpourBrpcClosure(
-      request_call_num, [shard_sorted_kvs, value_size](void *done) {
+      request_call_num, [shard_keys_list, value_size, cache, cache_step,
+                         cache_epochs, pull_codec](void *done) {
         int ret = 0;
         auto *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
-        for (size_t i = 0; i < shard_sorted_kvs->size(); ++i) {
+        std::vector<char> wire_buffer;
+        if (pull_codec) {
+          wire_buffer.resize(pull_codec->EncodedSize());
+        }
+        for (size_t i = 0; i < shard_keys_list->size(); ++i) {
           if (closure->check_response(i, PS_PULL_SPARSE_TABLE) != 0) {
             ret = -1;
             break;
           }
 
-          auto &request_kvs = shard_sorted_kvs->at(i);
+          auto &shard_keys = shard_keys_list->at(i);
           auto &res_io_buffer = closure->cntl(i)->response_attachment();
           butil::IOBufBytesIterator io_buffer_itr(res_io_buffer);
-          uint64_t last_key = UINT64_MAX;
-          float *last_value_data = NULL;
 
-          for (size_t kv_idx = 0; kv_idx < request_kvs.size(); ++kv_idx) {
-            auto *kv_pair = &(request_kvs[kv_idx]);
-            if (kv_pair->first == last_key) {
-              memcpy(reinterpret_cast<void *>(kv_pair->second),
-                     reinterpret_cast<void *>(last_value_data), value_size);
-            } else {
-              last_key = kv_pair->first;
-              last_value_data = kv_pair->second;
-              if (value_size !=
-                  io_buffer_itr.copy_and_forward(
-                      reinterpret_cast<void *>(last_value_data), value_size)) {
-                LOG(WARNING) << "res data is lack or not in format";
-                ret = -1;
-                break;
+          for (size_t kv_idx = 0; kv_idx < shard_keys.keys.size(); ++kv_idx) {
+            float *value_data = shard_keys.values[kv_idx];
+            bool read_ok = false;
+            if (pull_codec) {
+              read_ok = wire_buffer.size() ==
+                        io_buffer_itr.copy_and_forward(
+                            reinterpret_cast<void *>(wire_buffer.data()),
+                            wire_buffer.size());
+              if (read_ok) {
+                pull_codec->Decode(wire_buffer.data(), value_data);
               }
+            } else {
+              read_ok = value_size ==
+                        io_buffer_itr.copy_and_forward(
+                            reinterpret_cast<void *>(value_data), value_size);
             }
+            if (!read_ok) {
+              LOG(WARNING) << "res data is lack or not in format";
+              ret = -1;
+              break;
+            }
+            if (cache) {
+              cache->Insert(shard_keys.keys[kv_idx], cache_step,
+                            reinterpret_cast<char *>(value_data),
+                            *cache_epochs);
+            }
+          }
+          if (ret != 0) {
+            break;
           }
+          CopyDupSparseValues(shard_keys, value_size);
         }
         closure->set_promise_value(ret);
       });
@@ -951,38 +1054,15 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
   std::future<int> fut = promise->get_future();
 
   for (size_t i = 0; i < request_call_num; ++i) {
-    auto &sorted_kvs = shard_sorted_kvs->at(i);
-    std::sort(sorted_kvs.begin(), sorted_kvs.end(),
-              [](const std::pair<uint64_t, float *> &k1,
-                 const std::pair<uint64_t, float *> &k2) {
-                return k1.first < k2.first;
-              });
-
-    uint64_t last_key = UINT64_MAX;
-    uint32_t kv_request_count = 0;
-    size_t sorted_kv_size = sorted_kvs.size();
+    auto &shard_keys = shard_keys_list->at(i);
+    uint32_t kv_request_count = shard_keys.keys.size();
     auto &request_buffer = closure->cntl(i)->request_attachment();
 
     request_buffer.append(reinterpret_cast<void *>(&is_training), sizeof(bool));
-    std::vector<uint32_t> keys_counter;
-    keys_counter.reserve(sorted_kv_size);
-
-    for (size_t kv_idx = 0; kv_idx < sorted_kv_size; ++kv_idx) {
-      ++kv_request_count;
-      uint32_t keys = 1;
-      last_key = sorted_kvs[kv_idx].first;
-      request_buffer.append(reinterpret_cast<void *>(&last_key),
-                            sizeof(uint64_t));
-      while (kv_idx < sorted_kv_size - 1 &&
-             last_key == sorted_kvs[kv_idx + 1].first) {
-        ++kv_idx;
-        ++keys;
-      }
-      keys_counter.push_back(keys);
-    }
-
-    request_buffer.append(reinterpret_cast<void *>(keys_counter.data()),
-                          sizeof(uint32_t) * keys_counter.size());
+    request_buffer.append(reinterpret_cast<void *>(shard_keys.keys.data()),
+                          sizeof(uint64_t) * kv_request_count);
+    request_buffer.append(reinterpret_cast<void *>(shard_keys.counts.data()),
+                          sizeof(uint32_t) * kv_request_count);
 
     if (kv_request_count == 0) {
       closure->Run();
@@ -992,6 +1072,11 @@ std::future<int32_t> BrpcPsClient::PullSparse(float **select_values,
       closure->request(i)->set_client_id(_client_id);
       closure->request(i)->add_params((char *)&kv_request_count,  // NOLINT
                                       sizeof(uint32_t));
+      if (pull_codec) {
+        uint32_t wire_type = pull_codec->wire_type();
+        closure->request(i)->add_params(reinterpret_cast<char *>(&wire_type),
+                                        sizeof(uint32_t));
+      }
       PsService_Stub rpc_stub(GetCmdChannel(i));
       closure->cntl(i)->set_log_id(butil::gettimeofday_ms());
       rpc_stub.service(closure->cntl(i), closure->request(i),
@@ -1142,8 +1227,8 @@ std::future<int32_t> BrpcPsClient::SendClient2ClientMsg(
 std::future<int32_t> BrpcPsClient::PushSparseRawGradientPartial(
     size_t table_id, const uint64_t *keys, const float **update_values,
     uint32_t num, void *done, int pserver_idx) {
+  InvalidateSparsePullCache(table_id, keys, num);
   auto *accessor = GetTableAccessor(table_id);
-  size_t value_size = accessor->GetAccessorInfo().update_size;
   DownpourBrpcClosure *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
   auto promise = std::make_shared<std::promise<int32_t>>();
   closure->add_promise(promise);
@@ -1155,15 +1240,8 @@ std::future<int32_t> BrpcPsClient::PushSparseRawGradientPartial(
   push_request->set_table_id(table_id);
   push_request->set_client_id(_client_id);
   push_request->add_params((char *)&num, sizeof(uint32_t));  // NOLINT
-  auto *push_data = push_request->mutable_data();
-  push_data->resize(num * (sizeof(uint64_t) + value_size));
-  char *push_data_ptr = const_cast<char *>(push_data->data());
-  memcpy(push_data_ptr, keys, num * sizeof(uint64_t));
-  push_data_ptr += num * sizeof(uint64_t);
-  for (int i = 0; i < num; ++i) {
-    memcpy(push_data_ptr, update_values[i], value_size);
-    push_data_ptr += value_size;
-  }
+  SerializeSparsePushValues(table_id, accessor, keys, update_values, num,
+                            push_request);
   PsService_Stub rpc_stub(GetSparseChannel(pserver_idx));
   closure->cntl(0)->set_request_compress_type(
       (brpc::CompressType)FLAGS_pserver_communicate_compress_type);
@@ -1255,6 +1333,7 @@ std::future<int32_t> BrpcPsClient::PushSparse(size_t table_id,
                                               const uint64_t *keys,
                                               const float **update_values,
                                               size_t num) {
+  InvalidateSparsePullCache(table_id, keys, num);
   auto push_timer = std::make_shared<CostTimer>("pserver_client_push_sparse");
   CostTimer parse_timer("pserver_client_push_sparse_parse");
   int push_sparse_async_num = _push_sparse_task_queue_map[table_id]->Size();
@@ -1317,27 +1396,131 @@ std::future<int32_t> BrpcPsClient::PushSparse(size_t table_id,
   return fut;
 }
 
+void BrpcPsClient::SerializeSparsePushValues(size_t table_id,
+                                             ValueAccessor *accessor,
+                                             const uint64_t *keys,
+                                             const float **values, size_t num,
+                                             PsRequestMessage *push_request) {
+  /*
+  Push Content:
+  |---keysData---|---valuesData(float或按wire_type编码)---|
+  */
+  auto push_codec = GetSparseCodec(_sparse_push_codec_map, table_id);
+  size_t value_size = accessor->GetAccessorInfo().update_size;
+  size_t wire_size = push_codec ? push_codec->EncodedSize() : value_size;
+  if (push_codec) {
+    uint32_t wire_type = push_codec->wire_type();
+    push_request->add_params(reinterpret_cast<char *>(&wire_type),
+                             sizeof(uint32_t));
+  }
+  auto *push_data = push_request->mutable_data();
+  push_data->resize(num * (sizeof(uint64_t) + wire_size));
+  char *push_data_ptr = const_cast<char *>(push_data->data());
+  memcpy(push_data_ptr, keys, num * sizeof(uint64_t));
+  push_data_ptr += num * sizeof(uint64_t);
+  for (size_t i = 0; i < num; ++i) {
+    if (push_codec) {
+      push_codec->Encode(values[i], push_data_ptr);
+    } else {
+      memcpy(push_data_ptr, values[i], value_size);
+    }
+    push_data_ptr += wire_size;
+  }
+}
+
+std::shared_ptr<SparseValueCodec> BrpcPsClient::GetSparseCodec(
+    const std::unordered_map<uint32_t, std::shared_ptr<SparseValueCodec>>
+        &codec_map,
+    size_t table_id) {
+  auto itr = codec_map.find(table_id);
+  if (itr == codec_map.end()) {
+    return nullptr;
+  }
+  return itr->second;
+}
+
+std::shared_ptr<SparsePullCache> BrpcPsClient::GetSparsePullCache(
+    size_t table_id) {
+  auto itr = _sparse_pull_cache_map.find(table_id);
+  if (itr == _sparse_pull_cache_map.end()) {
+    return nullptr;
+  }
+  return itr->second;
+}
+
+void BrpcPsClient::AdvanceSparsePullCacheStep() {
+  for (auto &itr : _sparse_pull_cache_map) {
+    itr.second->AdvanceStep();
+  }
+}
+
+void BrpcPsClient::InvalidateSparsePullCache(size_t table_id,
+                                             const uint64_t *keys,
+                                             size_t num) {
+  if (!FLAGS_pserver_client_sparse_cache_invalidate_on_push) {
+    return;
+  }
+  auto cache = GetSparsePullCache(table_id);
+  if (cache) {
+    cache->Invalidate(keys, num);
+  }
+}
+
 void BrpcPsClient::PushSparseTaskConsume() {
-  uint64_t merge_size = FLAGS_pserver_push_sparse_merge_limit;
   std::vector<std::shared_ptr<SparseAsyncTask>> task_list;
   size_t request_call_num = _server_channels.size();
+  bool adaptive = !_push_sparse_merge_tuner_map.empty();
   ::ThreadPool async_push_sparse_shard_threads(
-      FLAGS_pserver_sparse_merge_thread);
+      adaptive ? FLAGS_pserver_sparse_merge_thread_max
+               : FLAGS_pserver_sparse_merge_thread);
+  // 用thread_num个task分摊所有shard, 限制本轮merge的并行度
+  auto run_shard_tasks = [&](size_t thread_num,
+                             const std::function<void(int)> &shard_fn) {
+    thread_num = std::max<size_t>(1, std::min(thread_num, request_call_num));
+    std::vector<std::future<int>> merge_status(thread_num);
+    for (size_t i = 0; i < thread_num; ++i) {
+      merge_status[i] = async_push_sparse_shard_threads.enqueue(
+          [&shard_fn, i, thread_num, request_call_num]() -> int {
+            for (size_t shard_idx = i; shard_idx < request_call_num;
+                 shard_idx += thread_num) {
+              shard_fn(shard_idx);
+            }
+            return 0;
+          });
+    }
+    for (size_t i = 0; i < thread_num; ++i) {
+      merge_status[i].wait();
+    }
+  };
   while (_running) {
     auto async_start_time_ms = butil::gettimeofday_ms();
+    double cpu_headroom =
+        adaptive ? PushSparseMergeTuner::SampleCpuHeadroom() : 0;
     // 所有sparseTable的pushTask 进行处理
     for (auto &push_sparse_task_itr : _push_sparse_task_queue_map) {
       auto table_id = push_sparse_task_itr.first;
       auto *accessor = GetTableAccessor(table_id);
       auto &task_queue = push_sparse_task_itr.second;
       auto queue_size = task_queue->Size();
+      std::shared_ptr<PushSparseMergeTuner> tuner;
+      if (adaptive) {
+        tuner = _push_sparse_merge_tuner_map[table_id];
+      }
       if (queue_size == 0) {
+        if (tuner) {
+          tuner->Update(0, 0, 0, cpu_headroom);
+        }
         continue;
       }
+      uint64_t merge_size = tuner ? tuner->merge_limit()
+                                  : FLAGS_pserver_push_sparse_merge_limit;
+      size_t merge_thread_num = tuner ? tuner->merge_thread_num()
+                                      : FLAGS_pserver_sparse_merge_thread;
       if (merge_size > 0 && (queue_size <= 1 && _flushing == false)) {
         continue;
       }
       ++_async_call_num;
+      auto table_start_ms = butil::gettimeofday_ms();
 
       int merge_count = 0;
       for (size_t i = 0; i < task_list.size(); ++i) {
@@ -1377,8 +1560,10 @@ void BrpcPsClient::PushSparseTaskConsume() {
 
       if (_push_sparse_merge_count_map[table_id] >= merge_size ||
           _flushing == true) {
+        auto send_start_ms = butil::gettimeofday_ms();
         DownpourBrpcClosure *closure = new DownpourBrpcClosure(
-            request_call_num, [this, request_call_num](void *done) {
+            request_call_num,
+            [this, request_call_num, tuner, send_start_ms](void *done) {
               int ret = 0;
               auto *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
               for (size_t i = 0; i < request_call_num; ++i) {
@@ -1387,6 +1572,10 @@ void BrpcPsClient::PushSparseTaskConsume() {
                   break;
                 }
               }
+              if (tuner) {
+                tuner->RecordRpcLatency(butil::gettimeofday_ms() -
+                                        send_start_ms);
+              }
               closure->set_promise_value(ret);
               --_async_call_num;
             });
@@ -1403,40 +1592,27 @@ void BrpcPsClient::PushSparseTaskConsume() {
             std::make_shared<CostTimer>("pserver_client_push_sparse_rpc");
         closure->add_timer(rpc_timer);
 
-        std::vector<std::future<int>> merge_status(request_call_num);
-        for (int shard_idx = 0; shard_idx < request_call_num; ++shard_idx) {
-          merge_status[shard_idx] =
-              async_push_sparse_shard_threads.enqueue(std::bind(
-                  &BrpcPsClient::PushSparseAsyncShardPush, this, task_list,
-                  request_kv_num, table_id, shard_idx, closure, accessor));
-        }
-        for (int shard_idx = 0; shard_idx < request_call_num; ++shard_idx) {
-          merge_status[shard_idx].wait();
-        }
-        merge_status.clear();
-        std::vector<std::future<int>>().swap(merge_status);
+        run_shard_tasks(merge_thread_num, [&](int shard_idx) {
+          PushSparseAsyncShardPush(task_list, request_kv_num, table_id,
+                                   shard_idx, closure, accessor);
+        });
         _push_sparse_merge_count_map[table_id] = 0;
-
-        auto queue_size = task_queue->Size();
       } else {  // 未达到阈值 只做多路归并
-        std::vector<std::future<int>> merge_status(request_call_num);
-        for (int shard_idx = 0; shard_idx < request_call_num; ++shard_idx) {
-          merge_status[shard_idx] =
-              async_push_sparse_shard_threads.enqueue(std::bind(
-                  &BrpcPsClient::PushSparseAsyncShardMerge, this, task_list,
-                  request_kv_num, table_id, shard_idx, accessor));
-        }
-        for (int shard_idx = 0; shard_idx < request_call_num; ++shard_idx) {
-          merge_status[shard_idx].wait();
-        }
+        run_shard_tasks(merge_thread_num, [&](int shard_idx) {
+          PushSparseAsyncShardMerge(task_list, request_kv_num, table_id,
+                                    shard_idx, accessor);
+        });
 
         // meger到task_list[0]
         auto async_task = new SparseAsyncTask(*(task_list[0].get()));
 
         task_queue->Put(std::move(async_task));
         --_async_call_num;
-        merge_status.clear();
-        std::vector<std::future<int>>().swap(merge_status);
+      }
+      if (tuner) {
+        tuner->Update(queue_size, merge_count,
+                      butil::gettimeofday_ms() - table_start_ms,
+                      cpu_headroom);
       }
     }
     auto wait_ms = FLAGS_pserver_async_push_sparse_interval_ms -
@@ -1570,20 +1746,15 @@ int BrpcPsClient::PushSparseAsyncShardPush(
   push_request->set_client_id(_client_id);
   push_request->add_params(reinterpret_cast<char *>(&merged_kv_count),
                            sizeof(uint32_t));  // NOLINT
-  auto *push_data = push_request->mutable_data();
-  int update_size = accessor->GetAccessorInfo().update_size;
-  push_data->resize(merged_kv_count * (sizeof(uint64_t) + update_size));
-  char *push_data_ptr = const_cast<char *>(push_data->data());
-  memcpy(push_data_ptr, merged_key_list.data(),
-         merged_kv_count * sizeof(uint64_t));
-  push_data_ptr += merged_kv_count * sizeof(uint64_t);
-  for (int i = 0; i < merged_kv_count; ++i) {
-    const char *task_data_ptr = merged_value_list[i].data();
-
-    memcpy(push_data_ptr, (float *)(task_data_ptr),  // NOLINT
-           update_size);
-    push_data_ptr += update_size;
+  thread_local std::vector<const float *> merged_value_ptrs;
+  merged_value_ptrs.resize(merged_kv_count);
+  for (size_t i = 0; i < merged_kv_count; ++i) {
+    merged_value_ptrs[i] =
+        reinterpret_cast<const float *>(merged_value_list[i].data());
   }
+  SerializeSparsePushValues(table_id, accessor, merged_key_list.data(),
+                            merged_value_ptrs.data(), merged_kv_count,
+                            push_request);
   PsService_Stub rpc_stub(GetSparseChannel(shard_idx));
   closure->cntl(shard_idx)->set_request_compress_type(
       (brpc::CompressType)FLAGS_pserver_communicate_compress_type);
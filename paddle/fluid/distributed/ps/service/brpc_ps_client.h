@@ -24,6 +24,10 @@
 #include "brpc/server.h"
 #include "paddle/fluid/distributed/ps/service/brpc_utils.h"
 #include "paddle/fluid/distributed/ps/service/ps_client.h"
+#include "paddle/fluid/distributed/ps/service/push_sparse_merge_tuner.h"
+#include "paddle/fluid/distributed/ps/service/sparse_pull_cache.h"
+#include "paddle/fluid/distributed/ps/service/sparse_pull_dedup.h"
+#include "paddle/fluid/distributed/ps/service/sparse_value_codec.h"
 #include "paddle/fluid/framework/channel.h"
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/scope.h"
@@ -199,6 +203,8 @@ class BrpcPsClient : public PSClient {
                                                const uint64_t *keys, size_t num,
                                                bool is_training);
 
+  virtual void AdvanceSparsePullCacheStep();
+
   virtual std::future<int32_t> PrintTableStat(uint32_t table_id);
 
   virtual std::future<int32_t> Barrier(size_t table_id, uint32_t barrier_type);
@@ -262,6 +268,10 @@ class BrpcPsClient : public PSClient {
   std::unordered_map<uint32_t, paddle::framework::Channel<SparseAsyncTask *>>
       _push_sparse_task_queue_map;
   std::unordered_map<uint32_t, uint32_t> _push_sparse_merge_count_map;
+  // FLAGS_pserver_push_sparse_adaptive_merge开启时, 每个sparse表的
+  // merge_limit和merge线程数由tuner按队列长度和rpc耗时动态调整
+  std::unordered_map<uint32_t, std::shared_ptr<PushSparseMergeTuner>>
+      _push_sparse_merge_tuner_map;
 
   std::thread _print_thread;
 
@@ -277,6 +287,29 @@ class BrpcPsClient : public PSClient {
 
   SparseTaskPool _sparse_task_pool;
 
+  // worker侧热点key的pull缓存, 仅在FLAGS_pserver_client_sparse_cache_size>0
+  // 时为sparse表创建
+  std::shared_ptr<SparsePullCache> GetSparsePullCache(size_t table_id);
+  void InvalidateSparsePullCache(size_t table_id, const uint64_t *keys,
+                                 size_t num);
+  std::unordered_map<uint32_t, std::shared_ptr<SparsePullCache>>
+      _sparse_pull_cache_map;
+  bvar::Adder<int64_t> *_pull_cache_hit_counter = nullptr;
+  bvar::Adder<int64_t> *_pull_cache_miss_counter = nullptr;
+
+  // 按表配置的wire_type对sparse pull/push value编码, fp32的表不创建codec
+  std::shared_ptr<SparseValueCodec> GetSparseCodec(
+      const std::unordered_map<uint32_t, std::shared_ptr<SparseValueCodec>>
+          &codec_map,
+      size_t table_id);
+  void SerializeSparsePushValues(size_t table_id, ValueAccessor *accessor,
+                                 const uint64_t *keys, const float **values,
+                                 size_t num, PsRequestMessage *push_request);
+  std::unordered_map<uint32_t, std::shared_ptr<SparseValueCodec>>
+      _sparse_pull_codec_map;
+  std::unordered_map<uint32_t, std::shared_ptr<SparseValueCodec>>
+      _sparse_push_codec_map;
+
   std::vector<std::shared_ptr<brpc::Channel>>
       _client_channels;  // client2client
   std::vector<std::array<std::shared_ptr<brpc::Channel>, 3>>
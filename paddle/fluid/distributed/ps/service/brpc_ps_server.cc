@@ -16,6 +16,7 @@
 #include <thread>  // NOLINT
 #include "butil/object_pool.h"
 #include "paddle/fluid/distributed/common/cost_timer.h"
+#include "paddle/fluid/distributed/ps/service/sparse_value_codec.h"
 #include "paddle/fluid/distributed/ps/table/depends/sparse_utils.h"
 #include "paddle/fluid/distributed/ps/table/table.h"
 #include "paddle/fluid/framework/archive.h"
@@ -404,6 +405,11 @@ int32_t BrpcPsService::PullSparse(Table *table, const PsRequestMessage &request,
     return 0;
   }
 
+  ValueWireType wire_type = WIRE_FP32;
+  if (!ParseWireType(request, response, &wire_type)) {
+    return 0;
+  }
+
   CostTimer timer("pserver_server_pull_sparse");
   uint32_t num = *(uint32_t *)(request.params(0).c_str());
   auto dim = table->ValueAccesor()->GetAccessorInfo().select_dim;
@@ -427,12 +433,50 @@ int32_t BrpcPsService::PullSparse(Table *table, const PsRequestMessage &request,
   table->Pull(table_context);
   // table->PullSparse(res_data->data(), value);
 
-  cntl->response_attachment().append((char *)(res_data->data()),
-                                     res_data->size() * sizeof(float));
+  if (wire_type == WIRE_FP32) {
+    cntl->response_attachment().append((char *)(res_data->data()),  // NOLINT
+                                       res_data->size() * sizeof(float));
+  } else {
+    SparseValueCodec codec(wire_type, dim,
+                           table->ValueAccesor()->SelectEmbedxIndex());
+    thread_local std::vector<char> wire_buffer;
+    wire_buffer.resize(num * codec.EncodedSize());
+    for (uint32_t i = 0; i < num; ++i) {
+      codec.Encode(res_data->data() + i * dim,
+                   wire_buffer.data() + i * codec.EncodedSize());
+    }
+    cntl->response_attachment().append(wire_buffer.data(), wire_buffer.size());
+  }
   butil::return_object(res_data);
   return 0;
 }
 
+bool BrpcPsService::ParseWireType(const PsRequestMessage &request,
+                                  PsResponseMessage &response,
+                                  ValueWireType *wire_type) {
+  *wire_type = WIRE_FP32;
+  if (request.params_size() < 2) {
+    return true;
+  }
+  if (request.params(1).size() < sizeof(uint32_t)) {
+    set_response_code(response, -1,
+                      "PsRequestMessage.params(1) is too short for the value "
+                      "wire type");
+    return false;
+  }
+  uint32_t type = 0;
+  memcpy(&type, request.params(1).c_str(), sizeof(uint32_t));
+  if (!ValueWireType_IsValid(static_cast<int>(type))) {
+    std::string err_msg =
+        "PsRequestMessage.params(1) has unknown value wire type " +
+        std::to_string(type);
+    set_response_code(response, -1, err_msg.c_str());
+    return false;
+  }
+  *wire_type = static_cast<ValueWireType>(type);
+  return true;
+}
+
 int32_t BrpcPsService::PushSparse(Table *table, const PsRequestMessage &request,
                                   PsResponseMessage &response,
                                   brpc::Controller *cntl) {
@@ -450,6 +494,10 @@ int32_t BrpcPsService::PushSparse(Table *table, const PsRequestMessage &request,
                       "least 1 for num of sparse_key");
     return 0;
   }
+  ValueWireType wire_type = WIRE_FP32;
+  if (!ParseWireType(request, response, &wire_type)) {
+    return 0;
+  }
   CostTimer timer("pserver_server_push_sparse");
   uint32_t num = *(uint32_t *)(request.params(0).c_str());
   /*
@@ -463,6 +511,24 @@ int32_t BrpcPsService::PushSparse(Table *table, const PsRequestMessage &request,
   table_context.push_context.values =
       (const float *)(push_data.data() + sizeof(uint64_t) * num);
   table_context.num = num;
+  // params(1)为client指定的value编码, 非float时先解码
+  if (request.params_size() > 1) {
+    auto update_dim = table->ValueAccesor()->GetAccessorInfo().update_dim;
+    SparseValueCodec codec(wire_type, update_dim,
+                           table->ValueAccesor()->UpdateEmbedxIndex());
+    if (push_data.size() != num * (sizeof(uint64_t) + codec.EncodedSize())) {
+      set_response_code(response, -1, "PushSparse data size not match");
+      return 0;
+    }
+    thread_local std::vector<float> decoded_values;
+    decoded_values.resize(num * update_dim);
+    const char *wire_data = push_data.data() + sizeof(uint64_t) * num;
+    for (uint32_t i = 0; i < num; ++i) {
+      codec.Decode(wire_data + i * codec.EncodedSize(),
+                   decoded_values.data() + i * update_dim);
+    }
+    table_context.push_context.values = decoded_values.data();
+  }
   // const uint64_t *keys = (const uint64_t *)push_data.data();
   // const float *values = (const float *)(push_data.data() + sizeof(uint64_t) *
   // num);
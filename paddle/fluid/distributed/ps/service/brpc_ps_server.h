@@ -123,6 +123,11 @@ class BrpcPsService : public PsBaseService {
   int32_t PushGlobalStep(Table *table, const PsRequestMessage &request,
                          PsResponseMessage &response, brpc::Controller *cntl);
 
+  // 解析params(1)中client指定的value编码, 缺省为WIRE_FP32.
+  // 长度不足或编码未知时设置错误码并返回false
+  bool ParseWireType(const PsRequestMessage &request,
+                     PsResponseMessage &response, ValueWireType *wire_type);
+
   bool _is_initialize_shard_info;
   std::mutex _initialize_shard_mutex;
   std::unordered_map<int32_t, serviceHandlerFunc> _service_handler_map;
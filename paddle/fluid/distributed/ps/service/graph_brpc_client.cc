@@ -176,6 +176,38 @@ std::future<int32_t> GraphBrpcClient::clear_nodes(uint32_t table_id) {
   }
   return fut;
 }
+std::future<int32_t> GraphBrpcClient::build_csr(uint32_t table_id) {
+  DownpourBrpcClosure *closure = new DownpourBrpcClosure(
+      server_size, [&, server_size = this->server_size ](void *done) {
+        int ret = 0;
+        auto *closure = (DownpourBrpcClosure *)done;
+        size_t fail_num = 0;
+        for (size_t request_idx = 0; request_idx < server_size; ++request_idx) {
+          if (closure->check_response(request_idx, PS_GRAPH_BUILD_CSR) != 0) {
+            ++fail_num;
+            break;
+          }
+        }
+        ret = fail_num == 0 ? 0 : -1;
+        closure->set_promise_value(ret);
+      });
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  closure->add_promise(promise);
+  std::future<int> fut = promise->get_future();
+  for (size_t i = 0; i < server_size; i++) {
+    int server_index = i;
+    closure->request(server_index)->set_cmd_id(PS_GRAPH_BUILD_CSR);
+    closure->request(server_index)->set_table_id(table_id);
+    closure->request(server_index)->set_client_id(_client_id);
+
+    GraphPsService_Stub rpc_stub = getServiceStub(GetCmdChannel(server_index));
+    closure->cntl(server_index)->set_log_id(butil::gettimeofday_ms());
+    rpc_stub.service(closure->cntl(server_index),
+                     closure->request(server_index),
+                     closure->response(server_index), closure);
+  }
+  return fut;
+}
 std::future<int32_t> GraphBrpcClient::add_graph_node(
     uint32_t table_id, std::vector<int64_t> &node_id_list,
     std::vector<bool> &is_weighted_list) {
@@ -297,6 +329,65 @@ std::future<int32_t> GraphBrpcClient::remove_graph_node(
   }
   return fut;
 }
+std::future<int32_t> GraphBrpcClient::sample_k_hop(
+    uint32_t table_id, const std::vector<int64_t> &seeds,
+    const std::vector<int> &fanouts, bool need_weight,
+    std::vector<int64_t> &nodes, std::vector<uint32_t> &edge_src,
+    std::vector<uint32_t> &edge_dst, std::vector<float> &edge_weight,
+    std::vector<size_t> &hop_edge_end, int server_index) {
+  if (server_index == -1) {
+    server_index = seeds.size() > 0 ? get_server_index_by_id(seeds[0]) : 0;
+  }
+  DownpourBrpcClosure *closure = new DownpourBrpcClosure(1, [&](void *done) {
+    int ret = 0;
+    auto *closure = (DownpourBrpcClosure *)done;
+    if (closure->check_response(0, PS_GRAPH_SAMPLE_K_HOP) != 0) {
+      ret = -1;
+    } else {
+      auto &res_io_buffer = closure->cntl(0)->response_attachment();
+      butil::IOBufBytesIterator io_buffer_itr(res_io_buffer);
+      size_t num;
+      io_buffer_itr.copy_and_forward((void *)&num, sizeof(size_t));
+      nodes.resize(num);
+      io_buffer_itr.copy_and_forward((void *)nodes.data(),
+                                     sizeof(int64_t) * num);
+      io_buffer_itr.copy_and_forward((void *)&num, sizeof(size_t));
+      hop_edge_end.resize(num);
+      io_buffer_itr.copy_and_forward((void *)hop_edge_end.data(),
+                                     sizeof(size_t) * num);
+      io_buffer_itr.copy_and_forward((void *)&num, sizeof(size_t));
+      edge_src.resize(num);
+      edge_dst.resize(num);
+      io_buffer_itr.copy_and_forward((void *)edge_src.data(),
+                                     sizeof(uint32_t) * num);
+      io_buffer_itr.copy_and_forward((void *)edge_dst.data(),
+                                     sizeof(uint32_t) * num);
+      edge_weight.resize(need_weight ? num : 0);
+      if (need_weight) {
+        io_buffer_itr.copy_and_forward((void *)edge_weight.data(),
+                                       sizeof(float) * num);
+      }
+    }
+    closure->set_promise_value(ret);
+  });
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  closure->add_promise(promise);
+  std::future<int> fut = promise->get_future();
+  closure->request(0)->set_cmd_id(PS_GRAPH_SAMPLE_K_HOP);
+  closure->request(0)->set_table_id(table_id);
+  closure->request(0)->set_client_id(_client_id);
+  closure->request(0)->add_params((char *)seeds.data(),
+                                  sizeof(int64_t) * seeds.size());
+  closure->request(0)->add_params((char *)fanouts.data(),
+                                  sizeof(int) * fanouts.size());
+  closure->request(0)->add_params((char *)&need_weight, sizeof(bool));
+  GraphPsService_Stub rpc_stub = getServiceStub(GetCmdChannel(server_index));
+  closure->cntl(0)->set_log_id(butil::gettimeofday_ms());
+  rpc_stub.service(closure->cntl(0), closure->request(0), closure->response(0),
+                   closure);
+  return fut;
+}
+
 // char* &buffer,int &actual_size
 std::future<int32_t> GraphBrpcClient::batch_sample_neighbors(
     uint32_t table_id, std::vector<int64_t> node_ids, int sample_size,
@@ -68,6 +68,17 @@ class GraphBrpcClient : public BrpcPsClient {
       std::vector<std::vector<float>>& res_weight, bool need_weight,
       int server_index = -1);
 
+  // k-hop sampling executed by one server in a single round trip.
+  // fanouts[h] is the sample size of hop h. nodes are deduplicated with the
+  // seeds first, edge_src/edge_dst index into nodes and hop h's edges end
+  // at hop_edge_end[h]. server_index -1 uses the owner of seeds[0].
+  virtual std::future<int32_t> sample_k_hop(
+      uint32_t table_id, const std::vector<int64_t>& seeds,
+      const std::vector<int>& fanouts, bool need_weight,
+      std::vector<int64_t>& nodes, std::vector<uint32_t>& edge_src,
+      std::vector<uint32_t>& edge_dst, std::vector<float>& edge_weight,
+      std::vector<size_t>& hop_edge_end, int server_index = -1);
+
   virtual std::future<int32_t> pull_graph_list(uint32_t table_id,
                                                int server_index, int start,
                                                int size, int step,
@@ -87,6 +98,7 @@ class GraphBrpcClient : public BrpcPsClient {
       const std::vector<std::vector<std::string>>& features);
 
   virtual std::future<int32_t> clear_nodes(uint32_t table_id);
+  virtual std::future<int32_t> build_csr(uint32_t table_id);
   virtual std::future<int32_t> add_graph_node(
       uint32_t table_id, std::vector<int64_t>& node_id_list,
       std::vector<bool>& is_weighted_list);
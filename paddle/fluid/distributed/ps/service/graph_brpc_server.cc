@@ -128,6 +128,17 @@ int32_t GraphBrpcService::clear_nodes(Table *table,
   return 0;
 }
 
+int32_t GraphBrpcService::build_csr(Table *table,
+                                    const PsRequestMessage &request,
+                                    PsResponseMessage &response,
+                                    brpc::Controller *cntl) {
+  CHECK_TABLE_EXIST(table, request, response)
+  if (((GraphTable *)table)->build_csr() != 0) {
+    set_response_code(response, -1, "build csr graph failed");
+  }
+  return 0;
+}
+
 int32_t GraphBrpcService::add_graph_node(Table *table,
                                          const PsRequestMessage &request,
                                          PsResponseMessage &response,
@@ -193,6 +204,9 @@ int32_t GraphBrpcService::Initialize() {
   _service_handler_map[PS_GRAPH_GET_NODE_FEAT] =
       &GraphBrpcService::graph_get_node_feat;
   _service_handler_map[PS_GRAPH_CLEAR] = &GraphBrpcService::clear_nodes;
+  _service_handler_map[PS_GRAPH_BUILD_CSR] = &GraphBrpcService::build_csr;
+  _service_handler_map[PS_GRAPH_SAMPLE_K_HOP] =
+      &GraphBrpcService::graph_sample_k_hop;
   _service_handler_map[PS_GRAPH_ADD_GRAPH_NODE] =
       &GraphBrpcService::add_graph_node;
   _service_handler_map[PS_GRAPH_REMOVE_GRAPH_NODE] =
@@ -389,6 +403,23 @@ int32_t GraphBrpcService::graph_random_sample_neighbors(
   int64_t *node_data = (int64_t *)(request.params(0).c_str());
   int sample_size = *(int64_t *)(request.params(1).c_str());
   bool need_weight = *(bool *)(request.params(2).c_str());
+  auto *graph_table = (GraphTable *)table;
+  if (graph_table->is_csr() && !graph_table->is_sample_cache_enabled()) {
+    // csr tables sample the whole request into one contiguous block
+    std::vector<int> actual_sizes;
+    std::unique_ptr<char[]> buffer;
+    graph_table->batch_sample_neighbors(node_data, node_num, sample_size,
+                                        need_weight, actual_sizes, buffer);
+    size_t total_size = 0;
+    for (size_t idx = 0; idx < node_num; ++idx) {
+      total_size += actual_sizes[idx];
+    }
+    cntl->response_attachment().append(&node_num, sizeof(size_t));
+    cntl->response_attachment().append(actual_sizes.data(),
+                                       sizeof(int) * node_num);
+    cntl->response_attachment().append(buffer.get(), total_size);
+    return 0;
+  }
   std::vector<std::shared_ptr<char>> buffers(node_num);
   std::vector<int> actual_sizes(node_num, 0);
   ((GraphTable *)table)
@@ -606,6 +637,224 @@ int32_t GraphBrpcService::sample_neighbors_across_multi_servers(
   fut.get();
   return 0;
 }
+// Sample neighbors of node_ids: ids owned by this server are sampled from
+// the local table, the others are sent to their owners directly.
+// res[i] (and res_weight[i] if need_weight) holds the result of node_ids[i].
+int32_t GraphBrpcService::sample_neighbors_by_owner(
+    Table *table, uint32_t table_id, const std::vector<int64_t> &node_ids,
+    int sample_size, bool need_weight, std::vector<std::vector<int64_t>> &res,
+    std::vector<std::vector<float>> &res_weight) {
+  auto *graph_table = (GraphTable *)table;
+  size_t node_num = node_ids.size();
+  size_t rank = GetRank();
+  res.assign(node_num, {});
+  res_weight.assign(need_weight ? node_num : 0, {});
+  std::vector<int> server2request(server_size, -1);
+  std::vector<int> request2server;
+  std::vector<std::vector<int64_t>> node_id_buckets;
+  std::vector<std::vector<int>> query_idx_buckets;
+  std::vector<int64_t> local_ids;
+  std::vector<int> local_query_idx;
+  for (size_t query_idx = 0; query_idx < node_num; ++query_idx) {
+    int server_index = graph_table->get_server_index_by_id(node_ids[query_idx]);
+    if (server_index == (int)rank) {
+      local_ids.push_back(node_ids[query_idx]);
+      local_query_idx.push_back(query_idx);
+      continue;
+    }
+    if (server2request[server_index] == -1) {
+      server2request[server_index] = request2server.size();
+      request2server.push_back(server_index);
+      node_id_buckets.push_back({});
+      query_idx_buckets.push_back({});
+    }
+    node_id_buckets[server2request[server_index]].push_back(
+        node_ids[query_idx]);
+    query_idx_buckets[server2request[server_index]].push_back(query_idx);
+  }
+
+  // parse one response attachment of PS_GRAPH_SAMPLE_NEIGHBORS
+  auto parse_sample_result = [&](const char *buffer,
+                                 const std::vector<int> &query_idx) {
+    size_t num = *(size_t *)buffer;
+    const int *actual_sizes = (const int *)(buffer + sizeof(size_t));
+    const char *node_buffer = buffer + sizeof(size_t) + sizeof(int) * num;
+    for (size_t i = 0; i < num; ++i) {
+      int q = query_idx[i];
+      int start = 0;
+      while (start < actual_sizes[i]) {
+        res[q].push_back(*(int64_t *)(node_buffer + start));
+        start += GraphNode::id_size;
+        if (need_weight) {
+          res_weight[q].push_back(*(float *)(node_buffer + start));
+          start += GraphNode::weight_size;
+        }
+      }
+      node_buffer += actual_sizes[i];
+    }
+  };
+
+  size_t remote_call_num = request2server.size();
+  int ret = 0;
+  std::future<int> fut;
+  if (remote_call_num > 0) {
+    DownpourBrpcClosure *closure = new DownpourBrpcClosure(
+        remote_call_num, [&, remote_call_num](void *done) {
+          auto *closure = (DownpourBrpcClosure *)done;
+          for (size_t request_idx = 0; request_idx < remote_call_num;
+               ++request_idx) {
+            if (closure->check_response(request_idx,
+                                        PS_GRAPH_SAMPLE_NEIGHBORS) != 0) {
+              ret = -1;
+              continue;
+            }
+            auto &res_io_buffer =
+                closure->cntl(request_idx)->response_attachment();
+            butil::IOBufBytesIterator io_buffer_itr(res_io_buffer);
+            size_t bytes_size = io_buffer_itr.bytes_left();
+            std::unique_ptr<char[]> buffer(new char[bytes_size]);
+            io_buffer_itr.copy_and_forward((void *)(buffer.get()), bytes_size);
+            parse_sample_result(buffer.get(), query_idx_buckets[request_idx]);
+          }
+          closure->set_promise_value(ret);
+        });
+    auto promise = std::make_shared<std::promise<int32_t>>();
+    closure->add_promise(promise);
+    fut = promise->get_future();
+    for (size_t request_idx = 0; request_idx < remote_call_num;
+         ++request_idx) {
+      int server_index = request2server[request_idx];
+      closure->request(request_idx)->set_cmd_id(PS_GRAPH_SAMPLE_NEIGHBORS);
+      closure->request(request_idx)->set_table_id(table_id);
+      closure->request(request_idx)->set_client_id(rank);
+      closure->request(request_idx)
+          ->add_params((char *)node_id_buckets[request_idx].data(),
+                       sizeof(int64_t) * node_id_buckets[request_idx].size());
+      closure->request(request_idx)
+          ->add_params((char *)&sample_size, sizeof(int));
+      closure->request(request_idx)
+          ->add_params((char *)&need_weight, sizeof(bool));
+      PsService_Stub rpc_stub(
+          ((GraphBrpcServer *)GetServer())->GetCmdChannel(server_index));
+      closure->cntl(request_idx)->set_log_id(butil::gettimeofday_ms());
+      rpc_stub.service(closure->cntl(request_idx),
+                       closure->request(request_idx),
+                       closure->response(request_idx), closure);
+    }
+  }
+  // local part overlaps with the remote calls
+  if (local_ids.size() > 0) {
+    std::vector<std::shared_ptr<char>> local_buffers(local_ids.size());
+    std::vector<int> local_actual_sizes(local_ids.size(), 0);
+    graph_table->random_sample_neighbors(local_ids.data(), sample_size,
+                                         local_buffers, local_actual_sizes,
+                                         need_weight);
+    for (size_t i = 0; i < local_ids.size(); ++i) {
+      int q = local_query_idx[i];
+      const char *node_buffer = local_buffers[i].get();
+      int start = 0;
+      while (start < local_actual_sizes[i]) {
+        res[q].push_back(*(int64_t *)(node_buffer + start));
+        start += GraphNode::id_size;
+        if (need_weight) {
+          res_weight[q].push_back(*(float *)(node_buffer + start));
+          start += GraphNode::weight_size;
+        }
+      }
+    }
+  }
+  if (remote_call_num > 0) {
+    fut.get();
+  }
+  return ret;
+}
+
+// k-hop sampling in one request. params: seed ids, fanout of every hop
+// (int array), need_weight. Each hop's frontier is split by owner and
+// sampled through sample_neighbors_by_owner, nodes seen in earlier hops are
+// not expanded again. Response attachment:
+//   size_t node_num, int64_t nodes[node_num] (seeds first, no duplicates)
+//   size_t hop_num, size_t hop_edge_end[hop_num]
+//   size_t edge_num, uint32_t src[edge_num], uint32_t dst[edge_num],
+//   float weight[edge_num] if need_weight
+// where src/dst index into nodes.
+int32_t GraphBrpcService::graph_sample_k_hop(Table *table,
+                                             const PsRequestMessage &request,
+                                             PsResponseMessage &response,
+                                             brpc::Controller *cntl) {
+  CHECK_TABLE_EXIST(table, request, response)
+  if (request.params_size() < 3) {
+    set_response_code(response, -1,
+                      "graph_sample_k_hop request requires at least 3 "
+                      "arguments");
+    return 0;
+  }
+  size_t seed_num = request.params(0).size() / sizeof(int64_t);
+  const int64_t *seeds = (const int64_t *)(request.params(0).c_str());
+  size_t hop_num = request.params(1).size() / sizeof(int);
+  const int *fanouts = (const int *)(request.params(1).c_str());
+  bool need_weight = *(bool *)(request.params(2).c_str());
+
+  std::vector<int64_t> nodes;
+  std::unordered_map<int64_t, uint32_t> node_index;
+  std::vector<int64_t> frontier;
+  for (size_t i = 0; i < seed_num; ++i) {
+    if (node_index.emplace(seeds[i], nodes.size()).second) {
+      nodes.push_back(seeds[i]);
+      frontier.push_back(seeds[i]);
+    }
+  }
+  std::vector<uint32_t> edge_src, edge_dst;
+  std::vector<float> edge_weight;
+  std::vector<size_t> hop_edge_end;
+  std::vector<std::vector<int64_t>> res;
+  std::vector<std::vector<float>> res_weight;
+  for (size_t hop = 0; hop < hop_num; ++hop) {
+    if (frontier.size() > 0) {
+      if (sample_neighbors_by_owner(table, request.table_id(), frontier,
+                                    fanouts[hop], need_weight, res,
+                                    res_weight) != 0) {
+        set_response_code(response, -1, "graph_sample_k_hop sample failed");
+        return 0;
+      }
+    } else {
+      res.clear();
+    }
+    std::vector<int64_t> next_frontier;
+    for (size_t i = 0; i < res.size(); ++i) {
+      uint32_t src = node_index[frontier[i]];
+      for (size_t j = 0; j < res[i].size(); ++j) {
+        auto iter = node_index.emplace(res[i][j], nodes.size());
+        if (iter.second) {
+          nodes.push_back(res[i][j]);
+          next_frontier.push_back(res[i][j]);
+        }
+        edge_src.push_back(src);
+        edge_dst.push_back(iter.first->second);
+        if (need_weight) {
+          edge_weight.push_back(res_weight[i][j]);
+        }
+      }
+    }
+    hop_edge_end.push_back(edge_src.size());
+    frontier.swap(next_frontier);
+  }
+
+  size_t node_num = nodes.size(), edge_num = edge_src.size();
+  auto &attachment = cntl->response_attachment();
+  attachment.append(&node_num, sizeof(size_t));
+  attachment.append(nodes.data(), sizeof(int64_t) * node_num);
+  attachment.append(&hop_num, sizeof(size_t));
+  attachment.append(hop_edge_end.data(), sizeof(size_t) * hop_num);
+  attachment.append(&edge_num, sizeof(size_t));
+  attachment.append(edge_src.data(), sizeof(uint32_t) * edge_num);
+  attachment.append(edge_dst.data(), sizeof(uint32_t) * edge_num);
+  if (need_weight) {
+    attachment.append(edge_weight.data(), sizeof(float) * edge_num);
+  }
+  return 0;
+}
+
 int32_t GraphBrpcService::graph_set_node_feat(Table *table,
                                               const PsRequestMessage &request,
                                               PsResponseMessage &response,
@@ -95,6 +95,8 @@ class GraphBrpcService : public PsBaseService {
                               brpc::Controller *cntl);
   int32_t clear_nodes(Table *table, const PsRequestMessage &request,
                       PsResponseMessage &response, brpc::Controller *cntl);
+  int32_t build_csr(Table *table, const PsRequestMessage &request,
+                    PsResponseMessage &response, brpc::Controller *cntl);
   int32_t add_graph_node(Table *table, const PsRequestMessage &request,
                          PsResponseMessage &response, brpc::Controller *cntl);
   int32_t remove_graph_node(Table *table, const PsRequestMessage &request,
@@ -121,6 +123,16 @@ class GraphBrpcService : public PsBaseService {
                                                 PsResponseMessage &response,
                                                 brpc::Controller *cntl);
 
+  // k-hop sampling coordinated by this server, see sample_k_hop in .cc
+  int32_t graph_sample_k_hop(Table *table, const PsRequestMessage &request,
+                             PsResponseMessage &response,
+                             brpc::Controller *cntl);
+  int32_t sample_neighbors_by_owner(
+      Table *table, uint32_t table_id, const std::vector<int64_t> &node_ids,
+      int sample_size, bool need_weight,
+      std::vector<std::vector<int64_t>> &res,
+      std::vector<std::vector<float>> &res_weight);
+
   int32_t use_neighbors_sample_cache(Table *table,
                                      const PsRequestMessage &request,
                                      PsResponseMessage &response,
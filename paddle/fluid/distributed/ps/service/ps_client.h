@@ -151,6 +151,9 @@ class PSClient {
     return fut;
   }
 
+  // 训练每个mini-batch调用一次, 推进worker侧sparse pull缓存的step
+  virtual void AdvanceSparsePullCacheStep() {}
+
   virtual std::future<int32_t> PrintTableStat(uint32_t table_id) = 0;
 
   // 确保所有积攒中的请求都发起发送
@@ -259,6 +259,14 @@ void GraphPyClient::clear_nodes(std::string name) {
   }
 }
 
+void GraphPyClient::build_csr(std::string name) {
+  if (this->table_id_map.count(name)) {
+    uint32_t table_id = this->table_id_map[name];
+    auto status = get_ps_client()->build_csr(table_id);
+    status.wait();
+  }
+}
+
 void GraphPyClient::add_graph_node(std::string name,
                                    std::vector<int64_t>& node_ids,
                                    std::vector<bool>& weight_list) {
@@ -331,6 +339,35 @@ GraphPyClient::batch_sample_neighbors(std::string name,
   return res;
 }
 
+std::pair<std::vector<std::vector<int64_t>>, std::vector<float>>
+GraphPyClient::sample_k_hop(std::string name, std::vector<int64_t> seeds,
+                            std::vector<int> fanouts, bool return_weight) {
+  std::vector<int64_t> nodes;
+  std::vector<uint32_t> edge_src, edge_dst;
+  std::vector<size_t> hop_edge_end;
+  std::vector<float> edge_weight;
+  if (this->table_id_map.count(name)) {
+    uint32_t table_id = this->table_id_map[name];
+    auto status = worker_ptr->sample_k_hop(table_id, seeds, fanouts,
+                                           return_weight, nodes, edge_src,
+                                           edge_dst, edge_weight, hop_edge_end);
+    status.wait();
+  }
+  // res.first[0]: nodes, seeds first
+  // res.first[1]: edge src, index into res.first[0]
+  // res.first[2]: edge dst, index into res.first[0]
+  // res.first[3]: end of every hop's edges
+  // res.second: edges weight
+  std::pair<std::vector<std::vector<int64_t>>, std::vector<float>> res;
+  res.first.push_back(nodes);
+  res.first.push_back(std::vector<int64_t>(edge_src.begin(), edge_src.end()));
+  res.first.push_back(std::vector<int64_t>(edge_dst.begin(), edge_dst.end()));
+  res.first.push_back(
+      std::vector<int64_t>(hop_edge_end.begin(), hop_edge_end.end()));
+  res.second = edge_weight;
+  return res;
+}
+
 void GraphPyClient::use_neighbors_sample_cache(std::string name,
                                                size_t total_size_limit,
                                                size_t ttl) {
@@ -159,6 +159,7 @@ class GraphPyClient : public GraphPyService {
   void load_edge_file(std::string name, std::string filepath, bool reverse);
   void load_node_file(std::string name, std::string filepath);
   void clear_nodes(std::string name);
+  void build_csr(std::string name);
   void add_graph_node(std::string name, std::vector<int64_t>& node_ids,
                       std::vector<bool>& weight_list);
   void remove_graph_node(std::string name, std::vector<int64_t>& node_ids);
@@ -169,6 +170,9 @@ class GraphPyClient : public GraphPyService {
   batch_sample_neighbors(std::string name, std::vector<int64_t> node_ids,
                          int sample_size, bool return_weight,
                          bool return_edges);
+  std::pair<std::vector<std::vector<int64_t>>, std::vector<float>>
+  sample_k_hop(std::string name, std::vector<int64_t> seeds,
+               std::vector<int> fanouts, bool return_weight);
   std::vector<int64_t> random_sample_nodes(std::string name, int server_index,
                                            int sample_size);
   std::vector<std::vector<std::string>> get_node_feat(
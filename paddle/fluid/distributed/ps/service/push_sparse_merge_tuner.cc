@@ -0,0 +1,122 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/service/push_sparse_merge_tuner.h"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <cmath>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+
+#include "butil/time.h"
+
+namespace paddle {
+namespace distributed {
+
+static const double kSmoothFactor = 0.2;
+
+PushSparseMergeTuner::PushSparseMergeTuner(uint32_t init_merge_limit,
+                                           uint32_t max_merge_limit,
+                                           uint32_t max_thread_num,
+                                           double interval_ms)
+    : _max_merge_limit(std::max<uint32_t>(1, max_merge_limit)),
+      _max_thread_num(std::max<uint32_t>(1, max_thread_num)),
+      _interval_ms(std::max(1.0, interval_ms)) {
+  _merge_limit = std::min(std::max<uint32_t>(1, init_merge_limit),
+                          _max_merge_limit);
+  _merge_thread_num = 1;
+}
+
+void PushSparseMergeTuner::Expose(const std::string& prefix) {
+  _merge_limit_var.reset(
+      new bvar::Status<int64_t>(prefix + "_merge_limit", _merge_limit));
+  _merge_thread_num_var.reset(new bvar::Status<int64_t>(
+      prefix + "_merge_thread_num", _merge_thread_num));
+  _rpc_latency_var.reset(
+      new bvar::Status<double>(prefix + "_rpc_latency_ms", 0));
+}
+
+void PushSparseMergeTuner::RecordRpcLatency(double latency_ms) {
+  double old_value = _rpc_latency_ms.load();
+  double new_value = 0;
+  do {
+    new_value = old_value == 0
+                    ? latency_ms
+                    : old_value + kSmoothFactor * (latency_ms - old_value);
+  } while (!_rpc_latency_ms.compare_exchange_weak(old_value, new_value));
+}
+
+void PushSparseMergeTuner::Update(size_t queue_size, size_t task_num,
+                                  double merge_ms, double cpu_headroom) {
+  uint64_t now_ms = butil::gettimeofday_ms();
+  if (_last_update_ms != 0 && now_ms > _last_update_ms) {
+    double rate = static_cast<double>(task_num) / (now_ms - _last_update_ms);
+    _arrival_rate += kSmoothFactor * (rate - _arrival_rate);
+  }
+  _last_update_ms = now_ms;
+
+  // 一个rtt内到达的task合成一个请求发送
+  double rtt_ms = std::max(_rpc_latency_ms.load(), _interval_ms);
+  double target = std::ceil(_arrival_rate * rtt_ms);
+  _merge_limit = static_cast<uint32_t>(
+      std::min<double>(std::max(1.0, target), _max_merge_limit));
+
+  bool backlog = queue_size > 2 * static_cast<size_t>(_merge_limit);
+  uint32_t cpu_limit =
+      std::max<uint32_t>(1, static_cast<uint32_t>(std::floor(cpu_headroom)));
+  if (merge_ms > _interval_ms || backlog) {
+    _merge_thread_num = std::min(
+        {_merge_thread_num * 2, _max_thread_num,
+         std::max(_merge_thread_num, cpu_limit)});
+  } else if (merge_ms < _interval_ms / 4) {
+    _merge_thread_num = std::max<uint32_t>(1, _merge_thread_num / 2);
+  }
+
+  if (_merge_limit_var) {
+    _merge_limit_var->set_value(_merge_limit);
+    _merge_thread_num_var->set_value(_merge_thread_num);
+    _rpc_latency_var->set_value(_rpc_latency_ms.load());
+  }
+}
+
+double PushSparseMergeTuner::SampleCpuHeadroom() {
+  static std::mutex mutex;
+  static uint64_t last_wall_us = 0;
+  static uint64_t last_cpu_us = 0;
+  static double headroom = std::thread::hardware_concurrency();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return headroom;
+  }
+  uint64_t cpu_us = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 +
+                    usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+  uint64_t wall_us = butil::gettimeofday_us();
+  // 采样间隔太短时沿用上次的结果
+  if (last_wall_us != 0 && wall_us - last_wall_us >= 100000) {
+    double used_cores =
+        static_cast<double>(cpu_us - last_cpu_us) / (wall_us - last_wall_us);
+    headroom = std::max(0.0, std::thread::hardware_concurrency() - used_cores);
+  }
+  if (last_wall_us == 0 || wall_us - last_wall_us >= 100000) {
+    last_wall_us = wall_us;
+    last_cpu_us = cpu_us;
+  }
+  return headroom;
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,72 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "bvar/bvar.h"
+
+namespace paddle {
+namespace distributed {
+
+// 异步push sparse的自适应merge策略, 每个sparse表一个.
+// merge_limit: 约等于一个rpc往返时间内到达的push task数, 让同一时刻只有
+//   一个merge后的请求在路上, 同时不超过max_merge_limit以限制梯度的陈旧度.
+// merge_thread_num: 一轮merge耗时超过发送间隔或队列积压时, 在cpu有余量的
+//   前提下加倍; merge耗时远小于间隔时减半.
+// 选定的参数以bvar导出, 名字为<prefix>_merge_limit/_merge_thread_num.
+class PushSparseMergeTuner {
+ public:
+  PushSparseMergeTuner(uint32_t init_merge_limit, uint32_t max_merge_limit,
+                       uint32_t max_thread_num, double interval_ms);
+
+  void Expose(const std::string& prefix);
+
+  // push rpc回包时调用, 线程安全
+  void RecordRpcLatency(double latency_ms);
+
+  // 每轮consume调用一次
+  // queue_size: 本轮开始时队列中的task数, task_num: 本轮取出的task数,
+  // merge_ms: 本轮merge/发送耗时, cpu_headroom: 空闲的cpu核数
+  void Update(size_t queue_size, size_t task_num, double merge_ms,
+              double cpu_headroom);
+
+  uint32_t merge_limit() const { return _merge_limit; }
+  uint32_t merge_thread_num() const { return _merge_thread_num; }
+
+  // 进程级的空闲cpu核数: 核数 - 两次调用之间进程消耗的cpu核数
+  static double SampleCpuHeadroom();
+
+ private:
+  uint32_t _max_merge_limit;
+  uint32_t _max_thread_num;
+  double _interval_ms;
+  uint32_t _merge_limit;
+  uint32_t _merge_thread_num;
+  // 单位: task/ms, ms; 均为指数滑动平均
+  double _arrival_rate = 0;
+  std::atomic<double> _rpc_latency_ms{0};
+  uint64_t _last_update_ms = 0;
+
+  std::unique_ptr<bvar::Status<int64_t>> _merge_limit_var;
+  std::unique_ptr<bvar::Status<int64_t>> _merge_thread_num_var;
+  std::unique_ptr<bvar::Status<double>> _rpc_latency_var;
+};
+
+}  // namespace distributed
+}  // namespace paddle
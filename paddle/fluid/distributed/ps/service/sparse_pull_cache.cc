@@ -0,0 +1,195 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/service/sparse_pull_cache.h"
+
+#include <string.h>
+
+namespace paddle {
+namespace distributed {
+
+SparsePullCache::SparsePullCache(size_t capacity, size_t value_size,
+                                 uint32_t max_staleness)
+    : _value_size(value_size), _max_staleness(max_staleness) {
+  _bucket_capacity = (capacity + kBucketNum - 1) / kBucketNum;
+  if (_bucket_capacity == 0) {
+    _bucket_capacity = 1;
+  }
+  for (auto& bucket : _buckets) {
+    bucket.slots.resize(_bucket_capacity);
+    bucket.values.resize(_bucket_capacity * _value_size);
+    bucket.index.reserve(_bucket_capacity);
+  }
+}
+
+void SparsePullCache::SnapshotEpochs(EpochSnapshot* epochs) {
+  for (size_t i = 0; i < kBucketNum; ++i) {
+    std::lock_guard<std::mutex> lock(_buckets[i].mutex);
+    (*epochs)[i] = _buckets[i].epoch;
+  }
+}
+
+bool SparsePullCache::Lookup(uint64_t key, uint64_t step, char* value) {
+  auto& bucket = _buckets[BucketIdx(key)];
+  std::lock_guard<std::mutex> lock(bucket.mutex);
+  auto itr = bucket.index.find(key);
+  if (itr == bucket.index.end()) {
+    return false;
+  }
+  auto& slot = bucket.slots[itr->second];
+  if (!slot.valid || IsStale(slot, step)) {
+    return false;
+  }
+  slot.referenced = true;
+  memcpy(value, bucket.values.data() + itr->second * _value_size, _value_size);
+  return true;
+}
+
+void SparsePullCache::Insert(uint64_t key, uint64_t step, const char* value,
+                             const EpochSnapshot& epochs) {
+  size_t bucket_idx = BucketIdx(key);
+  auto& bucket = _buckets[bucket_idx];
+  std::lock_guard<std::mutex> lock(bucket.mutex);
+  uint64_t snapshot_epoch = epochs[bucket_idx];
+  uint64_t invalidated_epoch = 0;
+  auto itr = bucket.index.find(key);
+  if (itr != bucket.index.end()) {
+    invalidated_epoch = bucket.slots[itr->second].invalidated_epoch;
+    if (invalidated_epoch > snapshot_epoch) {
+      return;
+    }
+  } else {
+    if (bucket.evicted_epoch > snapshot_epoch) {
+      return;
+    }
+    auto tombstone = bucket.tombstones.find(key);
+    if (tombstone != bucket.tombstones.end()) {
+      if (tombstone->second > snapshot_epoch) {
+        return;
+      }
+      // 删除标记转到slot上, 继续拦截更早的回包
+      invalidated_epoch = tombstone->second;
+      bucket.tombstones.erase(tombstone);
+    }
+  }
+  uint32_t slot_idx = FindOrAllocate(&bucket, key, step);
+  auto& slot = bucket.slots[slot_idx];
+  slot.step = step;
+  slot.invalidated_epoch = invalidated_epoch;
+  slot.valid = true;
+  memcpy(bucket.values.data() + slot_idx * _value_size, value, _value_size);
+}
+
+uint32_t SparsePullCache::FindOrAllocate(Bucket* bucket, uint64_t key,
+                                         uint64_t step) {
+  auto itr = bucket->index.find(key);
+  if (itr != bucket->index.end()) {
+    return itr->second;
+  }
+  uint32_t slot_idx = 0;
+  if (bucket->used < _bucket_capacity) {
+    slot_idx = bucket->used++;
+  } else {
+    slot_idx = Evict(bucket, step);
+  }
+  auto& slot = bucket->slots[slot_idx];
+  slot.key = key;
+  slot.in_index = true;
+  bucket->index[key] = slot_idx;
+  return slot_idx;
+}
+
+uint32_t SparsePullCache::Evict(Bucket* bucket, uint64_t step) {
+  // 优先复用空slot和删除标记, 否则最多扫两圈:
+  // 第一圈清掉referenced标记, 第二圈必然能选中
+  size_t slot_idx = bucket->hand;
+  for (size_t i = 0; i < 2 * _bucket_capacity; ++i) {
+    slot_idx = bucket->hand;
+    bucket->hand = (bucket->hand + 1) % _bucket_capacity;
+    auto& slot = bucket->slots[slot_idx];
+    if (!slot.valid || IsStale(slot, step) || !slot.referenced) {
+      break;
+    }
+    slot.referenced = false;
+  }
+  auto& slot = bucket->slots[slot_idx];
+  if (slot.in_index) {
+    bucket->index.erase(slot.key);
+    if (slot.invalidated_epoch > 0) {
+      AddTombstone(bucket, slot.key, slot.invalidated_epoch);
+    }
+  }
+  slot = Slot();
+  return slot_idx;
+}
+
+void SparsePullCache::AddTombstone(Bucket* bucket, uint64_t key,
+                                   uint64_t epoch) {
+  bucket->tombstones[key] = epoch;
+  bucket->tombstone_order.emplace_back(key, epoch);
+  while (bucket->tombstone_order.size() > kMaxBucketTombstones) {
+    auto& oldest = bucket->tombstone_order.front();
+    auto itr = bucket->tombstones.find(oldest.first);
+    // 同一个key后来又被push过时, 表中已是更新的epoch
+    if (itr != bucket->tombstones.end() && itr->second == oldest.second) {
+      bucket->tombstones.erase(itr);
+      if (oldest.second > bucket->evicted_epoch) {
+        bucket->evicted_epoch = oldest.second;
+      }
+    }
+    bucket->tombstone_order.pop_front();
+  }
+}
+
+void SparsePullCache::Invalidate(const uint64_t* keys, size_t num) {
+  // 先按桶聚合, 每个桶只加一次锁
+  std::array<std::vector<uint64_t>, kBucketNum> bucket_keys;
+  for (size_t i = 0; i < num; ++i) {
+    bucket_keys[BucketIdx(keys[i])].push_back(keys[i]);
+  }
+  for (size_t i = 0; i < kBucketNum; ++i) {
+    if (bucket_keys[i].empty()) {
+      continue;
+    }
+    auto& bucket = _buckets[i];
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    uint64_t epoch = ++bucket.epoch;
+    for (auto key : bucket_keys[i]) {
+      auto itr = bucket.index.find(key);
+      if (itr == bucket.index.end()) {
+        // 未缓存的key也要留下删除标记, 拦截在途的pull回包
+        AddTombstone(&bucket, key, epoch);
+        continue;
+      }
+      auto& slot = bucket.slots[itr->second];
+      slot.valid = false;
+      slot.referenced = false;
+      slot.invalidated_epoch = epoch;
+    }
+  }
+}
+
+size_t SparsePullCache::Size() {
+  size_t size = 0;
+  for (auto& bucket : _buckets) {
+    std::lock_guard<std::mutex> lock(bucket.mutex);
+    for (auto& item : bucket.index) {
+      size += bucket.slots[item.second].valid ? 1 : 0;
+    }
+  }
+  return size;
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,119 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// worker侧sparse表pull结果的热点缓存, 按key分桶加锁.
+// 每个桶容量固定, 满了以后按CLOCK淘汰: 命中过的entry多一轮存活机会,
+// 因此长期留下的是被反复pull的热点key.
+// step由trainer每个mini-batch调用AdvanceStep推进一次, entry在写入
+// max_staleness个step后失效; 从未调用AdvanceStep时每次pull推进step.
+// push时调用Invalidate删除对应key并留下带epoch的删除标记, 使push前发出的
+// 该key的pull请求回包不再写入缓存, 同桶其他key的回包不受影响.
+// 未缓存key的删除标记记在桶内的小表中, 不占value slot, 以免大批冷key的
+// push把热点entry挤出缓存.
+class SparsePullCache {
+ public:
+  static const size_t kBucketNum = 64;
+  // 每个桶最多保留的未缓存key删除标记数
+  static const size_t kMaxBucketTombstones = 256;
+  typedef std::array<uint64_t, kBucketNum> EpochSnapshot;
+
+  // capacity: 最多缓存的key数, value_size: 单个value的字节数
+  SparsePullCache(size_t capacity, size_t value_size, uint32_t max_staleness);
+
+  // 每个mini-batch调用一次
+  void AdvanceStep() {
+    _external_step = true;
+    _step.fetch_add(1);
+  }
+
+  // 返回本次pull使用的step
+  uint64_t PullStep() {
+    return _external_step ? _step.load() : _step.fetch_add(1);
+  }
+
+  void SnapshotEpochs(EpochSnapshot* epochs);
+
+  // 命中且未过期时拷贝value并返回true
+  bool Lookup(uint64_t key, uint64_t step, char* value);
+
+  // snapshot之后该key被push过时不写入
+  void Insert(uint64_t key, uint64_t step, const char* value,
+              const EpochSnapshot& epochs);
+
+  void Invalidate(const uint64_t* keys, size_t num);
+
+  // 有效的entry数, 不含删除标记
+  size_t Size();
+
+ private:
+  struct Slot {
+    uint64_t key = 0;
+    uint64_t step = 0;
+    // 最近一次push该key时的epoch, 0表示未被push过
+    uint64_t invalidated_epoch = 0;
+    bool in_index = false;
+    bool valid = false;
+    bool referenced = false;
+  };
+  struct Bucket {
+    std::mutex mutex;
+    uint64_t epoch = 0;
+    // 被丢弃的删除标记中最大的epoch, 早于它的snapshot无法判断是否被push过
+    uint64_t evicted_epoch = 0;
+    // 未缓存key的删除标记: key -> epoch, 按加入顺序淘汰
+    std::unordered_map<uint64_t, uint64_t> tombstones;
+    std::deque<std::pair<uint64_t, uint64_t>> tombstone_order;
+    std::unordered_map<uint64_t, uint32_t> index;
+    std::vector<Slot> slots;
+    std::vector<char> values;
+    size_t used = 0;
+    size_t hand = 0;
+  };
+
+  static size_t BucketIdx(uint64_t key) {
+    return (key * 0x9E3779B97F4A7C15ULL) >> 58;  // 高6位, kBucketNum = 64
+  }
+  bool IsStale(const Slot& slot, uint64_t step) const {
+    return step > slot.step && step - slot.step > _max_staleness;
+  }
+  // 找到key的slot, 不存在时分配一个(可能淘汰其他entry)
+  uint32_t FindOrAllocate(Bucket* bucket, uint64_t key, uint64_t step);
+  // CLOCK选出一个可复用的slot
+  uint32_t Evict(Bucket* bucket, uint64_t step);
+  // 记录未缓存key的删除标记, 超出上限时最早的标记并入evicted_epoch
+  void AddTombstone(Bucket* bucket, uint64_t key, uint64_t epoch);
+
+  size_t _bucket_capacity;
+  size_t _value_size;
+  uint32_t _max_staleness;
+  std::atomic<uint64_t> _step{0};
+  std::atomic<bool> _external_step{false};
+  std::array<Bucket, kBucketNum> _buckets;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,82 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/service/sparse_pull_dedup.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace paddle {
+namespace distributed {
+
+void DedupSparseKeysBySort(std::vector<std::pair<uint64_t, float *>> *kvs,
+                           SparsePullShardKeys *shard_keys) {
+  std::sort(kvs->begin(), kvs->end(),
+            [](const std::pair<uint64_t, float *> &k1,
+               const std::pair<uint64_t, float *> &k2) {
+              return k1.first < k2.first;
+            });
+  for (size_t kv_idx = 0; kv_idx < kvs->size(); ++kv_idx) {
+    auto &kv = kvs->at(kv_idx);
+    if (kv_idx > 0 && kv.first == kvs->at(kv_idx - 1).first) {
+      ++shard_keys->counts.back();
+      shard_keys->dup_values.push_back(
+          {shard_keys->keys.size() - 1, kv.second});
+      continue;
+    }
+    shard_keys->keys.push_back(kv.first);
+    shard_keys->counts.push_back(1);
+    shard_keys->values.push_back(kv.second);
+  }
+}
+
+void DedupSparseKeysByHash(
+    const std::vector<std::pair<uint64_t, float *>> &kvs,
+    SparsePullShardKeys *shard_keys) {
+  const uint32_t kEmpty = UINT32_MAX;
+  size_t capacity = 16;
+  while (capacity < kvs.size() * 2) {
+    capacity <<= 1;
+  }
+  thread_local std::vector<uint32_t> slots;
+  slots.assign(capacity, kEmpty);
+  size_t mask = capacity - 1;
+  for (auto &kv : kvs) {
+    size_t pos = (kv.first * 0x9E3779B97F4A7C15ULL) & mask;
+    while (slots[pos] != kEmpty && shard_keys->keys[slots[pos]] != kv.first) {
+      pos = (pos + 1) & mask;
+    }
+    if (slots[pos] != kEmpty) {
+      ++shard_keys->counts[slots[pos]];
+      shard_keys->dup_values.push_back({slots[pos], kv.second});
+      continue;
+    }
+    slots[pos] = shard_keys->keys.size();
+    shard_keys->keys.push_back(kv.first);
+    shard_keys->counts.push_back(1);
+    shard_keys->values.push_back(kv.second);
+  }
+}
+
+void CopyDupSparseValues(const SparsePullShardKeys &shard_keys,
+                         size_t value_size) {
+  for (auto &dup_value : shard_keys.dup_values) {
+    memcpy(reinterpret_cast<void *>(dup_value.second),
+           reinterpret_cast<void *>(shard_keys.values[dup_value.first]),
+           value_size);
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,48 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// PullSparse发往单个pserver的去重后的key
+struct SparsePullShardKeys {
+  std::vector<uint64_t> keys;    // 去重后的key
+  std::vector<uint32_t> counts;  // 每个key在batch中出现的次数
+  std::vector<float *> values;   // 每个key第一次出现位置的select_value
+  // 其余重复出现的位置: (keys中的下标, select_value)
+  std::vector<std::pair<uint32_t, float *>> dup_values;
+};
+
+// 排序后相邻比较去重, 小batch下常数更小; kvs会被按key排序
+void DedupSparseKeysBySort(std::vector<std::pair<uint64_t, float *>> *kvs,
+                           SparsePullShardKeys *shard_keys);
+
+// 线性探测的hash去重, O(n), 大batch下避免排序; key按首次出现的顺序发送
+void DedupSparseKeysByHash(
+    const std::vector<std::pair<uint64_t, float *>> &kvs,
+    SparsePullShardKeys *shard_keys);
+
+// 回包已写入每个key第一次出现的位置后, 拷贝到其余重复的位置
+void CopyDupSparseValues(const SparsePullShardKeys &shard_keys,
+                         size_t value_size);
+
+}  // namespace distributed
+}  // namespace paddle
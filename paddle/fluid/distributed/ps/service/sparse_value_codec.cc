@@ -0,0 +1,125 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/service/sparse_value_codec.h"
+
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+#include "paddle/fluid/platform/bfloat16.h"
+#include "paddle/fluid/platform/float16.h"
+
+namespace paddle {
+namespace distributed {
+
+SparseValueCodec::SparseValueCodec(ValueWireType wire_type, size_t dim,
+                                   size_t head_dim)
+    : _wire_type(wire_type), _dim(dim), _head_dim(std::min(head_dim, dim)) {
+  size_t embedx_dim = _dim - _head_dim;
+  _encoded_size = _head_dim * sizeof(float);
+  switch (_wire_type) {
+    case WIRE_FP16:
+    case WIRE_BF16:
+      _encoded_size += embedx_dim * sizeof(uint16_t);
+      break;
+    case WIRE_INT8:
+      _encoded_size += sizeof(float) + embedx_dim * sizeof(int8_t);
+      break;
+    default:
+      _encoded_size += embedx_dim * sizeof(float);
+      break;
+  }
+}
+
+void SparseValueCodec::Encode(const float* value, char* buffer) const {
+  memcpy(buffer, value, _head_dim * sizeof(float));
+  buffer += _head_dim * sizeof(float);
+  const float* embedx = value + _head_dim;
+  size_t embedx_dim = _dim - _head_dim;
+  switch (_wire_type) {
+    case WIRE_FP16: {
+      for (size_t i = 0; i < embedx_dim; ++i) {
+        platform::float16 h(embedx[i]);
+        memcpy(buffer + i * sizeof(uint16_t), &h, sizeof(uint16_t));
+      }
+      break;
+    }
+    case WIRE_BF16: {
+      for (size_t i = 0; i < embedx_dim; ++i) {
+        platform::bfloat16 h(embedx[i]);
+        memcpy(buffer + i * sizeof(uint16_t), &h, sizeof(uint16_t));
+      }
+      break;
+    }
+    case WIRE_INT8: {
+      float max_abs = 0.0;
+      for (size_t i = 0; i < embedx_dim; ++i) {
+        max_abs = std::max(max_abs, std::fabs(embedx[i]));
+      }
+      float scale = max_abs / 127.0;
+      memcpy(buffer, &scale, sizeof(float));
+      int8_t* quant = reinterpret_cast<int8_t*>(buffer + sizeof(float));
+      for (size_t i = 0; i < embedx_dim; ++i) {
+        float q = scale > 0 ? std::round(embedx[i] / scale) : 0;
+        quant[i] = static_cast<int8_t>(std::max(-127.0f, std::min(127.0f, q)));
+      }
+      break;
+    }
+    default:
+      memcpy(buffer, embedx, embedx_dim * sizeof(float));
+      break;
+  }
+}
+
+void SparseValueCodec::Decode(const char* buffer, float* value) const {
+  memcpy(value, buffer, _head_dim * sizeof(float));
+  buffer += _head_dim * sizeof(float);
+  float* embedx = value + _head_dim;
+  size_t embedx_dim = _dim - _head_dim;
+  switch (_wire_type) {
+    case WIRE_FP16: {
+      platform::float16 h;
+      for (size_t i = 0; i < embedx_dim; ++i) {
+        memcpy(&h, buffer + i * sizeof(uint16_t), sizeof(uint16_t));
+        embedx[i] = static_cast<float>(h);
+      }
+      break;
+    }
+    case WIRE_BF16: {
+      platform::bfloat16 h;
+      for (size_t i = 0; i < embedx_dim; ++i) {
+        memcpy(&h, buffer + i * sizeof(uint16_t), sizeof(uint16_t));
+        embedx[i] = static_cast<float>(h);
+      }
+      break;
+    }
+    case WIRE_INT8: {
+      float scale = 0.0;
+      memcpy(&scale, buffer, sizeof(float));
+      const int8_t* quant =
+          reinterpret_cast<const int8_t*>(buffer + sizeof(float));
+      for (size_t i = 0; i < embedx_dim; ++i) {
+        embedx[i] = quant[i] * scale;
+      }
+      break;
+    }
+    default:
+      memcpy(embedx, buffer, embedx_dim * sizeof(float));
+      break;
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,48 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "paddle/fluid/distributed/ps.pb.h"
+
+namespace paddle {
+namespace distributed {
+
+// sparse pull/push value的rpc编码. 前head_dim维(show/click/embed等统计量)
+// 始终以float传输, 之后的embedx部分按wire_type压缩:
+//   WIRE_FP16/WIRE_BF16: 每维2字节
+//   WIRE_INT8: 一个float的行内scale(max|x|/127) + 每维1字节
+// 编码后每条value定长, 为EncodedSize()字节.
+class SparseValueCodec {
+ public:
+  SparseValueCodec(ValueWireType wire_type, size_t dim, size_t head_dim);
+
+  ValueWireType wire_type() const { return _wire_type; }
+  size_t EncodedSize() const { return _encoded_size; }
+
+  void Encode(const float* value, char* buffer) const;
+  void Decode(const char* buffer, float* value) const;
+
+ private:
+  ValueWireType _wire_type;
+  size_t _dim;
+  size_t _head_dim;
+  size_t _encoded_size;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -88,6 +88,10 @@ class ValueAccessor {
   virtual int Initialize() = 0;
 
   virtual AccessorInfo GetAccessorInfo() { return _accessor_info; }
+  // pull/push value中embedx部分的起始维度, rpc低精度编码只作用于其后的维度,
+  // 之前的show/click等统计量保持float; 默认整条value都不压缩
+  virtual size_t SelectEmbedxIndex() { return _accessor_info.select_dim; }
+  virtual size_t UpdateEmbedxIndex() { return _accessor_info.update_dim; }
 
   virtual bool NeedExtendMF(float* value) { return false; }
   virtual bool HasMF(size_t size) { return false; }
@@ -111,6 +115,8 @@ class ValueAccessor {
   }
   // 判断该value是否进行shrink
   virtual bool Shrink(float* value) = 0;
+  // 判断该value是否保存到ssd
+  virtual bool SaveSSD(float* value) { return false; }
 
   // 判断该value是否在save阶段dump,
   // param作为参数用于标识save阶段，如downpour的xbox与batch_model
@@ -314,10 +314,16 @@ std::vector<Node *> GraphShard::get_batch(int start, int end, int step) {
   return res;
 }
 
-size_t GraphShard::get_size() { return bucket.size(); }
+size_t GraphShard::get_size() {
+  return csr != nullptr ? csr->size() : bucket.size();
+}
 
 int32_t GraphTable::add_graph_node(std::vector<int64_t> &id_list,
                                    std::vector<bool> &is_weight_list) {
+  if (use_csr) {
+    LOG(WARNING) << "can not add graph node to a csr graph table";
+    return -1;
+  }
   size_t node_size = id_list.size();
   std::vector<std::vector<std::pair<int64_t, bool>>> batch(task_pool_size_);
   for (size_t i = 0; i < node_size; i++) {
@@ -344,6 +350,10 @@ int32_t GraphTable::add_graph_node(std::vector<int64_t> &id_list,
 }
 
 int32_t GraphTable::remove_graph_node(std::vector<int64_t> &id_list) {
+  if (use_csr) {
+    LOG(WARNING) << "can not remove graph node from a csr graph table";
+    return -1;
+  }
   size_t node_size = id_list.size();
   std::vector<std::vector<int64_t>> batch(task_pool_size_);
   for (size_t i = 0; i < node_size; i++) {
@@ -372,6 +382,18 @@ void GraphShard::clear() {
   }
   bucket.clear();
   node_location.clear();
+  csr.reset();
+}
+
+void GraphShard::build_csr() {
+  if (csr != nullptr) return;
+  csr.reset(new CsrGraph());
+  csr->build(bucket);
+  for (size_t i = 0; i < bucket.size(); i++) {
+    delete bucket[i];
+  }
+  std::vector<Node *>().swap(bucket);
+  std::unordered_map<int64_t, int>().swap(node_location);
 }
 
 GraphShard::~GraphShard() { clear(); }
@@ -500,6 +522,10 @@ int32_t GraphTable::get_nodes_ids_by_ranges(
 }
 
 int32_t GraphTable::load_nodes(const std::string &path, std::string node_type) {
+  if (use_csr) {
+    LOG(WARNING) << "can not load nodes into a csr graph table";
+    return -1;
+  }
   auto paths = paddle::string::split_string<std::string>(path, ";");
   int64_t count = 0;
   int64_t valid_count = 0;
@@ -554,6 +580,10 @@ int32_t GraphTable::load_nodes(const std::string &path, std::string node_type) {
 }
 
 int32_t GraphTable::load_edges(const std::string &path, bool reverse_edge) {
+  if (use_csr) {
+    LOG(WARNING) << "can not load edges into a csr graph table";
+    return -1;
+  }
 #ifdef PADDLE_WITH_HETERPS
   if (gpups_mode) pthread_rwlock_rdlock(rw_lock.get());
 #endif
@@ -734,6 +764,57 @@ Node *GraphTable::find_node(int64_t id) {
   Node *node = shards[index]->find_node(id);
   return node;
 }
+
+CsrGraph *GraphTable::find_csr_node(int64_t id, size_t *idx) {
+  GraphShard *shard = nullptr;
+  size_t shard_id = id % shard_num;
+  if (shard_id >= shard_end || shard_id < shard_start) {
+    if (use_duplicate_nodes == false || extra_nodes_to_thread_index.size() == 0)
+      return nullptr;
+    auto iter = extra_nodes_to_thread_index.find(id);
+    if (iter == extra_nodes_to_thread_index.end()) return nullptr;
+    shard = extra_shards[iter->second];
+  } else {
+    shard = shards[shard_id - shard_start];
+  }
+  CsrGraph *csr = shard->get_csr();
+  if (csr == nullptr) return nullptr;
+  int64_t pos = csr->find(id);
+  if (pos < 0) return nullptr;
+  *idx = pos;
+  return csr;
+}
+
+int32_t GraphTable::build_csr() {
+#ifdef PADDLE_WITH_HETERPS
+  if (gpups_mode) {
+    LOG(WARNING) << "csr graph table is not supported in gpups mode";
+    return -1;
+  }
+#endif
+  std::vector<GraphShard *> all_shards(shards);
+  all_shards.insert(all_shards.end(), extra_shards.begin(), extra_shards.end());
+  std::vector<std::future<int>> tasks;
+  for (size_t i = 0; i < all_shards.size(); i++) {
+    tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
+        [this, &all_shards, i]() -> int {
+          all_shards[i]->build_csr();
+          all_shards[i]->get_csr()->build_alias(alias_min_degree);
+          return 0;
+        }));
+  }
+  for (size_t i = 0; i < tasks.size(); i++) tasks[i].get();
+  use_csr = true;
+  size_t node_num = 0, edge_num = 0, memory_size = 0;
+  for (auto *shard : all_shards) {
+    node_num += shard->get_csr()->size();
+    edge_num += shard->get_csr()->edge_size();
+    memory_size += shard->get_csr()->memory_size();
+  }
+  VLOG(0) << "graph table " << table_name << " built csr with " << node_num
+          << " nodes, " << edge_num << " edges, " << memory_size << " bytes";
+  return 0;
+}
 uint32_t GraphTable::get_thread_pool_index(int64_t node_id) {
   if (use_duplicate_nodes == false || extra_nodes_to_thread_index.size() == 0)
     return node_id % shard_num % shard_num_per_server % task_pool_size_;
@@ -767,6 +848,7 @@ int32_t GraphTable::clear_nodes() {
     }));
   }
   for (size_t i = 0; i < tasks.size(); i++) tasks[i].get();
+  use_csr = false;
   return 0;
 }
 
@@ -835,11 +917,99 @@ int32_t GraphTable::random_sample_nodes(int sample_size,
   memcpy(pointer, res.data(), actual_size);
   return 0;
 }
+int32_t GraphTable::batch_sample_neighbors(const int64_t *node_ids,
+                                           size_t node_num, int sample_size,
+                                           bool need_weight,
+                                           std::vector<int> &actual_sizes,
+                                           std::unique_ptr<char[]> &buffer) {
+  if (!use_csr) {
+    LOG(WARNING) << "batch_sample_neighbors requires a csr graph table";
+    return -1;
+  }
+  if (sample_size < 0) sample_size = 0;
+  actual_sizes.assign(node_num, 0);
+  std::vector<std::vector<uint32_t>> seq_id(task_pool_size_);
+  for (size_t idx = 0; idx < node_num; ++idx) {
+    seq_id[get_thread_pool_index(node_ids[idx])].push_back(idx);
+  }
+  int item_size = need_weight ? Node::id_size + Node::weight_size
+                              : Node::id_size;
+  // pass 1: locate nodes and size their results
+  std::vector<CsrGraph *> csrs(node_num, nullptr);
+  std::vector<size_t> csr_idx(node_num, 0);
+  std::vector<std::future<int>> tasks;
+  for (int i = 0; i < (int)seq_id.size(); i++) {
+    if (seq_id[i].size() == 0) continue;
+    tasks.push_back(_shards_task_pool[i]->enqueue([&, i]() -> int {
+      for (uint32_t idx : seq_id[i]) {
+        csrs[idx] = find_csr_node(node_ids[idx], &csr_idx[idx]);
+        if (csrs[idx] != nullptr) {
+          actual_sizes[idx] =
+              std::min<size_t>(sample_size,
+                               csrs[idx]->get_neighbor_size(csr_idx[idx])) *
+              item_size;
+        }
+      }
+      return 0;
+    }));
+  }
+  for (auto &t : tasks) t.get();
+  tasks.clear();
+  std::vector<size_t> offsets(node_num + 1, 0);
+  for (size_t idx = 0; idx < node_num; ++idx) {
+    offsets[idx + 1] = offsets[idx] + actual_sizes[idx];
+  }
+  buffer.reset(new char[offsets[node_num]]);
+  char *buffer_addr = buffer.get();
+  // pass 2: every thread samples its nodes straight into the shared buffer,
+  // its CounterRng is keyed once per request from the thread's engine
+  for (int i = 0; i < (int)seq_id.size(); i++) {
+    if (seq_id[i].size() == 0) continue;
+    tasks.push_back(_shards_task_pool[i]->enqueue([&, i]() -> int {
+      CounterRng rng((*_shards_task_rng_pool[i])());
+      std::vector<int> res(sample_size);
+      for (uint32_t idx : seq_id[i]) {
+        CsrGraph *csr = csrs[idx];
+        if (csr == nullptr) continue;
+        int count = csr->sample_k(csr_idx[idx], sample_size, &rng, res.data());
+        char *out = buffer_addr + offsets[idx];
+        for (int k = 0; k < count; ++k) {
+          uint64_t id = csr->get_neighbor_id(csr_idx[idx], res[k]);
+          memcpy(out, &id, Node::id_size);
+          out += Node::id_size;
+          if (need_weight) {
+            float weight = csr->get_neighbor_weight(csr_idx[idx], res[k]);
+            memcpy(out, &weight, Node::weight_size);
+            out += Node::weight_size;
+          }
+        }
+      }
+      return 0;
+    }));
+  }
+  for (auto &t : tasks) t.get();
+  return 0;
+}
+
 int32_t GraphTable::random_sample_neighbors(
     int64_t *node_ids, int sample_size,
     std::vector<std::shared_ptr<char>> &buffers, std::vector<int> &actual_sizes,
     bool need_weight) {
   size_t node_num = buffers.size();
+  if (use_csr && !use_cache) {
+    // one batch for the whole list, buffers alias slices of a shared block
+    std::unique_ptr<char[]> batch_buffer;
+    batch_sample_neighbors(node_ids, node_num, sample_size, need_weight,
+                           actual_sizes, batch_buffer);
+    std::shared_ptr<char> block(batch_buffer.release(),
+                                [](char *p) { delete[] p; });
+    size_t offset = 0;
+    for (size_t idx = 0; idx < node_num; ++idx) {
+      buffers[idx] = std::shared_ptr<char>(block, block.get() + offset);
+      offset += actual_sizes[idx];
+    }
+    return 0;
+  }
   std::function<void(char *)> char_del = [](char *c) { delete[] c; };
   std::vector<std::future<int>> tasks;
   std::vector<std::vector<uint32_t>> seq_id(task_pool_size_);
@@ -865,6 +1035,8 @@ int32_t GraphTable::random_sample_neighbors(
       std::vector<SampleResult> sample_res;
       std::vector<SampleKey> sample_keys;
       auto &rng = _shards_task_rng_pool[i];
+      CounterRng csr_rng((*rng)());
+      std::vector<int> csr_res;
       for (size_t k = 0; k < id_list[i].size(); k++) {
         if (index < (int)r.size() &&
             r[index].first.node_key == id_list[i][k].node_key) {
@@ -874,15 +1046,31 @@ int32_t GraphTable::random_sample_neighbors(
           index++;
         } else {
           node_id = id_list[i][k].node_key;
-          Node *node = find_node(node_id);
+          Node *node = nullptr;
+          CsrGraph *csr = nullptr;
+          size_t csr_idx = 0;
+          if (use_csr) {
+            csr = find_csr_node(node_id, &csr_idx);
+          } else {
+            node = find_node(node_id);
+          }
           idx = seq_id[i][k];
           int &actual_size = actual_sizes[idx];
-          if (node == nullptr) {
+          if (node == nullptr && csr == nullptr) {
             actual_size = 0;
             continue;
           }
           std::shared_ptr<char> &buffer = buffers[idx];
-          std::vector<int> res = node->sample_k(sample_size, rng);
+          std::vector<int> res;
+          if (csr != nullptr) {
+            csr_res.resize(sample_size);
+            res.assign(csr_res.begin(),
+                       csr_res.begin() + csr->sample_k(csr_idx, sample_size,
+                                                       &csr_rng,
+                                                       csr_res.data()));
+          } else {
+            res = node->sample_k(sample_size, rng);
+          }
           actual_size =
               res.size() * (need_weight ? (Node::id_size + Node::weight_size)
                                         : Node::id_size);
@@ -898,11 +1086,13 @@ int32_t GraphTable::random_sample_neighbors(
             buffer.reset(buffer_addr, char_del);
           }
           for (int &x : res) {
-            id = node->get_neighbor_id(x);
+            id = csr != nullptr ? csr->get_neighbor_id(csr_idx, x)
+                                : node->get_neighbor_id(x);
             memcpy(buffer_addr + offset, &id, Node::id_size);
             offset += Node::id_size;
             if (need_weight) {
-              weight = node->get_neighbor_weight(x);
+              weight = csr != nullptr ? csr->get_neighbor_weight(csr_idx, x)
+                                      : node->get_neighbor_weight(x);
               memcpy(buffer_addr + offset, &weight, Node::weight_size);
               offset += Node::weight_size;
             }
@@ -931,9 +1121,16 @@ int32_t GraphTable::get_node_feat(const std::vector<int64_t> &node_ids,
     int64_t node_id = node_ids[idx];
     tasks.push_back(_shards_task_pool[get_thread_pool_index(node_id)]->enqueue(
         [&, idx, node_id]() -> int {
-          Node *node = find_node(node_id);
+          Node *node = nullptr;
+          CsrGraph *csr = nullptr;
+          size_t csr_idx = 0;
+          if (use_csr) {
+            csr = find_csr_node(node_id, &csr_idx);
+          } else {
+            node = find_node(node_id);
+          }
 
-          if (node == nullptr) {
+          if (node == nullptr && csr == nullptr) {
             return 0;
           }
           for (int feat_idx = 0; feat_idx < (int)feature_names.size();
@@ -942,7 +1139,9 @@ int32_t GraphTable::get_node_feat(const std::vector<int64_t> &node_ids,
             if (feat_id_map.find(feature_name) != feat_id_map.end()) {
               // res[feat_idx][idx] =
               // node->get_feature(feat_id_map[feature_name]);
-              auto feat = node->get_feature(feat_id_map[feature_name]);
+              int feat_id = feat_id_map[feature_name];
+              auto feat = csr != nullptr ? csr->get_feature(csr_idx, feat_id)
+                                         : node->get_feature(feat_id);
               res[feat_idx][idx] = feat;
             }
           }
@@ -959,6 +1158,10 @@ int32_t GraphTable::set_node_feat(
     const std::vector<int64_t> &node_ids,
     const std::vector<std::string> &feature_names,
     const std::vector<std::vector<std::string>> &res) {
+  if (use_csr) {
+    LOG(WARNING) << "can not set node feature of a csr graph table";
+    return -1;
+  }
   size_t node_num = node_ids.size();
   std::vector<std::future<int>> tasks;
   for (size_t idx = 0; idx < node_num; ++idx) {
@@ -1023,6 +1226,7 @@ int32_t GraphTable::pull_graph_list(int start, int total_size,
   if (start < 0) start = 0;
   int size = 0, cur_size;
   std::vector<std::future<std::vector<Node *>>> tasks;
+  std::vector<std::future<std::string>> csr_tasks;
   for (size_t i = 0; i < shards.size() && total_size > 0; i++) {
     cur_size = shards[i]->get_size();
     if (size + cur_size <= start) {
@@ -1031,14 +1235,46 @@ int32_t GraphTable::pull_graph_list(int start, int total_size,
     }
     int count = std::min(1 + (size + cur_size - start - 1) / step, total_size);
     int end = start + (count - 1) * step + 1;
-    tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
-        [this, i, start, end, step, size]() -> std::vector<Node *> {
-          return this->shards[i]->get_batch(start - size, end - size, step);
-        }));
+    if (use_csr) {
+      // csr shards have no Node objects, serialize inside the shard thread
+      csr_tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
+          [this, i, start, end, step, size, need_feature]() -> std::string {
+            CsrGraph *csr = this->shards[i]->get_csr();
+            std::string res;
+            int csr_end = std::min(end - size, (int)csr->size());
+            for (int pos = start - size; pos < csr_end; pos += step) {
+              size_t offset = res.size();
+              res.resize(offset + csr->get_size(pos, need_feature));
+              csr->to_buffer(pos, &res[offset], need_feature);
+            }
+            return res;
+          }));
+    } else {
+      tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
+          [this, i, start, end, step, size]() -> std::vector<Node *> {
+            return this->shards[i]->get_batch(start - size, end - size, step);
+          }));
+    }
     start += count * step;
     total_size -= count;
     size += cur_size;
   }
+  if (use_csr) {
+    std::vector<std::string> res(csr_tasks.size());
+    size = 0;
+    for (size_t i = 0; i < csr_tasks.size(); i++) {
+      res[i] = csr_tasks[i].get();
+      size += res[i].size();
+    }
+    char *buffer_addr = new char[size];
+    buffer.reset(buffer_addr);
+    for (size_t i = 0; i < res.size(); i++) {
+      memcpy(buffer_addr, res[i].data(), res[i].size());
+      buffer_addr += res[i].size();
+    }
+    actual_size = size;
+    return 0;
+  }
   for (size_t i = 0; i < tasks.size(); ++i) {
     tasks[i].wait();
   }
@@ -1104,6 +1340,7 @@ int32_t GraphTable::Initialize(const GraphParameter &graph) {
     shard_num = graph.shard_num();
   }
   task_pool_size_ = graph.task_pool_size();
+  alias_min_degree = graph.alias_sample_min_degree();
   use_cache = graph.use_cache();
   if (use_cache) {
     cache_size_limit = graph.cache_size_limit();
@@ -39,6 +39,7 @@
 #include "paddle/fluid/distributed/ps/table/accessor.h"
 #include "paddle/fluid/distributed/ps/table/common_table.h"
 #include "paddle/fluid/distributed/ps/table/graph/class_macro.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr.h"
 #include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
 #include "paddle/fluid/string/string_helper.h"
 #include "paddle/phi/core/utils/rw_lock.h"
@@ -57,6 +58,12 @@ class GraphShard {
   std::vector<Node *> get_batch(int start, int end, int step);
   std::vector<int64_t> get_ids_by_range(int start, int end) {
     std::vector<int64_t> res;
+    if (csr != nullptr) {
+      for (int i = start; i < end && i < (int)csr->size(); i++) {
+        res.push_back(csr->get_id(i));
+      }
+      return res;
+    }
     for (int i = start; i < end && i < (int)bucket.size(); i++) {
       res.push_back(bucket[i]->get_id());
     }
@@ -74,9 +81,15 @@ class GraphShard {
     return node_location;
   }
 
+  // convert the nodes in bucket into a read-only CsrGraph and free them,
+  // nodes can not be added or removed afterwards
+  void build_csr();
+  CsrGraph *get_csr() { return csr.get(); }
+
  private:
   std::unordered_map<int64_t, int> node_location;
   std::vector<Node *> bucket;
+  std::unique_ptr<CsrGraph> csr;
 };
 
 enum LRUResponse { ok = 0, blocked = 1, err = 2 };
@@ -408,6 +421,7 @@ class GraphTable : public Table {
  public:
   GraphTable() {
     use_cache = false;
+    use_csr = false;
     shard_num = 0;
 #ifdef PADDLE_WITH_HETERPS
     gpups_mode = false;
@@ -442,6 +456,13 @@ class GraphTable : public Table {
       std::vector<std::shared_ptr<char>> &buffers,
       std::vector<int> &actual_sizes, bool need_weight);
 
+  // csr only: samples the whole node list in one pass per thread and writes
+  // the results back to back into buffer, actual_sizes[i] bytes for node i
+  int32_t batch_sample_neighbors(const int64_t *node_ids, size_t node_num,
+                                 int sample_size, bool need_weight,
+                                 std::vector<int> &actual_sizes,
+                                 std::unique_ptr<char[]> &buffer);
+
   int32_t random_sample_nodes(int sample_size, std::unique_ptr<char[]> &buffers,
                               int &actual_sizes);
 
@@ -465,6 +486,15 @@ class GraphTable : public Table {
 
   int32_t get_server_index_by_id(int64_t id);
   Node *find_node(int64_t id);
+  // after build_csr, returns the CsrGraph holding id and sets *idx,
+  // nullptr if id is not found
+  CsrGraph *find_csr_node(int64_t id, size_t *idx);
+
+  // freeze the loaded graph into CSR shards, see CsrGraph. load/add/remove
+  // and set_node_feat fail until clear_nodes is called
+  int32_t build_csr();
+  bool is_csr() { return use_csr; }
+  bool is_sample_cache_enabled() { return use_cache; }
 
   virtual int32_t Pull(TableContext &context) { return 0; }
   virtual int32_t Push(TableContext &context) { return 0; }
@@ -549,6 +579,8 @@ class GraphTable : public Table {
   std::unordered_set<int64_t> extra_nodes;
   std::unordered_map<int64_t, size_t> extra_nodes_to_thread_index;
   bool use_cache, use_duplicate_nodes;
+  bool use_csr;
+  int alias_min_degree = 64;
   int cache_size_limit;
   int cache_ttl;
   mutable std::mutex mutex_;
@@ -136,10 +136,16 @@ class CtrCommonAccessor : public ValueAccessor {
   virtual int Initialize();
   // 初始化AccessorInfo
   virtual void InitAccessorInfo();
+  size_t SelectEmbedxIndex() override {
+    return CtrCommonPullValue::EmbedxWIndex();
+  }
+  size_t UpdateEmbedxIndex() override {
+    return CtrCommonPushValue::EmbedxGIndex();
+  }
   // 判断该value是否进行shrink
   virtual bool Shrink(float* value);
   // 判断该value是否保存到ssd
-  // virtual bool save_ssd(float* value);
+  bool SaveSSD(float* value) override;
   virtual bool NeedExtendMF(float* value);
   virtual bool HasMF(size_t size);
   // 判断该value是否在save阶段dump,
@@ -170,6 +170,12 @@ class DownpourCtrDoubleAccessor : public ValueAccessor {
   virtual int Initialize();
   // 初始化AccessorInfo
   virtual void InitAccessorInfo();
+  size_t SelectEmbedxIndex() override {
+    return DownpourCtrDoublePullValue::EmbedxWIndex();
+  }
+  size_t UpdateEmbedxIndex() override {
+    return DownpourCtrDoublePushValue::EmbedxGIndex();
+  }
   // 判断该value是否进行shrink
   virtual bool Shrink(float* value);
   virtual bool NeedExtendMF(float* value);
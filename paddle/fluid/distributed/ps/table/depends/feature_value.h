@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include <functional>
 #include <vector>
 #include "gflags/gflags.h"
 
@@ -40,11 +41,59 @@ class FixedFeatureValue {
   std::vector<float> _data;
 };
 
-template <class KEY, class VALUE>
+// 定长value: 仅在头部记录当前长度和容量, 数据紧随其后存放在shard的slab中.
+// 容量为建表时设置到SlabAllocator上的extra size (accessor的value size),
+// 由SlabAllocator在构造时传入, resize 只修改长度, 且不能超过容量.
+class SlabFeatureValue {
+ public:
+  explicit SlabFeatureValue(size_t capacity_bytes)
+      : _size(0),
+        _dirty(0),
+        _capacity(static_cast<uint32_t>(capacity_bytes / sizeof(float))) {}
+  ~SlabFeatureValue() {}
+  SlabFeatureValue(const SlabFeatureValue&) = delete;
+  SlabFeatureValue& operator=(const SlabFeatureValue&) = delete;
+  float* data() { return reinterpret_cast<float*>(this + 1); }
+  size_t size() { return _size; }
+  size_t capacity() { return _capacity; }
+  void resize(size_t size) {
+    CHECK_LE(size, _capacity) << "SlabFeatureValue resize beyond capacity";
+    _size = static_cast<uint32_t>(size);
+  }
+  void shrink_to_fit() {}
+  // 自上次checkpoint后是否被修改过, 用于增量保存
+  bool is_dirty() { return _dirty; }
+  void set_dirty(bool dirty) { _dirty = dirty; }
+
+ private:
+  uint32_t _size : 31;
+  uint32_t _dirty : 1;
+  uint32_t _capacity;
+};
+
+// libstdc++ 的 std::hash<uint64_t> 是恒等映射, 而 compute_bucket 取 hash
+// 的高位选桶, 高位相同的 feasign 会全部落到同一个桶里. 这里在 std::hash
+// 之上再做一次 murmur3 fmix64 混淆, 使高低位都均匀分布.
+template <class KEY>
+struct SparseKeyHasher {
+  size_t operator()(const KEY& key) const {
+    uint64_t h = static_cast<uint64_t>(std::hash<KEY>()(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb3f99cd9f6e3ULL;
+    h ^= h >> 33;
+    return static_cast<size_t>(h);
+  }
+};
+
+// HASHER 同时用于选桶和桶内的 closed_hash_map 寻址;
+// closed_hash_map 为开放寻址, key 与 value 指针存放在同一个槽位中.
+template <class KEY, class VALUE, class HASHER = SparseKeyHasher<KEY>,
+          class ALLOC = ChunkAllocator<VALUE>>
 struct alignas(64) SparseTableShard {
  public:
-  typedef typename mct::closed_hash_map<KEY, mct::Pointer, std::hash<KEY>>
-      map_type;
+  typedef typename mct::closed_hash_map<KEY, mct::Pointer, HASHER> map_type;
   struct iterator {
     typename map_type::iterator it;
     size_t bucket;
@@ -100,6 +149,7 @@ struct alignas(64) SparseTableShard {
     }
   }
   size_t bucket_count() { return CTR_SPARSE_SHARD_BUCKET_NUM; }
+  ALLOC& allocator() { return _alloc; }
   size_t bucket_size(size_t bucket) { return _buckets[bucket].size(); }
   void clear() {
     for (size_t bucket = 0; bucket < CTR_SPARSE_SHARD_BUCKET_NUM; bucket++) {
@@ -193,8 +243,8 @@ struct alignas(64) SparseTableShard {
 
  private:
   map_type _buckets[CTR_SPARSE_SHARD_BUCKET_NUM];
-  ChunkAllocator<VALUE> _alloc;
-  std::hash<KEY> _hasher;
+  ALLOC _alloc;
+  HASHER _hasher;
 };
 
 }  // namespace distributed
@@ -12,7 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#pragma once
 #ifdef PADDLE_WITH_HETERPS
+#include <dirent.h>
 #include <glog/logging.h>
 #include <rocksdb/db.h>
 #include <rocksdb/filter_policy.h>
@@ -20,8 +22,10 @@
 #include <rocksdb/slice.h>
 #include <rocksdb/table.h>
 #include <rocksdb/write_batch.h>
+#include <cerrno>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace paddle {
 namespace distributed {
@@ -29,7 +33,12 @@ namespace distributed {
 class RocksDBHandler {
  public:
   RocksDBHandler() {}
-  ~RocksDBHandler() {}
+  ~RocksDBHandler() {
+    for (auto* handle : _handles) {
+      _db->DestroyColumnFamilyHandle(handle);
+    }
+    delete _db;
+  }
 
   static RocksDBHandler* GetInstance() {
     static RocksDBHandler handler;
@@ -72,13 +81,23 @@ class RocksDBHandler {
     options.level0_stop_writes_trigger =
         3.6 * options.level0_file_num_compaction_trigger;
 
-    if (!db_path.empty()) {
-      std::string rm_cmd = "rm -rf " + db_path;
-      system(rm_cmd.c_str());
+    // 只通过rocksdb接口清理上次运行留下的db, 不删除其他文件
+    if (!IsEmptyOrRocksDB(db_path)) {
+      LOG(ERROR) << "db path " << db_path
+                 << " is not empty and not a rocksdb directory";
+      return -1;
+    }
+    rocksdb::Status s = rocksdb::DestroyDB(db_path, options);
+    if (!s.ok()) {
+      LOG(ERROR) << "destroy db " << db_path << " failed: " << s.ToString();
+      return -1;
     }
 
-    rocksdb::Status s = rocksdb::DB::Open(options, db_path, &_db);
-    assert(s.ok());
+    s = rocksdb::DB::Open(options, db_path, &_db);
+    if (!s.ok()) {
+      LOG(ERROR) << "open db " << db_path << " failed: " << s.ToString();
+      return -1;
+    }
     _handles.resize(colnum);
     for (int i = 0; i < colnum; i++) {
       s = _db->CreateColumnFamily(options, "shard_" + std::to_string(i),
@@ -150,9 +169,31 @@ class RocksDBHandler {
   }
 
  private:
+  // 路径不存在, 为空目录, 或含有rocksdb的CURRENT文件时返回true
+  static bool IsEmptyOrRocksDB(const std::string& db_path) {
+    DIR* dir = opendir(db_path.c_str());
+    if (dir == nullptr) {
+      return errno == ENOENT;
+    }
+    bool empty = true;
+    bool has_current = false;
+    while (struct dirent* entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name == "." || name == "..") {
+        continue;
+      }
+      empty = false;
+      if (name == "CURRENT") {
+        has_current = true;
+      }
+    }
+    closedir(dir);
+    return empty || has_current;
+  }
+
   std::vector<rocksdb::ColumnFamilyHandle*> _handles;
-  rocksdb::DB* _db;
+  rocksdb::DB* _db = nullptr;
 };
-}
-}
+}  // namespace distributed
+}  // namespace paddle
 #endif
@@ -0,0 +1,273 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_set>
+#include <utility>
+namespace paddle {
+namespace distributed {
+
+void CsrGraph::build(const std::vector<Node *> &nodes) {
+  std::vector<Node *> sorted_nodes(nodes);
+  std::sort(sorted_nodes.begin(), sorted_nodes.end(),
+            [](Node *a, Node *b) { return a->get_id() < b->get_id(); });
+  size_t node_num = sorted_nodes.size();
+  size_t edge_num = 0, feat_num = 0, feat_bytes = 0;
+  bool weighted = false;
+  for (auto *node : sorted_nodes) {
+    size_t degree = node->get_neighbor_size();
+    edge_num += degree;
+    for (size_t k = 0; k < degree && !weighted; ++k) {
+      weighted = node->get_neighbor_weight(k) != 1.;
+    }
+    int node_feat_num = node->get_feature_size();
+    feat_num += node_feat_num;
+    for (int f = 0; f < node_feat_num; ++f) {
+      feat_bytes += node->get_feature(f).size();
+    }
+  }
+
+  id_arr.clear();
+  id_arr.reserve(node_num);
+  offset_arr.assign(1, 0);
+  offset_arr.reserve(node_num + 1);
+  neighbor_arr.clear();
+  neighbor_arr.reserve(edge_num);
+  weight_arr.clear();
+  if (weighted) {
+    weight_arr.reserve(edge_num);
+  }
+  feat_index_arr.assign(1, 0);
+  feat_index_arr.reserve(node_num + 1);
+  feat_offset_arr.assign(1, 0);
+  feat_offset_arr.reserve(feat_num + 1);
+  feat_data.clear();
+  feat_data.reserve(feat_bytes);
+
+  for (auto *node : sorted_nodes) {
+    id_arr.push_back(node->get_id());
+    size_t degree = node->get_neighbor_size();
+    for (size_t k = 0; k < degree; ++k) {
+      neighbor_arr.push_back(node->get_neighbor_id(k));
+      if (weighted) {
+        weight_arr.push_back(node->get_neighbor_weight(k));
+      }
+    }
+    offset_arr.push_back(neighbor_arr.size());
+    int node_feat_num = node->get_feature_size();
+    for (int f = 0; f < node_feat_num; ++f) {
+      feat_data.append(node->get_feature(f));
+      feat_offset_arr.push_back(feat_data.size());
+    }
+    feat_index_arr.push_back(feat_offset_arr.size() - 1);
+  }
+}
+
+size_t CsrGraph::memory_size() const {
+  return id_arr.capacity() * sizeof(uint64_t) +
+         offset_arr.capacity() * sizeof(uint64_t) +
+         neighbor_arr.capacity() * sizeof(uint64_t) +
+         weight_arr.capacity() * sizeof(float) +
+         alias_prob_arr.capacity() * sizeof(float) +
+         alias_arr.capacity() * sizeof(uint32_t) +
+         alias_offset_arr.capacity() * sizeof(uint64_t) +
+         feat_index_arr.capacity() * sizeof(uint32_t) +
+         feat_offset_arr.capacity() * sizeof(uint64_t) + feat_data.capacity();
+}
+
+int64_t CsrGraph::find(uint64_t id) const {
+  auto iter = std::lower_bound(id_arr.begin(), id_arr.end(), id);
+  if (iter == id_arr.end() || *iter != id) {
+    return -1;
+  }
+  return iter - id_arr.begin();
+}
+
+void CsrGraph::build_alias(size_t min_degree) {
+  std::vector<uint64_t>().swap(alias_offset_arr);
+  std::vector<float>().swap(alias_prob_arr);
+  std::vector<uint32_t>().swap(alias_arr);
+  if (weight_arr.empty() || min_degree == 0) return;
+  // only the edges of nodes with degree >= min_degree and positive total
+  // weight get alias slots
+  alias_offset_arr.assign(1, 0);
+  alias_offset_arr.reserve(size() + 1);
+  for (size_t idx = 0; idx < size(); ++idx) {
+    size_t n = get_neighbor_size(idx);
+    const float *weights = weight_arr.data() + offset_arr[idx];
+    bool positive = false;
+    if (n >= min_degree) {
+      for (size_t i = 0; i < n && !positive; ++i) positive = weights[i] > 0;
+    }
+    alias_offset_arr.push_back(alias_offset_arr.back() + (positive ? n : 0));
+  }
+  if (alias_offset_arr.back() == 0) {
+    std::vector<uint64_t>().swap(alias_offset_arr);
+    return;
+  }
+  alias_prob_arr.resize(alias_offset_arr.back());
+  alias_arr.resize(alias_offset_arr.back());
+  std::vector<uint32_t> small, large;
+  for (size_t idx = 0; idx < size(); ++idx) {
+    size_t n = alias_offset_arr[idx + 1] - alias_offset_arr[idx];
+    if (n == 0) continue;
+    const float *weights = weight_arr.data() + offset_arr[idx];
+    float *prob = alias_prob_arr.data() + alias_offset_arr[idx];
+    uint32_t *alias = alias_arr.data() + alias_offset_arr[idx];
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) sum += std::max(weights[i], 0.f);
+    small.clear();
+    large.clear();
+    for (size_t i = 0; i < n; ++i) {
+      prob[i] = std::max(weights[i], 0.f) * n / sum;
+      alias[i] = i;
+      (prob[i] < 1 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+      uint32_t s = small.back(), l = large.back();
+      small.pop_back();
+      alias[s] = l;
+      prob[l] -= 1 - prob[s];
+      if (prob[l] < 1) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    // numerical leftovers are full columns
+    for (uint32_t l : large) prob[l] = 1;
+    for (uint32_t s : small) prob[s] = 1;
+  }
+}
+
+static inline bool contains(const int *res, int size, int value) {
+  for (int i = 0; i < size; ++i) {
+    if (res[i] == value) return true;
+  }
+  return false;
+}
+
+int CsrGraph::sample_k(size_t idx, int k, CounterRng *rng, int *res) const {
+  int n = get_neighbor_size(idx);
+  if (k >= n) {
+    for (int i = 0; i < n; i++) {
+      res[i] = i;
+    }
+    return n;
+  }
+  // small k probes res linearly, larger k keeps a hash set of picks
+  const int linear_limit = 32;
+  thread_local std::unordered_set<int> picked;
+  picked.clear();
+  auto is_picked = [&](int count, int value) {
+    return k <= linear_limit ? contains(res, count, value)
+                             : picked.count(value) > 0;
+  };
+  auto pick = [&](int count, int value) {
+    res[count] = value;
+    if (k > linear_limit) picked.insert(value);
+  };
+  int count = 0;
+  if (weight_arr.empty()) {
+    // Floyd's algorithm: k draws for k distinct positions
+    for (int j = n - k; j < n; ++j) {
+      int t = rng->next_int(j + 1);
+      pick(count, is_picked(count, t) ? j : t);
+      ++count;
+    }
+    return count;
+  }
+  if (!alias_offset_arr.empty() &&
+      alias_offset_arr[idx + 1] > alias_offset_arr[idx] && 2 * k <= n) {
+    // draw with replacement from the alias table and reject repeats, the
+    // same as drawing from the renormalized weights of the unpicked edges
+    const float *prob = alias_prob_arr.data() + alias_offset_arr[idx];
+    const uint32_t *alias = alias_arr.data() + alias_offset_arr[idx];
+    int max_draw = 16 * k;
+    for (int draw = 0; draw < max_draw && count < k; ++draw) {
+      uint32_t col = rng->next_int(n);
+      int t = rng->next_double() < prob[col] ? col : alias[col];
+      if (!is_picked(count, t)) {
+        pick(count, t);
+        ++count;
+      }
+    }
+    if (count == k) return count;
+    // too many rejections (few heavy edges), fall back to exponential keys
+    count = 0;
+    picked.clear();
+  }
+  // weighted sampling without replacement (Efraimidis-Spirakis):
+  // keep the k edges with the largest log(u) / weight
+  const float *weights = weight_arr.data() + offset_arr[idx];
+  thread_local std::vector<std::pair<double, int>> keys;
+  keys.resize(n);
+  for (int i = 0; i < n; i++) {
+    double u = std::max(rng->next_double(), 1e-300);
+    keys[i].first = weights[i] > 0 ? std::log(u) / weights[i]
+                                   : -std::numeric_limits<double>::infinity();
+    keys[i].second = i;
+  }
+  std::partial_sort(keys.begin(), keys.begin() + k, keys.end(),
+                    [](const std::pair<double, int> &a,
+                       const std::pair<double, int> &b) {
+                      return a.first > b.first;
+                    });
+  for (int i = 0; i < k; i++) {
+    res[i] = keys[i].second;
+  }
+  return k;
+}
+
+std::string CsrGraph::get_feature(size_t idx, int feat_idx) const {
+  if (feat_idx >= get_feature_size(idx)) {
+    return std::string("");
+  }
+  size_t pos = feat_index_arr[idx] + feat_idx;
+  return feat_data.substr(feat_offset_arr[pos],
+                          feat_offset_arr[pos + 1] - feat_offset_arr[pos]);
+}
+
+int CsrGraph::get_size(size_t idx, bool need_feature) const {
+  int size = Node::id_size + Node::int_size;  // id, feat_num
+  if (need_feature) {
+    size_t begin = feat_index_arr[idx], end = feat_index_arr[idx + 1];
+    size += (end - begin) * Node::int_size;
+    size += feat_offset_arr[end] - feat_offset_arr[begin];
+  }
+  return size;
+}
+
+void CsrGraph::to_buffer(size_t idx, char *buffer, bool need_feature) const {
+  memcpy(buffer, &id_arr[idx], Node::id_size);
+  buffer += Node::id_size;
+
+  int feat_num = need_feature ? get_feature_size(idx) : 0;
+  memcpy(buffer, &feat_num, sizeof(int));
+  buffer += sizeof(int);
+  for (int i = 0; i < feat_num; ++i) {
+    size_t pos = feat_index_arr[idx] + i;
+    int feat_len = feat_offset_arr[pos + 1] - feat_offset_arr[pos];
+    memcpy(buffer, &feat_len, sizeof(int));
+    buffer += sizeof(int);
+    memcpy(buffer, feat_data.data() + feat_offset_arr[pos], feat_len);
+    buffer += feat_len;
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,113 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
+namespace paddle {
+namespace distributed {
+
+// Counter-based rng: the n-th draw is splitmix64(key + n * golden), so a
+// sampling thread only keeps a key and a counter and never shares state.
+class CounterRng {
+ public:
+  explicit CounterRng(uint64_t key) : key(key), counter(0) {}
+  uint64_t next() {
+    uint64_t z = key + (++counter) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+  // uniform in [0, n)
+  uint32_t next_int(uint32_t n) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(next())) * n) >> 32;
+  }
+  // uniform in [0, 1)
+  double next_double() { return (next() >> 11) * (1.0 / (1ULL << 53)); }
+
+ private:
+  uint64_t key;
+  uint64_t counter;
+};
+
+// Read-only CSR storage for a graph shard that is loaded once and then only
+// sampled. Nodes are kept sorted by id and located by binary search; the
+// neighbors of the node at idx are neighbor_arr[offset_arr[idx],
+// offset_arr[idx + 1]). weight_arr is dropped when every edge weight is 1.
+// Features are concatenated into feat_data, feat_index_arr[idx] gives the
+// first feature of a node in feat_offset_arr.
+class CsrGraph {
+ public:
+  CsrGraph() {}
+  ~CsrGraph() {}
+
+  // nodes may mix GraphNode and FeatureNode, ids must be unique
+  void build(const std::vector<Node *> &nodes);
+  // precompute Vose alias tables for weighted nodes whose degree is at
+  // least min_degree, smaller nodes are sampled by exponential keys
+  void build_alias(size_t min_degree);
+
+  size_t size() const { return id_arr.size(); }
+  size_t edge_size() const { return neighbor_arr.size(); }
+  size_t alias_size() const { return alias_arr.size(); }
+  size_t memory_size() const;
+  bool is_weighted() const { return !weight_arr.empty(); }
+
+  // returns the node index of id, or -1 when id is not in the shard
+  int64_t find(uint64_t id) const;
+
+  uint64_t get_id(size_t idx) const { return id_arr[idx]; }
+  size_t get_neighbor_size(size_t idx) const {
+    return offset_arr[idx + 1] - offset_arr[idx];
+  }
+  uint64_t get_neighbor_id(size_t idx, int k) const {
+    return neighbor_arr[offset_arr[idx] + k];
+  }
+  float get_neighbor_weight(size_t idx, int k) const {
+    return weight_arr.empty() ? 1. : weight_arr[offset_arr[idx] + k];
+  }
+
+  // k neighbors without replacement, uniformly or proportional to weight.
+  // writes min(k, degree) neighbor positions into res and returns the count
+  int sample_k(size_t idx, int k, CounterRng *rng, int *res) const;
+
+  int get_feature_size(size_t idx) const {
+    return feat_index_arr[idx + 1] - feat_index_arr[idx];
+  }
+  std::string get_feature(size_t idx, int feat_idx) const;
+
+  // same layout as Node::get_size / FeatureNode::to_buffer
+  int get_size(size_t idx, bool need_feature) const;
+  void to_buffer(size_t idx, char *buffer, bool need_feature) const;
+
+ private:
+  std::vector<uint64_t> id_arr;
+  std::vector<uint64_t> offset_arr;
+  std::vector<uint64_t> neighbor_arr;
+  std::vector<float> weight_arr;
+  // the alias table of the node at idx is alias_*_arr[alias_offset_arr[idx],
+  // alias_offset_arr[idx + 1]), empty for nodes sampled without it
+  std::vector<uint64_t> alias_offset_arr;
+  std::vector<float> alias_prob_arr;
+  std::vector<uint32_t> alias_arr;
+  std::vector<uint32_t> feat_index_arr;
+  std::vector<uint64_t> feat_offset_arr;
+  std::string feat_data;
+};
+
+}  // namespace distributed
+}  // namespace paddle
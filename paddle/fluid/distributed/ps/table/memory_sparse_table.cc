@@ -12,7 +12,13 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <fcntl.h>
 #include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <limits>
 #include <sstream>
 
 #include "paddle/fluid/distributed/common/cost_timer.h"
@@ -20,12 +26,31 @@
 #include "paddle/fluid/framework/io/fs.h"
 
 #include "boost/lexical_cast.hpp"
+#include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "paddle/fluid/platform/enforce.h"
 
+DEFINE_bool(pserver_sparse_table_pinned_worker, false,
+            "dispatch sparse pull/push to cpu-pinned shard workers through "
+            "lock-free queues instead of per-shard ThreadPools");
+DEFINE_int32(pserver_sparse_table_worker_num, 0,
+             "number of pinned shard workers, 0 means hardware concurrency");
+
 namespace paddle {
 namespace distributed {
 
+// 执行update后若value发生了变化, 标记为dirty以写入下一次增量checkpoint
+template <class VALUE, class UPDATE>
+static void UpdateAndMarkDirty(VALUE* value, std::vector<float>* old_value,
+                               UPDATE&& update) {
+  old_value->assign(value->data(), value->data() + value->size());
+  update(value->data());
+  if (memcmp(old_value->data(), value->data(),
+             old_value->size() * sizeof(float)) != 0) {
+    value->set_dirty(true);
+  }
+}
+
 // TODO(zhaocaibei123): configure
 bool FLAGS_pserver_create_value_when_push = true;
 int FLAGS_pserver_table_save_max_retry = 3;
@@ -40,6 +65,12 @@ int32_t MemorySparseTable::Initialize() {
   profiler.register_profiler("pserver_sparse_update_all");
   profiler.register_profiler("pserver_sparse_select_all");
   InitializeValue();
+  if (FLAGS_pserver_sparse_table_pinned_worker) {
+    _shard_workers.reset(new ShardWorkerPool(
+        _real_local_shard_num, FLAGS_pserver_sparse_table_worker_num));
+    VLOG(0) << "MemorySparseTable use " << _shard_workers->worker_num()
+            << " pinned shard workers";
+  }
   VLOG(0) << "initalize MemorySparseTable succ";
   return 0;
 }
@@ -60,6 +91,11 @@ int32_t MemorySparseTable::InitializeValue() {
           << " _real_local_shard_num: " << _real_local_shard_num;
 
   _local_shards.reset(new shard_type[_real_local_shard_num]);
+  for (size_t i = 0; i < _real_local_shard_num; ++i) {
+    _local_shards[i].allocator().set_extra_size(
+        _value_accesor->GetAccessorInfo().size);
+  }
+  _shard_deleted_keys.resize(_real_local_shard_num);
 
   return 0;
 }
@@ -95,6 +131,10 @@ int32_t MemorySparseTable::Load(const std::string& path,
   omp_set_num_threads(thread_num);
 #pragma omp parallel for schedule(dynamic)
   for (size_t i = 0; i < _real_local_shard_num; ++i) {
+    if (IsBinaryShardFile(file_list[file_start_idx + i])) {
+      LoadBinaryShardWithRetry(i, file_list[file_start_idx + i]);
+      continue;
+    }
     FsChannelConfig channel_config;
     channel_config.path = file_list[file_start_idx + i];
     VLOG(1) << "MemorySparseTable::load begin load " << channel_config.path
@@ -180,6 +220,10 @@ int32_t MemorySparseTable::LoadLocalFS(const std::string& path,
   omp_set_num_threads(thread_num);
 #pragma omp parallel for schedule(dynamic)
   for (size_t i = 0; i < _real_local_shard_num; ++i) {
+    if (IsBinaryShardFile(file_list[file_start_idx + i])) {
+      LoadBinaryShardWithRetry(i, file_list[file_start_idx + i]);
+      continue;
+    }
     bool is_read_failed = false;
     int retry_num = 0;
     int err_no = 0;
@@ -225,6 +269,219 @@ int32_t MemorySparseTable::LoadLocalFS(const std::string& path,
   return 0;
 }
 
+static bool IsLocalFile(const std::string& path) {
+  return path.compare(0, 5, "hdfs:") != 0 && path.compare(0, 4, "afs:") != 0;
+}
+
+int64_t MemorySparseTable::SaveBinaryShard(size_t shard_id,
+                                           const std::string& path,
+                                           int save_param) {
+  auto accessor_info = _value_accesor->GetAccessorInfo();
+  SparseShardFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SPARSE_BINARY_MAGIC, sizeof(header.magic));
+  header.version = SPARSE_BINARY_VERSION;
+  header.value_dim = accessor_info.size / sizeof(float);
+  header.select_dim = accessor_info.select_size / sizeof(float);
+  header.update_dim = accessor_info.update_size / sizeof(float);
+  header.mf_dim = accessor_info.mf_size / sizeof(float);
+  header.embedx_dim = _config.accessor().embedx_dim();
+  header.record_size =
+      sizeof(SparseShardRecordHead) + header.value_dim * sizeof(float);
+
+  int err_no = 0;
+  auto fp = paddle::framework::fs_open_write(path, &err_no, "");
+  if (fp == nullptr || fwrite(&header, sizeof(header), 1, fp.get()) != 1) {
+    return -1;
+  }
+
+  std::vector<char> record(header.record_size, 0);
+  auto* record_head = reinterpret_cast<SparseShardRecordHead*>(record.data());
+  float* record_value =
+      reinterpret_cast<float*>(record.data() + sizeof(SparseShardRecordHead));
+  int64_t feasign_size = 0;
+  bool is_delta = save_param == SPARSE_SAVE_PARAM_CHECKPOINT_DELTA;
+  // 删除记录写在最前, 删除后又被重新创建的key回放时以后面的value为准
+  if (is_delta) {
+    for (auto key : _shard_deleted_keys[shard_id]) {
+      record_head->key = key;
+      if (fwrite(record.data(), header.record_size, 1, fp.get()) != 1) {
+        return -1;
+      }
+      ++feasign_size;
+    }
+  }
+  auto& shard = _local_shards[shard_id];
+  std::vector<float> old_value;
+  for (auto it = shard.begin(); it != shard.end(); ++it) {
+    if (is_delta && !it.value().is_dirty()) {
+      continue;
+    }
+    if (!AccessorSave(&it.value(), save_param, &old_value)) {
+      continue;
+    }
+    size_t value_size = it.value().size();
+    record_head->key = it.key();
+    record_head->size = value_size;
+    memcpy(record_value, it.value().data(), value_size * sizeof(float));
+    memset(record_value + value_size, 0,
+           (header.value_dim - value_size) * sizeof(float));
+    if (fwrite(record.data(), header.record_size, 1, fp.get()) != 1) {
+      return -1;
+    }
+    ++feasign_size;
+  }
+  fp.reset();
+  if (err_no == -1) {
+    return -1;
+  }
+  return feasign_size;
+}
+
+int64_t MemorySparseTable::LoadBinaryShard(size_t shard_id,
+                                           const std::string& path) {
+  auto check_header = [this, &path](const SparseShardFileHeader& header) {
+    auto accessor_info = _value_accesor->GetAccessorInfo();
+    size_t value_dim = accessor_info.size / sizeof(float);
+    if (memcmp(header.magic, SPARSE_BINARY_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SPARSE_BINARY_VERSION) {
+      LOG(ERROR) << "MemorySparseTable binary file has bad magic or version: "
+                 << header.version << ", path: " << path;
+      return false;
+    }
+    if (header.value_dim != value_dim ||
+        header.record_size !=
+            sizeof(SparseShardRecordHead) + value_dim * sizeof(float)) {
+      LOG(ERROR) << "MemorySparseTable binary file value_dim "
+                 << header.value_dim << " not match accessor dim "
+                 << value_dim << ", path: " << path;
+      return false;
+    }
+    // 总维度相同但布局不同的accessor写出的文件不能按当前布局解析
+    if (header.select_dim != accessor_info.select_size / sizeof(float) ||
+        header.update_dim != accessor_info.update_size / sizeof(float) ||
+        header.mf_dim != accessor_info.mf_size / sizeof(float) ||
+        header.embedx_dim != _config.accessor().embedx_dim()) {
+      LOG(ERROR) << "MemorySparseTable binary file layout (select_dim "
+                 << header.select_dim << ", update_dim " << header.update_dim
+                 << ", mf_dim " << header.mf_dim << ", embedx_dim "
+                 << header.embedx_dim << ") not match accessor, path: "
+                 << path;
+      return false;
+    }
+    return true;
+  };
+  auto& shard = _local_shards[shard_id];
+  // record_end为当前可读数据的末尾, 损坏的记录使整个shard加载失败
+  auto insert_record = [&shard, &path](const SparseShardFileHeader& header,
+                                       const char* record,
+                                       const char* record_end) {
+    if (record_end - record <
+        static_cast<ptrdiff_t>(sizeof(SparseShardRecordHead))) {
+      LOG(ERROR) << "MemorySparseTable binary file truncated, path: " << path;
+      return false;
+    }
+    auto* record_head = reinterpret_cast<const SparseShardRecordHead*>(record);
+    size_t value_bytes = record_head->size * sizeof(float);
+    if (record_head->size > header.value_dim ||
+        static_cast<size_t>(record_end - record) <
+            sizeof(SparseShardRecordHead) + value_bytes) {
+      LOG(ERROR) << "MemorySparseTable binary record of key "
+                 << record_head->key << " has bad size " << record_head->size
+                 << ", value_dim: " << header.value_dim << ", path: " << path;
+      return false;
+    }
+    // 增量checkpoint中的删除记录
+    if (record_head->size == 0) {
+      shard.erase(record_head->key);
+      return true;
+    }
+    auto& value = shard[record_head->key];
+    value.resize(record_head->size);
+    memcpy(value.data(), record + sizeof(SparseShardRecordHead), value_bytes);
+    return true;
+  };
+
+  int64_t feasign_size = 0;
+  if (IsLocalFile(path)) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return -1;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 ||
+        static_cast<size_t>(file_stat.st_size) <
+            sizeof(SparseShardFileHeader)) {
+      close(fd);
+      return -1;
+    }
+    size_t file_size = file_stat.st_size;
+    void* addr = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+      return -1;
+    }
+    madvise(addr, file_size, MADV_SEQUENTIAL);
+    const char* data = reinterpret_cast<const char*>(addr);
+    const auto* header = reinterpret_cast<const SparseShardFileHeader*>(data);
+    size_t body_size = file_size - sizeof(SparseShardFileHeader);
+    if (!check_header(*header) || body_size % header->record_size != 0) {
+      munmap(addr, file_size);
+      return -1;
+    }
+    feasign_size = body_size / header->record_size;
+    const char* record = data + sizeof(SparseShardFileHeader);
+    const char* end = data + file_size;
+    for (int64_t j = 0; j < feasign_size; ++j) {
+      if (!insert_record(*header, record, end)) {
+        munmap(addr, file_size);
+        return -1;
+      }
+      record += header->record_size;
+    }
+    munmap(addr, file_size);
+    return feasign_size;
+  }
+
+  int err_no = 0;
+  auto fp = paddle::framework::fs_open_read(path, &err_no, "");
+  SparseShardFileHeader header;
+  if (fp == nullptr || fread(&header, sizeof(header), 1, fp.get()) != 1 ||
+      !check_header(header)) {
+    return -1;
+  }
+  std::vector<char> record(header.record_size);
+  while (fread(record.data(), header.record_size, 1, fp.get()) == 1) {
+    if (!insert_record(header, record.data(),
+                       record.data() + header.record_size)) {
+      return -1;
+    }
+    ++feasign_size;
+  }
+  fp.reset();
+  if (err_no == -1) {
+    return -1;
+  }
+  return feasign_size;
+}
+
+void MemorySparseTable::LoadBinaryShardWithRetry(size_t shard_id,
+                                                 const std::string& path) {
+  int retry_num = 0;
+  int64_t feasign_size = 0;
+  while ((feasign_size = LoadBinaryShard(shard_id, path)) < 0) {
+    ++retry_num;
+    LOG(ERROR) << "MemorySparseTable binary load failed, retry it! path:"
+               << path << " , retry_num=" << retry_num;
+    if (retry_num > paddle::distributed::FLAGS_pserver_table_save_max_retry) {
+      LOG(ERROR) << "MemorySparseTable binary load failed reach max limit!";
+      exit(-1);
+    }
+  }
+  VLOG(1) << "MemorySparseTable binary load " << path << " into local shard "
+          << shard_id << ", feasign_size: " << feasign_size;
+}
+
 int32_t MemorySparseTable::Save(const std::string& dirname,
                                 const std::string& param) {
   VLOG(0) << "MemorySparseTable::save dirname: " << dirname;
@@ -237,10 +494,42 @@ int32_t MemorySparseTable::Save(const std::string& dirname,
 
   size_t file_start_idx = _avg_local_shard_num * _shard_idx;
 
+  // 二进制格式仅用于checkpoint, xbox等需要converter的格式仍保存为文本
+  bool binary_save =
+      save_param == SPARSE_SAVE_PARAM_CHECKPOINT_DELTA ||
+      (_config.enable_binary_save() && (save_param == 0 || save_param == 3) &&
+       _value_accesor->Converter(save_param).converter.empty());
+  // checkpoint之后重新开始记录增量
+  bool reset_dirty = save_param == 0 || save_param == 3 ||
+                     save_param == SPARSE_SAVE_PARAM_CHECKPOINT_DELTA;
+
   int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
   omp_set_num_threads(thread_num);
 #pragma omp parallel for schedule(dynamic)
   for (size_t i = 0; i < _real_local_shard_num; ++i) {
+    if (binary_save) {
+      std::string path = paddle::string::format_string(
+          "%s/part-%03d-%05d%s", table_path.c_str(), _shard_idx,
+          file_start_idx + i, PSERVER_BINARY_SAVE_SUFFIX);
+      int retry_num = 0;
+      int64_t feasign_size = 0;
+      while ((feasign_size = SaveBinaryShard(i, path, save_param)) < 0) {
+        ++retry_num;
+        LOG(ERROR) << "MemorySparseTable binary save failed, retry it! path:"
+                   << path << " , retry_num=" << retry_num;
+        _afs_client.remove(path);
+        if (retry_num >
+            paddle::distributed::FLAGS_pserver_table_save_max_retry) {
+          LOG(ERROR) << "MemorySparseTable binary save failed reach max limit!";
+          exit(-1);
+        }
+      }
+      feasign_size_all += feasign_size;
+      UpdateShardStatAfterSave(i, save_param, reset_dirty);
+      LOG(INFO) << "MemorySparseTable binary save success, path: " << path
+                << " feasign_size: " << feasign_size;
+      continue;
+    }
     FsChannelConfig channel_config;
     if (_config.compress_in_save() && (save_param == 0 || save_param == 3)) {
       channel_config.path = paddle::string::format_string(
@@ -259,6 +548,7 @@ int32_t MemorySparseTable::Save(const std::string& dirname,
     int retry_num = 0;
     int err_no = 0;
     auto& shard = _local_shards[i];
+    std::vector<float> old_value;
     do {
       err_no = 0;
       feasign_size = 0;
@@ -266,7 +556,7 @@ int32_t MemorySparseTable::Save(const std::string& dirname,
       auto write_channel =
           _afs_client.open_w(channel_config, 1024 * 1024 * 40, &err_no);
       for (auto it = shard.begin(); it != shard.end(); ++it) {
-        if (_value_accesor->Save(it.value().data(), save_param)) {
+        if (AccessorSave(&it.value(), save_param, &old_value)) {
           std::string format_value = _value_accesor->ParseToString(
               it.value().data(), it.value().size());
           if (0 !=
@@ -299,9 +589,7 @@ int32_t MemorySparseTable::Save(const std::string& dirname,
       }
     } while (is_write_failed);
     feasign_size_all += feasign_size;
-    for (auto it = shard.begin(); it != shard.end(); ++it) {
-      _value_accesor->UpdateStatAfterSave(it.value().data(), save_param);
-    }
+    UpdateShardStatAfterSave(i, save_param, reset_dirty);
     LOG(INFO) << "MemorySparseTable save prefix success, path: "
               << channel_config.path;
   }
@@ -331,8 +619,9 @@ int32_t MemorySparseTable::SaveLocalFS(const std::string& dirname,
         file_start_idx + i);
     std::ofstream os;
     os.open(file_name);
+    std::vector<float> old_value;
     for (auto it = shard.begin(); it != shard.end(); ++it) {
-      if (_value_accesor->Save(it.value().data(), save_param)) {
+      if (AccessorSave(&it.value(), save_param, &old_value)) {
         std::string format_value =
             _value_accesor->ParseToString(it.value().data(), it.value().size());
         std::string out_line = paddle::string::format_string(
@@ -359,25 +648,16 @@ int64_t MemorySparseTable::LocalSize() {
 
 int64_t MemorySparseTable::LocalMFSize() {
   std::vector<int64_t> size_arr(_real_local_shard_num, 0);
-  std::vector<std::future<int>> tasks(_real_local_shard_num);
   int64_t ret_size = 0;
-  for (size_t shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
-    tasks[shard_id] =
-        _shards_task_pool[shard_id % _shards_task_pool.size()]->enqueue(
-            [this, shard_id, &size_arr]() -> int {
-              auto& local_shard = _local_shards[shard_id];
-              for (auto it = local_shard.begin(); it != local_shard.end();
-                   ++it) {
-                if (_value_accesor->HasMF(it.value().size())) {
-                  size_arr[shard_id] += 1;
-                }
-              }
-              return 0;
-            });
-  }
-  for (size_t i = 0; i < _real_local_shard_num; ++i) {
-    tasks[i].wait();
-  }
+  auto shard_task = [this, &size_arr](size_t shard_id) {
+    auto& local_shard = _local_shards[shard_id];
+    for (auto it = local_shard.begin(); it != local_shard.end(); ++it) {
+      if (_value_accesor->HasMF(it.value().size())) {
+        size_arr[shard_id] += 1;
+      }
+    }
+  };
+  RunShardTasks(shard_task);
   for (auto x : size_arr) {
     ret_size += x;
   }
@@ -387,6 +667,31 @@ int64_t MemorySparseTable::LocalMFSize() {
 std::pair<int64_t, int64_t> MemorySparseTable::PrintTableStat() {
   int64_t feasign_size = LocalSize();
   int64_t mf_size = LocalMFSize();
+
+  // 各shard同号bucket的key数累加, max/avg越大说明key分布越倾斜
+  std::vector<size_t> bucket_sizes(CTR_SPARSE_SHARD_BUCKET_NUM, 0);
+  for (size_t shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+    auto& local_shard = _local_shards[shard_id];
+    for (size_t bucket = 0; bucket < local_shard.bucket_count(); ++bucket) {
+      bucket_sizes[bucket] += local_shard.bucket_size(bucket);
+    }
+  }
+  size_t bucket_max = 0;
+  size_t bucket_min = std::numeric_limits<size_t>::max();
+  size_t bucket_total = 0;
+  for (auto bucket_size : bucket_sizes) {
+    bucket_max = std::max(bucket_max, bucket_size);
+    bucket_min = std::min(bucket_min, bucket_size);
+    bucket_total += bucket_size;
+  }
+  double bucket_avg =
+      static_cast<double>(bucket_total) / CTR_SPARSE_SHARD_BUCKET_NUM;
+  VLOG(0) << "MemorySparseTable bucket occupancy, table_id: "
+          << _config.table_id() << " min: " << bucket_min
+          << " max: " << bucket_max << " avg: " << bucket_avg
+          << " max/avg: " << (bucket_avg > 0 ? bucket_max / bucket_avg : 0);
+  VLOG(1) << "MemorySparseTable bucket sizes: "
+          << paddle::string::join_strings(bucket_sizes, ',');
   return {feasign_size, mf_size};
 }
 
@@ -414,10 +719,26 @@ int32_t MemorySparseTable::Push(TableContext& context) {
   }
 }
 
+std::vector<std::vector<std::pair<uint64_t, int>>>&
+MemorySparseTable::PartitionKeys(const uint64_t* keys, size_t num) {
+  // 每个请求线程复用自己的缓冲区, clear不释放容量
+  thread_local std::vector<std::vector<std::pair<uint64_t, int>>> task_keys;
+  if (task_keys.size() < _real_local_shard_num) {
+    task_keys.resize(_real_local_shard_num);
+  }
+  for (size_t shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+    task_keys[shard_id].clear();
+  }
+  for (size_t i = 0; i < num; ++i) {
+    int shard_id = (keys[i] % _sparse_table_shard_num) % _avg_local_shard_num;
+    task_keys[shard_id].push_back({keys[i], i});
+  }
+  return task_keys;
+}
+
 int32_t MemorySparseTable::PullSparse(float* pull_values,
                                       const PullSparseValue& pull_value) {
   CostTimer timer("pserver_sparse_select_all");
-  std::vector<std::future<int>> tasks(_real_local_shard_num);
 
   const size_t value_size =
       _value_accesor->GetAccessorInfo().size / sizeof(float);
@@ -427,61 +748,43 @@ int32_t MemorySparseTable::PullSparse(float* pull_values,
       _value_accesor->GetAccessorInfo().select_size / sizeof(float);
   // std::atomic<uint32_t> missed_keys{0};
 
-  std::vector<std::vector<std::pair<uint64_t, int>>> task_keys(
-      _real_local_shard_num);
-  size_t num = pull_value.numel_;
-  for (size_t i = 0; i < num; ++i) {
-    int shard_id = (pull_value.feasigns_[i] % _sparse_table_shard_num) %
-                   _avg_local_shard_num;
-    task_keys[shard_id].push_back({pull_value.feasigns_[i], i});
-  }
-  for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
-    tasks[shard_id] =
-        _shards_task_pool[shard_id % _shards_task_pool.size()]->enqueue(
-            [this, shard_id, &task_keys, value_size, pull_values, mf_value_size,
-             select_value_size]() -> int {
-              auto& local_shard = _local_shards[shard_id];
-              float data_buffer[value_size];  // NOLINT
-              float* data_buffer_ptr = data_buffer;
-
-              auto& keys = task_keys[shard_id];
-              for (size_t i = 0; i < keys.size(); i++) {
-                uint64_t key = keys[i].first;
-                auto itr = local_shard.find(key);
-                size_t data_size = value_size - mf_value_size;
-                if (itr == local_shard.end()) {
-                  // ++missed_keys;
-                  if (FLAGS_pserver_create_value_when_push) {
-                    memset(data_buffer, 0, sizeof(float) * data_size);
-                  } else {
-                    auto& feature_value = local_shard[key];
-                    feature_value.resize(data_size);
-                    float* data_ptr = feature_value.data();
-                    _value_accesor->Create(&data_buffer_ptr, 1);
-                    memcpy(data_ptr, data_buffer_ptr,
-                           data_size * sizeof(float));
-                  }
-                } else {
-                  data_size = itr.value().size();
-                  memcpy(data_buffer_ptr, itr.value().data(),
-                         data_size * sizeof(float));
-                }
-                for (int mf_idx = data_size; mf_idx < value_size; ++mf_idx) {
-                  data_buffer[mf_idx] = 0.0;
-                }
-                auto offset = keys[i].second;
-                float* select_data = pull_values + select_value_size * offset;
-                _value_accesor->Select(&select_data,
-                                       (const float**)&data_buffer_ptr, 1);
-              }
-
-              return 0;
-            });
-  }
-
-  for (size_t shard_id = 0; shard_id < tasks.size(); ++shard_id) {
-    tasks[shard_id].wait();
-  }
+  auto& task_keys = PartitionKeys(pull_value.feasigns_, pull_value.numel_);
+  auto shard_task = [this, &task_keys, value_size, pull_values, mf_value_size,
+                     select_value_size](size_t shard_id) {
+    auto& local_shard = _local_shards[shard_id];
+    float data_buffer[value_size];  // NOLINT
+    float* data_buffer_ptr = data_buffer;
+
+    auto& keys = task_keys[shard_id];
+    for (size_t i = 0; i < keys.size(); i++) {
+      uint64_t key = keys[i].first;
+      auto itr = local_shard.find(key);
+      size_t data_size = value_size - mf_value_size;
+      if (itr == local_shard.end()) {
+        // ++missed_keys;
+        if (FLAGS_pserver_create_value_when_push) {
+          memset(data_buffer, 0, sizeof(float) * data_size);
+        } else {
+          auto& feature_value = local_shard[key];
+          feature_value.resize(data_size);
+          feature_value.set_dirty(true);
+          float* data_ptr = feature_value.data();
+          _value_accesor->Create(&data_buffer_ptr, 1);
+          memcpy(data_ptr, data_buffer_ptr, data_size * sizeof(float));
+        }
+      } else {
+        data_size = itr.value().size();
+        memcpy(data_buffer_ptr, itr.value().data(), data_size * sizeof(float));
+      }
+      for (int mf_idx = data_size; mf_idx < value_size; ++mf_idx) {
+        data_buffer[mf_idx] = 0.0;
+      }
+      auto offset = keys[i].second;
+      float* select_data = pull_values + select_value_size * offset;
+      _value_accesor->Select(&select_data, (const float**)&data_buffer_ptr, 1);
+    }
+  };
+  RunShardTasks(shard_task);
   return 0;
 }
 
@@ -492,61 +795,44 @@ int32_t MemorySparseTable::PullSparsePtr(char** pull_values,
   size_t mf_value_size =
       _value_accesor->GetAccessorInfo().mf_size / sizeof(float);
 
-  std::vector<std::future<int>> tasks(_real_local_shard_num);
-  std::vector<std::vector<std::pair<uint64_t, int>>> task_keys(
-      _real_local_shard_num);
-  for (size_t i = 0; i < num; ++i) {
-    int shard_id = (keys[i] % _sparse_table_shard_num) % _avg_local_shard_num;
-    task_keys[shard_id].push_back({keys[i], i});
-  }
+  auto& task_keys = PartitionKeys(keys, num);
   // std::atomic<uint32_t> missed_keys{0};
-  for (size_t shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
-    tasks[shard_id] =
-        _shards_task_pool[shard_id % _shards_task_pool.size()]->enqueue(
-            [this, shard_id, &task_keys, pull_values, value_size,
-             mf_value_size]() -> int {
-              auto& keys = task_keys[shard_id];
-              auto& local_shard = _local_shards[shard_id];
-              float data_buffer[value_size];
-              float* data_buffer_ptr = data_buffer;
-              for (int i = 0; i < keys.size(); ++i) {
-                uint64_t key = keys[i].first;
-                auto itr = local_shard.find(key);
-                size_t data_size = value_size - mf_value_size;
-                FixedFeatureValue* ret = NULL;
-                if (itr == local_shard.end()) {
-                  // ++missed_keys;
-                  auto& feature_value = local_shard[key];
-                  feature_value.resize(data_size);
-                  float* data_ptr = feature_value.data();
-                  _value_accesor->Create(&data_buffer_ptr, 1);
-                  memcpy(data_ptr, data_buffer_ptr, data_size * sizeof(float));
-                  ret = &feature_value;
-                } else {
-                  ret = itr.value_ptr();
-                }
-                int pull_data_idx = keys[i].second;
-                pull_values[pull_data_idx] = (char*)ret;
-              }
-              return 0;
-            });
-  }
-  for (size_t shard_id = 0; shard_id < tasks.size(); ++shard_id) {
-    tasks[shard_id].wait();
-  }
+  auto shard_task = [this, &task_keys, pull_values, value_size,
+                     mf_value_size](size_t shard_id) {
+    auto& keys = task_keys[shard_id];
+    auto& local_shard = _local_shards[shard_id];
+    float data_buffer[value_size];  // NOLINT
+    float* data_buffer_ptr = data_buffer;
+    for (int i = 0; i < keys.size(); ++i) {
+      uint64_t key = keys[i].first;
+      auto itr = local_shard.find(key);
+      size_t data_size = value_size - mf_value_size;
+      value_type* ret = NULL;
+      if (itr == local_shard.end()) {
+        // ++missed_keys;
+        auto& feature_value = local_shard[key];
+        feature_value.resize(data_size);
+        float* data_ptr = feature_value.data();
+        _value_accesor->Create(&data_buffer_ptr, 1);
+        memcpy(data_ptr, data_buffer_ptr, data_size * sizeof(float));
+        ret = &feature_value;
+      } else {
+        ret = itr.value_ptr();
+      }
+      // 调用方会通过指针直接修改value
+      ret->set_dirty(true);
+      int pull_data_idx = keys[i].second;
+      pull_values[pull_data_idx] = (char*)ret;  // NOLINT
+    }
+  };
+  RunShardTasks(shard_task);
   return 0;
 }
 
 int32_t MemorySparseTable::PushSparse(const uint64_t* keys, const float* values,
                                       size_t num) {
   CostTimer timer("pserver_sparse_update_all");
-  std::vector<std::future<int>> tasks(_real_local_shard_num);
-  std::vector<std::vector<std::pair<uint64_t, int>>> task_keys(
-      _real_local_shard_num);
-  for (size_t i = 0; i < num; ++i) {
-    int shard_id = (keys[i] % _sparse_table_shard_num) % _avg_local_shard_num;
-    task_keys[shard_id].push_back({keys[i], i});
-  }
+  auto& task_keys = PartitionKeys(keys, num);
 
   const size_t value_col =
       _value_accesor->GetAccessorInfo().size / sizeof(float);
@@ -555,72 +841,59 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys, const float* values,
   size_t update_value_col =
       _value_accesor->GetAccessorInfo().update_size / sizeof(float);
 
-  for (size_t shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
-    tasks[shard_id] = _shards_task_pool[shard_id % _task_pool_size]->enqueue(
-        [this, shard_id, value_col, mf_value_col, update_value_col, values,
-         &task_keys]() -> int {
-          auto& keys = task_keys[shard_id];
-          auto& local_shard = _local_shards[shard_id];
-          float data_buffer[value_col];  // NOLINT
-          float* data_buffer_ptr = data_buffer;
-          for (int i = 0; i < keys.size(); ++i) {
-            uint64_t key = keys[i].first;
-            uint64_t push_data_idx = keys[i].second;
-            const float* update_data =
-                values + push_data_idx * update_value_col;
-            auto itr = local_shard.find(key);
-            if (itr == local_shard.end()) {
-              if (FLAGS_pserver_enable_create_feasign_randomly &&
-                  !_value_accesor->CreateValue(1, update_data)) {
-                continue;
-              }
-              auto value_size = value_col - mf_value_col;
-              auto& feature_value = local_shard[key];
-              feature_value.resize(value_size);
-              _value_accesor->Create(&data_buffer_ptr, 1);
-              memcpy(feature_value.data(), data_buffer_ptr,
-                     value_size * sizeof(float));
-              itr = local_shard.find(key);
-            }
-
-            auto& feature_value = itr.value();
-            float* value_data = feature_value.data();
-            size_t value_size = feature_value.size();
-
-            if (value_size == value_col) {  // 已拓展到最大size, 则就地update
-              _value_accesor->Update(&value_data, &update_data, 1);
-            } else {
-              // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
-              memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
-              _value_accesor->Update(&data_buffer_ptr, &update_data, 1);
-
-              if (_value_accesor->NeedExtendMF(data_buffer)) {
-                feature_value.resize(value_col);
-                value_data = feature_value.data();
-                _value_accesor->Create(&value_data, 1);
-              }
-              memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
-            }
-          }
-          return 0;
-        });
-  }
+  auto shard_task = [this, value_col, mf_value_col, update_value_col, values,
+                     &task_keys](size_t shard_id) {
+    auto& keys = task_keys[shard_id];
+    auto& local_shard = _local_shards[shard_id];
+    float data_buffer[value_col];  // NOLINT
+    float* data_buffer_ptr = data_buffer;
+    for (int i = 0; i < keys.size(); ++i) {
+      uint64_t key = keys[i].first;
+      uint64_t push_data_idx = keys[i].second;
+      const float* update_data = values + push_data_idx * update_value_col;
+      auto itr = local_shard.find(key);
+      if (itr == local_shard.end()) {
+        if (FLAGS_pserver_enable_create_feasign_randomly &&
+            !_value_accesor->CreateValue(1, update_data)) {
+          continue;
+        }
+        auto value_size = value_col - mf_value_col;
+        auto& feature_value = local_shard[key];
+        feature_value.resize(value_size);
+        _value_accesor->Create(&data_buffer_ptr, 1);
+        memcpy(feature_value.data(), data_buffer_ptr,
+               value_size * sizeof(float));
+        itr = local_shard.find(key);
+      }
 
-  for (size_t shard_id = 0; shard_id < tasks.size(); ++shard_id) {
-    tasks[shard_id].wait();
-  }
+      auto& feature_value = itr.value();
+      feature_value.set_dirty(true);
+      float* value_data = feature_value.data();
+      size_t value_size = feature_value.size();
+
+      if (value_size == value_col) {  // 已拓展到最大size, 则就地update
+        _value_accesor->Update(&value_data, &update_data, 1);
+      } else {
+        // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
+        memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
+        _value_accesor->Update(&data_buffer_ptr, &update_data, 1);
+
+        if (_value_accesor->NeedExtendMF(data_buffer)) {
+          feature_value.resize(value_col);
+          value_data = feature_value.data();
+          _value_accesor->Create(&value_data, 1);
+        }
+        memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+      }
+    }
+  };
+  RunShardTasks(shard_task);
   return 0;
 }
 
 int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
                                       const float** values, size_t num) {
-  std::vector<std::future<int>> tasks(_real_local_shard_num);
-  std::vector<std::vector<std::pair<uint64_t, int>>> task_keys(
-      _real_local_shard_num);
-  for (size_t i = 0; i < num; ++i) {
-    int shard_id = (keys[i] % _sparse_table_shard_num) % _avg_local_shard_num;
-    task_keys[shard_id].push_back({keys[i], i});
-  }
+  auto& task_keys = PartitionKeys(keys, num);
 
   size_t value_col = _value_accesor->GetAccessorInfo().size / sizeof(float);
   size_t mf_value_col =
@@ -628,57 +901,80 @@ int32_t MemorySparseTable::PushSparse(const uint64_t* keys,
   size_t update_value_col =
       _value_accesor->GetAccessorInfo().update_size / sizeof(float);
 
-  for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
-    tasks[shard_id] = _shards_task_pool[shard_id % _task_pool_size]->enqueue(
-        [this, shard_id, value_col, mf_value_col, update_value_col, values,
-         &task_keys]() -> int {
-          auto& keys = task_keys[shard_id];
-          auto& local_shard = _local_shards[shard_id];
-          float data_buffer[value_col];  // NOLINT
-          float* data_buffer_ptr = data_buffer;
-          for (int i = 0; i < keys.size(); ++i) {
-            uint64_t key = keys[i].first;
-            uint64_t push_data_idx = keys[i].second;
-            const float* update_data = values[push_data_idx];
-            auto itr = local_shard.find(key);
-            if (itr == local_shard.end()) {
-              if (FLAGS_pserver_enable_create_feasign_randomly &&
-                  !_value_accesor->CreateValue(1, update_data)) {
-                continue;
-              }
-              auto value_size = value_col - mf_value_col;
-              auto& feature_value = local_shard[key];
-              feature_value.resize(value_size);
-              _value_accesor->Create(&data_buffer_ptr, 1);
-              memcpy(feature_value.data(), data_buffer_ptr,
-                     value_size * sizeof(float));
-              itr = local_shard.find(key);
-            }
-            auto& feature_value = itr.value();
-            float* value_data = feature_value.data();
-            size_t value_size = feature_value.size();
-            if (value_size == value_col) {  // 已拓展到最大size, 则就地update
-              _value_accesor->Update(&value_data, &update_data, 1);
-            } else {
-              // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
-              memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
-              _value_accesor->Update(&data_buffer_ptr, &update_data, 1);
-              if (_value_accesor->NeedExtendMF(data_buffer)) {
-                feature_value.resize(value_col);
-                value_data = feature_value.data();
-                _value_accesor->Create(&value_data, 1);
-              }
-              memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
-            }
-          }
-          return 0;
-        });
-  }
+  auto shard_task = [this, value_col, mf_value_col, update_value_col, values,
+                     &task_keys](size_t shard_id) {
+    auto& keys = task_keys[shard_id];
+    auto& local_shard = _local_shards[shard_id];
+    float data_buffer[value_col];  // NOLINT
+    float* data_buffer_ptr = data_buffer;
+    for (int i = 0; i < keys.size(); ++i) {
+      uint64_t key = keys[i].first;
+      uint64_t push_data_idx = keys[i].second;
+      const float* update_data = values[push_data_idx];
+      auto itr = local_shard.find(key);
+      if (itr == local_shard.end()) {
+        if (FLAGS_pserver_enable_create_feasign_randomly &&
+            !_value_accesor->CreateValue(1, update_data)) {
+          continue;
+        }
+        auto value_size = value_col - mf_value_col;
+        auto& feature_value = local_shard[key];
+        feature_value.resize(value_size);
+        _value_accesor->Create(&data_buffer_ptr, 1);
+        memcpy(feature_value.data(), data_buffer_ptr,
+               value_size * sizeof(float));
+        itr = local_shard.find(key);
+      }
+      auto& feature_value = itr.value();
+      feature_value.set_dirty(true);
+      float* value_data = feature_value.data();
+      size_t value_size = feature_value.size();
+      if (value_size == value_col) {  // 已拓展到最大size, 则就地update
+        _value_accesor->Update(&value_data, &update_data, 1);
+      } else {
+        // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
+        memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
+        _value_accesor->Update(&data_buffer_ptr, &update_data, 1);
+        if (_value_accesor->NeedExtendMF(data_buffer)) {
+          feature_value.resize(value_col);
+          value_data = feature_value.data();
+          _value_accesor->Create(&value_data, 1);
+        }
+        memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+      }
+    }
+  };
+  RunShardTasks(shard_task);
+  return 0;
+}
+
+bool MemorySparseTable::AccessorSave(value_type* value, int save_param,
+                                     std::vector<float>* old_value) {
+  bool need_save = false;
+  UpdateAndMarkDirty(value, old_value, [&](float* data) {
+    need_save = _value_accesor->Save(data, save_param);
+  });
+  return need_save;
+}
 
-  for (size_t shard_id = 0; shard_id < tasks.size(); ++shard_id) {
-    tasks[shard_id].wait();
+void MemorySparseTable::UpdateShardStatAfterSave(size_t shard_id,
+                                                 int save_param,
+                                                 bool reset_dirty) {
+  auto& shard = _local_shards[shard_id];
+  std::vector<float> old_value;
+  for (auto it = shard.begin(); it != shard.end(); ++it) {
+    if (reset_dirty) {
+      it.value().set_dirty(false);
+    }
+    // 如xbox delta清零delta score, batch model增加unseen days,
+    // 保存后被修改的key需要写入下一次增量
+    UpdateAndMarkDirty(&it.value(), &old_value, [&](float* value) {
+      _value_accesor->UpdateStatAfterSave(value, save_param);
+    });
+  }
+  if (reset_dirty) {
+    _shard_deleted_keys[shard_id].clear();
   }
-  return 0;
 }
 
 int32_t MemorySparseTable::Flush() { return 0; }
@@ -689,8 +985,16 @@ int32_t MemorySparseTable::Shrink(const std::string& param) {
   for (int shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
     // Shrink
     auto& shard = _local_shards[shard_id];
+    auto& deleted_keys = _shard_deleted_keys[shard_id];
+    std::vector<float> old_value;
     for (auto it = shard.begin(); it != shard.end();) {
-      if (_value_accesor->Shrink(it.value().data())) {
+      bool need_delete = false;
+      // Shrink中做了show/click衰减, 只有值变化的key才写入下一次增量
+      UpdateAndMarkDirty(&it.value(), &old_value, [&](float* value) {
+        need_delete = _value_accesor->Shrink(value);
+      });
+      if (need_delete) {
+        deleted_keys.push_back(it.key());
         it = shard.erase(it);
       } else {
         ++it;
@@ -24,19 +24,59 @@
 #include <utility>
 #include <vector>
 #include "Eigen/Dense"
+#include "paddle/fluid/distributed/common/shard_worker_pool.h"
 #include "paddle/fluid/distributed/ps/table/accessor.h"
 #include "paddle/fluid/distributed/ps/table/common_table.h"
 #include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
 #include "paddle/fluid/string/string_helper.h"
 
 #define PSERVER_SAVE_SUFFIX ".shard"
+#define PSERVER_BINARY_SAVE_SUFFIX ".bin"
 
 namespace paddle {
 namespace distributed {
 
+// save param: checkpoint:0  xbox delta:1  xbox base:2  batch model:3
+// checkpoint delta:6, 只保存上次checkpoint后修改/删除的key, 固定为二进制格式
+static const int SPARSE_SAVE_PARAM_CHECKPOINT_DELTA = 6;
+
+static const char SPARSE_BINARY_MAGIC[8] = "PDSPBIN";
+// version 2起记录embedx_dim, 加载时accessor布局的各维度须与文件一致
+static const uint32_t SPARSE_BINARY_VERSION = 2;
+
+// 二进制shard文件头, 其后为header.record_size字节的定长记录:
+// SparseShardRecordHead + float[value_dim], 未使用的mf部分补0
+struct SparseShardFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t value_dim;
+  uint32_t select_dim;
+  uint32_t update_dim;
+  uint32_t mf_dim;
+  uint32_t embedx_dim;
+  uint32_t record_size;
+  char reserved[28];
+};
+
+struct SparseShardRecordHead {
+  uint64_t key;
+  uint32_t size;  // value实际长度(float个数), 0表示该key已被删除
+  uint32_t reserved;
+};
+
+inline bool IsBinaryShardFile(const std::string& path) {
+  const std::string suffix = PSERVER_BINARY_SAVE_SUFFIX;
+  return path.size() >= suffix.size() &&
+         path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
 class MemorySparseTable : public Table {
  public:
-  typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
+  // value按accessor的最大size在shard的slab中定长存放, 避免每个key一次堆分配
+  typedef SlabFeatureValue value_type;
+  typedef SparseTableShard<uint64_t, value_type, SparseKeyHasher<uint64_t>,
+                           SlabAllocator<value_type>>
+      shard_type;
   MemorySparseTable() {}
   virtual ~MemorySparseTable() {}
 
@@ -62,6 +102,7 @@ class MemorySparseTable : public Table {
   int32_t InitializeShard() override { return 0; }
   int32_t InitializeValue();
 
+  // 增量checkpoint的恢复: Load(base, "0")后按顺序对每个增量目录Load(delta, "6")
   int32_t Load(const std::string& path, const std::string& param) override;
 
   int32_t Save(const std::string& path, const std::string& param) override;
@@ -70,17 +111,27 @@ class MemorySparseTable : public Table {
   int32_t SaveLocalFS(const std::string& path, const std::string& param,
                       const std::string& prefix);
 
-  int64_t LocalSize();
+  // 二进制格式的单shard读写, 本地文件通过mmap加载;
+  // 成功时返回写入/读取的feasign数, 失败返回-1
+  int64_t SaveBinaryShard(size_t shard_id, const std::string& path,
+                          int save_param);
+  int64_t LoadBinaryShard(size_t shard_id, const std::string& path);
+  void LoadBinaryShardWithRetry(size_t shard_id, const std::string& path);
+
+  virtual int64_t LocalSize();
   int64_t LocalMFSize();
 
   std::pair<int64_t, int64_t> PrintTableStat() override;
-  int32_t PullSparse(float* values, const PullSparseValue& pull_value);
+  virtual int32_t PullSparse(float* values, const PullSparseValue& pull_value);
 
-  int32_t PullSparsePtr(char** pull_values, const uint64_t* keys, size_t num);
+  virtual int32_t PullSparsePtr(char** pull_values, const uint64_t* keys,
+                                size_t num);
 
-  int32_t PushSparse(const uint64_t* keys, const float* values, size_t num);
+  virtual int32_t PushSparse(const uint64_t* keys, const float* values,
+                             size_t num);
 
-  int32_t PushSparse(const uint64_t* keys, const float** values, size_t num);
+  virtual int32_t PushSparse(const uint64_t* keys, const float** values,
+                             size_t num);
 
   int32_t Flush() override;
   int32_t Shrink(const std::string& param) override;
@@ -91,12 +142,51 @@ class MemorySparseTable : public Table {
   }
 
  protected:
+  // accessor的Save可能修改value(如xbox base清零delta score),
+  // 修改过的key标记为dirty; 返回value是否需要保存
+  bool AccessorSave(value_type* value, int save_param,
+                    std::vector<float>* old_value);
+
+  // 保存后更新shard内value的统计量; reset_dirty时重新开始记录增量,
+  // 统计量被修改的key仍标记为dirty
+  void UpdateShardStatAfterSave(size_t shard_id, int save_param,
+                                bool reset_dirty);
+
+  // 按shard划分key, 返回当前线程复用的缓冲区, 在下一次调用前有效
+  std::vector<std::vector<std::pair<uint64_t, int>>>& PartitionKeys(
+      const uint64_t* keys, size_t num);
+
+  // 对每个本地shard执行fn(shard_id)并等待全部完成;
+  // 开启FLAGS_pserver_sparse_table_pinned_worker时走绑核的shard worker
+  template <class Fn>
+  void RunShardTasks(Fn& fn) {  // NOLINT
+    if (_shard_workers) {
+      _shard_workers->Run(fn);
+      return;
+    }
+    std::vector<std::future<int>> tasks(_real_local_shard_num);
+    for (size_t shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+      tasks[shard_id] =
+          _shards_task_pool[shard_id % _shards_task_pool.size()]->enqueue(
+              [&fn, shard_id]() -> int {
+                fn(shard_id);
+                return 0;
+              });
+    }
+    for (size_t shard_id = 0; shard_id < tasks.size(); ++shard_id) {
+      tasks[shard_id].wait();
+    }
+  }
+
   const int _task_pool_size = 24;
   size_t _avg_local_shard_num;
   size_t _real_local_shard_num;
   size_t _sparse_table_shard_num;
   std::vector<std::shared_ptr<::ThreadPool>> _shards_task_pool;
+  std::unique_ptr<ShardWorkerPool> _shard_workers;
   std::unique_ptr<shard_type[]> _local_shards;
+  // 每个shard自上次checkpoint后被Shrink删除的key, 增量保存时写为删除记录
+  std::vector<std::vector<uint64_t>> _shard_deleted_keys;
 };
 
 }  // namespace distributed
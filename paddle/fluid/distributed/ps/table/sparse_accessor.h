@@ -123,6 +123,12 @@ class SparseAccessor : public ValueAccessor {
   virtual int Initialize();
   // 初始化AccessorInfo
   virtual void InitAccessorInfo();
+  size_t SelectEmbedxIndex() override {
+    return SparsePullValue::EmbedxWIndex();
+  }
+  size_t UpdateEmbedxIndex() override {
+    return SparsePushValue::EmbedxGIndex();
+  }
   // 判断该value是否进行shrink
   virtual bool Shrink(float* value);
   // 判断该value是否保存到ssd
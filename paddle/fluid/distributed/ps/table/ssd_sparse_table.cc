@@ -0,0 +1,499 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifdef PADDLE_WITH_HETERPS
+#include "paddle/fluid/distributed/ps/table/ssd_sparse_table.h"
+
+#include <omp.h>
+#include <algorithm>
+
+#include "paddle/fluid/distributed/common/cost_timer.h"
+#include "paddle/fluid/framework/io/fs.h"
+
+#include "glog/logging.h"
+
+DEFINE_string(rocksdb_path, "database", "path of sparse table rocksdb file");
+
+namespace paddle {
+namespace distributed {
+
+extern bool FLAGS_pserver_create_value_when_push;
+extern int FLAGS_pserver_table_save_max_retry;
+extern bool FLAGS_pserver_enable_create_feasign_randomly;
+
+int32_t SSDSparseTable::Initialize() {
+  MemorySparseTable::Initialize();
+  paddle::framework::localfs_mkdir(FLAGS_rocksdb_path);
+  std::string db_path = paddle::string::format_string(
+      "%s/table_%03d_%03d", FLAGS_rocksdb_path.c_str(),
+      static_cast<int>(_config.table_id()), static_cast<int>(_shard_idx));
+  _db.reset(new RocksDBHandler());
+  if (_db->initialize(db_path, _real_local_shard_num) != 0) {
+    LOG(ERROR) << "initalize SSDSparseTable failed, db path: " << db_path;
+    return -1;
+  }
+  VLOG(0) << "initalize SSDSparseTable succ, db path: " << db_path;
+  return 0;
+}
+
+SSDSparseTable::shard_type::iterator SSDSparseTable::FindAndRestore(
+    size_t shard_id, uint64_t key) {
+  auto& local_shard = _local_shards[shard_id];
+  auto itr = local_shard.find(key);
+  if (itr != local_shard.end()) {
+    return itr;
+  }
+  std::string ssd_value;
+  if (_db->get(shard_id, reinterpret_cast<char*>(&key), sizeof(uint64_t),
+               ssd_value) != 0) {
+    return itr;
+  }
+  auto& feature_value = local_shard[key];
+  feature_value.resize(ssd_value.size() / sizeof(float));
+  memcpy(feature_value.data(), ssd_value.data(), ssd_value.size());
+  _db->del_data(shard_id, reinterpret_cast<char*>(&key), sizeof(uint64_t));
+  return local_shard.find(key);
+}
+
+int32_t SSDSparseTable::PullSparse(float* pull_values,
+                                   const PullSparseValue& pull_value) {
+  CostTimer timer("pserver_sparse_select_all");
+
+  const size_t value_size =
+      _value_accesor->GetAccessorInfo().size / sizeof(float);
+  size_t mf_value_size =
+      _value_accesor->GetAccessorInfo().mf_size / sizeof(float);
+  size_t select_value_size =
+      _value_accesor->GetAccessorInfo().select_size / sizeof(float);
+
+  auto& task_keys = PartitionKeys(pull_value.feasigns_, pull_value.numel_);
+  auto shard_task = [this, &task_keys, value_size, pull_values, mf_value_size,
+                     select_value_size](size_t shard_id) {
+    auto& local_shard = _local_shards[shard_id];
+    float data_buffer[value_size];  // NOLINT
+    float* data_buffer_ptr = data_buffer;
+
+    auto& keys = task_keys[shard_id];
+    for (size_t i = 0; i < keys.size(); i++) {
+      uint64_t key = keys[i].first;
+      auto itr = FindAndRestore(shard_id, key);
+      size_t data_size = value_size - mf_value_size;
+      if (itr == local_shard.end()) {
+        if (FLAGS_pserver_create_value_when_push) {
+          memset(data_buffer, 0, sizeof(float) * data_size);
+        } else {
+          auto& feature_value = local_shard[key];
+          feature_value.resize(data_size);
+          float* data_ptr = feature_value.data();
+          _value_accesor->Create(&data_buffer_ptr, 1);
+          memcpy(data_ptr, data_buffer_ptr, data_size * sizeof(float));
+        }
+      } else {
+        data_size = itr.value().size();
+        memcpy(data_buffer_ptr, itr.value().data(), data_size * sizeof(float));
+      }
+      for (size_t mf_idx = data_size; mf_idx < value_size; ++mf_idx) {
+        data_buffer[mf_idx] = 0.0;
+      }
+      auto offset = keys[i].second;
+      float* select_data = pull_values + select_value_size * offset;
+      _value_accesor->Select(&select_data, (const float**)&data_buffer_ptr, 1);
+    }
+  };
+  RunShardTasks(shard_task);
+  return 0;
+}
+
+int32_t SSDSparseTable::PullSparsePtr(char** pull_values, const uint64_t* keys,
+                                      size_t num) {
+  CostTimer timer("pscore_sparse_select_all");
+  size_t value_size = _value_accesor->GetAccessorInfo().size / sizeof(float);
+  size_t mf_value_size =
+      _value_accesor->GetAccessorInfo().mf_size / sizeof(float);
+
+  auto& task_keys = PartitionKeys(keys, num);
+  auto shard_task = [this, &task_keys, pull_values, value_size,
+                     mf_value_size](size_t shard_id) {
+    auto& keys = task_keys[shard_id];
+    auto& local_shard = _local_shards[shard_id];
+    float data_buffer[value_size];  // NOLINT
+    float* data_buffer_ptr = data_buffer;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      uint64_t key = keys[i].first;
+      auto itr = FindAndRestore(shard_id, key);
+      size_t data_size = value_size - mf_value_size;
+      value_type* ret = NULL;
+      if (itr == local_shard.end()) {
+        auto& feature_value = local_shard[key];
+        feature_value.resize(data_size);
+        float* data_ptr = feature_value.data();
+        _value_accesor->Create(&data_buffer_ptr, 1);
+        memcpy(data_ptr, data_buffer_ptr, data_size * sizeof(float));
+        ret = &feature_value;
+      } else {
+        ret = itr.value_ptr();
+      }
+      int pull_data_idx = keys[i].second;
+      pull_values[pull_data_idx] = (char*)ret;  // NOLINT
+    }
+  };
+  RunShardTasks(shard_task);
+  return 0;
+}
+
+int32_t SSDSparseTable::PushSparse(const uint64_t* keys, const float* values,
+                                   size_t num) {
+  size_t update_value_col =
+      _value_accesor->GetAccessorInfo().update_size / sizeof(float);
+  std::vector<const float*> value_ptrs(num);
+  for (size_t i = 0; i < num; ++i) {
+    value_ptrs[i] = values + i * update_value_col;
+  }
+  return PushSparse(keys, value_ptrs.data(), num);
+}
+
+int32_t SSDSparseTable::PushSparse(const uint64_t* keys, const float** values,
+                                   size_t num) {
+  CostTimer timer("pserver_sparse_update_all");
+  auto& task_keys = PartitionKeys(keys, num);
+
+  size_t value_col = _value_accesor->GetAccessorInfo().size / sizeof(float);
+  size_t mf_value_col =
+      _value_accesor->GetAccessorInfo().mf_size / sizeof(float);
+
+  auto shard_task = [this, value_col, mf_value_col, values,
+                     &task_keys](size_t shard_id) {
+    auto& keys = task_keys[shard_id];
+    auto& local_shard = _local_shards[shard_id];
+    float data_buffer[value_col];  // NOLINT
+    float* data_buffer_ptr = data_buffer;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      uint64_t key = keys[i].first;
+      uint64_t push_data_idx = keys[i].second;
+      const float* update_data = values[push_data_idx];
+      auto itr = FindAndRestore(shard_id, key);
+      if (itr == local_shard.end()) {
+        if (FLAGS_pserver_enable_create_feasign_randomly &&
+            !_value_accesor->CreateValue(1, update_data)) {
+          continue;
+        }
+        auto value_size = value_col - mf_value_col;
+        auto& feature_value = local_shard[key];
+        feature_value.resize(value_size);
+        _value_accesor->Create(&data_buffer_ptr, 1);
+        memcpy(feature_value.data(), data_buffer_ptr,
+               value_size * sizeof(float));
+        itr = local_shard.find(key);
+      }
+      auto& feature_value = itr.value();
+      float* value_data = feature_value.data();
+      size_t value_size = feature_value.size();
+      if (value_size == value_col) {  // 已拓展到最大size, 则就地update
+        _value_accesor->Update(&value_data, &update_data, 1);
+      } else {
+        // 拷入buffer区进行update，然后再回填，不需要的mf则回填时抛弃了
+        memcpy(data_buffer_ptr, value_data, value_size * sizeof(float));
+        _value_accesor->Update(&data_buffer_ptr, &update_data, 1);
+        if (_value_accesor->NeedExtendMF(data_buffer)) {
+          feature_value.resize(value_col);
+          value_data = feature_value.data();
+          _value_accesor->Create(&value_data, 1);
+        }
+        memcpy(value_data, data_buffer_ptr, value_size * sizeof(float));
+      }
+    }
+  };
+  RunShardTasks(shard_task);
+  return 0;
+}
+
+int32_t SSDSparseTable::Shrink(const std::string& param) {
+  VLOG(0) << "SSDSparseTable::Shrink";
+  std::vector<std::future<int>> tasks(_real_local_shard_num);
+  for (size_t shard_id = 0; shard_id < _real_local_shard_num; ++shard_id) {
+    tasks[shard_id] =
+        _shards_task_pool[shard_id % _shards_task_pool.size()]->enqueue(
+            [this, shard_id]() -> int {
+              auto& shard = _local_shards[shard_id];
+              size_t mem_delete = 0;
+              size_t to_ssd = 0;
+              size_t ssd_delete = 0;
+              for (auto it = shard.begin(); it != shard.end();) {
+                if (_value_accesor->Shrink(it.value().data())) {
+                  it = shard.erase(it);
+                  ++mem_delete;
+                } else if (_value_accesor->SaveSSD(it.value().data())) {
+                  uint64_t key = it.key();
+                  _db->put(shard_id, reinterpret_cast<char*>(&key),
+                           sizeof(uint64_t),
+                           reinterpret_cast<char*>(it.value().data()),
+                           it.value().size() * sizeof(float));
+                  it = shard.erase(it);
+                  ++to_ssd;
+                } else {
+                  ++it;
+                }
+              }
+
+              // 对ssd中的特征同样做衰减与淘汰
+              std::vector<float> value;
+              std::unique_ptr<rocksdb::Iterator> db_it(
+                  _db->get_iterator(shard_id));
+              for (db_it->SeekToFirst(); db_it->Valid(); db_it->Next()) {
+                auto db_value = db_it->value();
+                value.resize(db_value.size() / sizeof(float));
+                memcpy(value.data(), db_value.data(), db_value.size());
+                if (_value_accesor->Shrink(value.data())) {
+                  _db->del_data(shard_id, db_it->key().data(),
+                                db_it->key().size());
+                  ++ssd_delete;
+                } else {
+                  _db->put(shard_id, db_it->key().data(), db_it->key().size(),
+                           reinterpret_cast<char*>(value.data()),
+                           db_value.size());
+                }
+              }
+              _db->flush(shard_id);
+              VLOG(1) << "SSDSparseTable::Shrink shard " << shard_id
+                      << " mem_delete: " << mem_delete
+                      << " to_ssd: " << to_ssd
+                      << " ssd_delete: " << ssd_delete;
+              return 0;
+            });
+  }
+  for (size_t shard_id = 0; shard_id < tasks.size(); ++shard_id) {
+    tasks[shard_id].wait();
+  }
+  return 0;
+}
+
+int32_t SSDSparseTable::Save(const std::string& dirname,
+                             const std::string& param) {
+  VLOG(0) << "SSDSparseTable::save dirname: " << dirname;
+  int save_param =
+      atoi(param.c_str());  // checkpoint:0  xbox delta:1  xbox base:2
+  std::string table_path = TableDir(dirname);
+  _afs_client.remove(paddle::string::format_string(
+      "%s/part-%03d-*", table_path.c_str(), _shard_idx));
+
+  size_t file_start_idx = _avg_local_shard_num * _shard_idx;
+
+  int thread_num = _real_local_shard_num < 20 ? _real_local_shard_num : 20;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < _real_local_shard_num; ++i) {
+    FsChannelConfig channel_config;
+    if (_config.compress_in_save() && (save_param == 0 || save_param == 3)) {
+      channel_config.path = paddle::string::format_string(
+          "%s/part-%03d-%05d.gz", table_path.c_str(), _shard_idx,
+          file_start_idx + i);
+    } else {
+      channel_config.path =
+          paddle::string::format_string("%s/part-%03d-%05d", table_path.c_str(),
+                                        _shard_idx, file_start_idx + i);
+    }
+    channel_config.converter = _value_accesor->Converter(save_param).converter;
+    channel_config.deconverter =
+        _value_accesor->Converter(save_param).deconverter;
+    bool is_write_failed = false;
+    int feasign_size = 0;
+    int retry_num = 0;
+    int err_no = 0;
+    auto& shard = _local_shards[i];
+    std::vector<float> ssd_value;
+    do {
+      err_no = 0;
+      feasign_size = 0;
+      is_write_failed = false;
+      auto write_channel =
+          _afs_client.open_w(channel_config, 1024 * 1024 * 40, &err_no);
+      auto write_value = [&](uint64_t key, float* value, size_t size) {
+        if (!_value_accesor->Save(value, save_param)) {
+          return true;
+        }
+        std::string format_value = _value_accesor->ParseToString(value, size);
+        if (0 != write_channel->write_line(paddle::string::format_string(
+                     "%lu %s", key, format_value.c_str()))) {
+          return false;
+        }
+        ++feasign_size;
+        return true;
+      };
+      for (auto it = shard.begin(); it != shard.end() && !is_write_failed;
+           ++it) {
+        is_write_failed =
+            !write_value(it.key(), it.value().data(), it.value().size());
+      }
+      std::unique_ptr<rocksdb::Iterator> db_it(_db->get_iterator(i));
+      for (db_it->SeekToFirst(); db_it->Valid() && !is_write_failed;
+           db_it->Next()) {
+        uint64_t key =
+            *(reinterpret_cast<const uint64_t*>(db_it->key().data()));
+        ssd_value.resize(db_it->value().size() / sizeof(float));
+        memcpy(ssd_value.data(), db_it->value().data(),
+               db_it->value().size());
+        is_write_failed = !write_value(key, ssd_value.data(), ssd_value.size());
+      }
+      if (is_write_failed) {
+        ++retry_num;
+        LOG(ERROR) << "SSDSparseTable save prefix failed, retry it! path:"
+                   << channel_config.path << " , retry_num=" << retry_num;
+      }
+      write_channel->close();
+      if (err_no == -1) {
+        ++retry_num;
+        is_write_failed = true;
+        LOG(ERROR)
+            << "SSDSparseTable save prefix failed after write, retry it! "
+            << "path:" << channel_config.path << " , retry_num=" << retry_num;
+      }
+      if (is_write_failed) {
+        _afs_client.remove(channel_config.path);
+      }
+      if (retry_num > paddle::distributed::FLAGS_pserver_table_save_max_retry) {
+        LOG(ERROR) << "SSDSparseTable save prefix failed reach max limit!";
+        exit(-1);
+      }
+    } while (is_write_failed);
+    for (auto it = shard.begin(); it != shard.end(); ++it) {
+      _value_accesor->UpdateStatAfterSave(it.value().data(), save_param);
+    }
+    std::unique_ptr<rocksdb::Iterator> db_it(_db->get_iterator(i));
+    for (db_it->SeekToFirst(); db_it->Valid(); db_it->Next()) {
+      ssd_value.resize(db_it->value().size() / sizeof(float));
+      memcpy(ssd_value.data(), db_it->value().data(), db_it->value().size());
+      _value_accesor->UpdateStatAfterSave(ssd_value.data(), save_param);
+      _db->put(i, db_it->key().data(), db_it->key().size(),
+               reinterpret_cast<char*>(ssd_value.data()),
+               ssd_value.size() * sizeof(float));
+    }
+    LOG(INFO) << "SSDSparseTable save prefix success, path: "
+              << channel_config.path << " feasign_size: " << feasign_size;
+  }
+  return 0;
+}
+
+int32_t SSDSparseTable::Load(const std::string& path,
+                             const std::string& param) {
+  std::string table_path = TableDir(path);
+  auto file_list = _afs_client.list(table_path);
+
+  std::sort(file_list.begin(), file_list.end());
+  for (auto file : file_list) {
+    VLOG(1) << "SSDSparseTable::Load() file list: " << file;
+  }
+
+  int load_param = atoi(param.c_str());
+  auto expect_shard_num = _sparse_table_shard_num;
+  if (file_list.size() != expect_shard_num) {
+    LOG(WARNING) << "SSDSparseTable file_size:" << file_list.size()
+                 << " not equal to expect_shard_num:" << expect_shard_num;
+    return -1;
+  }
+  if (file_list.size() == 0) {
+    LOG(WARNING) << "SSDSparseTable load file is empty, path:" << path;
+    return -1;
+  }
+
+  size_t file_start_idx = _shard_idx * _avg_local_shard_num;
+
+  size_t feature_value_size =
+      _value_accesor->GetAccessorInfo().size / sizeof(float);
+
+  int thread_num = _real_local_shard_num < 15 ? _real_local_shard_num : 15;
+  omp_set_num_threads(thread_num);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < _real_local_shard_num; ++i) {
+    // 二进制checkpoint整体载入内存, 由之后的Shrink换出冷特征
+    if (IsBinaryShardFile(file_list[file_start_idx + i])) {
+      LoadBinaryShardWithRetry(i, file_list[file_start_idx + i]);
+      continue;
+    }
+    FsChannelConfig channel_config;
+    channel_config.path = file_list[file_start_idx + i];
+    VLOG(1) << "SSDSparseTable::load begin load " << channel_config.path
+            << " into local shard " << i;
+    channel_config.converter = _value_accesor->Converter(load_param).converter;
+    channel_config.deconverter =
+        _value_accesor->Converter(load_param).deconverter;
+
+    bool is_read_failed = false;
+    int retry_num = 0;
+    int err_no = 0;
+    std::vector<float> value(feature_value_size);
+    do {
+      is_read_failed = false;
+      err_no = 0;
+      size_t mem_count = 0;
+      size_t ssd_count = 0;
+      std::string line_data;
+      auto read_channel = _afs_client.open_r(channel_config, 0, &err_no);
+      char* end = NULL;
+      auto& shard = _local_shards[i];
+      try {
+        while (read_channel->read_line(line_data) == 0 &&
+               line_data.size() > 1) {
+          uint64_t key = std::strtoul(line_data.data(), &end, 10);
+          int parse_size = _value_accesor->ParseFromString(++end, value.data());
+          // 冷特征直接写入ssd, 不占用内存
+          if (_value_accesor->SaveSSD(value.data())) {
+            _db->put(i, reinterpret_cast<char*>(&key), sizeof(uint64_t),
+                     reinterpret_cast<char*>(value.data()),
+                     parse_size * sizeof(float));
+            ++ssd_count;
+          } else {
+            auto& feature_value = shard[key];
+            feature_value.resize(parse_size);
+            memcpy(feature_value.data(), value.data(),
+                   parse_size * sizeof(float));
+            ++mem_count;
+          }
+        }
+        read_channel->close();
+        if (err_no == -1) {
+          ++retry_num;
+          is_read_failed = true;
+          LOG(ERROR) << "SSDSparseTable load failed after read, retry it! path:"
+                     << channel_config.path << " , retry_num=" << retry_num;
+        }
+      } catch (...) {
+        ++retry_num;
+        is_read_failed = true;
+        LOG(ERROR) << "SSDSparseTable load failed, retry it! path:"
+                   << channel_config.path << " , retry_num=" << retry_num;
+      }
+      if (retry_num > paddle::distributed::FLAGS_pserver_table_save_max_retry) {
+        LOG(ERROR) << "SSDSparseTable load failed reach max limit!";
+        exit(-1);
+      }
+      VLOG(1) << "SSDSparseTable load shard " << i
+              << " mem_count: " << mem_count << " ssd_count: " << ssd_count;
+    } while (is_read_failed);
+    _db->flush(i);
+  }
+  LOG(INFO) << "SSDSparseTable load success, path from "
+            << file_list[file_start_idx] << " to "
+            << file_list[file_start_idx + _real_local_shard_num - 1];
+  return 0;
+}
+
+int64_t SSDSparseTable::LocalSize() {
+  uint64_t ssd_size = 0;
+  _db->get_estimate_key_num(ssd_size);
+  return MemorySparseTable::LocalSize() + static_cast<int64_t>(ssd_size);
+}
+
+}  // namespace distributed
+}  // namespace paddle
+#endif
@@ -0,0 +1,64 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#ifdef PADDLE_WITH_HETERPS
+#include <memory>
+#include <string>
+#include <utility>
+#include "gflags/gflags.h"
+#include "paddle/fluid/distributed/ps/table/depends/rocksdb_warpper.h"
+#include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
+
+namespace paddle {
+namespace distributed {
+
+// 冷热分层的稀疏表: 热特征保存在内存shard中, 由accessor的SaveSSD
+// 判定为冷的特征在Shrink时换出到每个shard对应的rocksdb column family,
+// pull/push命中ssd时再搬回内存. 同一个key只会存在于内存或ssd其中之一.
+class SSDSparseTable : public MemorySparseTable {
+ public:
+  SSDSparseTable() {}
+  virtual ~SSDSparseTable() {}
+
+  int32_t Initialize() override;
+
+  int32_t PullSparse(float* pull_values,
+                     const PullSparseValue& pull_value) override;
+  int32_t PullSparsePtr(char** pull_values, const uint64_t* keys,
+                        size_t num) override;
+  int32_t PushSparse(const uint64_t* keys, const float* values,
+                     size_t num) override;
+  int32_t PushSparse(const uint64_t* keys, const float** values,
+                     size_t num) override;
+
+  int32_t Load(const std::string& path, const std::string& param) override;
+  int32_t Save(const std::string& path, const std::string& param) override;
+  int32_t Shrink(const std::string& param) override;
+
+  int64_t LocalSize() override;
+
+ protected:
+  // 在内存shard中查找key, 未命中时从ssd读出并搬回内存,
+  // 两者都未命中时返回shard.end()
+  shard_type::iterator FindAndRestore(size_t shard_id, uint64_t key);
+
+ private:
+  std::unique_ptr<RocksDBHandler> _db;
+};
+
+}  // namespace distributed
+}  // namespace paddle
+#endif
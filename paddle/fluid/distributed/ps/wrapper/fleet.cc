@@ -271,6 +271,12 @@ void FleetWrapper::PullSparseVarsSync(
 // is_training is true means training, false means inference, the behavior is
 // different on pserver
 
+void FleetWrapper::AdvanceSparsePullCacheStep() {
+  if (worker_ptr_ != nullptr) {
+    worker_ptr_->AdvanceSparsePullCacheStep();
+  }
+}
+
 void FleetWrapper::PullSparseToTensorSync(const uint64_t table_id, int fea_dim,
                                           uint64_t padding_id,
                                           platform::Place place,
@@ -113,6 +113,10 @@ class FleetWrapper {
                               std::vector<const LoDTensor*>* inputs,  // NOLINT
                               std::vector<LoDTensor*>* outputs);      // NOLINT
 
+  // advance the step of worker side sparse pull cache, called once per
+  // mini-batch by trainer
+  void AdvanceSparsePullCacheStep();
+
   // pull dense variables from server in sync mod
   // Param<in>: scope, table_id, var_names
   // Param<out>: void
@@ -13,6 +13,7 @@ See the License for the specific language governing permissions and
 limitations under the License. */
 
 #include "paddle/fluid/distributed/ps/table/depends/feature_value.h"
+#include <algorithm>
 #include <vector>
 #include "gtest/gtest.h"
 
@@ -44,5 +45,60 @@ TEST(BENCHMARK, LargeScaleKV) {
   ASSERT_FLOAT_EQ(value_data[3], 0.3);
 }
 
+TEST(SparseTableShard, SlabValue) {
+  typedef SparseTableShard<uint64_t, SlabFeatureValue,
+                           SparseKeyHasher<uint64_t>,
+                           SlabAllocator<SlabFeatureValue>>
+      shard_type;
+  const size_t value_dim = 11;
+  shard_type shard;
+  shard.allocator().set_extra_size(value_dim * sizeof(float));
+
+  for (uint64_t key = 0; key < 1000; ++key) {
+    auto& feature_value = shard[key];
+    ASSERT_EQ(feature_value.capacity(), value_dim);
+    feature_value.resize(key % 2 == 0 ? value_dim : value_dim - 4);
+    for (size_t i = 0; i < feature_value.size(); ++i) {
+      feature_value.data()[i] = key + i * 0.1;
+    }
+  }
+  ASSERT_EQ(shard.size(), 1000UL);
+  for (uint64_t key = 0; key < 1000; ++key) {
+    auto itr = shard.find(key);
+    ASSERT_TRUE(itr != shard.end());
+    ASSERT_EQ(itr.value().size(), key % 2 == 0 ? value_dim : value_dim - 4);
+    for (size_t i = 0; i < itr.value().size(); ++i) {
+      ASSERT_FLOAT_EQ(itr.value().data()[i], key + i * 0.1);
+    }
+  }
+  for (uint64_t key = 0; key < 1000; key += 2) {
+    ASSERT_EQ(shard.erase(key), 1UL);
+  }
+  ASSERT_EQ(shard.size(), 500UL);
+}
+
+TEST(SparseTableShard, BucketBalance) {
+  typedef SparseTableShard<uint64_t, FixedFeatureValue> shard_type;
+  shard_type shard;
+  // feasigns sharing the same high bits must not collapse into one bucket
+  const uint64_t prefix = static_cast<uint64_t>(0x12345) << 40;
+  const size_t key_num = 64 * 1024;
+  for (uint64_t i = 0; i < key_num; ++i) {
+    shard[prefix + i].resize(1);
+  }
+  ASSERT_EQ(shard.size(), key_num);
+
+  size_t max_bucket_size = 0;
+  for (size_t bucket = 0; bucket < shard.bucket_count(); ++bucket) {
+    max_bucket_size = std::max(max_bucket_size, shard.bucket_size(bucket));
+  }
+  size_t avg_bucket_size = key_num / shard.bucket_count();
+  ASSERT_LT(max_bucket_size, avg_bucket_size * 2);
+
+  for (uint64_t i = 0; i < key_num; ++i) {
+    ASSERT_TRUE(shard.find(prefix + i) != shard.end());
+  }
+}
+
 }  // namespace distributed
 }  // namespace paddle
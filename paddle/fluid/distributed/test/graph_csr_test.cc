@@ -0,0 +1,246 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/ps/table/common_graph_table.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_csr.h"
+#include "paddle/fluid/distributed/ps/table/graph/graph_node.h"
+
+namespace distributed = paddle::distributed;
+
+TEST(CsrGraph, BuildFromNodes) {
+  distributed::GraphNode node_a(12);
+  node_a.build_edges(true);
+  node_a.add_edge(3, 0.5);
+  node_a.add_edge(4, 2.0);
+  node_a.add_edge(5, 1.0);
+  node_a.build_sampler("weighted");
+  distributed::GraphNode node_b(7);
+  node_b.build_edges(true);
+  node_b.add_edge(12, 1.5);
+  node_b.build_sampler("weighted");
+  distributed::FeatureNode node_c(9);
+  node_c.set_feature_size(2);
+  node_c.set_feature(0, "abc");
+  node_c.set_feature(1, "de");
+
+  std::vector<distributed::Node *> nodes = {&node_a, &node_b, &node_c};
+  distributed::CsrGraph csr;
+  csr.build(nodes);
+  ASSERT_EQ(csr.size(), 3u);
+  ASSERT_EQ(csr.edge_size(), 4u);
+  ASSERT_TRUE(csr.is_weighted());
+  ASSERT_EQ(csr.find(100), -1);
+
+  int64_t idx = csr.find(12);
+  ASSERT_GE(idx, 0);
+  ASSERT_EQ(csr.get_neighbor_size(idx), 3u);
+  for (int k = 0; k < 3; ++k) {
+    ASSERT_EQ(csr.get_neighbor_id(idx, k), node_a.get_neighbor_id(k));
+    ASSERT_FLOAT_EQ(csr.get_neighbor_weight(idx, k),
+                    node_a.get_neighbor_weight(k));
+  }
+
+  distributed::CounterRng rng(0);
+  int res[5];
+  for (int round = 0; round < 100; ++round) {
+    ASSERT_EQ(csr.sample_k(idx, 2, &rng, res), 2);
+    ASSERT_NE(res[0], res[1]);
+    ASSERT_LT(res[0], 3);
+    ASSERT_LT(res[1], 3);
+  }
+  ASSERT_EQ(csr.sample_k(idx, 5, &rng, res), 3);
+
+  idx = csr.find(9);
+  ASSERT_GE(idx, 0);
+  ASSERT_EQ(csr.get_neighbor_size(idx), 0u);
+  ASSERT_EQ(csr.get_feature_size(idx), 2);
+  ASSERT_EQ(csr.get_feature(idx, 0), "abc");
+  ASSERT_EQ(csr.get_feature(idx, 1), "de");
+  ASSERT_EQ(csr.get_feature(idx, 2), "");
+
+  // serialized layout is the same as the node based storage
+  for (bool need_feature : {true, false}) {
+    int size = node_c.get_size(need_feature);
+    ASSERT_EQ(csr.get_size(idx, need_feature), size);
+    std::string expect(size, '\0'), actual(size, '\0');
+    node_c.to_buffer(&expect[0], need_feature);
+    csr.to_buffer(idx, &actual[0], need_feature);
+    ASSERT_EQ(expect, actual);
+  }
+}
+
+TEST(CsrGraph, UnweightedSample) {
+  distributed::GraphNode node(1);
+  node.build_edges(false);
+  for (int i = 0; i < 10; ++i) {
+    node.add_edge(100 + i, 1.0);
+  }
+  std::vector<distributed::Node *> nodes = {&node};
+  distributed::CsrGraph csr;
+  csr.build(nodes);
+  ASSERT_FALSE(csr.is_weighted());
+  distributed::CounterRng rng(0);
+  int res[6];
+  ASSERT_EQ(csr.sample_k(0, 6, &rng, res), 6);
+  std::set<int> uniq(res, res + 6);
+  ASSERT_EQ(uniq.size(), 6u);
+}
+
+TEST(CsrGraph, AliasSample) {
+  // edge i has weight i + 1, sampled by alias table
+  const int degree = 100;
+  distributed::GraphNode node(1);
+  node.build_edges(true);
+  for (int i = 0; i < degree; ++i) {
+    node.add_edge(i, i + 1);
+  }
+  // sorted before node 1 and below min_degree, so it gets no alias slots
+  distributed::GraphNode small_node(0);
+  small_node.build_edges(true);
+  for (int i = 0; i < 8; ++i) {
+    small_node.add_edge(i, 2.0);
+  }
+  std::vector<distributed::Node *> nodes = {&node, &small_node};
+  distributed::CsrGraph csr;
+  csr.build(nodes);
+  csr.build_alias(16);
+  ASSERT_EQ(csr.alias_size(), static_cast<size_t>(degree));
+  size_t idx = csr.find(1);
+
+  distributed::CounterRng rng(7);
+  std::vector<int> hits(degree, 0);
+  const int rounds = 200000;
+  int res[40];
+  for (int round = 0; round < rounds; ++round) {
+    ASSERT_EQ(csr.sample_k(idx, 1, &rng, res), 1);
+    hits[res[0]]++;
+  }
+  double total = degree * (degree + 1) / 2;
+  for (int i : {0, 49, 99}) {
+    double expect = rounds * (i + 1) / total;
+    ASSERT_NEAR(hits[i], expect, 5 * std::sqrt(expect) + 5);
+  }
+
+  // without replacement
+  for (int round = 0; round < 100; ++round) {
+    ASSERT_EQ(csr.sample_k(idx, 40, &rng, res), 40);
+    std::set<int> uniq(res, res + 40);
+    ASSERT_EQ(uniq.size(), 40u);
+  }
+}
+
+TEST(GraphTable, BuildCsr) {
+  std::vector<std::string> edges = {"37\t45\t0.34", "37\t145\t0.31",
+                                    "37\t112\t0.21", "96\t48\t1.4",
+                                    "96\t247\t0.31", "96\t111\t1.21"};
+  std::vector<std::string> nodes = {"user\t59\ta 0.34\tb 13 14",
+                                    "user\t60\ta 0.11\tb 11 14"};
+  std::ofstream edge_file("csr_edges.txt");
+  for (auto &line : edges) edge_file << line << std::endl;
+  edge_file.close();
+  std::ofstream node_file("csr_nodes.txt");
+  for (auto &line : nodes) node_file << line << std::endl;
+  node_file.close();
+
+  distributed::GraphParameter table_proto;
+  table_proto.set_shard_num(127);
+  table_proto.set_task_pool_size(4);
+  auto *feature = table_proto.mutable_graph_feature();
+  feature->add_name("a");
+  feature->add_dtype("float32");
+  feature->add_shape(1);
+  feature->add_name("b");
+  feature->add_dtype("int32");
+  feature->add_shape(2);
+  distributed::GraphTable table;
+  table.Initialize(table_proto);
+  ASSERT_EQ(table.Load("csr_edges.txt", "e>"), 0);
+  ASSERT_EQ(table.Load("csr_nodes.txt", "nuser"), 0);
+
+  std::vector<int64_t> ids = {37, 96, 59, 1000};
+  std::vector<std::string> feature_names = {"a", "b"};
+  auto sample = [&](std::vector<std::vector<int64_t>> *neighbors) {
+    std::vector<std::shared_ptr<char>> buffers(ids.size());
+    std::vector<int> actual_sizes(ids.size(), 0);
+    table.random_sample_neighbors(ids.data(), 10, buffers, actual_sizes,
+                                  true);
+    neighbors->assign(ids.size(), {});
+    for (size_t i = 0; i < ids.size(); ++i) {
+      int step = sizeof(int64_t) + sizeof(float);
+      for (int offset = 0; offset < actual_sizes[i]; offset += step) {
+        int64_t id;
+        memcpy(&id, buffers[i].get() + offset, sizeof(int64_t));
+        (*neighbors)[i].push_back(id);
+      }
+    }
+  };
+  std::vector<std::vector<int64_t>> before, after;
+  sample(&before);
+  std::vector<std::vector<std::string>> feat_before(
+      2, std::vector<std::string>(ids.size()));
+  table.get_node_feat(ids, feature_names, feat_before);
+  std::unique_ptr<char[]> list_before;
+  int list_size_before = 0;
+  table.pull_graph_list(0, 10, list_before, list_size_before, true, 1);
+
+  ASSERT_EQ(table.build_csr(), 0);
+  ASSERT_TRUE(table.is_csr());
+  sample(&after);
+  ASSERT_EQ(before, after);
+  ASSERT_EQ(before[0].size(), 3u);
+  ASSERT_EQ(before[3].size(), 0u);
+  std::vector<std::vector<std::string>> feat_after(
+      2, std::vector<std::string>(ids.size()));
+  table.get_node_feat(ids, feature_names, feat_after);
+  ASSERT_EQ(feat_before, feat_after);
+  std::unique_ptr<char[]> list_after;
+  int list_size_after = 0;
+  table.pull_graph_list(0, 10, list_after, list_size_after, true, 1);
+  ASSERT_EQ(list_size_before, list_size_after);
+
+  std::vector<int> actual_sizes;
+  std::unique_ptr<char[]> batch_buffer;
+  ASSERT_EQ(table.batch_sample_neighbors(ids.data(), ids.size(), 2, false,
+                                         actual_sizes, batch_buffer),
+            0);
+  std::vector<int> expect_sizes = {16, 16, 0, 0};
+  ASSERT_EQ(actual_sizes, expect_sizes);
+  std::set<int64_t> sampled;
+  for (int i = 0; i < 2; ++i) {
+    int64_t id;
+    memcpy(&id, batch_buffer.get() + i * sizeof(int64_t), sizeof(int64_t));
+    sampled.insert(id);
+  }
+  ASSERT_EQ(sampled.size(), 2u);
+  for (auto id : sampled) {
+    ASSERT_TRUE(id == 45 || id == 145 || id == 112);
+  }
+
+  std::vector<int64_t> new_ids = {1};
+  std::vector<bool> weighted = {false};
+  ASSERT_EQ(table.add_graph_node(new_ids, weighted), -1);
+  table.clear_nodes();
+  ASSERT_FALSE(table.is_csr());
+  ASSERT_EQ(table.add_graph_node(new_ids, weighted), 0);
+}
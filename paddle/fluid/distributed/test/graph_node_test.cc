@@ -194,6 +194,37 @@ void testAddNode(
     ASSERT_EQ(id_set_check.find(x) != id_set_check.end(), true);
   }
 }
+void testSampleKHop(
+    std::shared_ptr<paddle::distributed::GraphBrpcClient>& worker_ptr_) {
+  std::vector<int64_t> nodes;
+  std::vector<uint32_t> edge_src, edge_dst;
+  std::vector<float> edge_weight;
+  std::vector<size_t> hop_edge_end;
+  auto pull_status = worker_ptr_->sample_k_hop(
+      0, {37, 96, 37}, {4, 2}, true, nodes, edge_src, edge_dst, edge_weight,
+      hop_edge_end);
+  pull_status.wait();
+  // items have no out edges, so the second hop is empty
+  ASSERT_EQ(hop_edge_end.size(), 2);
+  ASSERT_EQ(hop_edge_end[0], 6);
+  ASSERT_EQ(hop_edge_end[1], 6);
+  ASSERT_EQ(nodes.size(), 8);
+  ASSERT_EQ(nodes[0], 37);
+  ASSERT_EQ(nodes[1], 96);
+  ASSERT_EQ(edge_weight.size(), 6);
+  std::unordered_set<int64_t> s1 = {112, 45, 145};
+  std::unordered_set<int64_t> s2 = {111, 48, 247};
+  for (size_t i = 0; i < edge_src.size(); i++) {
+    int64_t dst = nodes[edge_dst[i]];
+    if (nodes[edge_src[i]] == 37) {
+      ASSERT_EQ(true, s1.find(dst) != s1.end());
+    } else {
+      ASSERT_EQ(nodes[edge_src[i]], 96);
+      ASSERT_EQ(true, s2.find(dst) != s2.end());
+    }
+  }
+}
+
 void testBatchSampleNeighboor(
     std::shared_ptr<paddle::distributed::GraphBrpcClient>& worker_ptr_) {
   std::vector<std::vector<int64_t>> vs;
@@ -433,6 +464,7 @@ void RunBrpcPushSparse() {
   sleep(5);
   testSingleSampleNeighboor(worker_ptr_);
   testBatchSampleNeighboor(worker_ptr_);
+  testSampleKHop(worker_ptr_);
   pull_status = worker_ptr_->batch_sample_neighbors(
       0, std::vector<int64_t>(1, 10240001024), 4, _vs, vs, true);
   pull_status.wait();
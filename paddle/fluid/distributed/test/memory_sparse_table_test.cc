@@ -18,12 +18,15 @@ limitations under the License. */
 #include <string>
 #include <thread>  // NOLINT
 
+#include "gflags/gflags.h"
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
 #include "paddle/fluid/distributed/ps.pb.h"
 #include "paddle/fluid/distributed/ps/table/memory_sparse_table.h"
 #include "paddle/fluid/distributed/ps/table/table.h"
 
+DECLARE_bool(pserver_sparse_table_pinned_worker);
+
 namespace paddle {
 namespace distributed {
 
@@ -154,5 +157,349 @@ TEST(MemorySparseTable, SGD) {
   ctr_table->SaveLocalFS("./work/table.save", "0", "test");
 }
 
+TEST(MemorySparseTable, BinarySaveLoad) {
+  int emb_dim = 8;
+  TableParameter table_config;
+  table_config.set_table_class("MemorySparseTable");
+  table_config.set_shard_num(10);
+  table_config.set_enable_binary_save(true);
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(emb_dim);
+  accessor_config->set_embedx_threshold(5);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  auto *naive_param =
+      accessor_config->mutable_embed_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0.3);
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  naive_param = accessor_config->mutable_embedx_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0.3);
+  FsClientParameter fs_config;
+
+  MemorySparseTable *table = new MemorySparseTable();
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+
+  // push gradients to create keys, half of them with extended mf
+  std::vector<uint64_t> keys;
+  std::vector<float> gradients;
+  for (uint64_t key = 0; key < 100; ++key) {
+    keys.push_back(key);
+    for (int k = 0; k < emb_dim + 4; k++) {
+      gradients.push_back(k == 1 ? (key % 2 == 0 ? 100.0 : 0.0) : 0.1 * k);
+    }
+  }
+  table->PushSparse(keys.data(), gradients.data(), keys.size());
+
+  std::string path = "./work/binary_table";
+  for (size_t i = 0; i < 10; ++i) {
+    std::string file = paddle::string::format_string(
+        "%s/000/part-000-%05d%s", path.c_str(), i, PSERVER_BINARY_SAVE_SUFFIX);
+    ASSERT_GT(table->SaveBinaryShard(i, file, 0), 0);
+  }
+
+  MemorySparseTable *loaded_table = new MemorySparseTable();
+  loaded_table->SetShard(0, 1);
+  ASSERT_EQ(loaded_table->Initialize(table_config, fs_config), 0);
+  ASSERT_EQ(loaded_table->LoadLocalFS(path, "0"), 0);
+  ASSERT_EQ(loaded_table->LocalSize(), table->LocalSize());
+  ASSERT_EQ(loaded_table->LocalMFSize(), table->LocalMFSize());
+
+  std::vector<uint32_t> fres(keys.size(), 1);
+  auto value = PullSparseValue(keys, fres, emb_dim);
+  std::vector<float> pull_values(keys.size() * (emb_dim + 3));
+  std::vector<float> loaded_pull_values(keys.size() * (emb_dim + 3));
+  table->PullSparse(pull_values.data(), value);
+  loaded_table->PullSparse(loaded_pull_values.data(), value);
+  for (size_t i = 0; i < pull_values.size(); ++i) {
+    ASSERT_FLOAT_EQ(pull_values[i], loaded_pull_values[i]);
+  }
+}
+
+TEST(MemorySparseTable, BinaryLoadLayoutMismatch) {
+  TableParameter table_config;
+  table_config.set_table_class("MemorySparseTable");
+  table_config.set_shard_num(10);
+  table_config.set_enable_binary_save(true);
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(8);
+  accessor_config->set_embedx_threshold(5);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  accessor_config->mutable_embed_sgd_param()->mutable_naive();
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  accessor_config->mutable_embedx_sgd_param()->mutable_naive();
+  FsClientParameter fs_config;
+
+  MemorySparseTable *table = new MemorySparseTable();
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+  std::vector<uint64_t> keys;
+  std::vector<float> gradients;
+  for (uint64_t key = 0; key < 10; ++key) {
+    keys.push_back(key);
+    for (int k = 0; k < 8 + 4; k++) {
+      gradients.push_back(0.1 * k);
+    }
+  }
+  table->PushSparse(keys.data(), gradients.data(), keys.size());
+  std::string file = paddle::string::format_string(
+      "./work/binary_layout/000/part-000-%05d%s",
+      0,
+      PSERVER_BINARY_SAVE_SUFFIX);
+  ASSERT_GT(table->SaveBinaryShard(0, file, 0), 0);
+
+  // embedx_dim 7 + adagrad g2sum与embedx_dim 8 + naive的value_dim同为14,
+  // 但select/embedx布局不同, 文件不能被加载
+  accessor_config->set_embedx_dim(7);
+  accessor_config->mutable_embedx_sgd_param()->set_name(
+      "SparseAdaGradSGDRule");
+  accessor_config->mutable_embedx_sgd_param()->mutable_adagrad();
+  MemorySparseTable *loaded_table = new MemorySparseTable();
+  loaded_table->SetShard(0, 1);
+  ASSERT_EQ(loaded_table->Initialize(table_config, fs_config), 0);
+  ASSERT_EQ(loaded_table->ValueAccesor()->GetAccessorInfo().size,
+            table->ValueAccesor()->GetAccessorInfo().size);
+  ASSERT_EQ(loaded_table->LoadBinaryShard(0, file), -1);
+  ASSERT_EQ(loaded_table->LocalSize(), 0);
+}
+
+TEST(MemorySparseTable, DeltaSaveLoad) {
+  int emb_dim = 8;
+  TableParameter table_config;
+  table_config.set_table_class("MemorySparseTable");
+  table_config.set_shard_num(10);
+  table_config.set_enable_binary_save(true);
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(emb_dim);
+  accessor_config->set_embedx_threshold(5);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  accessor_config->mutable_embed_sgd_param()->mutable_naive();
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  accessor_config->mutable_embedx_sgd_param()->mutable_naive();
+  FsClientParameter fs_config;
+
+  MemorySparseTable *table = new MemorySparseTable();
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+
+  auto push = [table, emb_dim](uint64_t begin, uint64_t end, float show) {
+    std::vector<uint64_t> keys;
+    std::vector<float> gradients;
+    for (uint64_t key = begin; key < end; ++key) {
+      keys.push_back(key);
+      for (int k = 0; k < emb_dim + 4; k++) {
+        gradients.push_back(k == 1 ? show : 0.1 * k);
+      }
+    }
+    table->PushSparse(keys.data(), gradients.data(), keys.size());
+  };
+  // keys 200~209 are never shown and will be deleted by Shrink
+  push(0, 100, 100.0);
+  push(200, 210, 0.0);
+  ASSERT_EQ(table->Save("./work/delta_table/base", "0"), 0);
+
+  table->Shrink("");
+  push(50, 150, 100.0);
+  ASSERT_EQ(table->LocalSize(), 150);
+  ASSERT_EQ(table->Save("./work/delta_table/delta_1",
+                        std::to_string(SPARSE_SAVE_PARAM_CHECKPOINT_DELTA)),
+            0);
+
+  MemorySparseTable *loaded_table = new MemorySparseTable();
+  loaded_table->SetShard(0, 1);
+  ASSERT_EQ(loaded_table->Initialize(table_config, fs_config), 0);
+  ASSERT_EQ(loaded_table->Load("./work/delta_table/base", "0"), 0);
+  ASSERT_EQ(loaded_table->LocalSize(), 110);
+  ASSERT_EQ(loaded_table->Load(
+                "./work/delta_table/delta_1",
+                std::to_string(SPARSE_SAVE_PARAM_CHECKPOINT_DELTA)),
+            0);
+  ASSERT_EQ(loaded_table->LocalSize(), table->LocalSize());
+
+  std::vector<uint64_t> keys;
+  for (uint64_t key = 0; key < 210; ++key) {
+    keys.push_back(key);
+  }
+  std::vector<uint32_t> fres(keys.size(), 1);
+  auto value = PullSparseValue(keys, fres, emb_dim);
+  std::vector<float> pull_values(keys.size() * (emb_dim + 3));
+  std::vector<float> loaded_pull_values(keys.size() * (emb_dim + 3));
+  table->PullSparse(pull_values.data(), value);
+  loaded_table->PullSparse(loaded_pull_values.data(), value);
+  for (size_t i = 0; i < pull_values.size(); ++i) {
+    ASSERT_FLOAT_EQ(pull_values[i], loaded_pull_values[i]);
+  }
+}
+
+// 比较两个表每个shard中key的完整value, 包括pull不可见的delta score等字段
+static void ExpectSameShards(MemorySparseTable *expected,
+                             MemorySparseTable *actual, size_t shard_num) {
+  ASSERT_EQ(expected->LocalSize(), actual->LocalSize());
+  for (size_t i = 0; i < shard_num; ++i) {
+    auto *expected_shard =
+        static_cast<MemorySparseTable::shard_type *>(expected->GetShard(i));
+    auto *actual_shard =
+        static_cast<MemorySparseTable::shard_type *>(actual->GetShard(i));
+    ASSERT_EQ(expected_shard->size(), actual_shard->size());
+    for (auto it = expected_shard->begin(); it != expected_shard->end();
+         ++it) {
+      auto actual_it = actual_shard->find(it.key());
+      ASSERT_TRUE(actual_it != actual_shard->end()) << it.key();
+      ASSERT_EQ(it.value().size(), actual_it.value().size());
+      for (size_t j = 0; j < it.value().size(); ++j) {
+        ASSERT_FLOAT_EQ(it.value().data()[j], actual_it.value().data()[j])
+            << "key " << it.key() << " dim " << j;
+      }
+    }
+  }
+}
+
+TEST(MemorySparseTable, DeltaReplayAfterXboxSaveAndShrink) {
+  int emb_dim = 8;
+  TableParameter table_config;
+  table_config.set_table_class("MemorySparseTable");
+  table_config.set_shard_num(10);
+  table_config.set_enable_binary_save(true);
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(emb_dim);
+  accessor_config->set_embedx_threshold(5);
+  accessor_config->mutable_ctr_accessor_param()->set_base_threshold(0.5);
+  accessor_config->mutable_ctr_accessor_param()->set_delta_threshold(0.2);
+  accessor_config->mutable_ctr_accessor_param()->set_delta_keep_days(16);
+  accessor_config->mutable_ctr_accessor_param()->set_show_click_decay_rate(
+      0.98);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  accessor_config->mutable_embed_sgd_param()->mutable_naive();
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  accessor_config->mutable_embedx_sgd_param()->mutable_naive();
+  FsClientParameter fs_config;
+
+  MemorySparseTable *table = new MemorySparseTable();
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+
+  auto push = [table, emb_dim](uint64_t begin, uint64_t end, float show) {
+    std::vector<uint64_t> keys;
+    std::vector<float> gradients;
+    for (uint64_t key = begin; key < end; ++key) {
+      keys.push_back(key);
+      for (int k = 0; k < emb_dim + 4; k++) {
+        gradients.push_back(k == 1 ? show : (k == 2 ? 1.0 : 0.1 * k));
+      }
+    }
+    table->PushSparse(keys.data(), gradients.data(), keys.size());
+  };
+  // keys 200~209 are never shown and will be deleted by Shrink
+  push(0, 100, 100.0);
+  push(200, 210, 0.0);
+  ASSERT_EQ(table->Save("./work/delta_replay_table/base", "0"), 0);
+
+  // xbox saves reset the delta score and only keys 0~19 are pushed after
+  // them, the other keys must still be replayed with the reset score
+  ASSERT_EQ(table->Save("./work/delta_replay_table/xbox_delta", "1"), 0);
+  ASSERT_EQ(table->Save("./work/delta_replay_table/xbox_base", "2"), 0);
+  push(0, 20, 100.0);
+  table->Shrink("");
+  ASSERT_EQ(table->LocalSize(), 100);
+  ASSERT_EQ(table->Save("./work/delta_replay_table/delta_1",
+                        std::to_string(SPARSE_SAVE_PARAM_CHECKPOINT_DELTA)),
+            0);
+
+  // a batch model save increases the unseen days after saving
+  push(100, 120, 100.0);
+  ASSERT_EQ(table->Save("./work/delta_replay_table/delta_2",
+                        std::to_string(SPARSE_SAVE_PARAM_CHECKPOINT_DELTA)),
+            0);
+  ASSERT_EQ(table->Save("./work/delta_replay_table/batch_model", "3"), 0);
+  ASSERT_EQ(table->Save("./work/delta_replay_table/delta_3",
+                        std::to_string(SPARSE_SAVE_PARAM_CHECKPOINT_DELTA)),
+            0);
+
+  MemorySparseTable *loaded_table = new MemorySparseTable();
+  loaded_table->SetShard(0, 1);
+  ASSERT_EQ(loaded_table->Initialize(table_config, fs_config), 0);
+  ASSERT_EQ(loaded_table->Load("./work/delta_replay_table/base", "0"), 0);
+  for (auto delta : {"delta_1", "delta_2", "delta_3"}) {
+    ASSERT_EQ(loaded_table->Load(
+                  std::string("./work/delta_replay_table/") + delta,
+                  std::to_string(SPARSE_SAVE_PARAM_CHECKPOINT_DELTA)),
+              0);
+  }
+  ExpectSameShards(table, loaded_table, 10);
+}
+
+TEST(MemorySparseTable, PinnedWorker) {
+  int emb_dim = 8;
+  TableParameter table_config;
+  table_config.set_table_class("MemorySparseTable");
+  table_config.set_shard_num(10);
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(emb_dim);
+  accessor_config->set_embedx_threshold(5);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  auto *naive_param =
+      accessor_config->mutable_embed_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0.0);
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  naive_param = accessor_config->mutable_embedx_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0.0);
+  FsClientParameter fs_config;
+
+  MemorySparseTable *table = new MemorySparseTable();
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+
+  FLAGS_pserver_sparse_table_pinned_worker = true;
+  MemorySparseTable *pinned_table = new MemorySparseTable();
+  pinned_table->SetShard(0, 1);
+  ASSERT_EQ(pinned_table->Initialize(table_config, fs_config), 0);
+  FLAGS_pserver_sparse_table_pinned_worker = false;
+
+  std::vector<uint64_t> keys;
+  std::vector<float> gradients;
+  for (uint64_t key = 0; key < 1000; ++key) {
+    keys.push_back(key);
+    for (int k = 0; k < emb_dim + 4; k++) {
+      gradients.push_back(k == 1 ? (key % 2 == 0 ? 100.0 : 0.0) : 0.1 * k);
+    }
+  }
+  // 多线程并发push, 结果应与默认的ThreadPool模式一致
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    table->PushSparse(keys.data(), gradients.data(), keys.size());
+    threads.emplace_back([&] {
+      pinned_table->PushSparse(keys.data(), gradients.data(), keys.size());
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(pinned_table->LocalSize(), table->LocalSize());
+  ASSERT_EQ(pinned_table->LocalMFSize(), table->LocalMFSize());
+
+  std::vector<uint32_t> fres(keys.size(), 1);
+  auto value = PullSparseValue(keys, fres, emb_dim);
+  std::vector<float> pull_values(keys.size() * (emb_dim + 3));
+  std::vector<float> pinned_pull_values(keys.size() * (emb_dim + 3));
+  table->PullSparse(pull_values.data(), value);
+  pinned_table->PullSparse(pinned_pull_values.data(), value);
+  for (size_t i = 0; i < pull_values.size(); ++i) {
+    ASSERT_NEAR(pull_values[i], pinned_pull_values[i], 1e-5);
+  }
+}
+
 }  // namespace distributed
 }  // namespace paddle
@@ -0,0 +1,74 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/service/push_sparse_merge_tuner.h"
+
+namespace paddle {
+namespace distributed {
+
+TEST(PushSparseMergeTuner, MergeLimit) {
+  PushSparseMergeTuner tuner(10, 64, 8, 10);
+  ASSERT_EQ(tuner.merge_limit(), 10u);
+
+  // 没有任务到达时merge_limit收缩到1
+  for (int i = 0; i < 20; ++i) {
+    usleep(2000);
+    tuner.Update(0, 0, 0, 8);
+  }
+  ASSERT_EQ(tuner.merge_limit(), 1u);
+
+  // 高到达率且rpc较慢时放大merge_limit, 但不超过上限
+  tuner.RecordRpcLatency(100);
+  for (int i = 0; i < 20; ++i) {
+    usleep(2000);
+    tuner.Update(100, 100, 0, 8);
+  }
+  ASSERT_EQ(tuner.merge_limit(), 64u);
+}
+
+TEST(PushSparseMergeTuner, MergeThreadNum) {
+  PushSparseMergeTuner tuner(10, 64, 8, 10);
+  ASSERT_EQ(tuner.merge_thread_num(), 1u);
+
+  // merge耗时超过发送间隔: 加倍, 受cpu余量和上限限制
+  tuner.Update(1, 1, 20, 4);
+  ASSERT_EQ(tuner.merge_thread_num(), 2u);
+  tuner.Update(1, 1, 20, 4);
+  ASSERT_EQ(tuner.merge_thread_num(), 4u);
+  tuner.Update(1, 1, 20, 4);
+  ASSERT_EQ(tuner.merge_thread_num(), 4u);
+  tuner.Update(1, 1, 20, 100);
+  ASSERT_EQ(tuner.merge_thread_num(), 8u);
+
+  // merge耗时处于间隔的1/4到1之间时保持不变
+  tuner.Update(1, 1, 5, 100);
+  ASSERT_EQ(tuner.merge_thread_num(), 8u);
+
+  // merge很快时减半, 最少一个线程
+  for (int i = 0; i < 5; ++i) {
+    tuner.Update(1, 1, 0, 100);
+  }
+  ASSERT_EQ(tuner.merge_thread_num(), 1u);
+}
+
+TEST(PushSparseMergeTuner, CpuHeadroom) {
+  double headroom = PushSparseMergeTuner::SampleCpuHeadroom();
+  ASSERT_GE(headroom, 0);
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,204 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/service/sparse_pull_cache.h"
+
+namespace paddle {
+namespace distributed {
+
+TEST(SparsePullCache, LookupAndStaleness) {
+  const size_t dim = 4;
+  SparsePullCache cache(128, sizeof(float) * dim, 2);
+  SparsePullCache::EpochSnapshot epochs;
+  cache.SnapshotEpochs(&epochs);
+  uint64_t step = cache.PullStep();
+
+  std::vector<float> value(dim, 0.0);
+  std::vector<float> out(dim, 0.0);
+  for (uint64_t key = 0; key < 1000; ++key) {
+    value[0] = key;
+    cache.Insert(key, step, reinterpret_cast<char*>(value.data()), epochs);
+  }
+  // 容量按桶均分, 总数不超过capacity
+  ASSERT_LE(cache.Size(), 128);
+
+  value[0] = 5;
+  cache.Insert(5, step, reinterpret_cast<char*>(value.data()), epochs);
+  ASSERT_TRUE(cache.Lookup(5, step + 2, reinterpret_cast<char*>(out.data())));
+  ASSERT_FLOAT_EQ(out[0], 5);
+  ASSERT_FALSE(cache.Lookup(5, step + 3, reinterpret_cast<char*>(out.data())));
+}
+
+TEST(SparsePullCache, InvalidateOnPush) {
+  const size_t dim = 4;
+  SparsePullCache cache(128, sizeof(float) * dim, 10);
+  SparsePullCache::EpochSnapshot epochs;
+  cache.SnapshotEpochs(&epochs);
+  uint64_t step = cache.PullStep();
+  std::vector<float> value(dim, 1.0);
+  std::vector<float> out(dim, 0.0);
+
+  uint64_t key = 7;
+  cache.Insert(key, step, reinterpret_cast<char*>(value.data()), epochs);
+  cache.Invalidate(&key, 1);
+  ASSERT_FALSE(cache.Lookup(key, step, reinterpret_cast<char*>(out.data())));
+
+  // push之前发出的pull回包不能写回缓存
+  cache.Insert(key, step, reinterpret_cast<char*>(value.data()), epochs);
+  ASSERT_FALSE(cache.Lookup(key, step, reinterpret_cast<char*>(out.data())));
+
+  cache.SnapshotEpochs(&epochs);
+  cache.Insert(key, step, reinterpret_cast<char*>(value.data()), epochs);
+  ASSERT_TRUE(cache.Lookup(key, step, reinterpret_cast<char*>(out.data())));
+}
+
+TEST(SparsePullCache, InvalidateOnlyPushedKeys) {
+  const size_t dim = 4;
+  SparsePullCache cache(1024, sizeof(float) * dim, 10);
+  std::vector<float> value(dim, 1.0);
+  std::vector<float> out(dim, 0.0);
+
+  // push前发出的pull, 回包时key 0已被push, 其他key仍可写入缓存
+  SparsePullCache::EpochSnapshot epochs;
+  cache.SnapshotEpochs(&epochs);
+  uint64_t step = cache.PullStep();
+  uint64_t pushed_key = 0;
+  cache.Invalidate(&pushed_key, 1);
+  for (uint64_t key = 0; key < 256; ++key) {
+    cache.Insert(key, step, reinterpret_cast<char*>(value.data()), epochs);
+  }
+  ASSERT_FALSE(
+      cache.Lookup(pushed_key, step, reinterpret_cast<char*>(out.data())));
+  for (uint64_t key = 1; key < 256; ++key) {
+    ASSERT_TRUE(cache.Lookup(key, step, reinterpret_cast<char*>(out.data())));
+  }
+  ASSERT_EQ(cache.Size(), 255);
+}
+
+// 大批冷key的push不占slot, 不会把热点entry挤出缓存
+TEST(SparsePullCache, InvalidateColdKeysKeepsHotEntries) {
+  const size_t dim = 4;
+  SparsePullCache cache(256, sizeof(float) * dim, 10);
+  std::vector<float> value(dim, 1.0);
+  std::vector<float> out(dim, 0.0);
+
+  SparsePullCache::EpochSnapshot epochs;
+  cache.SnapshotEpochs(&epochs);
+  uint64_t step = cache.PullStep();
+  std::vector<uint64_t> hot_keys;
+  for (uint64_t key = 0; key < 64; ++key) {
+    hot_keys.push_back(key);
+    cache.Insert(key, step, reinterpret_cast<char*>(value.data()), epochs);
+  }
+  size_t hot_size = cache.Size();
+  ASSERT_GT(hot_size, 0);
+
+  SparsePullCache::EpochSnapshot pull_epochs;
+  cache.SnapshotEpochs(&pull_epochs);
+  std::vector<uint64_t> cold_keys;
+  for (uint64_t key = 0; key < 4096; ++key) {
+    cold_keys.push_back(1000000 + key);
+  }
+  cache.Invalidate(cold_keys.data(), 8);
+  ASSERT_EQ(cache.Size(), hot_size);
+  size_t hit = 0;
+  for (auto key : hot_keys) {
+    hit += cache.Lookup(key, step, reinterpret_cast<char*>(out.data()));
+  }
+  ASSERT_EQ(hit, hot_size);
+
+  // push之前发出的冷key pull回包被拦截
+  for (size_t i = 0; i < 8; ++i) {
+    cache.Insert(cold_keys[i], step, reinterpret_cast<char*>(value.data()),
+                 pull_epochs);
+    ASSERT_FALSE(
+        cache.Lookup(cold_keys[i], step, reinterpret_cast<char*>(out.data())));
+  }
+
+  // 删除标记超出上限后仍然保守: 更早的回包一律不写入
+  cache.SnapshotEpochs(&pull_epochs);
+  cache.Invalidate(cold_keys.data(), cold_keys.size());
+  ASSERT_EQ(cache.Size(), hot_size);
+  for (auto key : cold_keys) {
+    cache.Insert(key, step, reinterpret_cast<char*>(value.data()),
+                 pull_epochs);
+  }
+  ASSERT_EQ(cache.Size(), hot_size);
+
+  // push之后发出的pull可以正常写入
+  cache.SnapshotEpochs(&pull_epochs);
+  cache.Insert(cold_keys[0], step, reinterpret_cast<char*>(value.data()),
+               pull_epochs);
+  ASSERT_TRUE(
+      cache.Lookup(cold_keys[0], step, reinterpret_cast<char*>(out.data())));
+}
+
+// 模拟训练: 每个mini-batch pull一批热点key, 回包前push上一个batch的key,
+// step由trainer推进, 与每个batch内pull的次数无关
+TEST(SparsePullCache, HitRateWithPullPushInterleaving) {
+  const size_t dim = 4;
+  const uint32_t max_staleness = 4;
+  const size_t batch_num = 100;
+  const size_t pull_per_batch = 3;
+  std::vector<float> value(dim, 1.0);
+  std::vector<float> out(dim, 0.0);
+
+  for (bool invalidate_on_push : {false, true}) {
+    SparsePullCache cache(4096, sizeof(float) * dim, max_staleness);
+    size_t hit = 0;
+    size_t total = 0;
+    for (size_t batch = 0; batch < batch_num; ++batch) {
+      cache.AdvanceStep();
+      for (size_t pull = 0; pull < pull_per_batch; ++pull) {
+        // 每次pull 64个热点key和64个只出现一次的长尾key
+        std::vector<uint64_t> keys;
+        for (uint64_t key = 0; key < 64; ++key) {
+          keys.push_back(key);
+          keys.push_back(1000000 + (batch * pull_per_batch + pull) * 64 + key);
+        }
+        SparsePullCache::EpochSnapshot epochs;
+        cache.SnapshotEpochs(&epochs);
+        uint64_t step = cache.PullStep();
+        ASSERT_EQ(step, batch + 1);
+        std::vector<uint64_t> missed;
+        for (auto key : keys) {
+          ++total;
+          if (cache.Lookup(key, step, reinterpret_cast<char*>(out.data()))) {
+            ++hit;
+          } else {
+            missed.push_back(key);
+          }
+        }
+        // 在途期间其他线程push了一部分长尾key
+        if (invalidate_on_push) {
+          cache.Invalidate(keys.data() + 1, 1);
+        }
+        for (auto key : missed) {
+          cache.Insert(key, step, reinterpret_cast<char*>(value.data()),
+                       epochs);
+        }
+      }
+    }
+    // 热点key每max_staleness+1个batch只回源一次
+    ASSERT_GT(hit, total * 2 / 5) << "invalidate_on_push "
+                                  << invalidate_on_push;
+    ASSERT_LT(hit, total / 2);
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
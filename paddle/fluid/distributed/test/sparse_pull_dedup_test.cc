@@ -0,0 +1,123 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/service/sparse_pull_dedup.h"
+
+namespace paddle {
+namespace distributed {
+
+const size_t kDim = 3;
+
+// 带重复key的batch, 每个位置对应select_values中的一行
+static std::vector<uint64_t> MakeKeys() {
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 500; ++i) {
+    keys.push_back((i * 7919) % 113 + (static_cast<uint64_t>(1) << 40));
+  }
+  keys.push_back(0);
+  keys.push_back(0);
+  keys.push_back(UINT64_MAX);
+  return keys;
+}
+
+static std::vector<std::pair<uint64_t, float *>> MakeKvs(
+    const std::vector<uint64_t> &keys, std::vector<float> *select_values) {
+  select_values->assign(keys.size() * kDim, -1.0);
+  std::vector<std::pair<uint64_t, float *>> kvs;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    kvs.push_back({keys[i], select_values->data() + i * kDim});
+  }
+  return kvs;
+}
+
+// 模拟pserver回包: 只写每个去重后key第一次出现的位置
+static void FillPulledValues(const SparsePullShardKeys &shard_keys) {
+  for (size_t i = 0; i < shard_keys.keys.size(); ++i) {
+    for (size_t j = 0; j < kDim; ++j) {
+      shard_keys.values[i][j] = shard_keys.keys[i] % 1000 + j * 0.5;
+    }
+  }
+  CopyDupSparseValues(shard_keys, kDim * sizeof(float));
+}
+
+static std::map<uint64_t, uint32_t> KeyCounts(
+    const SparsePullShardKeys &shard_keys) {
+  std::map<uint64_t, uint32_t> counts;
+  for (size_t i = 0; i < shard_keys.keys.size(); ++i) {
+    EXPECT_EQ(counts.count(shard_keys.keys[i]), 0UL);
+    counts[shard_keys.keys[i]] = shard_keys.counts[i];
+  }
+  return counts;
+}
+
+static void CheckDedup(const std::vector<uint64_t> &keys,
+                       const SparsePullShardKeys &shard_keys,
+                       const std::vector<float> &select_values) {
+  std::map<uint64_t, uint32_t> expected;
+  for (auto key : keys) {
+    ++expected[key];
+  }
+  ASSERT_EQ(KeyCounts(shard_keys), expected);
+  ASSERT_EQ(shard_keys.keys.size() + shard_keys.dup_values.size(),
+            keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    for (size_t j = 0; j < kDim; ++j) {
+      ASSERT_FLOAT_EQ(select_values[i * kDim + j], keys[i] % 1000 + j * 0.5);
+    }
+  }
+}
+
+TEST(SparsePullDedup, SortAndHashMatch) {
+  auto keys = MakeKeys();
+
+  std::vector<float> sort_values;
+  auto sort_kvs = MakeKvs(keys, &sort_values);
+  SparsePullShardKeys sort_keys;
+  DedupSparseKeysBySort(&sort_kvs, &sort_keys);
+  FillPulledValues(sort_keys);
+  CheckDedup(keys, sort_keys, sort_values);
+
+  std::vector<float> hash_values;
+  auto hash_kvs = MakeKvs(keys, &hash_values);
+  SparsePullShardKeys hash_keys;
+  DedupSparseKeysByHash(hash_kvs, &hash_keys);
+  FillPulledValues(hash_keys);
+  CheckDedup(keys, hash_keys, hash_values);
+
+  // 两种去重得到相同的key集合和计数, hash去重保持首次出现的顺序
+  ASSERT_EQ(KeyCounts(sort_keys), KeyCounts(hash_keys));
+  ASSERT_TRUE(std::is_sorted(sort_keys.keys.begin(), sort_keys.keys.end()));
+  ASSERT_EQ(hash_keys.keys[0], keys[0]);
+  ASSERT_EQ(hash_values, sort_values);
+}
+
+TEST(SparsePullDedup, NoDuplicate) {
+  std::vector<uint64_t> keys = {5, 3, 9};
+  std::vector<float> values;
+  auto kvs = MakeKvs(keys, &values);
+  SparsePullShardKeys shard_keys;
+  DedupSparseKeysByHash(kvs, &shard_keys);
+  ASSERT_EQ(shard_keys.keys, keys);
+  ASSERT_EQ(shard_keys.counts, std::vector<uint32_t>({1, 1, 1}));
+  ASSERT_TRUE(shard_keys.dup_values.empty());
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,59 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps/service/sparse_value_codec.h"
+
+namespace paddle {
+namespace distributed {
+
+TEST(SparseValueCodec, EncodeDecode) {
+  // show, click, embed_w 保持float, 其后8维embedx压缩
+  const size_t dim = 11;
+  const size_t head_dim = 3;
+  std::vector<float> value(dim);
+  for (size_t i = 0; i < dim; ++i) {
+    value[i] = (i < head_dim) ? 1000.123 + i : 0.01 * i - 0.05;
+  }
+
+  std::vector<std::pair<ValueWireType, float>> cases = {
+      {WIRE_FP32, 0.0},
+      {WIRE_FP16, 1e-3},
+      {WIRE_BF16, 1e-2},
+      {WIRE_INT8, 1e-3}};
+  for (auto& c : cases) {
+    SparseValueCodec codec(c.first, dim, head_dim);
+    std::vector<char> buffer(codec.EncodedSize());
+    std::vector<float> decoded(dim);
+    codec.Encode(value.data(), buffer.data());
+    codec.Decode(buffer.data(), decoded.data());
+    for (size_t i = 0; i < head_dim; ++i) {
+      ASSERT_FLOAT_EQ(decoded[i], value[i]);
+    }
+    for (size_t i = head_dim; i < dim; ++i) {
+      ASSERT_NEAR(decoded[i], value[i], c.second);
+    }
+  }
+
+  ASSERT_EQ(SparseValueCodec(WIRE_FP16, dim, head_dim).EncodedSize(),
+            head_dim * 4 + (dim - head_dim) * 2);
+  ASSERT_EQ(SparseValueCodec(WIRE_INT8, dim, head_dim).EncodedSize(),
+            head_dim * 4 + 4 + (dim - head_dim));
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,159 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/ps/table/ssd_sparse_table.h"
+#include "paddle/fluid/framework/io/fs.h"
+
+DECLARE_string(rocksdb_path);
+
+namespace paddle {
+namespace distributed {
+
+static const int kEmbDim = 8;
+
+static TableParameter SSDTableConfig() {
+  TableParameter table_config;
+  table_config.set_table_class("SSDSparseTable");
+  table_config.set_shard_num(10);
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CtrCommonAccessor");
+  accessor_config->set_fea_dim(11);
+  accessor_config->set_embedx_dim(kEmbDim);
+  accessor_config->set_embedx_threshold(5);
+  auto *ctr_param = accessor_config->mutable_ctr_accessor_param();
+  ctr_param->set_show_click_decay_rate(1.0);
+  ctr_param->set_delete_threshold(0.0);
+  // unseen_days > 1.5的特征被淘汰, > 0的特征换出到ssd
+  ctr_param->set_delete_after_unseen_days(1.5);
+  ctr_param->set_ssd_unseenday_threshold(0);
+  accessor_config->mutable_embed_sgd_param()->set_name("SparseNaiveSGDRule");
+  auto *naive_param =
+      accessor_config->mutable_embed_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0.3);
+  accessor_config->mutable_embedx_sgd_param()->set_name("SparseNaiveSGDRule");
+  naive_param = accessor_config->mutable_embedx_sgd_param()->mutable_naive();
+  naive_param->set_learning_rate(0.1);
+  naive_param->set_initial_range(0.3);
+  return table_config;
+}
+
+static void PushKeys(SSDSparseTable *table, uint64_t begin, uint64_t end) {
+  std::vector<uint64_t> keys;
+  std::vector<float> gradients;
+  for (uint64_t key = begin; key < end; ++key) {
+    keys.push_back(key);
+    for (int k = 0; k < kEmbDim + 4; k++) {
+      gradients.push_back(k == 1 ? 1.0 : 0.1 * k);
+    }
+  }
+  table->PushSparse(keys.data(), gradients.data(), keys.size());
+}
+
+static std::vector<float> PullKeys(SSDSparseTable *table, uint64_t begin,
+                                   uint64_t end) {
+  std::vector<uint64_t> keys;
+  for (uint64_t key = begin; key < end; ++key) {
+    keys.push_back(key);
+  }
+  std::vector<uint32_t> fres(keys.size(), 1);
+  auto value = PullSparseValue(keys, fres, kEmbDim);
+  std::vector<float> pull_values(keys.size() * (kEmbDim + 3));
+  table->PullSparse(pull_values.data(), value);
+  return pull_values;
+}
+
+static int64_t MemSize(SSDSparseTable *table) {
+  return table->MemorySparseTable::LocalSize();
+}
+
+TEST(SSDSparseTable, TierSaveLoad) {
+  FsClientParameter fs_config;
+  TableParameter table_config = SSDTableConfig();
+  FLAGS_rocksdb_path = "./work/ssd_table_db";
+  SSDSparseTable *table = new SSDSparseTable();
+  table->SetShard(0, 1);
+  ASSERT_EQ(table->Initialize(table_config, fs_config), 0);
+
+  // 10个key的unseen_days经save(param 3)变为1, 再次push的0~4重置为0
+  PushKeys(table, 0, 10);
+  ASSERT_EQ(table->Save("./work/ssd_table_day0", "3"), 0);
+  PushKeys(table, 0, 5);
+  auto expected = PullKeys(table, 0, 10);
+  ASSERT_EQ(MemSize(table), 10);
+
+  // 冷特征5~9换出到ssd, pull时搬回内存且值不变
+  ASSERT_EQ(table->Shrink(""), 0);
+  ASSERT_EQ(MemSize(table), 5);
+  auto pulled = PullKeys(table, 0, 10);
+  ASSERT_EQ(MemSize(table), 10);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_FLOAT_EQ(expected[i], pulled[i]);
+  }
+
+  // save同时写出内存与ssd中的特征, load时冷特征直接进入ssd
+  ASSERT_EQ(table->Shrink(""), 0);
+  ASSERT_EQ(MemSize(table), 5);
+  ASSERT_EQ(table->Save("./work/ssd_table", "0"), 0);
+  FLAGS_rocksdb_path = "./work/ssd_table_db_load";
+  SSDSparseTable *loaded_table = new SSDSparseTable();
+  loaded_table->SetShard(0, 1);
+  ASSERT_EQ(loaded_table->Initialize(table_config, fs_config), 0);
+  ASSERT_EQ(loaded_table->Load("./work/ssd_table", "0"), 0);
+  ASSERT_EQ(MemSize(loaded_table), 5);
+  // 文本格式只保留6位有效数字
+  pulled = PullKeys(loaded_table, 0, 10);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_NEAR(expected[i], pulled[i], 1e-5);
+  }
+
+  // 再过一天: ssd中的5~9超过delete_after_unseen_days被删除, 0~4换出到ssd
+  ASSERT_EQ(table->Save("./work/ssd_table_day1", "3"), 0);
+  ASSERT_EQ(table->Shrink(""), 0);
+  ASSERT_EQ(MemSize(table), 0);
+  pulled = PullKeys(table, 0, 5);
+  ASSERT_EQ(MemSize(table), 5);
+  for (size_t i = 0; i < pulled.size(); ++i) {
+    ASSERT_FLOAT_EQ(expected[i], pulled[i]);
+  }
+  // 已删除的key在push时才创建, pull不会把它们带回内存
+  PullKeys(table, 5, 10);
+  ASSERT_EQ(MemSize(table), 5);
+}
+
+TEST(SSDSparseTable, RefuseNonRocksDBPath) {
+  FsClientParameter fs_config;
+  TableParameter table_config = SSDTableConfig();
+  FLAGS_rocksdb_path = "./work/ssd_table_foreign";
+  std::string db_path = FLAGS_rocksdb_path + "/table_000_000";
+  paddle::framework::localfs_mkdir(db_path);
+  std::string keep_file = db_path + "/keep.txt";
+  std::ofstream(keep_file) << "not a rocksdb file";
+
+  SSDSparseTable *table = new SSDSparseTable();
+  table->SetShard(0, 1);
+  ASSERT_NE(table->Initialize(table_config, fs_config), 0);
+  ASSERT_EQ(access(keep_file.c_str(), F_OK), 0);
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -30,6 +30,7 @@ limitations under the License. */
 
 USE_INT_STAT(STAT_total_feasign_num_in_mem);
 DECLARE_bool(enable_ins_parser_file);
+DECLARE_bool(enable_slotrecord_binary_file);
 namespace paddle {
 namespace framework {
 
@@ -1848,6 +1849,14 @@ void PaddleBoxDataFeed::AssignFeedVar(const Scope& scope) {
   }
 }
 
+std::vector<std::string> PaddleBoxDataFeed::GetFeedVarNames() {
+  auto names = MultiSlotInMemoryDataFeed::GetFeedVarNames();
+  if (enable_pv_merge_) {
+    names.push_back(rank_offset_name_);
+  }
+  return names;
+}
+
 void PaddleBoxDataFeed::PutToFeedVec(const std::vector<PvInstance>& pv_vec) {
 #ifdef _LINUX
   int ins_number = 0;
@@ -2065,9 +2074,274 @@ void SlotRecordInMemoryDataFeed::Init(const DataFeedDesc& data_feed_desc) {
   }
 }
 
+// Binary slot record files hold the parsed SlotRecords by columns, so that
+// loading them costs a few memcpy per record instead of parsing the text.
+// The layout is in native byte order, and every part is padded to 8 bytes:
+//   SlotRecordBinaryHeader, then the slot names (see BinarySlotNames)
+//   blocks of at most OBJPOOL_BLOCK_SIZE records, each of which is a
+//   SlotRecordBinaryBlock followed by the columns
+//     uint64_t search_id[ins_num]
+//     uint64_t uint64_values[uint64_value_num]
+//     uint32_t cmatch[ins_num], rank[ins_num], ins_id_len[ins_num]
+//     uint32_t uint64_offsets[ins_num][uint64_slot_num + 1]
+//     uint32_t float_offsets[ins_num][float_slot_num + 1]
+//     float float_values[float_value_num]
+//     char ins_ids[ins_id_bytes]
+static const char kSlotRecordBinaryMagic[8] = {'P', 'D', 'S', 'L',
+                                               'O', 'T', 'B', '1'};
+
+struct SlotRecordBinaryHeader {
+  char magic[8];
+  uint32_t uint64_slot_num;
+  uint32_t float_slot_num;
+  uint64_t slot_names_len;
+};
+
+struct SlotRecordBinaryBlock {
+  uint32_t ins_num;
+  uint32_t ins_id_bytes;
+  uint64_t uint64_value_num;
+  uint64_t float_value_num;
+};
+
+static size_t BinaryAlign(size_t len) {
+  return (len + 7) & ~static_cast<size_t>(7);
+}
+
+// the size of the columns following the block header
+static size_t BinaryBlockBytes(const SlotRecordBinaryBlock& block,
+                               size_t uint64_slot_num, size_t float_slot_num) {
+  size_t n = block.ins_num;
+  return BinaryAlign(
+      sizeof(uint64_t) * (n + block.uint64_value_num) +
+      sizeof(uint32_t) * n * (3 + uint64_slot_num + 1 + float_slot_num + 1) +
+      sizeof(float) * block.float_value_num + block.ins_id_bytes);
+}
+
+class SlotRecordBinaryWriter {
+ public:
+  SlotRecordBinaryWriter(FILE* fp, size_t uint64_slot_num,
+                         size_t float_slot_num, const std::string& slot_names)
+      : fp_(fp),
+        uint64_slot_num_(uint64_slot_num),
+        float_slot_num_(float_slot_num) {
+    SlotRecordBinaryHeader header;
+    memcpy(header.magic, kSlotRecordBinaryMagic, sizeof(header.magic));
+    header.uint64_slot_num = static_cast<uint32_t>(uint64_slot_num);
+    header.float_slot_num = static_cast<uint32_t>(float_slot_num);
+    header.slot_names_len = slot_names.size();
+    WriteBytes(&header, sizeof(header));
+    WriteBytes(slot_names.data(), slot_names.size());
+    WritePadding(slot_names.size());
+  }
+
+  void Write(const SlotRecord& rec) {
+    auto& uint64_offsets = rec->slot_uint64_feasigns_.slot_offsets;
+    auto& float_offsets = rec->slot_float_feasigns_.slot_offsets;
+    PADDLE_ENFORCE_EQ(
+        uint64_offsets.size() == uint64_slot_num_ + 1 &&
+            float_offsets.size() == float_slot_num_ + 1,
+        true, platform::errors::InvalidArgument(
+                  "The slot number of the record does not match the "
+                  "binary slot record file."));
+    search_ids_.push_back(rec->search_id);
+    cmatches_.push_back(rec->cmatch);
+    ranks_.push_back(rec->rank);
+    ins_id_lens_.push_back(static_cast<uint32_t>(rec->ins_id_.size()));
+    ins_ids_.append(rec->ins_id_);
+    uint64_offsets_.insert(uint64_offsets_.end(), uint64_offsets.begin(),
+                           uint64_offsets.end());
+    float_offsets_.insert(float_offsets_.end(), float_offsets.begin(),
+                          float_offsets.end());
+    auto& uint64_values = rec->slot_uint64_feasigns_.slot_values;
+    uint64_values_.insert(uint64_values_.end(), uint64_values.begin(),
+                          uint64_values.begin() + uint64_offsets.back());
+    auto& float_values = rec->slot_float_feasigns_.slot_values;
+    float_values_.insert(float_values_.end(), float_values.begin(),
+                         float_values.begin() + float_offsets.back());
+    if (search_ids_.size() >= static_cast<size_t>(OBJPOOL_BLOCK_SIZE)) {
+      Flush();
+    }
+  }
+
+  void Flush() {
+    if (search_ids_.empty()) {
+      return;
+    }
+    SlotRecordBinaryBlock block;
+    block.ins_num = static_cast<uint32_t>(search_ids_.size());
+    block.ins_id_bytes = static_cast<uint32_t>(ins_ids_.size());
+    block.uint64_value_num = uint64_values_.size();
+    block.float_value_num = float_values_.size();
+    WriteBytes(&block, sizeof(block));
+    size_t bytes = 0;
+    bytes += WriteColumn(search_ids_);
+    bytes += WriteColumn(uint64_values_);
+    bytes += WriteColumn(cmatches_);
+    bytes += WriteColumn(ranks_);
+    bytes += WriteColumn(ins_id_lens_);
+    bytes += WriteColumn(uint64_offsets_);
+    bytes += WriteColumn(float_offsets_);
+    bytes += WriteColumn(float_values_);
+    WriteBytes(ins_ids_.data(), ins_ids_.size());
+    WritePadding(bytes + ins_ids_.size());
+
+    search_ids_.clear();
+    uint64_values_.clear();
+    cmatches_.clear();
+    ranks_.clear();
+    ins_id_lens_.clear();
+    uint64_offsets_.clear();
+    float_offsets_.clear();
+    float_values_.clear();
+    ins_ids_.clear();
+  }
+
+ private:
+  template <typename T>
+  size_t WriteColumn(const std::vector<T>& column) {
+    WriteBytes(column.data(), sizeof(T) * column.size());
+    return sizeof(T) * column.size();
+  }
+  void WriteBytes(const void* data, size_t len) {
+    if (len > 0) {
+      PADDLE_ENFORCE_EQ(fwrite(data, 1, len, fp_), len,
+                        platform::errors::Unavailable(
+                            "Failed to write the binary slot record file."));
+    }
+  }
+  void WritePadding(size_t len) {
+    static const char padding[8] = {0};
+    WriteBytes(padding, BinaryAlign(len) - len);
+  }
+
+  FILE* fp_;
+  size_t uint64_slot_num_;
+  size_t float_slot_num_;
+  std::vector<uint64_t> search_ids_;
+  std::vector<uint64_t> uint64_values_;
+  std::vector<uint32_t> cmatches_;
+  std::vector<uint32_t> ranks_;
+  std::vector<uint32_t> ins_id_lens_;
+  std::vector<uint32_t> uint64_offsets_;
+  std::vector<uint32_t> float_offsets_;
+  std::vector<float> float_values_;
+  std::string ins_ids_;
+};
+
+static void CheckSlotRecordBinaryHeader(const SlotRecordBinaryHeader& header,
+                                        const std::string& file_slot_names,
+                                        const std::string& slot_names,
+                                        const std::string& filename) {
+  PADDLE_ENFORCE_EQ(
+      memcmp(header.magic, kSlotRecordBinaryMagic, sizeof(header.magic)), 0,
+      platform::errors::InvalidArgument(
+          "%s is not a binary slot record file.", filename));
+  PADDLE_ENFORCE_EQ(
+      file_slot_names, slot_names,
+      platform::errors::InvalidArgument(
+          "The slots of the binary slot record file %s do not match the "
+          "used slots of the dataset.",
+          filename));
+}
+
+// Checks that the slot offsets of one record are monotonic and that its
+// values stay inside the block. Returns the value number of the record.
+static uint32_t CheckBinarySlotOffsets(const uint32_t* offsets,
+                                       size_t slot_num, uint64_t used_num,
+                                       uint64_t total_num,
+                                       const std::string& filename) {
+  for (size_t j = 0; j < slot_num; ++j) {
+    PADDLE_ENFORCE_LE(
+        offsets[j], offsets[j + 1],
+        platform::errors::InvalidArgument(
+            "The slot offsets in binary slot record file %s are not "
+            "monotonic.",
+            filename));
+  }
+  PADDLE_ENFORCE_LE(
+      used_num + offsets[slot_num], total_num,
+      platform::errors::InvalidArgument(
+          "The slot offsets in binary slot record file %s exceed the values "
+          "of the block.",
+          filename));
+  return offsets[slot_num];
+}
+
+// Fills the records with the columns of a block, skipping the records not
+// sampled. Returns the number of records filled.
+static int FillSlotRecordsFromBinary(const SlotRecordBinaryBlock& block,
+                                     const char* data, size_t uint64_slot_num,
+                                     size_t float_slot_num,
+                                     const std::function<bool()>& sample_func,
+                                     const std::string& filename,
+                                     SlotRecord* recs) {
+  size_t n = block.ins_num;
+  auto* search_ids = reinterpret_cast<const uint64_t*>(data);
+  auto* uint64_values = search_ids + n;
+  auto* cmatches =
+      reinterpret_cast<const uint32_t*>(uint64_values + block.uint64_value_num);
+  auto* ranks = cmatches + n;
+  auto* ins_id_lens = ranks + n;
+  auto* uint64_offsets = ins_id_lens + n;
+  auto* float_offsets = uint64_offsets + n * (uint64_slot_num + 1);
+  auto* float_values =
+      reinterpret_cast<const float*>(float_offsets + n * (float_slot_num + 1));
+  auto* ins_ids =
+      reinterpret_cast<const char*>(float_values + block.float_value_num);
+
+  int num = 0;
+  uint64_t uint64_used = 0;
+  uint64_t float_used = 0;
+  uint64_t ins_id_used = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const uint32_t* uint64_offset = uint64_offsets + i * (uint64_slot_num + 1);
+    const uint32_t* float_offset = float_offsets + i * (float_slot_num + 1);
+    uint32_t uint64_num =
+        CheckBinarySlotOffsets(uint64_offset, uint64_slot_num, uint64_used,
+                               block.uint64_value_num, filename);
+    uint32_t float_num =
+        CheckBinarySlotOffsets(float_offset, float_slot_num, float_used,
+                               block.float_value_num, filename);
+    PADDLE_ENFORCE_LE(ins_id_used + ins_id_lens[i], block.ins_id_bytes,
+                      platform::errors::InvalidArgument(
+                          "The ins id lengths in binary slot record file %s "
+                          "exceed the block.",
+                          filename));
+    uint64_used += uint64_num;
+    float_used += float_num;
+    ins_id_used += ins_id_lens[i];
+    if (sample_func()) {
+      SlotRecord rec = recs[num++];
+      rec->search_id = search_ids[i];
+      rec->cmatch = cmatches[i];
+      rec->rank = ranks[i];
+      rec->ins_id_.assign(ins_ids, ins_id_lens[i]);
+      rec->slot_uint64_feasigns_.slot_offsets.assign(
+          uint64_offset, uint64_offset + uint64_slot_num + 1);
+      rec->slot_uint64_feasigns_.slot_values.assign(uint64_values,
+                                                    uint64_values + uint64_num);
+      rec->slot_float_feasigns_.slot_offsets.assign(
+          float_offset, float_offset + float_slot_num + 1);
+      rec->slot_float_feasigns_.slot_values.assign(float_values,
+                                                   float_values + float_num);
+    }
+    ins_ids += ins_id_lens[i];
+    uint64_values += uint64_num;
+    float_values += float_num;
+  }
+  return num;
+}
+
+static bool ReadBinaryBytes(FILE* fp, void* data, size_t len) {
+  return fread(data, 1, len, fp) == len;
+}
+
 void SlotRecordInMemoryDataFeed::LoadIntoMemory() {
   VLOG(3) << "SlotRecord LoadIntoMemory() begin, thread_id=" << thread_id_;
-  if (!so_parser_name_.empty()) {
+  if (FLAGS_enable_slotrecord_binary_file) {
+    LoadIntoMemoryByBinary();
+  } else if (!so_parser_name_.empty()) {
     LoadIntoMemoryByLib();
   } else {
     LoadIntoMemoryByCommand();
@@ -2308,6 +2582,219 @@ void SlotRecordInMemoryDataFeed::LoadIntoMemoryByCommand(void) {
 #endif
 }
 
+std::string SlotRecordInMemoryDataFeed::BinarySlotNames() const {
+  std::string uint64_slots;
+  std::string float_slots;
+  for (auto& info : used_slots_info_) {
+    if (info.type[0] == 'u') {
+      uint64_slots.append(info.slot).append(",");
+    } else if (info.type[0] == 'f') {
+      float_slots.append(info.slot).append(",");
+    }
+  }
+  return uint64_slots + ";" + float_slots;
+}
+
+void SlotRecordInMemoryDataFeed::LoadIntoMemoryByBinary(void) {
+#ifdef _LINUX
+  const std::string slot_names = BinarySlotNames();
+  std::default_random_engine random_engine(std::random_device()());
+  std::uniform_real_distribution<float> uniform_distribution(0.0f, 1.0f);
+  bool sample = std::abs(sample_rate_ - 1.0f) >= 1e-5f;
+  std::function<bool()> sample_func = [&]() {
+    return !sample || uniform_distribution(random_engine) < sample_rate_;
+  };
+  std::vector<SlotRecord> record_vec;
+  std::vector<char> buffer;
+  uint64_t total_size = 0;
+
+  std::string filename;
+  while (this->PickOneFile(&filename)) {
+    VLOG(3) << "PickOneFile, filename=" << filename
+            << ", thread_id=" << thread_id_;
+    platform::Timer timeline;
+    timeline.Start();
+    size_t lines = 0;
+    size_t sample_lines = 0;
+    auto fill_block = [&](const SlotRecordBinaryBlock& block,
+                          const char* data) {
+      SlotRecordPool().get(&record_vec, block.ins_num);
+      int num = FillSlotRecordsFromBinary(
+          block, data, uint64_use_slot_size_, float_use_slot_size_,
+          sample_func, filename, &record_vec[0]);
+      if (num > 0) {
+        input_channel_->WriteMove(num, &record_vec[0]);
+      }
+      if (num < static_cast<int>(block.ins_num)) {
+        SlotRecordPool().put(&record_vec[num], block.ins_num - num);
+      }
+      record_vec.clear();
+      lines += block.ins_num;
+      sample_lines += num;
+    };
+
+    size_t file_size = 0;
+    if (fs_select_internal(filename) == 0 &&
+        (pipe_command_.empty() || pipe_command_ == "cat")) {
+      // local files are mapped and parsed in place
+      int fd = open(filename.c_str(), O_RDONLY);
+      PADDLE_ENFORCE_NE(fd, -1, platform::errors::Unavailable(
+                                    "Fail to open file: %s.", filename));
+      struct stat sb;
+      fstat(fd, &sb);
+      file_size = static_cast<size_t>(sb.st_size);
+      PADDLE_ENFORCE_GE(
+          file_size, sizeof(SlotRecordBinaryHeader),
+          platform::errors::InvalidArgument(
+              "%s is not a binary slot record file.", filename));
+      char* data = reinterpret_cast<char*>(
+          mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0));
+      PADDLE_ENFORCE_NE(
+          data, MAP_FAILED,
+          platform::errors::Unavailable(
+              "Memory map failed when loading %s, error number is %s.",
+              filename, strerror(errno)));
+      madvise(data, file_size, MADV_SEQUENTIAL);
+
+      SlotRecordBinaryHeader header;
+      memcpy(&header, data, sizeof(header));
+      size_t pos = sizeof(header);
+      PADDLE_ENFORCE_LE(pos + header.slot_names_len, file_size,
+                        platform::errors::InvalidArgument(
+                            "The binary slot record file %s is truncated.",
+                            filename));
+      CheckSlotRecordBinaryHeader(
+          header, std::string(data + pos, header.slot_names_len), slot_names,
+          filename);
+      pos += BinaryAlign(header.slot_names_len);
+      while (pos < file_size) {
+        SlotRecordBinaryBlock block;
+        PADDLE_ENFORCE_LE(pos + sizeof(block), file_size,
+                          platform::errors::InvalidArgument(
+                              "The binary slot record file %s is truncated.",
+                              filename));
+        memcpy(&block, data + pos, sizeof(block));
+        pos += sizeof(block);
+        size_t bytes = BinaryBlockBytes(block, uint64_use_slot_size_,
+                                        float_use_slot_size_);
+        PADDLE_ENFORCE_LE(pos + bytes, file_size,
+                          platform::errors::InvalidArgument(
+                              "The binary slot record file %s is truncated.",
+                              filename));
+        fill_block(block, data + pos);
+        pos += bytes;
+      }
+      munmap(data, file_size);
+      close(fd);
+    } else {
+      int err_no = 0;
+      this->fp_ = fs_open_read(filename, &err_no, this->pipe_command_);
+      CHECK(this->fp_ != nullptr);
+      __fsetlocking(&*(this->fp_), FSETLOCKING_BYCALLER);
+      FILE* fp = this->fp_.get();
+      SlotRecordBinaryHeader header;
+      PADDLE_ENFORCE_EQ(ReadBinaryBytes(fp, &header, sizeof(header)), true,
+                        platform::errors::InvalidArgument(
+                            "%s is not a binary slot record file.", filename));
+      std::string file_slot_names(BinaryAlign(header.slot_names_len), '\0');
+      PADDLE_ENFORCE_EQ(
+          ReadBinaryBytes(fp, &file_slot_names[0], file_slot_names.size()),
+          true, platform::errors::InvalidArgument(
+                    "The binary slot record file %s is truncated.", filename));
+      file_slot_names.resize(header.slot_names_len);
+      CheckSlotRecordBinaryHeader(header, file_slot_names, slot_names,
+                                  filename);
+      file_size = sizeof(header) + BinaryAlign(header.slot_names_len);
+      SlotRecordBinaryBlock block;
+      while (ReadBinaryBytes(fp, &block, sizeof(block))) {
+        size_t bytes = BinaryBlockBytes(block, uint64_use_slot_size_,
+                                        float_use_slot_size_);
+        buffer.resize(bytes);
+        PADDLE_ENFORCE_EQ(ReadBinaryBytes(fp, buffer.data(), bytes), true,
+                          platform::errors::InvalidArgument(
+                              "The binary slot record file %s is truncated.",
+                              filename));
+        fill_block(block, buffer.data());
+        file_size += sizeof(block) + bytes;
+      }
+    }
+    total_size += file_size;
+    timeline.Pause();
+    VLOG(3) << "LoadIntoMemoryByBinary() read all records, file=" << filename
+            << ", lines=" << lines << ", sample lines=" << sample_lines
+            << ", cost time=" << timeline.ElapsedSec()
+            << " seconds, thread_id=" << thread_id_;
+  }
+  VLOG(3) << "LoadIntoMemoryByBinary() end, thread_id=" << thread_id_
+          << ", total size: " << total_size;
+#endif
+}
+
+void SlotRecordInMemoryDataFeed::ConvertToBinary(
+    const std::string& output_dir) {
+#ifdef _LINUX
+  const std::string slot_names = BinarySlotNames();
+  fs_mkdir(output_dir);
+  std::vector<SlotRecord> record_vec;
+  SlotRecordPool().get(&record_vec, 1);
+  SlotRecord rec = record_vec[0];
+
+  std::string filename;
+  while (this->PickOneFile(&filename)) {
+    // input files in different directories may share the same base name
+    char path_hash[17];
+    snprintf(path_hash, sizeof(path_hash), "%016llx",
+             static_cast<unsigned long long>(  // NOLINT
+                 std::hash<std::string>()(filename)));
+    std::string output = output_dir + "/" +
+                         filename.substr(filename.rfind('/') + 1) + "." +
+                         path_hash;
+    VLOG(3) << "ConvertToBinary() begin, filename=" << filename
+            << ", output=" << output << ", thread_id=" << thread_id_;
+    platform::Timer timeline;
+    timeline.Start();
+    int err_no = 0;
+    auto out_fp = fs_open_write(output, &err_no, "");
+    CHECK(out_fp != nullptr);
+    SlotRecordBinaryWriter writer(out_fp.get(), uint64_use_slot_size_,
+                                  float_use_slot_size_, slot_names);
+
+    BufferedLineFileReader line_reader;
+    this->fp_ = fs_open_read(filename, &err_no, this->pipe_command_);
+    CHECK(this->fp_ != nullptr);
+    __fsetlocking(&*(this->fp_), FSETLOCKING_BYCALLER);
+    int lines = line_reader.read_file(
+        this->fp_.get(),
+        [this, &rec, &writer, &filename](const std::string& line) {
+          rec->reset();
+          rec->ins_id_.clear();
+          rec->search_id = 0;
+          rec->cmatch = 0;
+          rec->rank = 0;
+          if (!ParseOneInstance(line, &rec)) {
+            LOG(WARNING) << "read file:[" << filename << "] item error, line:["
+                         << line << "]";
+            return false;
+          }
+          writer.Write(rec);
+          return true;
+        },
+        0);
+    // the records written can not be taken back, so no retry as loading
+    PADDLE_ENFORCE_EQ(line_reader.is_error(), false,
+                      platform::errors::InvalidArgument(
+                          "Too many error lines in %s.", filename));
+    writer.Flush();
+    out_fp.reset();
+    timeline.Pause();
+    VLOG(3) << "ConvertToBinary() end, file=" << filename
+            << ", lines=" << lines << ", cost time=" << timeline.ElapsedSec()
+            << " seconds, thread_id=" << thread_id_;
+  }
+  SlotRecordPool().put(&record_vec);
+#endif
+}
+
 static void parser_log_key(const std::string& log_key, uint64_t* search_id,
                            uint32_t* cmatch, uint32_t* rank) {
   std::string searchid_str = log_key.substr(16, 16);
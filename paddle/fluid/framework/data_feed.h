@@ -811,6 +811,8 @@ class DataFeed {
 
   // This function is used for binding feed_vec memory in a given scope
   virtual void AssignFeedVar(const Scope& scope);
+  // Get the names of all the vars bound by AssignFeedVar
+  virtual std::vector<std::string> GetFeedVarNames() { return use_slots_; }
 
   // This function will do nothing at default
   virtual void SetInputPvChannel(void* channel) {}
@@ -853,6 +855,12 @@ class DataFeed {
     PADDLE_THROW(platform::errors::Unimplemented(
         "This function(LoadIntoMemory) is not implemented."));
   }
+  // convert the text files to binary files in output_dir, which are loaded
+  // without parsing
+  virtual void ConvertToBinary(const std::string& output_dir) {
+    PADDLE_THROW(platform::errors::Unimplemented(
+        "This function(ConvertToBinary) is not implemented."));
+  }
   virtual void SetPlace(const paddle::platform::Place& place) {
     place_ = place;
   }
@@ -1399,6 +1407,7 @@ class SlotRecordInMemoryDataFeed : public InMemoryDataFeed<SlotRecord> {
   }
   virtual void Init(const DataFeedDesc& data_feed_desc);
   virtual void LoadIntoMemory();
+  virtual void ConvertToBinary(const std::string& output_dir);
   void ExpandSlotRecord(SlotRecord* ins);
 
  protected:
@@ -1414,6 +1423,9 @@ class SlotRecordInMemoryDataFeed : public InMemoryDataFeed<SlotRecord> {
   virtual void LoadIntoMemoryByLib(void);
   virtual void LoadIntoMemoryByLine(void);
   virtual void LoadIntoMemoryByFile(void);
+  virtual void LoadIntoMemoryByBinary(void);
+  // the used slot names in binary files, uint64 slots first
+  std::string BinarySlotNames() const;
   virtual void SetInputChannel(void* channel) {
     input_channel_ = static_cast<ChannelObject<SlotRecord>*>(channel);
   }
@@ -1460,6 +1472,7 @@ class PaddleBoxDataFeed : public MultiSlotInMemoryDataFeed {
   virtual bool Start();
   virtual int Next();
   virtual void AssignFeedVar(const Scope& scope);
+  virtual std::vector<std::string> GetFeedVarNames();
   virtual void PutToFeedVec(const std::vector<PvInstance>& pv_vec);
   virtual void PutToFeedVec(const std::vector<Record*>& ins_vec);
   virtual int GetCurrentPhase();
@@ -468,6 +468,25 @@ void DatasetImpl<T>::WaitPreLoadDone() {
   VLOG(3) << "DatasetImpl<T>::WaitPreLoadDone() end";
 }
 
+template <typename T>
+void DatasetImpl<T>::ConvertToBinary(const std::string& output_dir) {
+  VLOG(3) << "DatasetImpl<T>::ConvertToBinary() begin";
+  platform::Timer timeline;
+  timeline.Start();
+  std::vector<std::thread> convert_threads;
+  for (int64_t i = 0; i < thread_num_; ++i) {
+    convert_threads.push_back(
+        std::thread(&paddle::framework::DataFeed::ConvertToBinary,
+                    readers_[i].get(), output_dir));
+  }
+  for (std::thread& t : convert_threads) {
+    t.join();
+  }
+  timeline.Pause();
+  VLOG(3) << "DatasetImpl<T>::ConvertToBinary() end, cost time="
+          << timeline.ElapsedSec() << " seconds";
+}
+
 // release memory data
 template <typename T>
 void DatasetImpl<T>::ReleaseMemory() {
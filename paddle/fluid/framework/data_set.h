@@ -116,6 +116,8 @@ class Dataset {
   virtual void PreLoadIntoMemory() = 0;
   // wait async load done
   virtual void WaitPreLoadDone() = 0;
+  // convert the text files to binary files in output_dir
+  virtual void ConvertToBinary(const std::string& output_dir) = 0;
   // release all memory data
   virtual void ReleaseMemory() = 0;
   // local shuffle data
@@ -218,6 +220,7 @@ class DatasetImpl : public Dataset {
   virtual void LoadIntoMemory();
   virtual void PreLoadIntoMemory();
   virtual void WaitPreLoadDone();
+  virtual void ConvertToBinary(const std::string& output_dir);
   virtual void ReleaseMemory();
   virtual void LocalShuffle();
   virtual void GlobalShuffle(int thread_num = -1) {}
@@ -15,6 +15,7 @@ limitations under the License. */
 #pragma once
 
 #include <atomic>
+#include <exception>
 #include <fstream>
 #include <map>
 #include <memory>
@@ -295,6 +296,24 @@ class DownpourWorker : public HogwildWorker {
   void CopySparseTable();
   void CopyDenseTable();
   void CopyDenseVars();
+  void PullSparse(
+      size_t table_idx, const Scope& scope,
+      std::map<uint64_t, std::vector<uint64_t>>* features,
+      std::map<uint64_t, std::vector<std::vector<float>>>* feature_values);
+  void FillPulledSparse(size_t table_idx);
+  void TrainOneBatch(int cur_batch, int batch_cnt,
+                     const std::vector<std::string>& ins_id_vec);
+  void TrainFilesWithPrefetch();
+
+  // a batch read and pulled ahead of the computation
+  struct PrefetchBatch {
+    Scope* scope = nullptr;
+    int batch_size = 0;
+    std::vector<std::string> ins_id_vec;
+    std::map<uint64_t, std::vector<uint64_t>> features;
+    std::map<uint64_t, std::vector<std::vector<float>>> feature_values;
+    std::exception_ptr error;
+  };
 
   DownpourWorkerParameter param_;
   // copy table
@@ -427,6 +427,9 @@ void DownpourLiteWorker::TrainFiles() {
   int batch_cnt = 0;
   int cur_batch;
   while ((cur_batch = device_reader_->Next()) > 0) {
+    if (thread_id_ == 0) {
+      fleet_ptr_->AdvanceSparsePullCacheStep();
+    }
     if (copy_table_config_.need_copy()) {
       VLOG(3) << "Begin to copy table";
       if (batch_cnt % copy_table_config_.batch_num() == 0) {
@@ -757,253 +757,379 @@ inline void AddAucMonitor(const Scope* scope, const platform::Place& place) {
 }
 #endif
 
-void DownpourWorker::TrainFiles() {
-  VLOG(3) << "Begin to train files";
-  platform::SetNumThreads(1);
-  device_reader_->Start();
-  int batch_cnt = 0;
-  int cur_batch;
-  while ((cur_batch = device_reader_->Next()) > 0) {
-    if (copy_table_config_.need_copy()) {
-      if (batch_cnt % copy_table_config_.batch_num() == 0) {
-        CopySparseTable();
-        CopyDenseTable();
-        CopyDenseVars();
-      }
-    }
-    // pull sparse here
-    for (int i = 0; i < param_.program_config(0).pull_sparse_table_id_size();
-         ++i) {
-      uint64_t tid = static_cast<uint64_t>(
-          param_.program_config(0).pull_sparse_table_id(i));
-      TableParameter table;
-      for (auto j : param_.sparse_table()) {
-        if (j.table_id() == tid) {
-          table = j;
-          break;
-        }
-      }
-      fleet_ptr_->PullSparseVarsSync(
-          *thread_scope_, tid, sparse_key_names_[tid], &features_[tid],
-          &feature_values_[tid], table.fea_dim(), sparse_value_names_[tid]);
-      CollectLabelInfo(i);
-      FillSparseValue(i);
-      auto nid_iter = std::find(sparse_value_names_[tid].begin(),
-                                sparse_value_names_[tid].end(),
-                                adjust_ins_weight_config_.nid_slot());
-      if (nid_iter != sparse_value_names_[tid].end()) {
-        AdjustInsWeight();
-      }
+void DownpourWorker::PullSparse(
+    size_t table_idx, const Scope& scope,
+    std::map<uint64_t, std::vector<uint64_t>>* features,
+    std::map<uint64_t, std::vector<std::vector<float>>>* feature_values) {
+  uint64_t tid = static_cast<uint64_t>(
+      param_.program_config(0).pull_sparse_table_id(table_idx));
+  TableParameter table;
+  for (auto j : param_.sparse_table()) {
+    if (j.table_id() == tid) {
+      table = j;
+      break;
     }
-    VLOG(3) << "fill sparse value for all sparse table done.";
+  }
+  fleet_ptr_->PullSparseVarsSync(scope, tid, sparse_key_names_[tid],
+                                 &(*features)[tid], &(*feature_values)[tid],
+                                 table.fea_dim(), sparse_value_names_[tid]);
+}
 
-    // do computation here
-    for (auto& op : ops_) {
-      bool need_skip = false;
-      for (auto t = 0u; t < skip_ops_.size(); ++t) {
-        if (op->Type().find(skip_ops_[t]) != std::string::npos) {
-          need_skip = true;
-          break;
-        }
+void DownpourWorker::FillPulledSparse(size_t table_idx) {
+  uint64_t tid = static_cast<uint64_t>(
+      param_.program_config(0).pull_sparse_table_id(table_idx));
+  CollectLabelInfo(table_idx);
+  FillSparseValue(table_idx);
+  auto nid_iter = std::find(sparse_value_names_[tid].begin(),
+                            sparse_value_names_[tid].end(),
+                            adjust_ins_weight_config_.nid_slot());
+  if (nid_iter != sparse_value_names_[tid].end()) {
+    AdjustInsWeight();
+  }
+}
+
+void DownpourWorker::TrainOneBatch(int cur_batch, int batch_cnt,
+                                   const std::vector<std::string>& ins_id_vec) {
+  // do computation here
+  for (auto& op : ops_) {
+    bool need_skip = false;
+    for (auto t = 0u; t < skip_ops_.size(); ++t) {
+      if (op->Type().find(skip_ops_[t]) != std::string::npos) {
+        need_skip = true;
+        break;
       }
-      if (!need_skip) {
+    }
+    if (!need_skip) {
 #ifdef PADDLE_WITH_PSLIB
-        try {
-          op->Run(*thread_scope_, place_);
-        } catch (std::exception& e) {
-          fprintf(stderr, "error message: %s\n", e.what());
-          auto& ins_id_vec = device_reader_->GetInsIdVec();
-          size_t batch_size = device_reader_->GetCurBatchSize();
-          std::string s = "";
-          for (auto& ins_id : ins_id_vec) {
-            if (s != "") s += ",";
-            s += ins_id;
+      try {
+        op->Run(*thread_scope_, place_);
+      } catch (std::exception& e) {
+        fprintf(stderr, "error message: %s\n", e.what());
+        size_t batch_size = cur_batch;
+        std::string s = "";
+        for (auto& ins_id : ins_id_vec) {
+          if (s != "") s += ",";
+          s += ins_id;
+        }
+        fprintf(stderr, "batch_size: %zu, ins_ids_vec: %s\n", batch_size,
+                s.c_str());
+        s = "";
+        for (auto& param : all_param_) {
+          Variable* var = thread_scope_->FindVar(param);
+          if (var == nullptr) {
+            continue;
           }
-          fprintf(stderr, "batch_size: %zu, ins_ids_vec: %s\n", batch_size,
-                  s.c_str());
-          s = "";
-          for (auto& param : all_param_) {
-            Variable* var = thread_scope_->FindVar(param);
-            if (var == nullptr) {
-              continue;
-            }
-            Tensor* tensor = nullptr;
-            int64_t len = 0;
-            if (var->IsType<framework::LoDTensor>()) {
-              tensor = var->GetMutable<LoDTensor>();
-              len = tensor->numel();
-            } else if (var->IsType<phi::SelectedRows>()) {
-              auto selected_rows = var->GetMutable<phi::SelectedRows>();
-              tensor = selected_rows->mutable_value();
-              len = tensor->numel();
-            }
-            if (!tensor->IsInitialized()) {
-              continue;
-            }
-            s += param + ":" + std::to_string(len) + ":";
-            s += PrintLodTensor(tensor, 0, len);
-            fprintf(stderr, "%s\n", s.c_str());
-            fflush(stderr);
-            s = "";
+          Tensor* tensor = nullptr;
+          int64_t len = 0;
+          if (var->IsType<framework::LoDTensor>()) {
+            tensor = var->GetMutable<LoDTensor>();
+            len = tensor->numel();
+          } else if (var->IsType<phi::SelectedRows>()) {
+            auto selected_rows = var->GetMutable<phi::SelectedRows>();
+            tensor = selected_rows->mutable_value();
+            len = tensor->numel();
           }
-          throw e;
+          if (!tensor->IsInitialized()) {
+            continue;
+          }
+          s += param + ":" + std::to_string(len) + ":";
+          s += PrintLodTensor(tensor, 0, len);
+          fprintf(stderr, "%s\n", s.c_str());
+          fflush(stderr);
+          s = "";
         }
+        throw e;
+      }
 #else
-        op->Run(*thread_scope_, place_);
+      op->Run(*thread_scope_, place_);
 #endif
-      }
     }
+  }
 
 #ifdef PADDLE_WITH_PSLIB
-    // add data for MetricMsg
-    if (Metric::GetInstance() != nullptr) {
-      AddAucMonitor(thread_scope_, place_);
-    }
+  // add data for MetricMsg
+  if (Metric::GetInstance() != nullptr) {
+    AddAucMonitor(thread_scope_, place_);
+  }
 #endif
 
-    // check inf and nan
-    for (std::string& var_name : check_nan_var_names_) {
-      Variable* var = thread_scope_->FindVar(var_name);
-      if (var == nullptr) {
-        continue;
-      }
-      LoDTensor* tensor = var->GetMutable<LoDTensor>();
-      if (tensor == nullptr) {
-        continue;
-      }
-      PADDLE_ENFORCE_EQ(framework::TensorContainsInf(*tensor), false,
-                        platform::errors::InvalidArgument(
-                            "Tensor %s contains Inf.", var_name));
-      PADDLE_ENFORCE_EQ(framework::TensorContainsNAN(*tensor), false,
-                        platform::errors::InvalidArgument(
-                            "Tensor %s contains NAN.", var_name));
+  // check inf and nan
+  for (std::string& var_name : check_nan_var_names_) {
+    Variable* var = thread_scope_->FindVar(var_name);
+    if (var == nullptr) {
+      continue;
+    }
+    LoDTensor* tensor = var->GetMutable<LoDTensor>();
+    if (tensor == nullptr) {
+      continue;
     }
+    PADDLE_ENFORCE_EQ(framework::TensorContainsInf(*tensor), false,
+                      platform::errors::InvalidArgument(
+                          "Tensor %s contains Inf.", var_name));
+    PADDLE_ENFORCE_EQ(framework::TensorContainsNAN(*tensor), false,
+                      platform::errors::InvalidArgument(
+                          "Tensor %s contains NAN.", var_name));
+  }
 
-    if (need_to_push_sparse_) {
-      // push gradients here
-      for (int i = 0; i < param_.program_config(0).push_sparse_table_id_size();
-           ++i) {
-        uint64_t tid = static_cast<uint64_t>(
-            param_.program_config(0).push_sparse_table_id(i));
-        TableParameter table;
-        for (auto i : param_.sparse_table()) {
-          if (i.table_id() == tid) {
-            table = i;
-            break;
-          }
+  if (need_to_push_sparse_) {
+    // push gradients here
+    for (int i = 0; i < param_.program_config(0).push_sparse_table_id_size();
+         ++i) {
+      uint64_t tid = static_cast<uint64_t>(
+          param_.program_config(0).push_sparse_table_id(i));
+      TableParameter table;
+      for (auto i : param_.sparse_table()) {
+        if (i.table_id() == tid) {
+          table = i;
+          break;
         }
-        fleet_ptr_->PushSparseVarsWithLabelAsync(
-            *thread_scope_, tid, features_[tid], feature_labels_[tid],
-            sparse_key_names_[tid], sparse_grad_names_[tid], table.emb_dim(),
-            &feature_grads_[tid], &push_sparse_status_, cur_batch, use_cvm_,
-            dump_slot_, &sparse_push_keys_[tid], no_cvm_,
-            scale_sparse_gradient_with_batch_size_);
       }
+      fleet_ptr_->PushSparseVarsWithLabelAsync(
+          *thread_scope_, tid, features_[tid], feature_labels_[tid],
+          sparse_key_names_[tid], sparse_grad_names_[tid], table.emb_dim(),
+          &feature_grads_[tid], &push_sparse_status_, cur_batch, use_cvm_,
+          dump_slot_, &sparse_push_keys_[tid], no_cvm_,
+          scale_sparse_gradient_with_batch_size_);
     }
+  }
 
 #ifdef PADDLE_WITH_PSLIB
-    if (copy_table_config_.need_copy()) {
-      if (copy_table_config_.sparse_copy_by_feasign()) {
-        for (size_t i = 0; i < copy_sparse_tables_.size(); ++i) {
-          uint64_t tid = copy_sparse_tables_[i].first;
-          feasign_set_[tid].insert(sparse_push_keys_[tid].begin(),
-                                   sparse_push_keys_[tid].end());
-        }
+  if (copy_table_config_.need_copy()) {
+    if (copy_table_config_.sparse_copy_by_feasign()) {
+      for (size_t i = 0; i < copy_sparse_tables_.size(); ++i) {
+        uint64_t tid = copy_sparse_tables_[i].first;
+        feasign_set_[tid].insert(sparse_push_keys_[tid].begin(),
+                                 sparse_push_keys_[tid].end());
       }
     }
+  }
 #endif
 
-    if (need_to_push_dense_) {
-      if (flag_partial_push_) {
-        Variable* var = (*thread_scope_).FindVar("cond_tag");
-        LoDTensor* tensor = var->GetMutable<LoDTensor>();
-        // check type in python code
-        int64_t* cond_value_batch = tensor->data<int64_t>();
-
-        for (int i = 0; i < param_.program_config(0).push_dense_table_id_size();
-             ++i) {
-          uint64_t tid = static_cast<uint64_t>(
-              param_.program_config(0).push_dense_table_id(i));
-          if (condvalue_set_.find(tid) != condvalue_set_.end()) {
-            // common dense table must push dense
-            if (cond2table_map_[cond_value_batch[0]] != tid) {
-              // can't push dense
-              continue;
-            }
-          }
+  if (need_to_push_dense_) {
+    if (flag_partial_push_) {
+      Variable* var = (*thread_scope_).FindVar("cond_tag");
+      LoDTensor* tensor = var->GetMutable<LoDTensor>();
+      // check type in python code
+      int64_t* cond_value_batch = tensor->data<int64_t>();
 
-          VLOG(3) << "push multitask dense gradient " << tid;
-          fleet_ptr_->PushDenseVarsAsync(
-              *thread_scope_, tid, dense_grad_names_[tid], &push_sparse_status_,
-              scale_datanorm_, cur_batch);
+      for (int i = 0; i < param_.program_config(0).push_dense_table_id_size();
+           ++i) {
+        uint64_t tid = static_cast<uint64_t>(
+            param_.program_config(0).push_dense_table_id(i));
+        if (condvalue_set_.find(tid) != condvalue_set_.end()) {
+          // common dense table must push dense
+          if (cond2table_map_[cond_value_batch[0]] != tid) {
+            // can't push dense
+            continue;
+          }
         }
 
-      } else {
-        for (int i = 0; i < param_.program_config(0).push_dense_table_id_size();
-             ++i) {
-          uint64_t tid = static_cast<uint64_t>(
-              param_.program_config(0).push_dense_table_id(i));
-
-          fleet_ptr_->PushDenseVarsAsync(
-              *thread_scope_, tid, dense_grad_names_[tid], &push_sparse_status_,
-              scale_datanorm_, cur_batch);
-        }
+        VLOG(3) << "push multitask dense gradient " << tid;
+        fleet_ptr_->PushDenseVarsAsync(
+            *thread_scope_, tid, dense_grad_names_[tid], &push_sparse_status_,
+            scale_datanorm_, cur_batch);
       }
 
-      VLOG(3) << "push dense gradient done.";
+    } else {
+      for (int i = 0; i < param_.program_config(0).push_dense_table_id_size();
+           ++i) {
+        uint64_t tid = static_cast<uint64_t>(
+            param_.program_config(0).push_dense_table_id(i));
 
-      // the following code should be more precise and clean
-      // TODO(guru4elephant)
-      int32_t tmp_push_dense_wait_times = -1;
-      static uint32_t push_dense_wait_times =
-          static_cast<uint32_t>(tmp_push_dense_wait_times);
+        fleet_ptr_->PushDenseVarsAsync(
+            *thread_scope_, tid, dense_grad_names_[tid], &push_sparse_status_,
+            scale_datanorm_, cur_batch);
+      }
+    }
 
-      if (push_dense_status_.size() >= push_dense_wait_times) {
-        for (auto& t : push_dense_status_) {
-          t.wait();
-        }
-        push_dense_status_.resize(0);
+    VLOG(3) << "push dense gradient done.";
+
+    // the following code should be more precise and clean
+    // TODO(guru4elephant)
+    int32_t tmp_push_dense_wait_times = -1;
+    static uint32_t push_dense_wait_times =
+        static_cast<uint32_t>(tmp_push_dense_wait_times);
+
+    if (push_dense_status_.size() >= push_dense_wait_times) {
+      for (auto& t : push_dense_status_) {
+        t.wait();
       }
+      push_dense_status_.resize(0);
+    }
 
-      if (tmp_push_dense_wait_times == -1) {
-        push_dense_status_.resize(0);
+    if (tmp_push_dense_wait_times == -1) {
+      push_dense_status_.resize(0);
+    }
+  }
+
+  if (need_to_push_sparse_) {
+    VLOG(3) << "push sparse gradient done.";
+    int32_t tmp_push_sparse_wait_times = -1;
+    static uint32_t push_sparse_wait_times =
+        static_cast<uint32_t>(tmp_push_sparse_wait_times);
+    if (push_sparse_status_.size() >= push_sparse_wait_times) {
+      for (auto& t : push_sparse_status_) {
+        t.wait();
       }
+      push_sparse_status_.resize(0);
     }
 
-    if (need_to_push_sparse_) {
-      VLOG(3) << "push sparse gradient done.";
-      int32_t tmp_push_sparse_wait_times = -1;
-      static uint32_t push_sparse_wait_times =
-          static_cast<uint32_t>(tmp_push_sparse_wait_times);
-      if (push_sparse_status_.size() >= push_sparse_wait_times) {
-        for (auto& t : push_sparse_status_) {
-          t.wait();
-        }
-        push_sparse_status_.resize(0);
+    if (tmp_push_sparse_wait_times == -1) {
+      push_sparse_status_.resize(0);
+    }
+  }
+
+  if (need_to_push_dense_) {
+    for (int i = 0; i < param_.program_config(0).push_dense_table_id_size();
+         ++i) {
+      uint64_t tid = static_cast<uint64_t>(
+          param_.program_config(0).push_dense_table_id(i));
+      pull_dense_worker_->IncreaseThreadVersion(thread_id_, tid);
+    }
+  }
+  if (need_dump_field_) {
+    DumpField(*thread_scope_, dump_mode_, dump_interval_);
+  }
+  if (need_dump_param_ && thread_id_ == 0) {
+    DumpParam(*thread_scope_, batch_cnt);
+  }
+
+  PrintFetchVars();
+  thread_scope_->DropKids();
+}
+
+// Reads the next batches and pulls their sparse values in a background thread
+// while running the current batch. Every batch in flight is read into its own
+// staging scope, and its feed tensors are swapped into thread_scope_ before
+// running, so the pulled values miss the pushes of at most
+// pull_sparse_prefetch_depth previous batches. The feed tensors include the
+// vars the reader fills besides the used slots, e.g. rank_offset of pv merge.
+void DownpourWorker::TrainFilesWithPrefetch() {
+  int depth = param_.pull_sparse_prefetch_depth();
+  int pull_table_num = param_.program_config(0).pull_sparse_table_id_size();
+  std::vector<std::string> feed_names = device_reader_->GetFeedVarNames();
+  std::vector<PrefetchBatch> batches(depth);
+  auto free_batches = MakeChannel<PrefetchBatch*>();
+  auto ready_batches = MakeChannel<PrefetchBatch*>();
+  for (auto& batch : batches) {
+    batch.scope = &root_scope_->NewScope();
+    for (auto& name : feed_names) {
+      InitializeVariable(batch.scope->Var(name), proto::VarType::LOD_TENSOR);
+    }
+    // PullSparseVarsSync skips the slots whose embedding is not in the scope
+    for (auto& value_names : sparse_value_names_) {
+      for (auto& name : value_names.second) {
+        batch.scope->Var(name);
       }
+    }
+    free_batches->Put(&batch);
+  }
 
-      if (tmp_push_sparse_wait_times == -1) {
-        push_sparse_status_.resize(0);
+  device_reader_->Start();
+  std::thread prefetch_thread([&]() {
+    PrefetchBatch* batch = nullptr;
+    while (free_batches->Get(batch)) {
+      try {
+        device_reader_->AssignFeedVar(*batch->scope);
+        batch->batch_size = device_reader_->Next();
+        if (batch->batch_size > 0) {
+          batch->ins_id_vec = device_reader_->GetInsIdVec();
+          for (int i = 0; i < pull_table_num; ++i) {
+            PullSparse(i, *batch->scope, &batch->features,
+                       &batch->feature_values);
+          }
+        }
+      } catch (...) {
+        batch->error = std::current_exception();
+        batch->batch_size = 0;
+      }
+      bool finished = batch->batch_size <= 0;
+      ready_batches->Put(batch);
+      if (finished) {
+        break;
       }
     }
+    ready_batches->Close();
+  });
 
-    if (need_to_push_dense_) {
-      for (int i = 0; i < param_.program_config(0).push_dense_table_id_size();
-           ++i) {
-        uint64_t tid = static_cast<uint64_t>(
-            param_.program_config(0).push_dense_table_id(i));
-        pull_dense_worker_->IncreaseThreadVersion(thread_id_, tid);
+  int batch_cnt = 0;
+  std::exception_ptr error;
+  std::vector<std::string> ins_id_vec;
+  PrefetchBatch* batch = nullptr;
+  while (ready_batches->Get(batch)) {
+    if (batch->batch_size <= 0) {
+      error = batch->error;
+      break;
+    }
+    try {
+      for (auto& name : feed_names) {
+        std::swap(*thread_scope_->FindVar(name)->GetMutable<LoDTensor>(),
+                  *batch->scope->FindVar(name)->GetMutable<LoDTensor>());
+      }
+      features_.swap(batch->features);
+      feature_values_.swap(batch->feature_values);
+      ins_id_vec.swap(batch->ins_id_vec);
+      int cur_batch = batch->batch_size;
+      // the batch is taken out, let the next one be prefetched
+      free_batches->Put(batch);
+
+      for (int i = 0; i < pull_table_num; ++i) {
+        FillPulledSparse(i);
       }
+      VLOG(3) << "fill sparse value for all sparse table done.";
+      TrainOneBatch(cur_batch, batch_cnt, ins_id_vec);
+    } catch (...) {
+      error = std::current_exception();
+      break;
     }
-    if (need_dump_field_) {
-      DumpField(*thread_scope_, dump_mode_, dump_interval_);
+    ++batch_cnt;
+  }
+  free_batches->Close();
+  ready_batches->Close();
+  prefetch_thread.join();
+
+  device_reader_->AssignFeedVar(*thread_scope_);
+  for (auto& batch : batches) {
+    root_scope_->DeleteScope(batch.scope);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void DownpourWorker::TrainFiles() {
+  VLOG(3) << "Begin to train files";
+  platform::SetNumThreads(1);
+  // the dumped fields are read from the reader and the tables are copied
+  // between the batches, both need the serial pull
+  if (param_.pull_sparse_prefetch_depth() > 0 && !need_dump_field_ &&
+      !copy_table_config_.need_copy()) {
+    TrainFilesWithPrefetch();
+    if (need_dump_param_) {
+      writer_.Flush();
     }
-    if (need_dump_param_ && thread_id_ == 0) {
-      DumpParam(*thread_scope_, batch_cnt);
+    return;
+  }
+  device_reader_->Start();
+  int batch_cnt = 0;
+  int cur_batch;
+  while ((cur_batch = device_reader_->Next()) > 0) {
+    if (copy_table_config_.need_copy()) {
+      if (batch_cnt % copy_table_config_.batch_num() == 0) {
+        CopySparseTable();
+        CopyDenseTable();
+        CopyDenseVars();
+      }
     }
+    // pull sparse here
+    for (int i = 0; i < param_.program_config(0).pull_sparse_table_id_size();
+         ++i) {
+      PullSparse(i, *thread_scope_, &features_, &feature_values_);
+      FillPulledSparse(i);
+    }
+    VLOG(3) << "fill sparse value for all sparse table done.";
 
-    PrintFetchVars();
-    thread_scope_->DropKids();
+    TrainOneBatch(cur_batch, batch_cnt, device_reader_->GetInsIdVec());
     ++batch_cnt;
   }
   if (need_dump_field_ || need_dump_param_) {
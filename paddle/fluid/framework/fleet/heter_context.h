@@ -65,10 +65,10 @@ class HeterContext {
       device_dim_ptr_;
 #endif
 #ifdef PADDLE_WITH_PSCORE
-  std::vector<std::vector<paddle::distributed::FixedFeatureValue*>> value_ptr_;
-  std::vector<std::vector<std::vector<paddle::distributed::FixedFeatureValue*>>>
+  std::vector<std::vector<paddle::distributed::SlabFeatureValue*>> value_ptr_;
+  std::vector<std::vector<std::vector<paddle::distributed::SlabFeatureValue*>>>
       value_dim_ptr_;
-  std::vector<std::vector<std::vector<paddle::distributed::FixedFeatureValue*>>>
+  std::vector<std::vector<std::vector<paddle::distributed::SlabFeatureValue*>>>
       device_dim_ptr_;
 #endif
   std::vector<std::vector<FeatureValue>> device_values_;
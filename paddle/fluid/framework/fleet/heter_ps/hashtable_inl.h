@@ -225,7 +225,7 @@ void HashTable<KeyType, ValType>::dump_to_cpu(int devid, cudaStream_t stream) {
 #endif
 #ifdef PADDLE_WITH_PSCORE
       auto* downpour_value =
-          (paddle::distributed::FixedFeatureValue*)(gpu_val.cpu_ptr);
+          (paddle::distributed::SlabFeatureValue*)(gpu_val.cpu_ptr);
       int downpour_value_size = downpour_value->size();
       if (gpu_val.mf_size > 0 && downpour_value_size == 7) {
         downpour_value->resize(gpu_val.mf_size + downpour_value_size);
@@ -14,8 +14,10 @@
 #include "paddle/fluid/framework/fleet/metrics.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <ctime>
 #include <memory>
+#include <new>
 #include <numeric>
 #include "paddle/fluid/framework/lod_tensor.h"
 
@@ -25,12 +27,42 @@ namespace framework {
 
 std::shared_ptr<Metric> Metric::s_instance_ = nullptr;
 
+// Each thread uses its own shard as long as there are no more threads than
+// shards
+static size_t ThreadShardId(size_t shard_num) {
+  static std::atomic<size_t> next_id{0};
+  thread_local size_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+  return id % shard_num;
+}
+
+static size_t UidShardId(uint64_t uid, size_t shard_num) {
+  return ((uid * 0x9E3779B97F4A7C15ULL) >> 32) % shard_num;
+}
+
+static void AtomicAdd(std::atomic<double>* value, double delta) {
+  double old_value = value->load(std::memory_order_relaxed);
+  while (!value->compare_exchange_weak(old_value, old_value + delta,
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+void* BasicAucCalculator::operator new(size_t size) {
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, alignof(BasicAucCalculator), size) != 0) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void BasicAucCalculator::operator delete(void* ptr) { free(ptr); }
+
 void BasicAucCalculator::init(int table_size) {
   set_table_size(table_size);
 
   // init CPU memory
   for (int i = 0; i < 2; i++) {
     _table[i] = std::vector<double>();
+    _bucket_counts[i] = std::vector<std::atomic<uint64_t>>(table_size);
   }
 
   // reset
@@ -41,10 +73,36 @@ void BasicAucCalculator::reset() {
   // reset CPU counter
   for (int i = 0; i < 2; i++) {
     _table[i].assign(_table_size, 0.0);
+    for (auto& count : _bucket_counts[i]) {
+      count.store(0, std::memory_order_relaxed);
+    }
+  }
+  for (auto& shard : _error_shards) {
+    shard.abserr.store(0, std::memory_order_relaxed);
+    shard.sqrerr.store(0, std::memory_order_relaxed);
+    shard.pred.store(0, std::memory_order_relaxed);
+  }
+  _local_abserr = 0;
+  _local_sqrerr = 0;
+  _local_pred = 0;
+}
+
+void BasicAucCalculator::merge_counters() {
+  for (int i = 0; i < 2; i++) {
+    _table[i].resize(_table_size);
+    for (int j = 0; j < _table_size; j++) {
+      _table[i][j] = static_cast<double>(
+          _bucket_counts[i][j].load(std::memory_order_relaxed));
+    }
   }
   _local_abserr = 0;
   _local_sqrerr = 0;
   _local_pred = 0;
+  for (auto& shard : _error_shards) {
+    _local_abserr += shard.abserr.load(std::memory_order_relaxed);
+    _local_sqrerr += shard.sqrerr.load(std::memory_order_relaxed);
+    _local_pred += shard.pred.load(std::memory_order_relaxed);
+  }
 }
 
 void BasicAucCalculator::add_data(const float* d_pred, const int64_t* d_label,
@@ -56,7 +114,6 @@ void BasicAucCalculator::add_data(const float* d_pred, const int64_t* d_label,
   h_label.resize(batch_size);
   memcpy(h_pred.data(), d_pred, sizeof(float) * batch_size);
   memcpy(h_label.data(), d_label, sizeof(int64_t) * batch_size);
-  std::lock_guard<std::mutex> lock(_table_mutex);
   for (int i = 0; i < batch_size; ++i) {
     add_unlock_data(h_pred[i], h_label[i]);
   }
@@ -80,10 +137,11 @@ void BasicAucCalculator::add_unlock_data(double pred, int label) {
       pos, _table_size,
       platform::errors::PreconditionNotMet(
           "pos must be less than table_size, but its value is: %d", pos));
-  _local_abserr += fabs(pred - label);
-  _local_sqrerr += (pred - label) * (pred - label);
-  _local_pred += pred;
-  ++_table[label][pos];
+  auto& shard = _error_shards[ThreadShardId(kShardNum)];
+  AtomicAdd(&shard.abserr, fabs(pred - label));
+  AtomicAdd(&shard.sqrerr, (pred - label) * (pred - label));
+  AtomicAdd(&shard.pred, pred);
+  _bucket_counts[label][pos].fetch_add(1, std::memory_order_relaxed);
 }
 
 // add mask data
@@ -102,7 +160,6 @@ void BasicAucCalculator::add_mask_data(const float* d_pred,
   memcpy(h_label.data(), d_label, sizeof(int64_t) * batch_size);
   memcpy(h_mask.data(), d_mask, sizeof(int64_t) * batch_size);
 
-  std::lock_guard<std::mutex> lock(_table_mutex);
   for (int i = 0; i < batch_size; ++i) {
     if (h_mask[i]) {
       add_unlock_data(h_pred[i], h_label[i]);
@@ -111,6 +168,7 @@ void BasicAucCalculator::add_mask_data(const float* d_pred,
 }
 
 void BasicAucCalculator::compute() {
+  merge_counters();
 #if defined(PADDLE_WITH_GLOO)
   double area = 0;
   double fp = 0;
@@ -240,8 +298,11 @@ void BasicAucCalculator::calculate_bucket_error() {
 }
 
 void BasicAucCalculator::reset_records() {
-  // reset wuauc_records_
-  wuauc_records_.clear();
+  // reset the records of users
+  for (auto& shard : _wuauc_shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.records.clear();
+  }
   _user_cnt = 0;
   _size = 0;
   _uauc = 0;
@@ -264,7 +325,6 @@ void BasicAucCalculator::add_uid_data(const float* d_pred,
   memcpy(h_label.data(), d_label, sizeof(int64_t) * batch_size);
   memcpy(h_uid.data(), d_uid, sizeof(uint64_t) * batch_size);
 
-  std::lock_guard<std::mutex> lock(_table_mutex);
   for (int i = 0; i < batch_size; ++i) {
     add_uid_unlock_data(h_pred[i], h_label[i], static_cast<uint64_t>(h_uid[i]));
   }
@@ -281,57 +341,62 @@ void BasicAucCalculator::add_uid_unlock_data(double pred, int label,
       platform::errors::PreconditionNotMet(
           "label must be equal to 0 or 1, but its value is: %d", label));
 
-  WuaucRecord record;
-  record.uid_ = uid;
-  record.label_ = label;
-  record.pred_ = pred;
-  wuauc_records_.emplace_back(std::move(record));
+  auto& shard = _wuauc_shards[UidShardId(uid, kShardNum)];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.records.push_back({uid, label, static_cast<float>(pred)});
 }
 
 void BasicAucCalculator::computeWuAuc() {
-  std::sort(wuauc_records_.begin(), wuauc_records_.end(),
-            [](const WuaucRecord& lhs, const WuaucRecord& rhs) {
-              if (lhs.uid_ == rhs.uid_) {
-                if (lhs.pred_ == rhs.pred_) {
-                  return lhs.label_ < rhs.label_;
+  // every shard is sorted as the records were sorted globally, then the
+  // users are computed in descending order of uid, so the sums are the same
+  // as sorting all the records
+  struct UserRange {
+    uint64_t uid;
+    size_t shard;
+    size_t begin;
+    size_t end;
+  };
+  std::vector<UserRange> users;
+  for (size_t i = 0; i < kShardNum; ++i) {
+    auto& records = _wuauc_shards[i].records;
+    std::sort(records.begin(), records.end(),
+              [](const WuaucRecord& lhs, const WuaucRecord& rhs) {
+                if (lhs.uid_ == rhs.uid_) {
+                  if (lhs.pred_ == rhs.pred_) {
+                    return lhs.label_ < rhs.label_;
+                  } else {
+                    return lhs.pred_ > rhs.pred_;
+                  }
                 } else {
-                  return lhs.pred_ > rhs.pred_;
+                  return lhs.uid_ > rhs.uid_;
                 }
-              } else {
-                return lhs.uid_ > rhs.uid_;
-              }
-            });
-
-  WuaucRocData roc_data;
-  uint64_t prev_uid = 0;
-  size_t prev_pos = 0;
-  for (size_t i = 0; i < wuauc_records_.size(); ++i) {
-    if (wuauc_records_[i].uid_ != prev_uid) {
-      std::vector<WuaucRecord> single_user_recs(
-          wuauc_records_.begin() + prev_pos, wuauc_records_.begin() + i);
-      roc_data = computeSingelUserAuc(single_user_recs);
-      if (roc_data.auc_ != -1) {
-        double ins_num = (roc_data.tp_ + roc_data.fp_);
-        _user_cnt += 1;
-        _size += ins_num;
-        _uauc += roc_data.auc_;
-        _wuauc += roc_data.auc_ * ins_num;
+              });
+    size_t begin = 0;
+    for (size_t j = 1; j <= records.size(); ++j) {
+      if (j == records.size() || records[j].uid_ != records[begin].uid_) {
+        users.push_back({records[begin].uid_, i, begin, j});
+        begin = j;
       }
-
-      prev_uid = wuauc_records_[i].uid_;
-      prev_pos = i;
     }
   }
+  std::sort(users.begin(), users.end(),
+            [](const UserRange& lhs, const UserRange& rhs) {
+              return lhs.uid > rhs.uid;
+            });
 
-  std::vector<WuaucRecord> single_user_recs(wuauc_records_.begin() + prev_pos,
-                                            wuauc_records_.end());
-  roc_data = computeSingelUserAuc(single_user_recs);
-  if (roc_data.auc_ != -1) {
-    double ins_num = (roc_data.tp_ + roc_data.fp_);
-    _user_cnt += 1;
-    _size += ins_num;
-    _uauc += roc_data.auc_;
-    _wuauc += roc_data.auc_ * ins_num;
+  WuaucRocData roc_data;
+  for (auto& user : users) {
+    auto& records = _wuauc_shards[user.shard].records;
+    std::vector<WuaucRecord> single_user_recs(records.begin() + user.begin,
+                                              records.begin() + user.end);
+    roc_data = computeSingelUserAuc(single_user_recs);
+    if (roc_data.auc_ != -1) {
+      double ins_num = (roc_data.tp_ + roc_data.fp_);
+      _user_cnt += 1;
+      _size += ins_num;
+      _uauc += roc_data.auc_;
+      _wuauc += roc_data.auc_ * ins_num;
+    }
   }
 }
 
@@ -19,6 +19,7 @@ limitations under the License. */
 #include <ctime>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <random>
 #include <string>
 #include <unordered_map>
@@ -46,6 +47,10 @@ namespace framework {
 class BasicAucCalculator {
  public:
   BasicAucCalculator() {}
+  // the error shards are cache line aligned, which the global operator new
+  // does not honor before C++17
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
   struct WuaucRecord {
     uint64_t uid_;
     int label_;
@@ -61,7 +66,7 @@ class BasicAucCalculator {
   void init_wuauc(int table_size);
   void reset();
   void reset_records();
-  // add single data in CPU with LOCK, deprecated
+  // add single data in CPU, lock free
   void add_unlock_data(double pred, int label);
   void add_uid_unlock_data(double pred, int label, uint64_t uid);
   // add batch data
@@ -91,11 +96,13 @@ class BasicAucCalculator {
   double size() const { return _size; }
   double rmse() const { return _rmse; }
   std::unordered_set<uint64_t> uid_keys() const { return _uid_keys; }
-  // lock and unlock
+  // lock and unlock, no longer needed to add data
   std::mutex& table_mutex(void) { return _table_mutex; }
 
  private:
   void calculate_bucket_error();
+  // merges the counters into _table and the local errors
+  void merge_counters();
 
  protected:
   double _local_abserr = 0;
@@ -116,11 +123,36 @@ class BasicAucCalculator {
  private:
   void set_table_size(int table_size) { _table_size = table_size; }
   int _table_size;
+  // the buckets are counted by atomic increments, and merged into _table to
+  // compute the metrics
+  std::vector<std::atomic<uint64_t>> _bucket_counts[2];
   std::vector<double> _table[2];
-  std::vector<WuaucRecord> wuauc_records_;
+
+  // the errors are summed by the threads in different shards, each on its
+  // own cache line to avoid false sharing
+  static constexpr size_t kShardNum = 64;
+  struct alignas(64) ErrorShard {
+    std::atomic<double> abserr{0};
+    std::atomic<double> sqrerr{0};
+    std::atomic<double> pred{0};
+  };
+  ErrorShard _error_shards[kShardNum];
+
+  // the records for WuAUC, sharded by uid. The exact AUC of a user ranks all
+  // of its records, so every record is kept as before, 16 bytes each.
+  struct WuaucShard {
+    std::mutex mutex;
+    std::vector<WuaucRecord> records;
+  };
+  WuaucShard _wuauc_shards[kShardNum];
+
   static constexpr double kRelativeErrorBound = 0.05;
   static constexpr double kMaxSpan = 0.01;
   std::mutex _table_mutex;
+
+#if PADDLE_WITH_TESTING
+  friend class BasicAucCalculatorTest;
+#endif
 };
 
 class Metric {
@@ -299,7 +331,6 @@ class Metric {
                 batch_size, pred_data_list[i].size()));
       }
       auto cal = GetCalculator();
-      std::lock_guard<std::mutex> lock(cal->table_mutex());
       for (size_t i = 0; i < batch_size; ++i) {
         auto cmatch_rank_it =
             std::find(cmatch_rank_v.begin(), cmatch_rank_v.end(),
@@ -368,7 +399,6 @@ class Metric {
               "illegal batch size: cmatch_rank[%lu] and pred_data[%lu]",
               batch_size, pred_data.size()));
       auto cal = GetCalculator();
-      std::lock_guard<std::mutex> lock(cal->table_mutex());
       for (size_t i = 0; i < batch_size; ++i) {
         const auto& cur_cmatch_rank = parse_cmatch_rank(cmatch_rank_data[i]);
         for (size_t j = 0; j < cmatch_rank_v.size(); ++j) {
@@ -494,7 +524,6 @@ class Metric {
       }
 
       auto cal = GetCalculator();
-      std::lock_guard<std::mutex> lock(cal->table_mutex());
       for (size_t i = 0; i < batch_size; ++i) {
         const auto& cur_cmatch_rank = parse_cmatch_rank(cmatch_rank_data[i]);
         for (size_t j = 0; j < cmatch_rank_v.size(); ++j) {
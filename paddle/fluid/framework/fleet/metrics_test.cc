@@ -0,0 +1,230 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/fleet/metrics.h"
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(PADDLE_WITH_PSLIB) || defined(PADDLE_WITH_PSCORE)
+namespace paddle {
+namespace framework {
+
+static const int kTableSize = 1000;
+static const int kInsNum = 20000;
+static const int kThreadNum = 8;
+static const int kBatchSize = 64;
+
+// compute() needs an initialized gloo context, so the test reads the merged
+// counters and computes the AUC from the buckets as compute() does
+class BasicAucCalculatorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> pred_dist(0, 1);
+    std::uniform_int_distribution<int64_t> uid_dist(0, 300);
+    for (int i = 0; i < kInsNum; ++i) {
+      float pred = pred_dist(rng);
+      preds_.push_back(pred);
+      // clicks are more likely with larger predictions
+      labels_.push_back(pred_dist(rng) < pred ? 1 : 0);
+      uids_.push_back(uid_dist(rng));
+    }
+  }
+
+  void AddSerial(BasicAucCalculator* calculator) {
+    for (int i = 0; i < kInsNum; ++i) {
+      calculator->add_unlock_data(preds_[i], labels_[i]);
+      calculator->add_uid_unlock_data(preds_[i], labels_[i], uids_[i]);
+    }
+  }
+
+  // every thread adds batches of its own slice, as the Hogwild workers do
+  void AddParallel(BasicAucCalculator* calculator) {
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < kThreadNum; ++tid) {
+      threads.emplace_back([this, calculator, tid] {
+        for (int begin = tid * kBatchSize; begin < kInsNum;
+             begin += kThreadNum * kBatchSize) {
+          int batch_size = std::min(kBatchSize, kInsNum - begin);
+          calculator->add_data(preds_.data() + begin, labels_.data() + begin,
+                               batch_size, platform::CPUPlace());
+          calculator->add_uid_data(preds_.data() + begin,
+                                   labels_.data() + begin,
+                                   uids_.data() + begin, batch_size,
+                                   platform::CPUPlace());
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  static void Merge(BasicAucCalculator* calculator) {
+    calculator->merge_counters();
+  }
+
+  static const std::vector<double>& Table(
+      const BasicAucCalculator& calculator, int label) {
+    return calculator._table[label];
+  }
+
+  static double Auc(const BasicAucCalculator& calculator) {
+    double area = 0;
+    double fp = 0;
+    double tp = 0;
+    for (int i = kTableSize - 1; i >= 0; i--) {
+      double newfp = fp + calculator._table[0][i];
+      double newtp = tp + calculator._table[1][i];
+      area += (newfp - fp) * (tp + newtp) / 2;
+      fp = newfp;
+      tp = newtp;
+    }
+    return area / (fp * tp);
+  }
+
+  static void ExpectErrorsNear(const BasicAucCalculator& lhs,
+                               const BasicAucCalculator& rhs) {
+    // only the summation order differs
+    EXPECT_NEAR(lhs._local_abserr, rhs._local_abserr,
+                1e-9 * rhs._local_abserr);
+    EXPECT_NEAR(lhs._local_sqrerr, rhs._local_sqrerr,
+                1e-9 * rhs._local_sqrerr);
+    EXPECT_NEAR(lhs._local_pred, rhs._local_pred, 1e-9 * rhs._local_pred);
+  }
+
+  struct WuAucSums {
+    double user_cnt = 0;
+    double size = 0;
+    double uauc = 0;
+    double wuauc = 0;
+  };
+
+  // WuAUC by sorting all the records globally, as the calculator did
+  // before the records were sharded
+  WuAucSums ReferenceWuAuc(BasicAucCalculator* calculator) const {
+    typedef BasicAucCalculator::WuaucRecord Record;
+    std::vector<Record> records;
+    for (int i = 0; i < kInsNum; ++i) {
+      records.push_back({static_cast<uint64_t>(uids_[i]),
+                         static_cast<int>(labels_[i]), preds_[i]});
+    }
+    std::sort(records.begin(), records.end(),
+              [](const Record& lhs, const Record& rhs) {
+                if (lhs.uid_ == rhs.uid_) {
+                  if (lhs.pred_ == rhs.pred_) {
+                    return lhs.label_ < rhs.label_;
+                  }
+                  return lhs.pred_ > rhs.pred_;
+                }
+                return lhs.uid_ > rhs.uid_;
+              });
+    WuAucSums sums;
+    size_t begin = 0;
+    for (size_t i = 1; i <= records.size(); ++i) {
+      if (i < records.size() && records[i].uid_ == records[begin].uid_) {
+        continue;
+      }
+      auto roc_data = calculator->computeSingelUserAuc(std::vector<Record>(
+          records.begin() + begin, records.begin() + i));
+      if (roc_data.auc_ != -1) {
+        double ins_num = roc_data.tp_ + roc_data.fp_;
+        sums.user_cnt += 1;
+        sums.size += ins_num;
+        sums.uauc += roc_data.auc_;
+        sums.wuauc += roc_data.auc_ * ins_num;
+      }
+      begin = i;
+    }
+    return sums;
+  }
+
+  std::vector<float> preds_;
+  std::vector<int64_t> labels_;
+  std::vector<int64_t> uids_;
+};
+
+TEST_F(BasicAucCalculatorTest, parallel_add_matches_serial) {
+  std::unique_ptr<BasicAucCalculator> serial(new BasicAucCalculator());
+  std::unique_ptr<BasicAucCalculator> parallel(new BasicAucCalculator());
+  serial->init(kTableSize);
+  parallel->init(kTableSize);
+  serial->reset_records();
+  parallel->reset_records();
+  AddSerial(serial.get());
+  AddParallel(parallel.get());
+  Merge(serial.get());
+  Merge(parallel.get());
+
+  for (int label = 0; label < 2; ++label) {
+    ASSERT_EQ(Table(*parallel, label), Table(*serial, label));
+  }
+  double total = 0;
+  for (int label = 0; label < 2; ++label) {
+    for (auto count : Table(*serial, label)) {
+      total += count;
+    }
+  }
+  ASSERT_EQ(total, kInsNum);
+  EXPECT_DOUBLE_EQ(Auc(*parallel), Auc(*serial));
+  EXPECT_GT(Auc(*serial), 0.5);
+  ExpectErrorsNear(*parallel, *serial);
+
+  serial->computeWuAuc();
+  parallel->computeWuAuc();
+  EXPECT_GT(serial->user_cnt(), 0);
+  EXPECT_EQ(parallel->user_cnt(), serial->user_cnt());
+  EXPECT_EQ(parallel->size(), serial->size());
+  EXPECT_DOUBLE_EQ(parallel->uauc(), serial->uauc());
+  EXPECT_DOUBLE_EQ(parallel->wuauc(), serial->wuauc());
+
+  // the users are summed in the same order as the global sort
+  auto reference = ReferenceWuAuc(serial.get());
+  EXPECT_EQ(serial->user_cnt(), reference.user_cnt);
+  EXPECT_EQ(serial->size(), reference.size);
+  EXPECT_DOUBLE_EQ(serial->uauc(), reference.uauc);
+  EXPECT_DOUBLE_EQ(serial->wuauc(), reference.wuauc);
+}
+
+TEST_F(BasicAucCalculatorTest, reset) {
+  std::unique_ptr<BasicAucCalculator> calculator(new BasicAucCalculator());
+  calculator->init(kTableSize);
+  calculator->reset_records();
+  AddParallel(calculator.get());
+  calculator->reset();
+  calculator->reset_records();
+  Merge(calculator.get());
+  for (int label = 0; label < 2; ++label) {
+    for (auto count : Table(*calculator, label)) {
+      ASSERT_EQ(count, 0);
+    }
+  }
+  calculator->computeWuAuc();
+  EXPECT_EQ(calculator->user_cnt(), 0);
+}
+
+TEST_F(BasicAucCalculatorTest, error_shards_aligned) {
+  std::unique_ptr<BasicAucCalculator> calculator(new BasicAucCalculator());
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(calculator.get()) % 64, 0UL);
+}
+
+}  // namespace framework
+}  // namespace paddle
+#endif
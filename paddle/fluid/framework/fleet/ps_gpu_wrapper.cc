@@ -543,7 +543,7 @@ void PSGPUWrapper::BuildPull(std::shared_ptr<HeterContext> gpu_task) {
 #endif
 
 #ifdef PADDLE_WITH_PSCORE
-    std::vector<std::vector<paddle::distributed::FixedFeatureValue*>> task_ptrs(
+    std::vector<std::vector<paddle::distributed::SlabFeatureValue*>> task_ptrs(
         device_num);
 #endif
 
@@ -220,6 +220,12 @@ void HogwildWorker::TrainFiles() {
   int cur_batch;
   int batch_cnt = 0;
   while ((cur_batch = device_reader_->Next()) > 0) {
+#if defined PADDLE_WITH_PSCORE
+    if (thread_id_ == 0) {
+      paddle::distributed::FleetWrapper::GetInstance()
+          ->AdvanceSparsePullCacheStep();
+    }
+#endif
     for (auto &op : ops_) {
       bool need_skip = false;
       for (auto t = 0u; t < skip_ops_.size(); ++t) {
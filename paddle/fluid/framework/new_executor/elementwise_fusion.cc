@@ -0,0 +1,313 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/elementwise_fusion.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "paddle/fluid/framework/op_registry.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+static constexpr char kFusedChainOp[] = "fused_elementwise_chain";
+
+static const std::unordered_set<std::string>& UnaryChainOps() {
+  static const std::unordered_set<std::string> ops = {
+      "relu", "sigmoid", "tanh",       "exp",  "sqrt",
+      "square", "silu",  "leaky_relu", "scale"};
+  return ops;
+}
+
+static const std::unordered_set<std::string>& BinaryChainOps() {
+  static const std::unordered_set<std::string> ops = {
+      "elementwise_add", "elementwise_sub", "elementwise_mul",
+      "elementwise_div"};
+  return ops;
+}
+
+// An op in the chain, see fused_elementwise_chain_op.cc for the attributes
+struct ChainStage {
+  std::string type;
+  int chain_in{kEmptyVarIndex};
+  int other{kEmptyVarIndex};
+  bool chain_is_x{true};
+  int out{kEmptyVarIndex};
+  std::vector<float> attrs{0.f, 0.f, 0.f};
+};
+
+static int SingleVar(const std::map<std::string, std::vector<int>>& index,
+                     const std::string& name) {
+  auto iter = index.find(name);
+  if (iter == index.end() || iter->second.size() != 1) {
+    return kEmptyVarIndex;
+  }
+  return iter->second[0];
+}
+
+static const LoDTensor* GetLoDTensor(const VariableScope& var_scope,
+                                     int var_id) {
+  if (var_id == kEmptyVarIndex) {
+    return nullptr;
+  }
+  auto* var = var_scope.Var(var_id);
+  if (var == nullptr || !var->IsType<LoDTensor>()) {
+    return nullptr;
+  }
+  return &var->Get<LoDTensor>();
+}
+
+// Whether y broadcasts to x along the trailing dims, e.g. [N, C] and [C]
+static bool IsTrailingBroadcast(const DDim& x_dims, const DDim& y_dims) {
+  int y_begin = 0;
+  while (y_begin < y_dims.size() && y_dims[y_begin] == 1) {
+    ++y_begin;
+  }
+  int y_rank = y_dims.size() - y_begin;
+  if (y_rank > x_dims.size()) {
+    return false;
+  }
+  for (int i = 0; i < y_rank; ++i) {
+    if (y_dims[y_begin + i] != x_dims[x_dims.size() - y_rank + i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Parses the op into a stage whose chain input is chain_in, or any input if
+// chain_in is kEmptyVarIndex. Returns false if the op can not be fused.
+static bool ParseChainStage(const OpFuncNode& node,
+                            const VariableScope& var_scope, int chain_in,
+                            ChainStage* stage) {
+  auto* op = node.operator_base_.get();
+  auto& type = op->Type();
+  bool is_unary = UnaryChainOps().count(type);
+  bool is_binary = BinaryChainOps().count(type);
+  if ((!is_unary && !is_binary) ||
+      dynamic_cast<const OperatorWithKernel*>(op) == nullptr ||
+      node.type_ != OpFuncType::kQueueSync || node.dev_ctx_ == nullptr ||
+      !platform::is_cpu_place(node.dev_ctx_->GetPlace()) ||
+      !node.inplace_back_map.empty() ||
+      (op->HasAttr("use_mkldnn") && op->Attr<bool>("use_mkldnn"))) {
+    return false;
+  }
+
+  stage->type = type;
+  stage->out = SingleVar(node.output_index, "Out");
+  auto* out = GetLoDTensor(var_scope, stage->out);
+  if (out == nullptr || (out->dtype() != phi::DataType::FLOAT32 &&
+                         out->dtype() != phi::DataType::FLOAT64)) {
+    return false;
+  }
+
+  int x_id = SingleVar(node.input_index, "X");
+  if (is_unary) {
+    if (type == "scale") {
+      auto iter = node.input_index.find("ScaleTensor");
+      if (iter != node.input_index.end() && !iter->second.empty()) {
+        return false;
+      }
+      stage->attrs = {op->Attr<float>("scale"), op->Attr<float>("bias"),
+                      op->Attr<bool>("bias_after_scale") ? 1.f : 0.f};
+    } else if (type == "leaky_relu") {
+      stage->attrs[0] = op->Attr<float>("alpha");
+    }
+    stage->chain_in = x_id;
+    stage->other = kEmptyVarIndex;
+    stage->chain_is_x = true;
+  } else {
+    int y_id = SingleVar(node.input_index, "Y");
+    if (x_id == y_id) {
+      return false;
+    }
+    if (chain_in != kEmptyVarIndex) {
+      stage->chain_is_x = x_id == chain_in;
+    } else {
+      auto* x = GetLoDTensor(var_scope, x_id);
+      stage->chain_is_x = x != nullptr && x->dims() == out->dims();
+    }
+    stage->chain_in = stage->chain_is_x ? x_id : y_id;
+    stage->other = stage->chain_is_x ? y_id : x_id;
+    auto* other = GetLoDTensor(var_scope, stage->other);
+    int axis = op->Attr<int>("axis");
+    if (other == nullptr || other->dtype() != out->dtype() ||
+        other->numel() <= 0 ||
+        !IsTrailingBroadcast(out->dims(), other->dims()) ||
+        (axis != -1 && axis != out->dims().size() - other->dims().size())) {
+      return false;
+    }
+  }
+
+  auto* in = GetLoDTensor(var_scope, stage->chain_in);
+  return (chain_in == kEmptyVarIndex || stage->chain_in == chain_in) &&
+         in != nullptr && in->dtype() == out->dtype() &&
+         in->dims() == out->dims() && stage->out != stage->chain_in &&
+         stage->out != stage->other;
+}
+
+void FuseElementwiseOps(std::vector<OpFuncNode>* op_func_nodes,
+                        VariableScope* var_scope) {
+  if (!OpInfoMap::Instance().Has(kFusedChainOp)) {
+    return;
+  }
+  auto& nodes = *op_func_nodes;
+  size_t var_num = var_scope->VarSize();
+  // one entry for every read, so an op reading a var twice counts twice
+  std::vector<std::vector<size_t>> consumers(var_num);
+  std::vector<int> producer_num(var_num, 0);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    for (auto& item : nodes[i].input_index) {
+      for (auto var_id : item.second) {
+        if (var_id != kEmptyVarIndex) {
+          consumers[var_id].push_back(i);
+        }
+      }
+    }
+    for (auto& item : nodes[i].output_index) {
+      for (auto var_id : item.second) {
+        if (var_id != kEmptyVarIndex) {
+          ++producer_num[var_id];
+        }
+      }
+    }
+  }
+
+  auto CanBeIntermediate = [&](int var_id) {
+    auto* var_desc = var_scope->VarDesc(var_id);
+    return consumers[var_id].size() == 1 && producer_num[var_id] == 1 &&
+           !(var_desc && var_desc->Persistable()) &&
+           !var_scope->GetVarSikpInplace(var_id);
+  };
+
+  std::vector<char> in_chain(nodes.size(), 0);
+  // the fused nodes, keyed by the position of the last op of their chains
+  std::unordered_map<size_t, OpFuncNode> fused_nodes;
+  size_t fused_op_num = 0;
+  for (size_t head = 0; head < nodes.size(); ++head) {
+    ChainStage head_stage;
+    if (in_chain[head] ||
+        !ParseChainStage(nodes[head], *var_scope, kEmptyVarIndex,
+                         &head_stage)) {
+      continue;
+    }
+    std::vector<size_t> chain = {head};
+    std::vector<ChainStage> stages = {head_stage};
+    std::unordered_set<int> external_inputs = {head_stage.chain_in};
+    if (head_stage.other != kEmptyVarIndex) {
+      external_inputs.insert(head_stage.other);
+    }
+
+    while (CanBeIntermediate(stages.back().out)) {
+      size_t next = consumers[stages.back().out][0];
+      ChainStage stage;
+      if (next <= chain.back() || in_chain[next] ||
+          !ParseChainStage(nodes[next], *var_scope, stages.back().out,
+                           &stage) ||
+          external_inputs.count(stage.out)) {
+        break;
+      }
+      auto inputs = external_inputs;
+      if (stage.other != kEmptyVarIndex) {
+        inputs.insert(stage.other);
+      }
+      // the fused op reads all the inputs at the position of the last op, so
+      // no op in between may write them
+      bool overwritten = false;
+      for (size_t i = head + 1; i < next && !overwritten; ++i) {
+        if (std::find(chain.begin(), chain.end(), i) != chain.end()) {
+          continue;
+        }
+        for (auto& item : nodes[i].output_index) {
+          for (auto var_id : item.second) {
+            overwritten = overwritten || inputs.count(var_id);
+          }
+        }
+      }
+      if (overwritten) {
+        break;
+      }
+      chain.push_back(next);
+      stages.push_back(stage);
+      external_inputs.swap(inputs);
+    }
+    if (chain.size() < 2) {
+      continue;
+    }
+
+    std::vector<std::string> types;
+    std::vector<int> chain_is_x;
+    std::vector<float> stage_attrs;
+    std::vector<int> y_ids;
+    std::vector<std::string> y_names;
+    for (auto& stage : stages) {
+      types.push_back(stage.type);
+      chain_is_x.push_back(stage.chain_is_x);
+      stage_attrs.insert(stage_attrs.end(), stage.attrs.begin(),
+                         stage.attrs.end());
+      if (stage.other != kEmptyVarIndex) {
+        y_ids.push_back(stage.other);
+        y_names.push_back(var_scope->GetNameById(stage.other));
+      }
+    }
+    int x_id = stages.front().chain_in;
+    int out_id = stages.back().out;
+    AttributeMap attrs;
+    attrs["functor_list"] = types;
+    attrs["chain_is_x"] = chain_is_x;
+    attrs["stage_attrs"] = stage_attrs;
+    auto op = OpRegistry::CreateOp(
+        kFusedChainOp, {{"X", {var_scope->GetNameById(x_id)}}, {"Y", y_names}},
+        {{"Out", {var_scope->GetNameById(out_id)}}}, attrs);
+
+    OpFuncNode fused_node;
+    fused_node.operator_base_ = std::shared_ptr<OperatorBase>(op.release());
+    fused_node.input_index = {{"X", {x_id}}, {"Y", y_ids}};
+    fused_node.output_index = {{"Out", {out_id}}};
+    fused_node.dev_ctx_ = nodes[chain.back()].dev_ctx_;
+    fused_node.type_ = OpFuncType::kQueueSync;
+    fused_nodes.emplace(chain.back(), std::move(fused_node));
+    for (auto i : chain) {
+      in_chain[i] = 1;
+    }
+    fused_op_num += chain.size();
+    VLOG(4) << "Fuse " << chain.size() << " ops from " << head_stage.type
+            << " to " << stages.back().type << " into " << kFusedChainOp;
+  }
+
+  if (fused_nodes.empty()) {
+    return;
+  }
+  std::vector<OpFuncNode> new_nodes;
+  new_nodes.reserve(nodes.size() - fused_op_num + fused_nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    auto iter = fused_nodes.find(i);
+    if (iter != fused_nodes.end()) {
+      new_nodes.emplace_back(std::move(iter->second));
+    } else if (!in_chain[i]) {
+      new_nodes.emplace_back(std::move(nodes[i]));
+    }
+  }
+  VLOG(3) << "Fuse " << fused_op_num << " elementwise ops into "
+          << fused_nodes.size() << " " << kFusedChainOp << " ops";
+  nodes.swap(new_nodes);
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,44 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <vector>
+
+#include "paddle/fluid/framework/new_executor/new_executor_defs.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+/*
+ * Replaces the chains of elementwise and activation ops on CPU with single
+ * fused_elementwise_chain ops, which run the whole chain tile by tile while
+ * the data stays in cache.
+ *
+ * An op joins the chain of its input if it is the only consumer of that
+ * input, and the input is neither persistable nor fed. The chain input has
+ * the same shape as the output of each op, and the other inputs of binary ops
+ * broadcast to it along the trailing dims. The shapes are those of the first
+ * run, which is done before this pass.
+ *
+ * The fused op takes the place of the last op in the chain, and the
+ * intermediate variables are not written any more.
+ */
+void FuseElementwiseOps(std::vector<OpFuncNode>* op_func_nodes,
+                        VariableScope* var_scope);
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,186 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/elementwise_fusion.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/new_executor/interpretercore_util.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/framework/program_desc.h"
+#include "paddle/fluid/framework/tensor_util.h"
+#include "paddle/phi/core/kernel_registry.h"
+
+USE_OP_ITSELF(relu);
+USE_OP_ITSELF(sigmoid);
+USE_OP_ITSELF(tanh);
+USE_OP_ITSELF(scale);
+USE_OP_ITSELF(elementwise_add);
+USE_OP_ITSELF(fetch_v2);
+USE_OP_ITSELF(fused_elementwise_chain);
+
+PD_DECLARE_KERNEL(relu, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(sigmoid, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(tanh, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(scale, CPU, ALL_LAYOUT);
+PD_DECLARE_KERNEL(add_raw, CPU, ALL_LAYOUT);
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+static void AddVar(BlockDesc* block, const std::string& name,
+                   const std::vector<int64_t>& shape,
+                   bool persistable = false) {
+  auto* var = block->Var(name);
+  var->SetType(proto::VarType::LOD_TENSOR);
+  var->SetDataType(proto::VarType::FP32);
+  var->SetShape(shape);
+  var->SetPersistable(persistable);
+}
+
+static void AddOp(BlockDesc* block, const std::string& type,
+                  const VariableNameMap& inputs,
+                  const VariableNameMap& outputs,
+                  const AttributeMap& attrs = {}) {
+  auto* op = block->AppendOp();
+  op->SetType(type);
+  for (auto& item : inputs) {
+    op->SetInput(item.first, item.second);
+  }
+  for (auto& item : outputs) {
+    op->SetOutput(item.first, item.second);
+  }
+  for (auto& item : attrs) {
+    op->SetAttr(item.first, item.second);
+  }
+  op->CheckAttrs();
+}
+
+static void FillInput(Scope* scope, const std::string& name,
+                      const std::vector<int64_t>& shape) {
+  auto* tensor = scope->Var(name)->GetMutable<LoDTensor>();
+  tensor->Resize(phi::make_ddim(shape));
+  float* data = tensor->mutable_data<float>(platform::CPUPlace());
+  for (int64_t i = 0; i < tensor->numel(); ++i) {
+    data[i] = static_cast<float>(i % 17) / 8.f - 1.f;
+  }
+}
+
+// Runs the block once as the interpreter does, then fuses it
+static std::vector<OpFuncNode> BuildAndFuse(const BlockDesc& block,
+                                            VariableScope* var_scope) {
+  build_variable_scope(block, var_scope, false);
+  std::vector<OpFuncNode> nodes;
+  build_op_func_list(platform::CPUPlace(), block, &nodes, var_scope, false);
+  FuseElementwiseOps(&nodes, var_scope);
+  return nodes;
+}
+
+static std::vector<std::string> OpTypes(const std::vector<OpFuncNode>& nodes) {
+  std::vector<std::string> types;
+  for (auto& node : nodes) {
+    types.push_back(node.operator_base_->Type());
+  }
+  return types;
+}
+
+TEST(ElementwiseFusion, fuse_single_consumer_chain) {
+  ProgramDesc program;
+  auto* block = program.MutableBlock(0);
+  // the tail of 37 elements is shorter than a tile
+  std::vector<int64_t> shape = {2, 2085};
+  AddVar(block, "x", shape);
+  AddVar(block, "bias", {2085}, true);
+  AddVar(block, "t1", shape);
+  AddVar(block, "t2", shape);
+  AddVar(block, "out", shape, true);
+  AddOp(block, "elementwise_add", {{"X", {"x"}}, {"Y", {"bias"}}},
+        {{"Out", {"t1"}}});
+  AddOp(block, "relu", {{"X", {"t1"}}}, {{"Out", {"t2"}}});
+  AddOp(block, "scale", {{"X", {"t2"}}}, {{"Out", {"out"}}},
+        {{"scale", 2.f}, {"bias", 0.5f}, {"bias_after_scale", false}});
+
+  Scope scope;
+  FillInput(&scope, "x", shape);
+  FillInput(&scope, "bias", {2085});
+  VariableScope var_scope(&scope);
+  auto nodes = BuildAndFuse(*block, &var_scope);
+  ASSERT_EQ(OpTypes(nodes),
+            std::vector<std::string>({"fused_elementwise_chain"}));
+
+  // the build run is unfused, compare the fused op with its output
+  LoDTensor expected;
+  TensorCopySync(scope.FindVar("out")->Get<LoDTensor>(), platform::CPUPlace(),
+                 &expected);
+  nodes[0].operator_base_->Run(scope, platform::CPUPlace());
+  auto& out = scope.FindVar("out")->Get<LoDTensor>();
+  ASSERT_EQ(out.dims(), expected.dims());
+  for (int64_t i = 0; i < out.numel(); ++i) {
+    ASSERT_FLOAT_EQ(out.data<float>()[i], expected.data<float>()[i]);
+  }
+}
+
+TEST(ElementwiseFusion, skip_multi_consumer_intermediate) {
+  ProgramDesc program;
+  auto* block = program.MutableBlock(0);
+  std::vector<int64_t> shape = {4, 16};
+  for (auto name : {"x", "t1", "t2", "t3"}) {
+    AddVar(block, name, shape);
+  }
+  AddVar(block, "out", shape, true);
+  // t1 is read by both sigmoid and tanh, so relu ends no chain. sigmoid can
+  // not join the add either, since tanh writes the other input in between.
+  AddOp(block, "relu", {{"X", {"x"}}}, {{"Out", {"t1"}}});
+  AddOp(block, "sigmoid", {{"X", {"t1"}}}, {{"Out", {"t2"}}});
+  AddOp(block, "tanh", {{"X", {"t1"}}}, {{"Out", {"t3"}}});
+  AddOp(block, "elementwise_add", {{"X", {"t2"}}, {"Y", {"t3"}}},
+        {{"Out", {"out"}}});
+
+  Scope scope;
+  FillInput(&scope, "x", shape);
+  VariableScope var_scope(&scope);
+  auto nodes = BuildAndFuse(*block, &var_scope);
+  ASSERT_EQ(OpTypes(nodes),
+            std::vector<std::string>(
+                {"relu", "sigmoid", "fused_elementwise_chain"}));
+  // tanh feeds Y of the add
+  ASSERT_EQ(nodes[2].operator_base_->Attr<std::vector<int>>("chain_is_x"),
+            std::vector<int>({1, 0}));
+}
+
+TEST(ElementwiseFusion, skip_fetched_intermediate) {
+  ProgramDesc program;
+  auto* block = program.MutableBlock(0);
+  std::vector<int64_t> shape = {4, 16};
+  AddVar(block, "x", shape);
+  AddVar(block, "t1", shape);
+  AddVar(block, "out", shape);
+  AddOp(block, "relu", {{"X", {"x"}}}, {{"Out", {"t1"}}});
+  AddOp(block, "sigmoid", {{"X", {"t1"}}}, {{"Out", {"out"}}});
+  add_fetch({"t1", "out"}, block);
+
+  Scope scope;
+  FillInput(&scope, "x", shape);
+  VariableScope var_scope(&scope);
+  auto nodes = BuildAndFuse(*block, &var_scope);
+  ASSERT_EQ(OpTypes(nodes), std::vector<std::string>({"relu", "sigmoid",
+                                                      "fetch_v2", "fetch_v2"}));
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,205 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/infershape_cache.h"
+
+#include "paddle/fluid/framework/operator.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+static bool EndsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() &&
+         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool InferShapeCache::Build(const std::vector<Instruction>& vec_instruction,
+                            const VariableScope& var_scope) {
+  cacheable_.assign(vec_instruction.size(), 0);
+  records_.assign(vec_instruction.size(), {});
+  infershape_dims_.assign(vec_instruction.size(), {});
+
+  auto IsLoDTensor = [&var_scope](int var_id) {
+    auto* var = var_scope.Var(var_id);
+    return var_id == kEmptyVarIndex ||
+           (var != nullptr && var->IsType<LoDTensor>());
+  };
+
+  size_t cacheable_num = 0;
+  for (size_t i = 0; i < vec_instruction.size(); ++i) {
+    auto& instr = vec_instruction[i];
+    auto* op = instr.OpBase();
+    auto* op_with_kernel = dynamic_cast<const OperatorWithKernel*>(op);
+    // the ops without kernel (e.g. control flow ops) have no InferShape
+    if (op_with_kernel == nullptr ||
+        (op_with_kernel->HasAttr(kAllKernelsMustComputeRuntimeShape) &&
+         op_with_kernel->Attr<bool>(kAllKernelsMustComputeRuntimeShape))) {
+      continue;
+    }
+    bool cacheable = true;
+    for (auto& item : instr.Inputs()) {
+      if (!item.second.empty() && (EndsWith(item.first, "Tensor") ||
+                                   EndsWith(item.first, "TensorList"))) {
+        cacheable = false;
+      }
+      for (auto var_id : item.second) {
+        cacheable = cacheable && IsLoDTensor(var_id);
+      }
+    }
+    for (auto& item : instr.Outputs()) {
+      for (auto var_id : item.second) {
+        cacheable = cacheable && IsLoDTensor(var_id);
+      }
+    }
+    cacheable_[i] = cacheable;
+    cacheable_num += cacheable;
+  }
+  VLOG(3) << "InferShapeCache can skip the InferShape of " << cacheable_num
+          << " in " << vec_instruction.size() << " ops";
+  return cacheable_num > 0;
+}
+
+void InferShapeCache::BeforeRun(const std::vector<std::string>& feed_names,
+                                const VariableScope& var_scope) {
+  std::vector<int64_t> signature;
+  for (auto& feed_name : feed_names) {
+    auto* var = var_scope.FindVar(feed_name);
+    if (var == nullptr || !var->IsType<LoDTensor>()) {
+      signature.push_back(-1);
+      continue;
+    }
+    auto& tensor = var->Get<LoDTensor>();
+    auto& dims = tensor.dims();
+    signature.push_back(dims.size());
+    for (int i = 0; i < dims.size(); ++i) {
+      signature.push_back(dims[i]);
+    }
+    auto& lod = tensor.lod();
+    signature.push_back(lod.size());
+    for (auto& level : lod) {
+      signature.push_back(level.size());
+      for (auto offset : level) {
+        signature.push_back(static_cast<int64_t>(offset));
+      }
+    }
+    // small integer feeds may be used as shapes, e.g. ShapeTensor of reshape
+    if (tensor.IsInitialized() && platform::is_cpu_place(tensor.place()) &&
+        tensor.numel() <= kMaxShapeFeedNumel) {
+      if (tensor.dtype() == phi::DataType::INT32) {
+        auto* data = tensor.data<int32_t>();
+        signature.insert(signature.end(), data, data + tensor.numel());
+      } else if (tensor.dtype() == phi::DataType::INT64) {
+        auto* data = tensor.data<int64_t>();
+        signature.insert(signature.end(), data, data + tensor.numel());
+      }
+    }
+  }
+
+  if (ready_ && signature == signature_) {
+    mode_ = Mode::kHit;
+    hit_ = true;
+  } else {
+    VLOG(4) << "InferShapeCache records the shapes for a new signature";
+    mode_ = Mode::kRecord;
+    ready_ = false;
+    hit_ = false;
+    signature_ = std::move(signature);
+  }
+}
+
+void InferShapeCache::AfterRun(bool succeeded) {
+  if (mode_ == Mode::kRecord) {
+    ready_ = succeeded;
+  } else if (mode_ == Mode::kHit && (!succeeded || !hit_)) {
+    ready_ = false;
+  }
+  mode_ = Mode::kOff;
+}
+
+void InferShapeCache::CollectOutputs(const Instruction& instr,
+                                     std::vector<ShapeRecord>* records) {
+  records->clear();
+  for (auto& item : instr.InnerRuntimeContext()->outputs) {
+    for (auto* var : item.second) {
+      if (var != nullptr && var->IsType<LoDTensor>()) {
+        auto* tensor = var->GetMutable<LoDTensor>();
+        records->push_back(ShapeRecord{tensor, tensor->dims(), tensor->lod()});
+      }
+    }
+  }
+}
+
+void InferShapeCache::Apply(const Instruction& instr) const {
+  for (auto& record : records_[instr.Id()]) {
+    record.tensor->Resize(record.dims);
+    record.tensor->set_lod(record.lod);
+  }
+}
+
+void InferShapeCache::AfterInferShape(const Instruction& instr) {
+  size_t id = instr.Id();
+  if (mode_ != Mode::kRecord || !cacheable_[id]) {
+    return;
+  }
+  auto& dims = infershape_dims_[id];
+  dims.clear();
+  for (auto& item : instr.InnerRuntimeContext()->outputs) {
+    for (auto* var : item.second) {
+      if (var != nullptr && var->IsType<LoDTensor>()) {
+        dims.push_back(var->Get<LoDTensor>().dims());
+      }
+    }
+  }
+}
+
+void InferShapeCache::AfterCompute(const Instruction& instr) {
+  size_t id = instr.Id();
+  if (mode_ == Mode::kRecord) {
+    auto& records = records_[id];
+    CollectOutputs(instr, &records);
+    if (!cacheable_[id]) {
+      return;
+    }
+    auto& dims = infershape_dims_[id];
+    bool changed = dims.size() != records.size();
+    for (size_t i = 0; !changed && i < dims.size(); ++i) {
+      changed = dims[i] != records[i].dims;
+    }
+    if (changed) {
+      VLOG(3) << "The kernel of " << instr.OpBase()->Type()
+              << " changes the output shapes, never skip its InferShape";
+      cacheable_[id] = 0;
+    }
+  } else if (mode_ == Mode::kHit && !cacheable_[id] &&
+             hit_.load(std::memory_order_relaxed)) {
+    std::vector<ShapeRecord> current;
+    CollectOutputs(instr, &current);
+    auto& records = records_[id];
+    bool changed = current.size() != records.size();
+    for (size_t i = 0; !changed && i < current.size(); ++i) {
+      changed = current[i].dims != records[i].dims ||
+                current[i].lod != records[i].lod;
+    }
+    if (changed) {
+      VLOG(4) << "The output shapes of " << instr.OpBase()->Type()
+              << " changed, invalidate InferShapeCache";
+      hit_.store(false, std::memory_order_relaxed);
+    }
+  }
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
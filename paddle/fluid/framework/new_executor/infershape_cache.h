@@ -0,0 +1,95 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/framework/lod_tensor.h"
+#include "paddle/fluid/framework/new_executor/new_executor_defs.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+/*
+ * InferShapeCache skips the InferShape of ops when the feeds have the same
+ * shapes as a previous run, by reapplying the output dims and LoD recorded
+ * in that run.
+ *
+ * - The signature of a run is the dims and LoD of all feeds, plus the values
+ *   of small integer feeds since they may be used as shapes.
+ * - A run with a new signature records the output shapes of every op. The
+ *   following runs with the same signature use the records.
+ * - Ops whose output shapes may depend on data are never skipped: ops with
+ *   non LoDTensor inputs or outputs, ops taking shapes from tensors (the
+ *   *Tensor and *TensorList inputs), ops without kernel or computing shapes
+ *   in kernel, and ops whose kernel changes the shapes set by InferShape.
+ *   Their outputs are checked after running, and any difference invalidates
+ *   the cache for the ops depending on them, which run InferShape as usual.
+ *   The next run records again.
+ */
+class InferShapeCache {
+ public:
+  // Returns false if the program can not use the cache
+  bool Build(const std::vector<Instruction>& vec_instruction,
+             const VariableScope& var_scope);
+
+  // Decides whether this run records the shapes or uses the records
+  void BeforeRun(const std::vector<std::string>& feed_names,
+                 const VariableScope& var_scope);
+
+  void AfterRun(bool succeeded);
+
+  bool CanSkipInferShape(const Instruction& instr) const {
+    return mode_ == Mode::kHit && cacheable_[instr.Id()] &&
+           hit_.load(std::memory_order_relaxed);
+  }
+
+  // Sets the recorded dims and LoD of the outputs instead of InferShape
+  void Apply(const Instruction& instr) const;
+
+  // The following are called concurrently for different instructions
+  void AfterInferShape(const Instruction& instr);
+  void AfterCompute(const Instruction& instr);
+
+ private:
+  enum class Mode { kOff, kRecord, kHit };
+
+  struct ShapeRecord {
+    LoDTensor* tensor;
+    DDim dims;
+    LoD lod;
+  };
+
+  static void CollectOutputs(const Instruction& instr,
+                             std::vector<ShapeRecord>* records);
+
+  static constexpr int64_t kMaxShapeFeedNumel = 8;
+
+  Mode mode_{Mode::kOff};
+  bool ready_{false};
+  std::vector<int64_t> signature_;
+  std::vector<char> cacheable_;
+  std::vector<std::vector<ShapeRecord>> records_;
+  // dims set by InferShape in the recording run
+  std::vector<std::vector<DDim>> infershape_dims_;
+  std::atomic<bool> hit_{false};
+};
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
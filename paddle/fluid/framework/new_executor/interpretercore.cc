@@ -13,9 +13,12 @@
 // limitations under the License.
 
 #include "paddle/fluid/framework/new_executor/interpretercore.h"
+#include <algorithm>
+#include <chrono>  // NOLINT
 #include <unordered_set>
 #include "paddle/fluid/framework/details/nan_inf_utils.h"
 #include "paddle/fluid/framework/details/share_tensor_buffer_functor.h"
+#include "paddle/fluid/framework/new_executor/elementwise_fusion.h"
 #include "paddle/fluid/framework/new_executor/garbage_collector/event_garbage_collector.h"
 #include "paddle/fluid/framework/new_executor/garbage_collector/fast_garbage_collector.h"
 #include "paddle/fluid/framework/new_executor/interpretercore_util.h"
@@ -31,6 +34,22 @@ PADDLE_DEFINE_EXPORTED_bool(new_executor_use_inplace, true,
 PADDLE_DEFINE_EXPORTED_bool(new_executor_use_local_scope, true,
                             "Use local_scope in new executor(especially used "
                             "in UT), can turn off for better performance");
+PADDLE_DEFINE_EXPORTED_bool(new_executor_static_memory_plan, false,
+                            "Serve the intermediate tensors of programs with "
+                            "static shapes from one planned arena in new "
+                            "executor, only for CPUPlace now");
+PADDLE_DEFINE_EXPORTED_bool(new_executor_cache_infershape, false,
+                            "Skip InferShape of ops in new executor when the "
+                            "feeds have the same shapes as a previous run");
+PADDLE_DEFINE_EXPORTED_bool(new_executor_critical_path_schedule, false,
+                            "Dispatch the ready ops on the longest remaining "
+                            "path first in new executor");
+PADDLE_DEFINE_EXPORTED_bool(new_executor_profile_priority, false,
+                            "Profile the first run to refine the priorities "
+                            "of critical path scheduling in new executor");
+PADDLE_DEFINE_EXPORTED_bool(new_executor_fuse_elementwise, false,
+                            "Fuse the chains of elementwise and activation "
+                            "ops on CPU into single ops in new executor");
 
 DECLARE_bool(check_nan_inf);
 DECLARE_bool(benchmark);
@@ -121,6 +140,9 @@ paddle::framework::FetchList InterpreterCore::Run(
   Prepare(feed_names, feed_tensors, is_build);
 
   if (is_build) {
+    if (infershape_cache_) {
+      infershape_cache_->BeforeRun(feed_names, *global_scope_);
+    }
     ExecuteInstructionList(vec_instruction_);
   }
 
@@ -162,6 +184,9 @@ paddle::framework::FetchList InterpreterCore::Run(
     Convert(&op_func_nodes);
 
   } else {
+    if (infershape_cache_) {
+      infershape_cache_->BeforeRun(feed_names, *global_scope_);
+    }
     ExecuteInstructionList(vec_instruction_);
   }
 
@@ -206,6 +231,9 @@ void InterpreterCore::BuildOperatorDependences() {
 
 void InterpreterCore::Convert(
     std::vector<paddle::framework::OpFuncNode>* op_func_nodes) {
+  if (FLAGS_new_executor_fuse_elementwise) {
+    interpreter::FuseElementwiseOps(op_func_nodes, global_scope_);
+  }
   auto& vec_meta_info = global_scope_->MutableVecMetaInfo();
   auto var_nums = global_scope_->VarSize();
   input_var2op_info_.resize(var_nums);
@@ -296,6 +324,11 @@ void InterpreterCore::Convert(
 
   BuildSkipShareLoDInfo();
 
+  if (FLAGS_new_executor_critical_path_schedule) {
+    BuildInstructionPriority(EstimateInstructionCost());
+    profile_priority_ = FLAGS_new_executor_profile_priority;
+  }
+
   for (size_t i = 0; i < vec_instruction_.size(); ++i) {
     gc_event_.emplace_back(vec_instruction_[i].DeviceContext().GetPlace(),
                            platform::GenerateDeviceEventFlag());
@@ -313,11 +346,103 @@ void InterpreterCore::Convert(
     BuildInplace();
   }
 
+  if (FLAGS_new_executor_static_memory_plan) {
+    memory_planner_ =
+        std::make_unique<interpreter::StaticMemoryPlanner>(place_);
+    if (!memory_planner_->Build(vec_instruction_, global_scope_)) {
+      memory_planner_.reset();
+    }
+  }
+
+  if (FLAGS_new_executor_cache_infershape) {
+    infershape_cache_ = std::make_unique<interpreter::InferShapeCache>();
+    if (!infershape_cache_->Build(vec_instruction_, *global_scope_)) {
+      infershape_cache_.reset();
+    }
+  }
+
   // prepare for the first time.
   async_work_queue_->PrepareAtomicDeps(dependecy_count_);
   async_work_queue_->PrepareAtomicVarRef(vec_meta_info);
 }
 
+// Estimates the cost of every instruction by the number of elements it
+// reads and writes, weighted by op type, plus a launch overhead.
+std::vector<double> InterpreterCore::EstimateInstructionCost() const {
+  // in number of elements
+  static constexpr double kOpLaunchCost = 1000;
+  static const std::unordered_set<std::string> kComputeIntensiveOps = {
+      "mul",        "matmul",      "matmul_v2",        "fc",
+      "conv2d",     "conv3d",      "depthwise_conv2d", "conv2d_transpose",
+      "lstm",       "gru",         "fusion_lstm",      "fusion_gru",
+      "multihead_matmul"};
+  static constexpr double kComputeIntensiveFactor = 16;
+
+  std::vector<double> costs(vec_instruction_.size(), kOpLaunchCost);
+  for (size_t i = 0; i < vec_instruction_.size(); ++i) {
+    auto& instr = vec_instruction_[i];
+    double elements = 0;
+    auto runtime_ctx = instr.InnerRuntimeContext();
+    for (auto* var_map : {&runtime_ctx->inputs, &runtime_ctx->outputs}) {
+      for (auto& item : *var_map) {
+        for (auto* var : item.second) {
+          if (var != nullptr && var->IsType<LoDTensor>()) {
+            auto& dims = var->Get<LoDTensor>().dims();
+            if (dims.size() > 0) {
+              elements += std::max<int64_t>(phi::product(dims), 0);
+            }
+          }
+        }
+      }
+    }
+    std::string type = instr.OpBase()->Type();
+    if (type.size() > 5 && type.compare(type.size() - 5, 5, "_grad") == 0) {
+      type = type.substr(0, type.size() - 5);
+    }
+    if (kComputeIntensiveOps.count(type)) {
+      elements *= kComputeIntensiveFactor;
+    }
+    costs[i] += elements;
+  }
+  return costs;
+}
+
+// The priority of an instruction is its bottom level, i.e. the cost of the
+// longest path from it to the end of the program.
+void InterpreterCore::BuildInstructionPriority(
+    const std::vector<double>& costs) {
+  instr_priority_.assign(vec_instruction_.size(), 0);
+  double max_priority = 0;
+  for (size_t i = vec_instruction_.size(); i > 0; --i) {
+    size_t id = i - 1;
+    auto& next_instr = vec_instruction_[id].NextInstructions();
+    double max_next = 0;
+    for (auto* next_ids : {&next_instr.DirectRunIds(),
+                           &next_instr.EventRunIds(),
+                           &next_instr.SyncRunIds()}) {
+      for (auto next_id : *next_ids) {
+        // downstream instructions always come later
+        if (next_id > id) {
+          max_next = std::max(max_next, instr_priority_[next_id]);
+        }
+      }
+    }
+    instr_priority_[id] = costs[id] + max_next;
+    max_priority = std::max(max_priority, instr_priority_[id]);
+  }
+  VLOG(4) << "The critical path costs " << max_priority;
+}
+
+void InterpreterCore::SortByPriority(std::vector<size_t>* instr_ids) const {
+  if (instr_priority_.empty() || instr_ids->size() < 2) {
+    return;
+  }
+  std::stable_sort(instr_ids->begin(), instr_ids->end(),
+                   [this](size_t a, size_t b) {
+                     return instr_priority_[a] > instr_priority_[b];
+                   });
+}
+
 bool InterpreterCore::BuildInplaceCheckVarIsOnlyInput(size_t var_index) {
   if (!global_scope_->VarDesc(var_index)) {
     return input_var2op_info_.at(var_index).size() == 1;
@@ -439,11 +564,19 @@ void InterpreterCore::RunInstruction(const Instruction& instr_node) {
           "infer_shape", platform::TracerEventType::OperatorInner, 1,
           platform::EventRole::kInnerOp);
 
-      // see OperatorWithKernel::RunImpl in operator.cc for why
-      if (!(op_with_kernel->HasAttr(kAllKernelsMustComputeRuntimeShape) &&
-            op_with_kernel->Attr<bool>(kAllKernelsMustComputeRuntimeShape))) {
+      if (infershape_cache_ &&
+          infershape_cache_->CanSkipInferShape(instr_node)) {
+        infershape_cache_->Apply(instr_node);
+      } else if (!(op_with_kernel->HasAttr(
+                       kAllKernelsMustComputeRuntimeShape) &&
+                   op_with_kernel->Attr<bool>(
+                       kAllKernelsMustComputeRuntimeShape))) {
+        // see OperatorWithKernel::RunImpl in operator.cc for why
         op_with_kernel->Info().infer_shape_(
             instr_node.InnerInferShapeContext().get());
+        if (infershape_cache_) {
+          infershape_cache_->AfterInferShape(instr_node);
+        }
       }
     }
   }
@@ -488,6 +621,10 @@ void InterpreterCore::RunInstruction(const Instruction& instr_node) {
 
   VLOG(4) << "End run " << place << " " << op->DebugStringEx(global_scope_);
 
+  if (infershape_cache_) {
+    infershape_cache_->AfterCompute(instr_node);
+  }
+
   if (!instr_node.InplaceBackMap().empty()) {
     platform::RecordEvent inplaceback_event(
         "InplaceVarsBack", platform::TracerEventType::UserDefined, 10);
@@ -545,14 +682,28 @@ void InterpreterCore::ExecuteInstructionList(
 
   exception_holder_.Clear();
 
+  if (UNLIKELY(profile_priority_)) {
+    instr_cost_ns_.assign(vec_instr.size(), 0);
+  }
+
+  if (memory_planner_) {
+    memory_planner_->BeforeRun();
+  }
+
+  std::vector<size_t> first_ops;
   for (size_t i = 0; i < dependecy_count_.size(); ++i) {
     if (dependecy_count_[i] == 0) {
-      async_work_queue_->AddTask(vec_instr.at(i).KernelType(), [
-        this, i, atomic_deps = atomic_deps.get(),
-        atomic_var_ref = atomic_var_ref.get()
-      ] { RunInstructionAsync(i, atomic_deps, atomic_var_ref); });
+      first_ops.push_back(i);
     }
   }
+  // tasks added by the main thread are queued in order
+  SortByPriority(&first_ops);
+  for (auto i : first_ops) {
+    async_work_queue_->AddTask(vec_instr.at(i).KernelType(), [
+      this, i, atomic_deps = atomic_deps.get(),
+      atomic_var_ref = atomic_var_ref.get()
+    ] { RunInstructionAsync(i, atomic_deps, atomic_var_ref); });
+  }
 
   auto event_name = main_thread_blocker_.WaitEvent();
   VLOG(1) << "event_name: " << event_name;
@@ -570,8 +721,29 @@ void InterpreterCore::ExecuteInstructionList(
         platform::errors::PreconditionNotMet(
             "main_thread_blocker_.Clear() return -1, clear failed"));
     VLOG(4) << "clear ok";
+    if (infershape_cache_) {
+      infershape_cache_->AfterRun(false);
+    }
     exception_holder_.ReThrow();
   }
+
+  if (infershape_cache_) {
+    infershape_cache_->AfterRun(true);
+  }
+
+  if (UNLIKELY(profile_priority_)) {
+    std::vector<double> costs(instr_cost_ns_.begin(), instr_cost_ns_.end());
+    BuildInstructionPriority(costs);
+    profile_priority_ = false;
+    VLOG(4) << "Rebuild the instruction priority from the profiled run";
+  }
+
+  if (memory_planner_) {
+    memory_planner_->AfterRun();
+    if (!memory_planner_->IsEnabled()) {
+      memory_planner_.reset();
+    }
+  }
 }
 
 void InterpreterCore::RunNextInstructions(
@@ -589,58 +761,58 @@ void InterpreterCore::RunNextInstructions(
     return (*atomic_deps)[next_id].fetch_sub(1, std::memory_order_relaxed) == 1;
   };
 
-  if (instr.KernelType() == OpFuncType::kQueueAsync) {
-    // move all sync_ops into other threads
-    for (auto next_id : next_instr.SyncRunIds()) {
+  auto AddTask = [this, atomic_deps, atomic_var_ref](size_t next_id) {
+    async_work_queue_->AddTask(
+        vec_instruction_[next_id].KernelType(),
+        [this, next_id, atomic_deps, atomic_var_ref] {
+          RunInstructionAsync(next_id, atomic_deps, atomic_var_ref);
+        });
+  };
+  auto ReadyIds = [&IsReady, this](const std::vector<size_t>& next_ids) {
+    std::vector<size_t> ready_ids;
+    for (auto next_id : next_ids) {
       if (IsReady(next_id)) {
-        async_work_queue_->AddTask(
-            vec_instruction_[next_id].KernelType(),
-            [this, next_id, atomic_deps, atomic_var_ref]() {
-              RunInstructionAsync(next_id, atomic_deps, atomic_var_ref);
-            });
+        ready_ids.push_back(next_id);
       }
     }
+    SortByPriority(&ready_ids);
+    return ready_ids;
+  };
+
+  if (instr.KernelType() == OpFuncType::kQueueAsync) {
+    // move all sync_ops into other threads
+    for (auto next_id : ReadyIds(next_instr.SyncRunIds())) {
+      AddTask(next_id);
+    }
     // keep all async_ops running in current thread
-    for (auto next_id : next_instr.DirectRunIds()) {
-      if (IsReady(next_id)) {
-        reserved_next_ops->push(next_id);
-      }
+    for (auto next_id : ReadyIds(next_instr.DirectRunIds())) {
+      reserved_next_ops->push(next_id);
     }
-    for (auto next_id : next_instr.EventRunIds()) {
-      if (IsReady(next_id)) {
-        reserved_next_ops->push(next_id);
-      }
+    for (auto next_id : ReadyIds(next_instr.EventRunIds())) {
+      reserved_next_ops->push(next_id);
     }
   } else {
     // move async_ops into async_thread
-    for (auto next_id : next_instr.EventRunIds()) {
-      if (IsReady(next_id)) {
-        async_work_queue_->AddTask(
-            vec_instruction_[next_id].KernelType(),
-            [this, next_id, atomic_deps, atomic_var_ref] {
-              RunInstructionAsync(next_id, atomic_deps, atomic_var_ref);
-            });
-      }
+    for (auto next_id : ReadyIds(next_instr.EventRunIds())) {
+      AddTask(next_id);
     }
-    auto direct_run_ops = interpreter::merge_vector(next_instr.SyncRunIds(),
-                                                    next_instr.DirectRunIds());
-    size_t first_op = 0;
-    for (auto next_id : direct_run_ops) {
-      if (IsReady(next_id)) {
-        // only keep one op running in current thread
-        if (first_op == 0) {
-          first_op = next_id;
-          continue;
-        }
-        // move rest ops into other threads
-        async_work_queue_->AddTask(
-            vec_instruction_[next_id].KernelType(),
-            [this, next_id, atomic_deps, atomic_var_ref] {
-              RunInstructionAsync(next_id, atomic_deps, atomic_var_ref);
-            });
+    auto direct_run_ops = ReadyIds(interpreter::merge_vector(
+        next_instr.SyncRunIds(), next_instr.DirectRunIds()));
+    if (!direct_run_ops.empty()) {
+      // only keep one op running in current thread
+      reserved_next_ops->push(direct_run_ops.front());
+      // move rest ops into other threads. The tasks added by a worker are
+      // popped from the front of its own queue, so add them from the lowest
+      // priority when scheduling by priority.
+      std::vector<size_t> rest_ops(direct_run_ops.begin() + 1,
+                                   direct_run_ops.end());
+      if (!instr_priority_.empty()) {
+        std::reverse(rest_ops.begin(), rest_ops.end());
+      }
+      for (auto next_id : rest_ops) {
+        AddTask(next_id);
       }
     }
-    if (first_op != 0) reserved_next_ops->push(first_op);
   }
 }
 
@@ -667,7 +839,20 @@ void InterpreterCore::RunInstructionAsync(
     try {
       interpreter::WaitEvent(instr_node, place_);
 
-      RunInstruction(instr_node);
+      if (UNLIKELY(profile_priority_)) {
+        auto start = std::chrono::steady_clock::now();
+        RunInstruction(instr_node);
+        instr_cost_ns_[instr_id] =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+      } else {
+        RunInstruction(instr_node);
+      }
+
+      if (memory_planner_) {
+        memory_planner_->AfterInstruction(instr_node);
+      }
 
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
       RecordStreamForGC(instr_node);
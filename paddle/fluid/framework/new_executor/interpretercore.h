@@ -22,7 +22,9 @@
 #include "paddle/fluid/framework/details/exception_holder.h"
 #include "paddle/fluid/framework/new_executor/event_manager.h"
 #include "paddle/fluid/framework/new_executor/garbage_collector/garbage_collector.h"
+#include "paddle/fluid/framework/new_executor/infershape_cache.h"
 #include "paddle/fluid/framework/new_executor/interpretercore_util.h"
+#include "paddle/fluid/framework/new_executor/memory_planner.h"
 #include "paddle/fluid/framework/new_executor/new_executor_defs.h"
 #include "paddle/fluid/framework/new_executor/profiler.h"
 #include "paddle/fluid/framework/new_executor/stream_analyzer.h"
@@ -91,6 +93,12 @@ class InterpreterCore {
 
   void BuildOperatorDependences();
 
+  std::vector<double> EstimateInstructionCost() const;
+
+  void BuildInstructionPriority(const std::vector<double>& costs);
+
+  void SortByPriority(std::vector<size_t>* instr_ids) const;
+
   void SetFeedVarsInplaceSkip(const std::vector<std::string>& feed_names);
 
   void ClearLoDTensorArrayInLocalScope();
@@ -122,8 +130,22 @@ class InterpreterCore {
 
   std::unique_ptr<InterpreterCoreGarbageCollector> gc_;
   std::vector<paddle::platform::DeviceEvent> gc_event_;
+  std::unique_ptr<interpreter::StaticMemoryPlanner> memory_planner_;
+  std::unique_ptr<interpreter::InferShapeCache> infershape_cache_;
+
+  // for critical path scheduling, the bottom level cost of every
+  // instruction, empty if disabled
+  std::vector<double> instr_priority_;
+  // whether to profile the next run to rebuild instr_priority_
+  bool profile_priority_{false};
+  std::vector<uint64_t> instr_cost_ns_;
   bool create_local_scope_{true};
   Scope* local_scope_{nullptr};  // not owned
+
+#if PADDLE_WITH_TESTING
+  friend class CriticalPathScheduleTest;
+  friend class StaticMemoryPlanTest;
+#endif
 };
 }  // namespace framework
 }  // namespace paddle
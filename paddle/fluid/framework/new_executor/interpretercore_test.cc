@@ -0,0 +1,532 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/interpretercore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/framework/program_desc.h"
+
+DECLARE_bool(new_executor_cache_infershape);
+DECLARE_bool(new_executor_critical_path_schedule);
+DECLARE_bool(new_executor_static_memory_plan);
+
+namespace paddle {
+namespace framework {
+
+// counts the InferShape calls of trace_test
+static std::atomic<int> g_infer_shape_num{0};
+
+// the outputs computed by trace_test in every thread, in order
+static std::mutex g_trace_mutex;
+static std::map<std::thread::id, std::vector<std::string>> g_trace;
+// the buffer written by trace_test for every output in the last run
+static std::map<std::string, const void*> g_out_data;
+
+// Out = X * 2, with the dims and LoD of X
+class TraceOp : public OperatorWithKernel {
+ public:
+  using OperatorWithKernel::OperatorWithKernel;
+
+  void InferShape(InferShapeContext* ctx) const override {
+    ++g_infer_shape_num;
+    ctx->SetOutputDim("Out", ctx->GetInputDim("X"));
+    ctx->ShareLoD("X", "Out");
+  }
+
+ protected:
+  OpKernelType GetExpectedKernelType(
+      const ExecutionContext& ctx) const override {
+    return OpKernelType(proto::VarType::FP32, ctx.GetPlace());
+  }
+};
+
+class TraceOpMaker : public OpProtoAndCheckerMaker {
+ public:
+  void Make() override {
+    AddInput("X", "input");
+    AddOutput("Out", "output");
+    AddComment(
+        "Op counting its InferShape calls and recording its runs, only for "
+        "test.");
+  }
+};
+
+template <typename T>
+class TraceKernel : public OpKernel<T> {
+ public:
+  void Compute(const ExecutionContext& ctx) const override {
+    auto* x = ctx.Input<LoDTensor>("X");
+    auto* out = ctx.Output<LoDTensor>("Out");
+    // the dims and LoD come from InferShape or InferShapeCache
+    PADDLE_ENFORCE_EQ(out->dims(), x->dims(),
+                      platform::errors::InvalidArgument(
+                          "The output dims are not inferred correctly."));
+    PADDLE_ENFORCE_EQ(out->lod(), x->lod(),
+                      platform::errors::InvalidArgument(
+                          "The output LoD is not inferred correctly."));
+    const T* x_data = x->data<T>();
+    T* out_data = out->mutable_data<T>(ctx.GetPlace());
+    for (int64_t i = 0; i < x->numel(); ++i) {
+      out_data[i] = x_data[i] * 2;
+    }
+    std::lock_guard<std::mutex> guard(g_trace_mutex);
+    g_trace[std::this_thread::get_id()].push_back(ctx.OutputName("Out"));
+    g_out_data[ctx.OutputName("Out")] = out_data;
+  }
+};
+
+// Out shares the buffer of X
+class AliasOp : public OperatorWithKernel {
+ public:
+  using OperatorWithKernel::OperatorWithKernel;
+
+  void InferShape(InferShapeContext* ctx) const override {
+    ctx->SetOutputDim("Out", ctx->GetInputDim("X"));
+    ctx->ShareLoD("X", "Out");
+  }
+
+ protected:
+  OpKernelType GetExpectedKernelType(
+      const ExecutionContext& ctx) const override {
+    return OpKernelType(proto::VarType::FP32, ctx.GetPlace());
+  }
+};
+
+class AliasOpMaker : public OpProtoAndCheckerMaker {
+ public:
+  void Make() override {
+    AddInput("X", "input");
+    AddOutput("Out", "output");
+    AddComment("Op sharing the buffer of its input, only for test.");
+  }
+};
+
+template <typename T>
+class AliasKernel : public OpKernel<T> {
+ public:
+  void Compute(const ExecutionContext& ctx) const override {
+    ctx.Output<LoDTensor>("Out")->ShareDataWith(*ctx.Input<LoDTensor>("X"));
+  }
+};
+
+}  // namespace framework
+}  // namespace paddle
+
+REGISTER_OPERATOR(trace_test, paddle::framework::TraceOp,
+                  paddle::framework::TraceOpMaker);
+REGISTER_OP_CPU_KERNEL(trace_test, paddle::framework::TraceKernel<float>);
+REGISTER_OPERATOR(alias_test, paddle::framework::AliasOp,
+                  paddle::framework::AliasOpMaker);
+REGISTER_OP_CPU_KERNEL(alias_test, paddle::framework::AliasKernel<float>);
+
+namespace paddle {
+namespace framework {
+
+static void AddTensorVar(BlockDesc* block, const std::string& name,
+                         bool persistable = false) {
+  auto* var = block->Var(name);
+  var->SetType(proto::VarType::LOD_TENSOR);
+  var->SetDataType(proto::VarType::FP32);
+  var->SetPersistable(persistable);
+}
+
+// Run returns the fetch list even without fetch ops
+static void AddFetchHolder(BlockDesc* block) {
+  auto* fetch_holder = block->Var(interpreter::kFetchVarName);
+  fetch_holder->SetType(proto::VarType::FETCH_LIST);
+  fetch_holder->SetPersistable(true);
+}
+
+static void AddTraceOp(BlockDesc* block, const std::string& x,
+                       const std::string& out,
+                       const std::string& type = "trace_test") {
+  auto* op = block->AppendOp();
+  op->SetType(type);
+  op->SetInput("X", {x});
+  op->SetOutput("Out", {out});
+}
+
+static LoDTensor MakeFeed(const std::vector<int64_t>& shape,
+                          const LoD& lod = {}) {
+  LoDTensor tensor;
+  tensor.Resize(phi::make_ddim(shape));
+  tensor.set_lod(lod);
+  float* data = tensor.mutable_data<float>(platform::CPUPlace());
+  for (int64_t i = 0; i < tensor.numel(); ++i) {
+    data[i] = static_cast<float>(i);
+  }
+  return tensor;
+}
+
+// x -> y -> z, z = x * 4
+class InferShapeCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FLAGS_new_executor_cache_infershape = true;
+    auto* block = program_.MutableBlock(0);
+    AddTensorVar(block, "x");
+    AddTensorVar(block, "y");
+    AddTensorVar(block, "z", true);
+    AddFetchHolder(block);
+    AddTraceOp(block, "x", "y");
+    AddTraceOp(block, "y", "z");
+    var_scope_ = std::make_unique<VariableScope>(&scope_);
+    core_ = std::make_unique<InterpreterCore>(
+        place_, program_.Block(0), var_scope_.get());
+  }
+
+  void TearDown() override { FLAGS_new_executor_cache_infershape = false; }
+
+  // Returns the number of InferShape calls in this run
+  int Run(const LoDTensor& x) {
+    int begin = g_infer_shape_num;
+    core_->Run({"x"}, {x});
+    auto& z = scope_.FindVar("z")->Get<LoDTensor>();
+    EXPECT_EQ(z.dims(), x.dims());
+    EXPECT_EQ(z.lod(), x.lod());
+    for (int64_t i = 0; i < x.numel(); ++i) {
+      EXPECT_FLOAT_EQ(z.data<float>()[i], x.data<float>()[i] * 4);
+    }
+    return g_infer_shape_num - begin;
+  }
+
+  platform::CPUPlace place_;
+  ProgramDesc program_;
+  Scope scope_;
+  std::unique_ptr<VariableScope> var_scope_;
+  std::unique_ptr<InterpreterCore> core_;
+};
+
+TEST_F(InferShapeCacheTest, skip_repeated_shape) {
+  auto x = MakeFeed({4, 8});
+  // the build run and the recording run infer the shapes
+  ASSERT_EQ(Run(x), 2);
+  ASSERT_EQ(Run(x), 2);
+  ASSERT_EQ(Run(x), 0);
+  ASSERT_EQ(Run(MakeFeed({4, 8})), 0);
+}
+
+TEST_F(InferShapeCacheTest, reinfer_changed_shape) {
+  Run(MakeFeed({4, 8}));
+  Run(MakeFeed({4, 8}));
+  ASSERT_EQ(Run(MakeFeed({4, 8})), 0);
+  // a new shape is recorded, then hits
+  ASSERT_EQ(Run(MakeFeed({6, 8})), 2);
+  ASSERT_EQ(Run(MakeFeed({6, 8})), 0);
+  // the old shape is not remembered
+  ASSERT_EQ(Run(MakeFeed({4, 8})), 2);
+}
+
+TEST_F(InferShapeCacheTest, reinfer_changed_lod) {
+  Run(MakeFeed({6, 8}, {{0, 2, 6}}));
+  Run(MakeFeed({6, 8}, {{0, 2, 6}}));
+  ASSERT_EQ(Run(MakeFeed({6, 8}, {{0, 2, 6}})), 0);
+  // same dims with another LoD
+  ASSERT_EQ(Run(MakeFeed({6, 8}, {{0, 3, 6}})), 2);
+  ASSERT_EQ(Run(MakeFeed({6, 8}, {{0, 3, 6}})), 0);
+  ASSERT_EQ(Run(MakeFeed({6, 8})), 2);
+}
+
+// h -> b and h -> a1 -> a2 -> a3. b comes first in the program, but a1 is on
+// the critical path.
+class CriticalPathScheduleTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    auto* block = program_.MutableBlock(0);
+    for (auto name : {"x", "h", "a1", "a2"}) {
+      AddTensorVar(block, name);
+    }
+    AddTensorVar(block, "b", true);
+    AddTensorVar(block, "a3", true);
+    AddFetchHolder(block);
+    AddTraceOp(block, "x", "h");
+    AddTraceOp(block, "h", "b");
+    AddTraceOp(block, "h", "a1");
+    AddTraceOp(block, "a1", "a2");
+    AddTraceOp(block, "a2", "a3");
+  }
+
+  void TearDown() override {
+    FLAGS_new_executor_critical_path_schedule = false;
+  }
+
+  // Runs the program twice with a new InterpreterCore. The first run builds
+  // it, and the second one is traced.
+  void Run(bool critical_path) {
+    FLAGS_new_executor_critical_path_schedule = critical_path;
+    core_.reset();
+    scope_ = std::make_unique<Scope>();
+    var_scope_ = std::make_unique<VariableScope>(scope_.get());
+    core_ = std::make_unique<InterpreterCore>(place_, program_.Block(0),
+                                              var_scope_.get());
+    auto x = MakeFeed({4, 8});
+    core_->Run({"x"}, {x});
+    {
+      std::lock_guard<std::mutex> guard(g_trace_mutex);
+      g_trace.clear();
+    }
+    core_->Run({"x"}, {x});
+  }
+
+  std::vector<float> Output(const std::string& name) const {
+    auto& tensor = scope_->FindVar(name)->Get<LoDTensor>();
+    return std::vector<float>(tensor.data<float>(),
+                              tensor.data<float>() + tensor.numel());
+  }
+
+  // The outputs computed by the thread computing the given one
+  std::vector<std::string> TraceOf(const std::string& name) const {
+    std::lock_guard<std::mutex> guard(g_trace_mutex);
+    for (auto& item : g_trace) {
+      auto& outputs = item.second;
+      if (std::find(outputs.begin(), outputs.end(), name) != outputs.end()) {
+        return outputs;
+      }
+    }
+    return {};
+  }
+
+  std::vector<double> Costs() const { return core_->EstimateInstructionCost(); }
+
+  const std::vector<double>& Priority() const { return core_->instr_priority_; }
+
+  std::vector<size_t> SortByPriority(std::vector<size_t> instr_ids) const {
+    core_->SortByPriority(&instr_ids);
+    return instr_ids;
+  }
+
+  platform::CPUPlace place_;
+  ProgramDesc program_;
+  std::unique_ptr<Scope> scope_;
+  std::unique_ptr<VariableScope> var_scope_;
+  std::unique_ptr<InterpreterCore> core_;
+};
+
+TEST_F(CriticalPathScheduleTest, build_priority) {
+  Run(true);
+  auto costs = Costs();
+  auto& priority = Priority();
+  ASSERT_EQ(priority.size(), 5UL);
+  // all ops read and write tensors of the same size
+  for (auto cost : costs) {
+    ASSERT_DOUBLE_EQ(cost, costs[0]);
+  }
+  // the priority is the cost of the longest path to the end
+  EXPECT_DOUBLE_EQ(priority[0], 4 * costs[0]);
+  EXPECT_DOUBLE_EQ(priority[1], costs[0]);
+  EXPECT_DOUBLE_EQ(priority[2], 3 * costs[0]);
+  EXPECT_DOUBLE_EQ(priority[3], 2 * costs[0]);
+  EXPECT_DOUBLE_EQ(priority[4], costs[0]);
+  // ties keep the program order
+  EXPECT_EQ(SortByPriority({0, 1, 2, 3, 4}),
+            std::vector<size_t>({0, 2, 3, 1, 4}));
+  EXPECT_EQ(SortByPriority({1, 2}), std::vector<size_t>({2, 1}));
+}
+
+TEST_F(CriticalPathScheduleTest, run_critical_path_first) {
+  Run(true);
+  // RunNextInstructions keeps the ready op of the highest priority in the
+  // current thread, so the critical path runs right after h
+  auto trace = TraceOf("h");
+  ASSERT_GE(trace.size(), 4UL);
+  EXPECT_EQ(std::vector<std::string>(trace.begin(), trace.begin() + 4),
+            std::vector<std::string>({"h", "a1", "a2", "a3"}));
+}
+
+TEST_F(CriticalPathScheduleTest, same_results_as_default_schedule) {
+  Run(false);
+  ASSERT_TRUE(Priority().empty());
+  auto b = Output("b");
+  auto a3 = Output("a3");
+
+  Run(true);
+  ASSERT_FALSE(Priority().empty());
+  EXPECT_EQ(Output("b"), b);
+  EXPECT_EQ(Output("a3"), a3);
+  auto x = MakeFeed({4, 8});
+  for (int64_t i = 0; i < x.numel(); ++i) {
+    EXPECT_FLOAT_EQ(a3[i], x.data<float>()[i] * 16);
+    EXPECT_FLOAT_EQ(b[i], x.data<float>()[i] * 4);
+  }
+}
+
+// x -> y1 -> y2 -> y3 -> z, y1 and y3 can share memory. x -> y1 -> a
+// additionally makes the persistable a share the buffer of y1.
+class StaticMemoryPlanTest : public ::testing::Test {
+ protected:
+  void TearDown() override { FLAGS_new_executor_static_memory_plan = false; }
+
+  // Builds a new InterpreterCore with a new scope
+  void Build(bool static_memory_plan, bool with_alias) {
+    FLAGS_new_executor_static_memory_plan = static_memory_plan;
+    core_.reset();
+    program_ = std::make_unique<ProgramDesc>();
+    scope_ = std::make_unique<Scope>();
+    auto* block = program_->MutableBlock(0);
+    for (auto name : {"x", "y1", "y2", "y3"}) {
+      AddTensorVar(block, name);
+    }
+    AddTensorVar(block, "z", true);
+    AddFetchHolder(block);
+    AddTraceOp(block, "x", "y1");
+    if (with_alias) {
+      AddTensorVar(block, "a", true);
+      AddTraceOp(block, "y1", "a", "alias_test");
+      AddTraceOp(block, "a", "y2");
+    } else {
+      AddTraceOp(block, "y1", "y2");
+    }
+    AddTraceOp(block, "y2", "y3");
+    AddTraceOp(block, "y3", "z");
+    var_scope_ = std::make_unique<VariableScope>(scope_.get());
+    core_ = std::make_unique<InterpreterCore>(place_, program_->Block(0),
+                                              var_scope_.get());
+  }
+
+  std::vector<float> Output(const std::string& name) const {
+    auto& tensor = scope_->FindVar(name)->Get<LoDTensor>();
+    return std::vector<float>(tensor.data<float>(),
+                              tensor.data<float>() + tensor.numel());
+  }
+
+  // Runs and checks z = x * 16
+  void Run(const LoDTensor& x) {
+    core_->Run({"x"}, {x});
+    auto& z = scope_->FindVar("z")->Get<LoDTensor>();
+    ASSERT_EQ(z.dims(), x.dims());
+    for (int64_t i = 0; i < x.numel(); ++i) {
+      ASSERT_FLOAT_EQ(z.data<float>()[i], x.data<float>()[i] * 16);
+    }
+  }
+
+  const interpreter::StaticMemoryPlanner* Planner() const {
+    return core_->memory_planner_.get();
+  }
+
+  // Whether trace_test wrote the output into the arena in the last run
+  bool InArena(const std::string& name) const {
+    auto* begin = static_cast<const char*>(Planner()->Arena()->ptr());
+    auto* data = static_cast<const char*>(g_out_data.at(name));
+    return begin <= data && data < begin + Planner()->Arena()->size();
+  }
+
+  platform::CPUPlace place_;
+  std::unique_ptr<ProgramDesc> program_;
+  std::unique_ptr<Scope> scope_;
+  std::unique_ptr<VariableScope> var_scope_;
+  std::unique_ptr<InterpreterCore> core_;
+};
+
+TEST_F(StaticMemoryPlanTest, reuse_arena) {
+  Build(true, false);
+  auto x = MakeFeed({4, 8});
+  // the build run and the recording run
+  Run(x);
+  Run(x);
+  ASSERT_NE(Planner(), nullptr);
+  ASSERT_NE(Planner()->Arena(), nullptr);
+
+  const void* arena = Planner()->Arena()->ptr();
+  for (int i = 0; i < 3; ++i) {
+    Run(x);
+    ASSERT_NE(Planner(), nullptr);
+    EXPECT_EQ(Planner()->Arena()->ptr(), arena);
+    for (auto name : {"y1", "y2", "y3"}) {
+      EXPECT_TRUE(InArena(name)) << name;
+    }
+    // y1 is dead before y3 is written, so they share a slice
+    EXPECT_EQ(g_out_data.at("y1"), g_out_data.at("y3"));
+    EXPECT_NE(g_out_data.at("y1"), g_out_data.at("y2"));
+    EXPECT_FALSE(InArena("z"));
+  }
+  // a smaller shape still fits the plan
+  Run(MakeFeed({2, 8}));
+  Run(MakeFeed({2, 8}));
+  ASSERT_NE(Planner(), nullptr);
+  EXPECT_EQ(Planner()->Arena()->ptr(), arena);
+  EXPECT_TRUE(InArena("y2"));
+}
+
+TEST_F(StaticMemoryPlanTest, replan_on_growing_shape) {
+  Build(true, false);
+  Run(MakeFeed({4, 8}));
+  Run(MakeFeed({4, 8}));
+  Run(MakeFeed({4, 8}));
+  ASSERT_NE(Planner(), nullptr);
+  // the planned slices are too small, the run falls back to dynamic
+  // allocation and the next run records again
+  Run(MakeFeed({6, 8}));
+  ASSERT_NE(Planner(), nullptr);
+  Run(MakeFeed({6, 8}));
+  Run(MakeFeed({6, 8}));
+  ASSERT_NE(Planner(), nullptr);
+  EXPECT_TRUE(InArena("y2"));
+}
+
+TEST_F(StaticMemoryPlanTest, disable_on_changing_shapes) {
+  Build(true, false);
+  Run(MakeFeed({4, 8}));
+  // every planned run misses, the planner gives up after 3 replans
+  for (int64_t rows = 4; rows < 12; ++rows) {
+    Run(MakeFeed({rows, 8}));
+  }
+  EXPECT_EQ(Planner(), nullptr);
+  Run(MakeFeed({12, 8}));
+}
+
+TEST_F(StaticMemoryPlanTest, exclude_shared_with_persistable) {
+  Build(true, true);
+  auto x = MakeFeed({4, 8});
+  for (int i = 0; i < 4; ++i) {
+    Run(x);
+    // a shares the buffer of y1, so y1 is not planned and y3 never
+    // overwrites a
+    auto a = Output("a");
+    for (int64_t j = 0; j < x.numel(); ++j) {
+      ASSERT_FLOAT_EQ(a[j], x.data<float>()[j] * 2);
+    }
+  }
+  ASSERT_NE(Planner(), nullptr);
+  EXPECT_FALSE(InArena("y1"));
+  EXPECT_TRUE(InArena("y2"));
+}
+
+TEST_F(StaticMemoryPlanTest, same_results_as_dynamic_allocation) {
+  std::vector<std::vector<int64_t>> shapes = {
+      {4, 8}, {4, 8}, {4, 8}, {6, 8}, {6, 8}, {3, 8}, {6, 8}};
+  std::vector<std::vector<float>> outputs[2];
+  for (bool static_memory_plan : {false, true}) {
+    Build(static_memory_plan, true);
+    for (auto& shape : shapes) {
+      Run(MakeFeed(shape));
+      outputs[static_memory_plan].push_back(Output("z"));
+      outputs[static_memory_plan].push_back(Output("a"));
+    }
+  }
+  EXPECT_EQ(outputs[1], outputs[0]);
+}
+
+}  // namespace framework
+}  // namespace paddle
@@ -29,6 +29,11 @@ PADDLE_DEFINE_EXPORTED_bool(
     new_executor_sequential_run, false,
     "Enable sequential execution for standalone executor, used for debug");
 
+PADDLE_DEFINE_EXPORTED_bool(
+    new_executor_numa_aware_host_tasks, false,
+    "Spread the host threads of standalone executor over NUMA nodes and "
+    "prefer stealing tasks on the same node");
+
 DECLARE_bool(use_mkldnn);
 
 namespace paddle {
@@ -45,6 +45,8 @@
 #include "paddle/fluid/platform/device_context.h"
 #include "paddle/fluid/platform/init.h"
 
+DECLARE_bool(new_executor_numa_aware_host_tasks);
+
 namespace paddle {
 namespace framework {
 
@@ -66,6 +68,7 @@ class AsyncWorkQueue {
                                /*track_task*/ false,
                                /*detached*/ true,
                                /*events_waiter*/ waiter);
+    group_options.back().numa_aware = FLAGS_new_executor_numa_aware_host_tasks;
     // for launch device Kernel
     group_options.emplace_back(/*name*/ "DeviceKernelLaunch",
                                /*num_threads*/ deivce_num_threads,
@@ -0,0 +1,430 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/memory_planner.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <unordered_set>
+
+#include "paddle/fluid/framework/new_executor/interpretercore_util.h"
+#include "paddle/fluid/framework/operator.h"
+#include "paddle/fluid/memory/malloc.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+size_t GreedyBySizeOffsets(const std::vector<size_t>& sizes,
+                           const std::function<bool(size_t, size_t)>& conflict,
+                           size_t alignment, std::vector<size_t>* offsets) {
+  auto aligned_size = [alignment](size_t size) {
+    return (size + alignment - 1) / alignment * alignment;
+  };
+  std::vector<size_t> order(sizes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) {
+    return sizes[a] > sizes[b];
+  });
+
+  offsets->assign(sizes.size(), 0);
+  size_t total_size = 0;
+  std::vector<size_t> placed;
+  std::vector<std::pair<size_t, size_t>> busy;
+  for (auto i : order) {
+    size_t size = aligned_size(sizes[i]);
+    busy.clear();
+    for (auto j : placed) {
+      if (conflict(i, j)) {
+        busy.emplace_back((*offsets)[j],
+                          (*offsets)[j] + aligned_size(sizes[j]));
+      }
+    }
+    std::sort(busy.begin(), busy.end());
+
+    size_t best_offset = std::numeric_limits<size_t>::max();
+    size_t best_gap = std::numeric_limits<size_t>::max();
+    size_t prev_end = 0;
+    for (auto& range : busy) {
+      if (range.first > prev_end) {
+        size_t gap = range.first - prev_end;
+        if (gap >= size && gap < best_gap) {
+          best_offset = prev_end;
+          best_gap = gap;
+        }
+      }
+      prev_end = std::max(prev_end, range.second);
+    }
+    if (best_offset == std::numeric_limits<size_t>::max()) {
+      best_offset = prev_end;
+    }
+    (*offsets)[i] = best_offset;
+    total_size = std::max(total_size, best_offset + size);
+    placed.push_back(i);
+  }
+  return total_size;
+}
+
+// A slice of the arena, keeps the arena alive while any tensor holds it
+class ArenaSliceAllocation : public phi::Allocation {
+ public:
+  ArenaSliceAllocation(const std::shared_ptr<phi::Allocation>& arena,
+                       size_t offset, size_t size)
+      : phi::Allocation(static_cast<uint8_t*>(arena->ptr()) + offset, size,
+                        arena->place()),
+        arena_(arena) {}
+
+ private:
+  std::shared_ptr<phi::Allocation> arena_;
+};
+
+bool StaticMemoryPlanner::Build(const std::vector<Instruction>& vec_instruction,
+                                VariableScope* var_scope) {
+  var_scope_ = var_scope;
+  if (!platform::is_cpu_place(place_)) {
+    VLOG(3) << "StaticMemoryPlanner only supports CPUPlace, skip " << place_;
+    return false;
+  }
+  size_t op_num = vec_instruction.size();
+  if (op_num == 0 || op_num > kMaxOpNum) {
+    VLOG(3) << "StaticMemoryPlanner skips the program with " << op_num
+            << " ops";
+    return false;
+  }
+
+  size_t var_num = var_scope->VarSize();
+  std::vector<char> gc_vars(var_num, 0);
+  std::vector<char> unplannable(var_num, 0);
+  std::unordered_set<Variable*> inplace_vars;
+  var2candidate_.assign(var_num, -1);
+  auto& var2candidate = var2candidate_;
+  instr_outputs_.assign(op_num, {});
+
+  for (size_t i = 0; i < op_num; ++i) {
+    auto& instr = vec_instruction[i];
+    auto* op = instr.OpBase();
+    if (op->HasAttr("sub_block")) {
+      VLOG(3) << "StaticMemoryPlanner skips the program with control flow op "
+              << op->Type();
+      return false;
+    }
+    for (auto var_id : instr.GCCheckVars()) {
+      gc_vars[var_id] = 1;
+    }
+    for (auto& pair : instr.InplaceInfo()) {
+      inplace_vars.insert(pair.first);
+      inplace_vars.insert(pair.second);
+    }
+    for (auto& pair : instr.InplaceBackMap()) {
+      unplannable[pair.first] = 1;
+      unplannable[pair.second] = 1;
+    }
+    // the kernel of fetch_v2 may share the buffer to the fetch list, and the
+    // ops without kernel may create sub scopes or share buffers
+    if (dynamic_cast<const OperatorWithKernel*>(op) == nullptr ||
+        op->Type() == "fetch_v2") {
+      for (auto* vars : {&instr.Inputs(), &instr.Outputs()}) {
+        for (auto& item : *vars) {
+          for (auto var_id : item.second) {
+            unplannable[var_id] = 1;
+          }
+        }
+      }
+    }
+  }
+
+  auto IsCandidate = [&](int var_id) {
+    if (var_id == kEmptyVarIndex || !gc_vars[var_id] || unplannable[var_id]) {
+      return false;
+    }
+    auto* var_desc = var_scope->VarDesc(var_id);
+    if (var_desc && var_desc->Persistable()) {
+      return false;
+    }
+    auto* var = var_scope->Var(var_id);
+    return var != nullptr && var->IsType<LoDTensor>() &&
+           !var_scope->GetVarSikpInplace(var_id) && !inplace_vars.count(var);
+  };
+
+  for (size_t i = 0; i < op_num; ++i) {
+    auto& instr = vec_instruction[i];
+    for (auto& item : instr.Outputs()) {
+      for (auto var_id : item.second) {
+        if (!IsCandidate(var_id)) {
+          continue;
+        }
+        if (var2candidate[var_id] < 0) {
+          var2candidate[var_id] = candidates_.size();
+          candidates_.push_back(Candidate{var_id, {}, {}});
+        }
+        auto& candidate = candidates_[var2candidate[var_id]];
+        if (candidate.def_ops.empty() || candidate.def_ops.back() != i) {
+          candidate.def_ops.push_back(i);
+          instr_outputs_[i].push_back(var2candidate[var_id]);
+        }
+      }
+    }
+  }
+  if (candidates_.empty()) {
+    VLOG(3) << "StaticMemoryPlanner finds no variable to plan";
+    return false;
+  }
+  for (size_t i = 0; i < op_num; ++i) {
+    auto& instr = vec_instruction[i];
+    for (auto* vars : {&instr.Inputs(), &instr.Outputs()}) {
+      for (auto& item : *vars) {
+        for (auto var_id : item.second) {
+          int index = var2candidate[var_id];
+          if (index >= 0 && (candidates_[index].ops.empty() ||
+                             candidates_[index].ops.back() != i)) {
+            candidates_[index].ops.push_back(i);
+          }
+        }
+      }
+    }
+  }
+
+  // the transitive closure of the op dependency graph, ops are in
+  // topological order so every downstream op has a larger id
+  size_t word_num = (op_num + 63) / 64;
+  reach_.assign(op_num, std::vector<uint64_t>(word_num, 0));
+  auto op2downstream = build_op_downstream_map(vec_instruction);
+  for (size_t i = op_num; i > 0; --i) {
+    size_t op = i - 1;
+    auto iter = op2downstream.find(static_cast<int>(op));
+    if (iter == op2downstream.end()) {
+      continue;
+    }
+    for (auto next : iter->second) {
+      if (static_cast<size_t>(next) <= op) {
+        VLOG(3) << "StaticMemoryPlanner skips the program whose ops are not "
+                   "in topological order";
+        return false;
+      }
+      reach_[op][next / 64] |= static_cast<uint64_t>(1) << (next % 64);
+      for (size_t w = 0; w < word_num; ++w) {
+        reach_[op][w] |= reach_[next][w];
+      }
+    }
+  }
+
+  sizes_.assign(candidates_.size(), 0);
+  excluded_.assign(candidates_.size(), 0);
+  enabled_ = true;
+  VLOG(3) << "StaticMemoryPlanner builds " << candidates_.size()
+          << " candidates for " << op_num << " ops";
+  return true;
+}
+
+bool StaticMemoryPlanner::HappensBefore(size_t op_a, size_t op_b) const {
+  return op_a != op_b && (reach_[op_a][op_b / 64] >> (op_b % 64)) & 1;
+}
+
+// Whether every op using candidate a happens before every op writing b
+bool StaticMemoryPlanner::AllOpsBefore(size_t a, size_t b) const {
+  for (auto op_a : candidates_[a].ops) {
+    for (auto op_b : candidates_[b].def_ops) {
+      if (!HappensBefore(op_a, op_b)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool StaticMemoryPlanner::Conflict(size_t a, size_t b) const {
+  return !AllOpsBefore(a, b) && !AllOpsBefore(b, a);
+}
+
+void StaticMemoryPlanner::BeforeRun() {
+  if (!enabled_) {
+    return;
+  }
+  if (state_ == State::kRecord) {
+    std::fill(sizes_.begin(), sizes_.end(), 0);
+    holder_owner_.clear();
+    return;
+  }
+  plan_missed_ = false;
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    if (slices_[i] == nullptr) {
+      continue;
+    }
+    auto* tensor =
+        var_scope_->Var(candidates_[i].var_id)->GetMutable<LoDTensor>();
+    // the holder is moved out by gc in the last run
+    if (tensor->Holder() == nullptr) {
+      tensor->ResetHolder(slices_[i]);
+    }
+  }
+}
+
+void StaticMemoryPlanner::AfterInstruction(const Instruction& instr) {
+  if (!enabled_) {
+    return;
+  }
+  auto& outputs = instr_outputs_[instr.Id()];
+  if (state_ == State::kPlanned) {
+    for (auto index : outputs) {
+      if (slices_[index] != nullptr &&
+          var_scope_->Var(candidates_[index].var_id)
+                  ->Get<LoDTensor>()
+                  .Holder() != slices_[index]) {
+        VLOG(4) << "StaticMemoryPlanner missed "
+                << var_scope_->GetNameById(candidates_[index].var_id);
+        plan_missed_.store(true, std::memory_order_relaxed);
+      }
+    }
+    return;
+  }
+
+  RecordOutputs(instr);
+}
+
+void StaticMemoryPlanner::Exclude(int var_id) {
+  int index = var2candidate_[var_id];
+  if (index >= 0) {
+    excluded_[index] = 1;
+  }
+}
+
+void StaticMemoryPlanner::RecordOutputs(const Instruction& instr) {
+  // every output is checked, a candidate may share its buffer with a
+  // persistable, inplace or non gc output as well
+  for (auto& output : instr.Outputs()) {
+    for (auto var_id : output.second) {
+      if (var_id == kEmptyVarIndex) {
+        continue;
+      }
+      auto* var = var_scope_->Var(var_id);
+      int index = var2candidate_[var_id];
+      if (var == nullptr || !var->IsType<LoDTensor>()) {
+        if (index >= 0) {
+          std::lock_guard<std::mutex> guard(mutex_);
+          excluded_[index] = 1;
+        }
+        continue;
+      }
+      auto& tensor = var->Get<LoDTensor>();
+      auto& holder = tensor.Holder();
+      if (holder == nullptr) {
+        continue;
+      }
+      bool shared = tensor.meta().offset != 0 || !(holder->place() == place_);
+      // the output shares the buffer of an input, e.g. reshape
+      std::vector<int> aliases;
+      for (auto& input : instr.Inputs()) {
+        for (auto in_id : input.second) {
+          if (in_id == kEmptyVarIndex || in_id == var_id) {
+            continue;
+          }
+          auto* in_var = var_scope_->Var(in_id);
+          if (in_var != nullptr && in_var->IsType<LoDTensor>() &&
+              in_var->Get<LoDTensor>().Holder() == holder) {
+            aliases.push_back(in_id);
+          }
+        }
+      }
+      if (index >= 0) {
+        // only written by the ops writing candidate index, which never run
+        // concurrently
+        sizes_[index] = std::max(sizes_[index], holder->size());
+      }
+
+      std::lock_guard<std::mutex> guard(mutex_);
+      auto iter = holder_owner_.find(holder.get());
+      if (iter != holder_owner_.end() && iter->second.first != var_id &&
+          !iter->second.second.expired()) {
+        aliases.push_back(iter->second.first);
+      }
+      if (shared || !aliases.empty()) {
+        Exclude(var_id);
+      }
+      for (auto alias : aliases) {
+        Exclude(alias);
+      }
+      holder_owner_[holder.get()] = std::make_pair(var_id, holder);
+    }
+  }
+}
+
+void StaticMemoryPlanner::AfterRun() {
+  if (!enabled_) {
+    return;
+  }
+  if (state_ == State::kRecord) {
+    holder_owner_.clear();
+    Plan();
+    return;
+  }
+  if (plan_missed_) {
+    if (++replan_times_ > kMaxReplanTimes) {
+      VLOG(3) << "StaticMemoryPlanner is disabled since the shapes keep "
+                 "changing";
+      Disable();
+      return;
+    }
+    VLOG(3) << "StaticMemoryPlanner replans since the shapes changed";
+    slices_.clear();
+    state_ = State::kRecord;
+  }
+}
+
+void StaticMemoryPlanner::Plan() {
+  std::vector<size_t> planned;
+  std::vector<size_t> sizes;
+  for (size_t i = 0; i < candidates_.size(); ++i) {
+    if (!excluded_[i] && sizes_[i] > 0) {
+      planned.push_back(i);
+      sizes.push_back(sizes_[i]);
+    }
+  }
+  if (planned.empty()) {
+    VLOG(3) << "StaticMemoryPlanner finds no variable to plan";
+    Disable();
+    return;
+  }
+
+  std::vector<size_t> offsets;
+  size_t arena_size = GreedyBySizeOffsets(
+      sizes,
+      [this, &planned](size_t a, size_t b) {
+        return Conflict(planned[a], planned[b]);
+      },
+      kAlignment, &offsets);
+  slices_.assign(candidates_.size(), nullptr);
+  if (arena_ == nullptr || arena_->size() < arena_size) {
+    arena_.reset();
+    arena_ = memory::AllocShared(place_, arena_size);
+  }
+  for (size_t i = 0; i < planned.size(); ++i) {
+    slices_[planned[i]] =
+        std::make_shared<ArenaSliceAllocation>(arena_, offsets[i], sizes[i]);
+  }
+  state_ = State::kPlanned;
+  VLOG(3) << "StaticMemoryPlanner plans " << planned.size() << " variables of "
+          << std::accumulate(sizes.begin(), sizes.end(), size_t{0})
+          << " bytes into an arena of " << arena_size << " bytes";
+}
+
+void StaticMemoryPlanner::Disable() {
+  enabled_ = false;
+  slices_.clear();
+  arena_.reset();
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
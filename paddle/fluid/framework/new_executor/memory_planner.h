@@ -0,0 +1,136 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/framework/new_executor/new_executor_defs.h"
+#include "paddle/fluid/platform/place.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+// Assigns an offset to every block so that two blocks which conflict (are
+// alive at the same time) never overlap, and returns the total size needed.
+// Blocks are placed from the largest to the smallest, each into the smallest
+// gap left by the conflicting blocks placed before it that fits it.
+size_t GreedyBySizeOffsets(const std::vector<size_t>& sizes,
+                           const std::function<bool(size_t, size_t)>& conflict,
+                           size_t alignment, std::vector<size_t>* offsets);
+
+/*
+ * StaticMemoryPlanner serves the intermediate LoDTensors of a program with
+ * static shapes from one arena, instead of allocating them on demand and
+ * freeing them through the garbage collector in every run.
+ *
+ * - Build() picks the candidates: non persistable LoDTensors which are
+ *   written by the program and garbage collected within a run, and are not
+ *   touched by inplace, fetch or non-kernel ops.
+ * - The first run records the buffer size of every candidate, and excludes
+ *   the ones whose buffer is shared with another variable, candidate or not
+ *   (e.g. a persistable output sharing the buffer of its input).
+ * - The lifetime of a candidate is the set of ops reading or writing it.
+ *   Two candidates may share memory only if all ops of one happen before
+ *   (in the op dependency graph) every op writing the other, so that the
+ *   sharing is also safe when ops run concurrently. The offsets are solved
+ *   by GreedyBySizeOffsets.
+ * - Later runs install the slices of the arena as the holders of the
+ *   candidates before running, and kernels reuse them in mutable_data. If a
+ *   kernel does not end up writing into its slice (e.g. the shape grows),
+ *   the plan is dropped and recorded again, that run simply falls back to
+ *   dynamic allocation for those variables.
+ */
+class StaticMemoryPlanner {
+ public:
+  explicit StaticMemoryPlanner(const platform::Place& place) : place_(place) {}
+
+  // Returns false if the program can not be planned
+  bool Build(const std::vector<Instruction>& vec_instruction,
+             VariableScope* var_scope);
+
+  bool IsEnabled() const { return enabled_; }
+
+  // The arena of the current plan, nullptr before planning
+  const phi::Allocation* Arena() const { return arena_.get(); }
+
+  void BeforeRun();
+
+  // Called after running every instruction, maybe concurrently
+  void AfterInstruction(const Instruction& instr);
+
+  // Called after a run finished without exception
+  void AfterRun();
+
+ private:
+  enum class State { kRecord, kPlanned };
+
+  struct Candidate {
+    int var_id;
+    std::vector<size_t> ops;      // ops reading or writing the var
+    std::vector<size_t> def_ops;  // ops writing the var
+  };
+
+  void Plan();
+  void Disable();
+  bool HappensBefore(size_t op_a, size_t op_b) const;
+  bool AllOpsBefore(size_t a, size_t b) const;
+  bool Conflict(size_t a, size_t b) const;
+  // Records the buffers written by instr in the recording run
+  void RecordOutputs(const Instruction& instr);
+  void Exclude(int var_id);
+
+  static constexpr size_t kAlignment = 64;
+  static constexpr size_t kMaxReplanTimes = 3;
+  static constexpr size_t kMaxOpNum = 8192;
+
+  platform::Place place_;
+  VariableScope* var_scope_{nullptr};  // not owned
+  bool enabled_{false};
+  State state_{State::kRecord};
+  size_t replan_times_{0};
+
+  std::vector<Candidate> candidates_;
+  // var id -> its index in candidates_, -1 if it is not a candidate
+  std::vector<int> var2candidate_;
+  // instruction id -> the candidates it writes
+  std::vector<std::vector<size_t>> instr_outputs_;
+  // reach_[i] is the bitset of ops depending on op i
+  std::vector<std::vector<uint64_t>> reach_;
+
+  // recorded in the recording run, sizes_[i] is only written by the ops
+  // writing candidate i, which never run concurrently
+  std::vector<size_t> sizes_;
+  std::mutex mutex_;
+  std::vector<char> excluded_;  // guarded by mutex_
+  // holder -> the output var owning it, guarded by mutex_
+  std::unordered_map<phi::Allocation*,
+                     std::pair<int, std::weak_ptr<phi::Allocation>>>
+      holder_owner_;
+
+  std::shared_ptr<phi::Allocation> arena_;
+  std::vector<std::shared_ptr<phi::Allocation>> slices_;
+  std::atomic<bool> plan_missed_{false};
+};
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -0,0 +1,84 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/framework/new_executor/memory_planner.h"
+
+#include <algorithm>
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace framework {
+namespace interpreter {
+
+TEST(GreedyBySizeOffsets, reuse_dead_blocks) {
+  // a chain: block i is alive in [i, i + 1], so only neighbours conflict
+  std::vector<size_t> sizes = {100, 300, 200, 300};
+  auto conflict = [](size_t a, size_t b) {
+    return a + 1 == b || b + 1 == a;
+  };
+  std::vector<size_t> offsets;
+  size_t total = GreedyBySizeOffsets(sizes, conflict, 64, &offsets);
+  // the two blocks of 300 bytes (aligned to 320) share the same memory
+  ASSERT_EQ(offsets[1], offsets[3]);
+  // the peak of two live neighbours
+  ASSERT_EQ(total, 320UL + 256UL);
+  for (auto offset : offsets) {
+    ASSERT_EQ(offset % 64, 0UL);
+  }
+}
+
+TEST(GreedyBySizeOffsets, no_overlap_between_conflicts) {
+  std::mt19937 rng(0);
+  size_t num = 200;
+  std::vector<size_t> sizes(num);
+  std::vector<std::pair<size_t, size_t>> lifetimes(num);
+  size_t peak = 0;
+  for (size_t i = 0; i < num; ++i) {
+    sizes[i] = rng() % 4096 + 1;
+    size_t begin = rng() % 100;
+    lifetimes[i] = {begin, begin + rng() % 20};
+  }
+  auto conflict = [&lifetimes](size_t a, size_t b) {
+    return lifetimes[a].first <= lifetimes[b].second &&
+           lifetimes[b].first <= lifetimes[a].second;
+  };
+  for (size_t t = 0; t < 120; ++t) {
+    size_t live = 0;
+    for (size_t i = 0; i < num; ++i) {
+      if (lifetimes[i].first <= t && t <= lifetimes[i].second) {
+        live += (sizes[i] + 63) / 64 * 64;
+      }
+    }
+    peak = std::max(peak, live);
+  }
+
+  std::vector<size_t> offsets;
+  size_t total = GreedyBySizeOffsets(sizes, conflict, 64, &offsets);
+  ASSERT_GE(total, peak);
+  for (size_t a = 0; a < num; ++a) {
+    ASSERT_LE(offsets[a] + sizes[a], total);
+    for (size_t b = a + 1; b < num; ++b) {
+      if (conflict(a, b)) {
+        ASSERT_TRUE(offsets[a] + sizes[a] <= offsets[b] ||
+                    offsets[b] + sizes[b] <= offsets[a]);
+      }
+    }
+  }
+}
+
+}  // namespace interpreter
+}  // namespace framework
+}  // namespace paddle
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cstdlib>
 #include <vector>
@@ -16,6 +17,7 @@
 #include "paddle/fluid/framework/new_executor/workqueue/event_count.h"
 #include "paddle/fluid/framework/new_executor/workqueue/run_queue.h"
 #include "paddle/fluid/framework/new_executor/workqueue/thread_environment.h"
+#include "paddle/fluid/platform/cpu_info.h"
 #include "paddle/fluid/platform/os_info.h"
 #include "paddle/fluid/platform/profiler/event_tracing.h"
 
@@ -29,7 +31,7 @@ class ThreadPoolTempl {
   typedef RunQueue<Task, 1024> Queue;
 
   ThreadPoolTempl(const std::string& name, int num_threads, bool allow_spinning,
-                  Environment env = Environment())
+                  bool numa_aware = false, Environment env = Environment())
       : env_(env),
         allow_spinning_(allow_spinning),
         global_steal_partition_(EncodePartition(0, num_threads_)),
@@ -55,8 +57,17 @@ class ThreadPoolTempl {
       all_coprimes_.emplace_back();
       ComputeCoprimes(i, &(all_coprimes_.back()));
     }
+    if (numa_aware) {
+      InitNumaPartitions();
+    }
     for (int i = 0; i < num_threads_; i++) {
-      SetStealPartition(i, EncodePartition(0, num_threads_));
+      if (thread_node_.empty()) {
+        SetStealPartition(i, EncodePartition(0, num_threads_));
+      } else {
+        const auto& partition = node_partition_[thread_node_[i]];
+        SetStealPartition(i,
+                          EncodePartition(partition.first, partition.second));
+      }
       thread_data_[i].thread.reset(
           env_.CreateThread([this, i]() { WorkerLoop(i); }));
     }
@@ -99,7 +110,13 @@ class ThreadPoolTempl {
   }
 
   void AddTask(std::function<void()> fn) {
-    AddTaskWithHint(std::move(fn), 0, num_threads_);
+    if (node_partition_.empty()) {
+      AddTaskWithHint(std::move(fn), 0, num_threads_);
+    } else {
+      // only used when the caller is not a worker of this pool
+      const auto& partition = node_partition_[platform::CurrentNumaNode()];
+      AddTaskWithHint(std::move(fn), partition.first, partition.second);
+    }
   }
 
   void AddTaskWithHint(std::function<void()> fn, int start, int limit) {
@@ -201,6 +218,27 @@ class ThreadPoolTempl {
     return thread_data_[i].steal_partition.load(std::memory_order_relaxed);
   }
 
+  // Splits the threads into contiguous ranges, one per NUMA node. Nodes
+  // without any thread (num_threads_ < node_num) use the whole pool.
+  void InitNumaPartitions() {
+    int node_num = platform::NumaNodeCount();
+    if (node_num <= 1 || num_threads_ <= 1) {
+      return;
+    }
+    node_partition_.assign(
+        node_num, std::make_pair(0u, static_cast<unsigned>(num_threads_)));
+    thread_node_.resize(num_threads_);
+    int used_node_num = std::min(node_num, num_threads_);
+    for (int node = 0; node < used_node_num; ++node) {
+      unsigned start = node * num_threads_ / used_node_num;
+      unsigned limit = (node + 1) * num_threads_ / used_node_num;
+      node_partition_[node] = std::make_pair(start, limit);
+      for (unsigned i = start; i < limit; ++i) {
+        thread_node_[i] = node;
+      }
+    }
+  }
+
   inline void ComputeCoprimes(int n, std::vector<unsigned>* coprimes) {
     for (int i = 1; i <= n; i++) {
       unsigned a = i;
@@ -246,12 +284,21 @@ class ThreadPoolTempl {
   const int num_threads_;
   std::vector<ThreadData> thread_data_;
   std::string name_;
+  // NUMA node of every thread and [start, limit) threads of every node,
+  // empty if the pool is not numa aware
+  std::vector<int> thread_node_;
+  std::vector<std::pair<unsigned, unsigned>> node_partition_;
 
   // Main worker thread loop.
   void WorkerLoop(int thread_id) {
     std::string thr_name = name_ + "_thread_" + std::to_string(thread_id);
     VLOG(1) << thr_name << " started ";
     platform::SetCurrentThreadName(thr_name);
+    if (!thread_node_.empty() &&
+        !platform::BindCurrentThreadToNumaNode(thread_node_[thread_id])) {
+      VLOG(1) << thr_name << " failed to bind to NUMA node "
+              << thread_node_[thread_id];
+    }
     PerThread* pt = GetPerThread();
     pt->pool = this;
     pt->rand = GlobalThreadIdHash();
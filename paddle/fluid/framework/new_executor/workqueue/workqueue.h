@@ -90,6 +90,10 @@ struct WorkQueueOptions {
   // false and set events_waiter.
   bool detached{true};
   EventsWaiter* events_waiter{nullptr};  // not owned
+  // If numa_aware = true, threads are spread over NUMA nodes and bound to
+  // them, steal from the threads of the same node first, and tasks added by
+  // outside threads go to the threads of the caller's node.
+  bool numa_aware{false};
 };
 
 class WorkQueue {
@@ -173,3 +173,32 @@ TEST(WorkQueue, TestWorkQueueGroup) {
   queue_group.reset();
   waiter_thread.join();
 }
+
+TEST(WorkQueue, TestNumaAwareWorkQueue) {
+  using paddle::framework::WorkQueueOptions;
+  using paddle::framework::WorkQueue;
+  using paddle::framework::CreateMultiThreadedWorkQueue;
+  using paddle::framework::EventsWaiter;
+  std::atomic<unsigned> counter{0};
+  constexpr unsigned kExternalLoopNum = 100;
+  constexpr unsigned kLoopNum = 100000;
+  EventsWaiter events_waiter;
+  WorkQueueOptions options(/*name*/ "NumaAwareWorkQueueForTesting",
+                           /*num_threads*/ 4, /*allow_spinning*/ true,
+                           /*track_task*/ true, /*detached*/ true,
+                           &events_waiter);
+  // falls back to a plain pool on machines with a single node
+  options.numa_aware = true;
+  auto work_queue = CreateMultiThreadedWorkQueue(options);
+  EXPECT_EQ(work_queue->NumThreads(), 4u);
+  for (unsigned i = 0; i < kExternalLoopNum; ++i) {
+    work_queue->AddTask([&counter, kLoopNum]() {
+      for (unsigned i = 0; i < kLoopNum; ++i) {
+        ++counter;
+      }
+    });
+  }
+  EXPECT_EQ(events_waiter.WaitEvent(), paddle::framework::kQueueEmptyEvent);
+  EXPECT_EQ(counter.load(), kLoopNum * kExternalLoopNum);
+  work_queue->Cancel();
+}
@@ -41,16 +41,29 @@ void IrGraphBuildPass::RunImpl(Argument *argument) {
   platform::Place place;
   place = platform::CPUPlace();
 
-  if (argument->model_dir_valid()) {
+  bool model_from_memory =
+      argument->model_from_memory_valid() && argument->model_from_memory();
+  if (argument->mmap_params_file_valid() &&
+      !argument->mmap_params_file().empty() && !model_from_memory) {
+    framework::Executor exe(place);
+    auto program = LoadWithMmapParams(
+        &exe, argument->scope_ptr(),
+        argument->model_dir_valid() ? argument->model_dir() : "",
+        argument->model_program_path_valid() ? argument->model_program_path()
+                                             : "",
+        argument->model_params_path_valid() ? argument->model_params_path()
+                                            : "",
+        argument->mmap_params_file());
+    argument->SetMainProgram(program.release());
+  } else if (argument->model_dir_valid()) {
     auto program =
         LoadModel(argument->model_dir(), argument->scope_ptr(), place);
     argument->SetMainProgram(program.release());
   } else if (argument->model_program_path_valid() &&
              argument->model_params_path_valid()) {
-    auto program = LoadModel(
-        argument->model_program_path(), argument->model_params_path(),
-        argument->scope_ptr(), place,
-        argument->model_from_memory_valid() && argument->model_from_memory());
+    auto program =
+        LoadModel(argument->model_program_path(), argument->model_params_path(),
+                  argument->scope_ptr(), place, model_from_memory);
     argument->SetMainProgram(program.release());
   } else {
     PADDLE_THROW(platform::errors::PreconditionNotMet(
@@ -219,6 +219,7 @@ AnalysisConfig::AnalysisConfig(const AnalysisConfig &other) {
                                   // params_file_ fields.
 
   CP_MEMBER(opt_cache_dir_);
+  CP_MEMBER(mmap_params_file_);
   CP_MEMBER(prog_file_);
   CP_MEMBER(params_file_);
 
@@ -698,6 +699,7 @@ std::string AnalysisConfig::SerializeInfoCache() {
   ss << model_dir_;
   ss << prog_file_;
   ss << params_file_;
+  ss << mmap_params_file_;
 
   ss << use_gpu_;
   ss << use_gpu_fp16_;
@@ -39,6 +39,7 @@
 #include "paddle/fluid/inference/api/helper.h"
 #include "paddle/fluid/inference/api/paddle_inference_api.h"
 #include "paddle/fluid/inference/api/paddle_inference_pass.h"
+#include "paddle/fluid/inference/io.h"
 #include "paddle/fluid/inference/utils/io_utils.h"
 #include "paddle/fluid/inference/utils/singleton.h"
 #include "paddle/fluid/memory/memcpy.h"
@@ -826,6 +827,7 @@ void AnalysisPredictor::PrepareArgument() {
   argument_.SetEnableAnalysisOptim(config_.enable_ir_optim_);
   argument_.SetEnableMemoryOptim(config_.enable_memory_optim());
   argument_.SetModelFromMemory(config_.model_from_memory_);
+  argument_.SetMmapParamsFile(config_.mmap_params_file());
   // Analyze inference_program
   argument_.SetPredictorID(predictor_id_);
   argument_.SetOptimCacheDir(config_.opt_cache_dir_);
@@ -1514,9 +1516,19 @@ bool AnalysisPredictor::LoadParameters() {
   }
 
   // Use NaiveExecutor to Load parameters.
-  framework::NaiveExecutor e(place_);
-  e.Prepare(scope_.get(), *load_program, 0, false);
-  e.Run();
+  auto load_params = [&]() {
+    framework::NaiveExecutor e(place_);
+    e.Prepare(scope_.get(), *load_program, 0, false);
+    e.Run();
+  };
+  // only the parameters on CPU can be mapped
+  if (config_.mmap_params_file().empty() || !platform::is_cpu_place(place_) ||
+      config_.model_from_memory() ||
+      !inference::LoadPersistablesWithMmap(
+          scope_.get(), *inference_program_, config_.model_dir(),
+          config_.params_file(), config_.mmap_params_file(), load_params)) {
+    load_params();
+  }
   VLOG(3) << "get " << scope_->LocalVarNames().size() << " vars after load";
 
   return true;
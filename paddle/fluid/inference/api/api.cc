@@ -20,6 +20,7 @@
 #include "paddle/fluid/inference/api/paddle_inference_api.h"
 #include "paddle/fluid/inference/api/paddle_pass_builder.h"
 #include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/float16.h"
 
 namespace paddle {
 
@@ -33,6 +34,10 @@ int PaddleDtypeSize(PaddleDType dtype) {
       return sizeof(int32_t);
     case PaddleDType::UINT8:
       return sizeof(uint8_t);
+    case PaddleDType::INT8:
+      return sizeof(int8_t);
+    case PaddleDType::FLOAT16:
+      return sizeof(platform::float16);
     default:
       assert(false);
       return -1;
@@ -0,0 +1,511 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/inference/api/paddle_inference_api.h"
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/float16.h"
+
+namespace paddle_infer {
+namespace services {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using LoD = std::vector<std::vector<size_t>>;
+
+template <typename T>
+void CopyFromCpu(Tensor* tensor, const void* data) {
+  tensor->CopyFromCpu(static_cast<const T*>(data));
+}
+
+template <typename T>
+void CopyToCpu(const Tensor& tensor, void* data) {
+  tensor.CopyToCpu(static_cast<T*>(data));
+}
+
+void CopyFromCpu(Tensor* tensor, DataType dtype, const void* data) {
+  switch (dtype) {
+    case DataType::FLOAT32:
+      return CopyFromCpu<float>(tensor, data);
+    case DataType::INT64:
+      return CopyFromCpu<int64_t>(tensor, data);
+    case DataType::INT32:
+      return CopyFromCpu<int32_t>(tensor, data);
+    case DataType::UINT8:
+      return CopyFromCpu<uint8_t>(tensor, data);
+    case DataType::INT8:
+      return CopyFromCpu<int8_t>(tensor, data);
+    case DataType::FLOAT16:
+      return CopyFromCpu<paddle::platform::float16>(tensor, data);
+    default:
+      PADDLE_THROW(paddle::platform::errors::Unimplemented(
+          "Unsupported data type %d in BatchingPredictor.",
+          static_cast<int>(dtype)));
+  }
+}
+
+void CopyToCpu(const Tensor& tensor, DataType dtype, void* data) {
+  switch (dtype) {
+    case DataType::FLOAT32:
+      return CopyToCpu<float>(tensor, data);
+    case DataType::INT64:
+      return CopyToCpu<int64_t>(tensor, data);
+    case DataType::INT32:
+      return CopyToCpu<int32_t>(tensor, data);
+    case DataType::UINT8:
+      return CopyToCpu<uint8_t>(tensor, data);
+    case DataType::INT8:
+      return CopyToCpu<int8_t>(tensor, data);
+    case DataType::FLOAT16:
+      return CopyToCpu<paddle::platform::float16>(tensor, data);
+    default:
+      PADDLE_THROW(paddle::platform::errors::Unimplemented(
+          "Unsupported data type %d in BatchingPredictor.",
+          static_cast<int>(dtype)));
+  }
+}
+
+size_t Numel(const std::vector<int>& shape) {
+  size_t numel = 1;
+  for (auto dim : shape) {
+    numel *= dim;
+  }
+  return numel;
+}
+
+// Each level must start from 0, not decrease, and end at the number of
+// sequences in the next level, or at the rows of the tensor for the last one
+bool CheckLoD(const LoD& lod, size_t rows) {
+  for (auto& offsets : lod) {
+    if (offsets.empty() || offsets.front() != 0 ||
+        !std::is_sorted(offsets.begin(), offsets.end())) {
+      return false;
+    }
+  }
+  for (size_t level = 0; level + 1 < lod.size(); ++level) {
+    if (lod[level].back() != lod[level + 1].size() - 1) {
+      return false;
+    }
+  }
+  return lod.back().back() == rows;
+}
+
+// Returns the rows of the sequences [begin, end) in the first level of LoD,
+// and slices the LoD of these sequences rebased to 0
+std::pair<size_t, size_t> SliceLoD(const LoD& lod, size_t begin, size_t end,
+                                   LoD* sliced) {
+  sliced->clear();
+  for (auto& level : lod) {
+    sliced->emplace_back(level.begin() + begin, level.begin() + end + 1);
+    for (auto& offset : sliced->back()) {
+      offset -= level[begin];
+    }
+    begin = level[begin];
+    end = level[end];
+  }
+  return {begin, end};
+}
+
+struct BatchingRequest {
+  // the inputs in the order of the model inputs
+  std::vector<const paddle::PaddleTensor*> inputs;
+  std::vector<paddle::PaddleTensor>* outputs;
+  size_t batch_size{0};
+  Clock::time_point arrival;
+  std::promise<bool> done;
+};
+
+struct BatchingBucket {
+  std::deque<BatchingRequest*> requests;
+  size_t batch_size{0};
+};
+
+}  // namespace
+
+class BatchingPredictorImpl {
+ public:
+  BatchingPredictorImpl(const Config& config, const BatchingOptions& options);
+  ~BatchingPredictorImpl();
+
+  bool Run(const std::vector<paddle::PaddleTensor>& inputs,
+           std::vector<paddle::PaddleTensor>* outputs);
+
+  const std::vector<std::string>& input_names() const { return input_names_; }
+  const std::vector<std::string>& output_names() const {
+    return output_names_;
+  }
+
+ private:
+  // Fills the request and returns the key of its bucket, or false if the
+  // inputs are invalid
+  bool Prepare(const std::vector<paddle::PaddleTensor>& inputs,
+               BatchingRequest* request, std::string* bucket) const;
+
+  void WorkerLoop(Predictor* predictor);
+
+  // Waits and pops a batch of requests in the same bucket, returns false
+  // when stopped
+  bool NextBatch(std::vector<BatchingRequest*>* batch);
+
+  bool RunBatch(Predictor* predictor,
+                const std::vector<BatchingRequest*>& batch);
+
+  BatchingOptions options_;
+  std::unique_ptr<PredictorPool> pool_;
+  std::vector<std::string> input_names_;
+  std::vector<std::string> output_names_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<std::string, BatchingBucket> buckets_;
+  size_t num_pending_{0};
+  bool stop_{false};
+};
+
+BatchingPredictorImpl::BatchingPredictorImpl(const Config& config,
+                                             const BatchingOptions& options)
+    : options_(options) {
+  PADDLE_ENFORCE_GE(
+      options.max_batch_size, 1,
+      paddle::platform::errors::InvalidArgument(
+          "The max batch size should be greater than 0, but it's (%d)",
+          options.max_batch_size));
+  PADDLE_ENFORCE_GE(
+      options.max_wait_time_us, 0,
+      paddle::platform::errors::InvalidArgument(
+          "The max wait time should not be negative, but it's (%d)",
+          options.max_wait_time_us));
+  pool_.reset(new PredictorPool(config, options.num_predictors));
+  input_names_ = pool_->Retrive(0)->GetInputNames();
+  output_names_ = pool_->Retrive(0)->GetOutputNames();
+  for (int i = 0; i < options.num_predictors; ++i) {
+    workers_.emplace_back(&BatchingPredictorImpl::WorkerLoop, this,
+                          pool_->Retrive(i));
+  }
+}
+
+BatchingPredictorImpl::~BatchingPredictorImpl() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+bool BatchingPredictorImpl::Prepare(
+    const std::vector<paddle::PaddleTensor>& inputs, BatchingRequest* request,
+    std::string* bucket) const {
+  if (inputs.size() != input_names_.size()) {
+    LOG(ERROR) << "The model has " << input_names_.size()
+               << " inputs, but the request has " << inputs.size();
+    return false;
+  }
+  request->inputs.assign(inputs.size(), nullptr);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    size_t idx = i;
+    if (!inputs[i].name.empty()) {
+      idx = std::find(input_names_.begin(), input_names_.end(),
+                      inputs[i].name) -
+            input_names_.begin();
+      if (idx == input_names_.size()) {
+        LOG(ERROR) << "The input " << inputs[i].name << " is not found";
+        return false;
+      }
+    }
+    request->inputs[idx] = &inputs[i];
+  }
+
+  bucket->clear();
+  for (size_t i = 0; i < input_names_.size(); ++i) {
+    auto* input = request->inputs[i];
+    if (input == nullptr) {
+      LOG(ERROR) << "The input " << input_names_[i] << " is not fed";
+      return false;
+    }
+    if (input->shape.empty() ||
+        input->data.length() <
+            Numel(input->shape) * paddle::PaddleDtypeSize(input->dtype)) {
+      LOG(ERROR) << "The input " << input_names_[i]
+                 << " has no batch dimension or not enough data";
+      return false;
+    }
+    if (!input->lod.empty() && !CheckLoD(input->lod, input->shape[0])) {
+      LOG(ERROR) << "The input " << input_names_[i]
+                 << " has an invalid LoD for " << input->shape[0] << " rows";
+      return false;
+    }
+    size_t batch_size = input->lod.empty() ? input->shape[0]
+                                           : input->lod[0].size() - 1;
+    if (i > 0 && batch_size != request->batch_size) {
+      LOG(ERROR) << "The input " << input_names_[i] << " has batch size "
+                 << batch_size << ", but the others have "
+                 << request->batch_size;
+      return false;
+    }
+    request->batch_size = batch_size;
+    // the requests can be merged only if all these are the same
+    bucket->append(std::to_string(static_cast<int>(input->dtype)));
+    for (size_t d = 1; d < input->shape.size(); ++d) {
+      bucket->append(",").append(std::to_string(input->shape[d]));
+    }
+    bucket->append(";").append(std::to_string(input->lod.size())).append("|");
+  }
+  return true;
+}
+
+bool BatchingPredictorImpl::Run(const std::vector<paddle::PaddleTensor>& inputs,
+                                std::vector<paddle::PaddleTensor>* outputs) {
+  BatchingRequest request;
+  std::string bucket;
+  if (!Prepare(inputs, &request, &bucket)) {
+    return false;
+  }
+  request.outputs = outputs;
+  request.arrival = Clock::now();
+  auto done = request.done.get_future();
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& queue = buckets_[bucket];
+    queue.requests.push_back(&request);
+    queue.batch_size += request.batch_size;
+    ++num_pending_;
+  }
+  cv_.notify_one();
+  return done.get();
+}
+
+bool BatchingPredictorImpl::NextBatch(std::vector<BatchingRequest*>* batch) {
+  batch->clear();
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto max_batch_size = static_cast<size_t>(options_.max_batch_size);
+  while (true) {
+    cv_.wait(lock, [this] { return stop_ || num_pending_ > 0; });
+    if (num_pending_ == 0) {
+      return false;
+    }
+    // a full bucket goes first, then the one with the oldest request
+    auto picked = buckets_.end();
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+      if (it->second.batch_size >= max_batch_size) {
+        picked = it;
+        break;
+      }
+      if (picked == buckets_.end() ||
+          it->second.requests.front()->arrival <
+              picked->second.requests.front()->arrival) {
+        picked = it;
+      }
+    }
+    auto& bucket = picked->second;
+    auto deadline = bucket.requests.front()->arrival +
+                    std::chrono::microseconds(options_.max_wait_time_us);
+    if (!stop_ && bucket.batch_size < max_batch_size &&
+        Clock::now() < deadline) {
+      cv_.wait_until(lock, deadline);
+      continue;
+    }
+
+    size_t batch_size = 0;
+    while (!bucket.requests.empty() &&
+           (batch->empty() || batch_size + bucket.requests.front()->batch_size <=
+                                  max_batch_size)) {
+      auto* request = bucket.requests.front();
+      bucket.requests.pop_front();
+      bucket.batch_size -= request->batch_size;
+      batch_size += request->batch_size;
+      batch->push_back(request);
+    }
+    num_pending_ -= batch->size();
+    if (bucket.requests.empty()) {
+      buckets_.erase(picked);
+    } else {
+      // the rest may be ready for the other workers
+      cv_.notify_one();
+    }
+    VLOG(4) << "BatchingPredictor merges " << batch->size()
+            << " requests into batch size " << batch_size;
+    return true;
+  }
+}
+
+void BatchingPredictorImpl::WorkerLoop(Predictor* predictor) {
+  std::vector<BatchingRequest*> batch;
+  while (NextBatch(&batch)) {
+    bool succeeded = false;
+    try {
+      succeeded = RunBatch(predictor, batch);
+    } catch (std::exception& e) {
+      LOG(ERROR) << "BatchingPredictor failed to run a batch of "
+                 << batch.size() << " requests: " << e.what();
+    }
+    for (auto* request : batch) {
+      request->done.set_value(succeeded);
+    }
+  }
+}
+
+bool BatchingPredictorImpl::RunBatch(
+    Predictor* predictor, const std::vector<BatchingRequest*>& batch) {
+  size_t total_batch_size = 0;
+  for (auto* request : batch) {
+    total_batch_size += request->batch_size;
+  }
+
+  std::vector<char> buffer;
+  for (size_t i = 0; i < input_names_.size(); ++i) {
+    auto input = predictor->GetInputHandle(input_names_[i]);
+    auto& first = *batch.front()->inputs[i];
+    if (batch.size() == 1) {
+      input->Reshape(first.shape);
+      CopyFromCpu(input.get(), first.dtype, first.data.data());
+      if (!first.lod.empty()) {
+        input->SetLoD(first.lod);
+      }
+      continue;
+    }
+
+    std::vector<int> shape(first.shape);
+    shape[0] = 0;
+    LoD lod(first.lod.size(), std::vector<size_t>(1, 0));
+    for (auto* request : batch) {
+      auto& tensor = *request->inputs[i];
+      shape[0] += tensor.shape[0];
+      for (size_t level = 0; level < lod.size(); ++level) {
+        size_t base = lod[level].back();
+        for (size_t k = 1; k < tensor.lod[level].size(); ++k) {
+          lod[level].push_back(base + tensor.lod[level][k]);
+        }
+      }
+    }
+    size_t element_size = paddle::PaddleDtypeSize(first.dtype);
+    buffer.resize(Numel(shape) * element_size);
+    char* pos = buffer.data();
+    for (auto* request : batch) {
+      auto& tensor = *request->inputs[i];
+      size_t bytes = Numel(tensor.shape) * element_size;
+      std::memcpy(pos, tensor.data.data(), bytes);
+      pos += bytes;
+    }
+    input->Reshape(shape);
+    CopyFromCpu(input.get(), first.dtype, buffer.data());
+    if (!lod.empty()) {
+      input->SetLoD(lod);
+    }
+  }
+
+  if (!predictor->Run()) {
+    return false;
+  }
+
+  for (auto* request : batch) {
+    request->outputs->resize(output_names_.size());
+  }
+  for (size_t i = 0; i < output_names_.size(); ++i) {
+    auto output = predictor->GetOutputHandle(output_names_[i]);
+    auto shape = output->shape();
+    auto lod = output->lod();
+    auto dtype = output->type();
+    size_t element_size = paddle::PaddleDtypeSize(dtype);
+    buffer.resize(Numel(shape) * element_size);
+    CopyToCpu(*output, dtype, buffer.data());
+
+    bool split_by_lod = !lod.empty() && lod[0].size() == total_batch_size + 1;
+    if (batch.size() > 1 && !split_by_lod &&
+        (shape.empty() || static_cast<size_t>(shape[0]) != total_batch_size)) {
+      LOG(ERROR) << "The output " << output_names_[i]
+                 << " can not be split into the requests, it has no batch "
+                    "dimension of size "
+                 << total_batch_size;
+      return false;
+    }
+
+    size_t row_bytes =
+        shape.empty() || shape[0] == 0 ? 0 : buffer.size() / shape[0];
+    size_t sequence_begin = 0;
+    for (auto* request : batch) {
+      auto& tensor = (*request->outputs)[i];
+      tensor.name = output_names_[i];
+      tensor.dtype = dtype;
+      tensor.shape = shape;
+      size_t row_begin = 0;
+      size_t row_end = shape.empty() ? 1 : shape[0];
+      if (batch.size() == 1) {
+        tensor.lod = lod;
+      } else if (split_by_lod) {
+        std::tie(row_begin, row_end) =
+            SliceLoD(lod, sequence_begin, sequence_begin + request->batch_size,
+                     &tensor.lod);
+      } else {
+        tensor.lod.clear();
+        row_begin = sequence_begin;
+        row_end = sequence_begin + request->batch_size;
+      }
+      sequence_begin += request->batch_size;
+      if (batch.size() > 1) {
+        tensor.shape[0] = row_end - row_begin;
+      }
+      size_t bytes = batch.size() == 1 ? buffer.size()
+                                       : (row_end - row_begin) * row_bytes;
+      tensor.data.Resize(bytes);
+      if (bytes > 0) {
+        std::memcpy(tensor.data.data(), buffer.data() + row_begin * row_bytes,
+                    bytes);
+      }
+    }
+  }
+  return true;
+}
+
+BatchingPredictor::BatchingPredictor(const Config& config,
+                                     const BatchingOptions& options)
+    : impl_(new BatchingPredictorImpl(config, options)) {}
+
+BatchingPredictor::~BatchingPredictor() {}
+
+bool BatchingPredictor::Run(const std::vector<paddle::PaddleTensor>& inputs,
+                            std::vector<paddle::PaddleTensor>* outputs) {
+  return impl_->Run(inputs, outputs);
+}
+
+std::vector<std::string> BatchingPredictor::GetInputNames() {
+  return impl_->input_names();
+}
+
+std::vector<std::string> BatchingPredictor::GetOutputNames() {
+  return impl_->output_names();
+}
+
+}  // namespace services
+}  // namespace paddle_infer
@@ -207,6 +207,24 @@ struct PD_INFER_DECL AnalysisConfig {
     opt_cache_dir_ = opt_cache_dir;
   }
   ///
+  /// \brief Load the parameters by mapping an aligned params file, so that
+  /// the weights are shared among processes through the page cache instead
+  /// of being read and copied by every predictor. The file is created from
+  /// the model parameters on the first load. Only the parameters loaded on
+  /// CPU are mapped. They are copied on write if a pass modifies them.
+  ///
+  /// \param mmap_params_file the path of the aligned params file.
+  ///
+  void EnableMmapParams(const std::string& mmap_params_file) {
+    mmap_params_file_ = mmap_params_file;
+  }
+  ///
+  /// \brief Get the path of the aligned params file to map.
+  ///
+  /// \return const std::string& The path, empty if not enabled.
+  ///
+  const std::string& mmap_params_file() const { return mmap_params_file_; }
+  ///
   /// \brief Get the model directory path.
   ///
   /// \return const std::string& The model directory path.
@@ -1000,6 +1018,7 @@ struct PD_INFER_DECL AnalysisConfig {
   // So we release the memory when the predictor is set up.
   mutable bool is_valid_{true};
   std::string opt_cache_dir_;
+  std::string mmap_params_file_;
   friend class paddle_infer::experimental::InternalUtils;
 
   // fleet exe related
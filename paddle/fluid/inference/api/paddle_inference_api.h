@@ -200,6 +200,80 @@ class PD_INFER_DECL PredictorPool {
   std::shared_ptr<Predictor> main_pred_;
   std::vector<std::unique_ptr<Predictor>> preds_;
 };
+
+///
+/// \brief The options of BatchingPredictor.
+///
+struct PD_INFER_DECL BatchingOptions {
+  /// The max batch size of a merged run.
+  int max_batch_size{32};
+  /// The max time (in microseconds) a request waits for others to merge.
+  int max_wait_time_us{1000};
+  /// The number of predictors running the merged batches concurrently.
+  int num_predictors{1};
+};
+
+class BatchingPredictorImpl;
+
+///
+/// \class BatchingPredictor
+///
+/// \brief BatchingPredictor merges the requests from multiple threads into
+/// one batch before running, to make better use of the hardware for small
+/// batch requests.
+///
+/// The concurrent requests are queued, and concatenated along the batch
+/// dimension until max_batch_size is reached or the oldest one has waited
+/// max_wait_time_us, then the outputs are split back to the requests.
+///
+/// - Only the requests with the same dtypes, shapes except the batch
+///   dimension and LoD levels for all the inputs are merged.
+/// - The batch size of a request is the number of sequences of its LoD
+///   inputs, or the first dimension of the others. All the inputs must have
+///   the same batch size.
+/// - An output is split by its first level of LoD if the level has the
+///   same number of sequences as the merged batch, otherwise by its first
+///   dimension, which must be the merged batch size.
+///
+/// Usage:
+///
+/// \code{.cpp}
+/// BatchingPredictor predictor(config, options);
+/// // called in multiple threads
+/// predictor.Run(inputs, &outputs);
+/// \endcode
+///
+class PD_INFER_DECL BatchingPredictor {
+ public:
+  BatchingPredictor() = delete;
+  BatchingPredictor(const BatchingPredictor&) = delete;
+  BatchingPredictor& operator=(const BatchingPredictor&) = delete;
+
+  explicit BatchingPredictor(const Config& config,
+                             const BatchingOptions& options = {});
+  ~BatchingPredictor();
+
+  ///
+  /// \brief Run a request, blocks until its outputs are ready. thread safe.
+  ///
+  /// \param[in] inputs the inputs on CPU. They are matched to the model
+  /// inputs by name, or by position if the names are empty.
+  /// \param[out] outputs the outputs of this request, in the order of the
+  /// model outputs.
+  /// \return Whether the function executed successfully
+  ///
+  bool Run(const std::vector<paddle::PaddleTensor>& inputs,
+           std::vector<paddle::PaddleTensor>* outputs);
+
+  /// \brief Get the input names of the model
+  std::vector<std::string> GetInputNames();
+
+  /// \brief Get the output names of the model
+  std::vector<std::string> GetOutputNames();
+
+ private:
+  std::unique_ptr<BatchingPredictorImpl> impl_;
+};
 }  // namespace services
 
 }  // namespace paddle_infer
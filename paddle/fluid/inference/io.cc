@@ -14,14 +14,26 @@ limitations under the License. */
 
 #include "paddle/fluid/inference/io.h"
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <unordered_map>
 #include <vector>
 
 #include "paddle/fluid/framework/block_desc.h"
+#include "paddle/fluid/framework/convert_utils.h"
+#include "paddle/fluid/framework/data_type.h"
 #include "paddle/fluid/framework/feed_fetch_type.h"
 #include "paddle/fluid/framework/op_registry.h"
 #include "paddle/fluid/framework/version.h"
+#ifndef _WIN32
+#include "paddle/fluid/memory/allocation/mmap_allocator.h"
+#endif
 #include "paddle/fluid/platform/cpu_helper.h"
 #include "paddle/fluid/platform/enforce.h"
 #include "paddle/fluid/pybind/pybind.h"
@@ -185,6 +197,394 @@ std::unique_ptr<framework::ProgramDesc> LoadFromMemory(
   return main_program;
 }
 
+// Layout of the aligned params file, in native byte order:
+//   kMmapParamsMagic, uint64_t meta_bytes, the meta of meta_bytes
+//   the data of every tensor, aligned to kMmapParamsAlignment
+// The meta is uint64_t fingerprint, uint64_t tensor_num, followed by the name,
+// dtype, dims, lod, data offset and data bytes of every tensor. The data is
+// aligned to pages, so a weight modified by a pass only copies its own pages.
+static const char kMmapParamsMagic[8] = {'P', 'D', 'M', 'M', 'P', 'R', 'M', '2'};
+static constexpr size_t kMmapParamsAlignment = 4096;
+
+static size_t MmapParamsAlign(size_t len) {
+  return (len + kMmapParamsAlignment - 1) / kMmapParamsAlignment *
+         kMmapParamsAlignment;
+}
+
+template <typename T>
+static void AppendPod(std::string* buf, const T& value) {
+  buf->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Returns false if there are not enough bytes left
+template <typename T>
+static bool ReadPod(const char** pos, const char* end, T* value) {
+  if (static_cast<size_t>(end - *pos) < sizeof(T)) {
+    return false;
+  }
+  memcpy(value, *pos, sizeof(T));
+  *pos += sizeof(T);
+  return true;
+}
+
+// FNV-1a, which is stable across builds and processes
+static uint64_t MmapParamsHash(uint64_t hash, const std::string& data) {
+  for (unsigned char c : data) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Identifies the params the aligned file is created from, by the size and
+// modification time of the source files and the persistables of the program
+static uint64_t MmapParamsFingerprint(
+    const framework::ProgramDesc& main_program,
+    const std::vector<std::string>& names,
+    const std::vector<std::string>& source_files) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (auto& file : source_files) {
+    std::string stat_str = file;
+#ifndef _WIN32
+    struct stat st;
+    if (stat(file.c_str(), &st) == 0) {
+      stat_str += ":" + std::to_string(st.st_size) + ":" +
+                  std::to_string(st.st_mtime);
+    }
+#endif
+    hash = MmapParamsHash(hash, stat_str);
+  }
+  const auto& block = main_program.Block(0);
+  for (auto& name : names) {
+    auto* var = block.FindVar(name);
+    std::string var_str =
+        name + ":" + std::to_string(static_cast<int>(var->GetDataType()));
+    for (auto dim : var->GetShape()) {
+      var_str += "," + std::to_string(dim);
+    }
+    hash = MmapParamsHash(hash, var_str);
+  }
+  return hash;
+}
+
+// Collects the persistables to map, returns false if any of them is not a
+// LoDTensor
+static bool CollectMmapParams(const framework::ProgramDesc& main_program,
+                              std::vector<std::string>* names) {
+  for (auto* var : main_program.Block(0).AllVars()) {
+    if (!IsPersistable(var)) {
+      continue;
+    }
+    if (var->GetType() != framework::proto::VarType::LOD_TENSOR) {
+      LOG(WARNING) << "Can not map the persistable " << var->Name()
+                   << " which is not a LoDTensor, load the params as usual.";
+      return false;
+    }
+    names->push_back(var->Name());
+  }
+  std::sort(names->begin(), names->end());
+  return true;
+}
+
+void SaveMmapParams(const framework::Scope& scope,
+                    const std::vector<std::string>& names,
+                    uint64_t fingerprint, const std::string& filename) {
+  std::vector<const framework::LoDTensor*> tensors;
+  std::vector<size_t> tensor_bytes;
+  std::string meta;
+  AppendPod<uint64_t>(&meta, fingerprint);
+  AppendPod<uint64_t>(&meta, names.size());
+  size_t data_offset = 0;
+  std::vector<size_t> data_offsets;
+  for (auto& name : names) {
+    auto* var = scope.FindVar(name);
+    PADDLE_ENFORCE_NOT_NULL(
+        var, platform::errors::NotFound("Persistable %s is not found.", name));
+    auto& tensor = var->Get<framework::LoDTensor>();
+    PADDLE_ENFORCE_EQ(
+        tensor.numel() == 0 || platform::is_cpu_place(tensor.place()), true,
+        platform::errors::Unimplemented(
+            "Only the persistables on CPU can be saved to the aligned params "
+            "file, but %s is on %s.",
+            name, tensor.place()));
+    auto dtype = framework::TransToProtoVarType(tensor.dtype());
+    size_t bytes = tensor.numel() * framework::SizeOfType(dtype);
+    AppendPod<uint64_t>(&meta, name.size());
+    meta.append(name);
+    AppendPod<int32_t>(&meta, static_cast<int32_t>(dtype));
+    auto dims = phi::vectorize(tensor.dims());
+    AppendPod<uint64_t>(&meta, dims.size());
+    for (auto dim : dims) {
+      AppendPod<int64_t>(&meta, dim);
+    }
+    AppendPod<uint64_t>(&meta, tensor.lod().size());
+    for (auto& level : tensor.lod()) {
+      AppendPod<uint64_t>(&meta, level.size());
+      for (auto offset : level) {
+        AppendPod<uint64_t>(&meta, offset);
+      }
+    }
+    data_offsets.push_back(data_offset);
+    tensor_bytes.push_back(bytes);
+    AppendPod<uint64_t>(&meta, data_offset);
+    AppendPod<uint64_t>(&meta, bytes);
+    data_offset = MmapParamsAlign(data_offset + bytes);
+    tensors.push_back(&tensor);
+  }
+
+#ifdef _WIN32
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "The aligned params file is not supported on Windows."));
+#else
+  // write to a temporary file and rename it, so that the other processes
+  // never map a partial file
+  std::string tmp_filename = filename + ".tmp." + std::to_string(getpid());
+  std::ofstream fout(tmp_filename, std::ios::binary);
+  PADDLE_ENFORCE_EQ(
+      fout.is_open(), true,
+      platform::errors::Unavailable("Failed to open file %s.", tmp_filename));
+  uint64_t meta_bytes = meta.size();
+  fout.write(kMmapParamsMagic, sizeof(kMmapParamsMagic));
+  fout.write(reinterpret_cast<const char*>(&meta_bytes), sizeof(meta_bytes));
+  fout.write(meta.data(), meta.size());
+  size_t data_begin =
+      MmapParamsAlign(sizeof(kMmapParamsMagic) + sizeof(meta_bytes) +
+                      meta.size());
+  for (size_t i = 0; i < tensors.size(); ++i) {
+    fout.seekp(data_begin + data_offsets[i]);
+    if (tensor_bytes[i] > 0) {
+      fout.write(static_cast<const char*>(tensors[i]->data()),
+                 tensor_bytes[i]);
+    }
+  }
+  // pad the file to the end of the last tensor
+  if (data_offset > 0) {
+    fout.seekp(data_begin + data_offset - 1);
+    fout.put('\0');
+  }
+  fout.close();
+  PADDLE_ENFORCE_EQ(
+      fout.good(), true,
+      platform::errors::Unavailable("Failed to write file %s.", tmp_filename));
+  PADDLE_ENFORCE_EQ(
+      rename(tmp_filename.c_str(), filename.c_str()), 0,
+      platform::errors::Unavailable("Failed to rename %s to %s.", tmp_filename,
+                                    filename));
+  VLOG(3) << "Saved " << names.size() << " params to " << filename;
+#endif
+}
+
+bool LoadMmapParams(framework::Scope* scope,
+                    const framework::ProgramDesc& main_program,
+                    const std::vector<std::string>& names,
+                    uint64_t fingerprint, const std::string& filename) {
+#ifdef _WIN32
+  return false;
+#else
+  if (access(filename.c_str(), R_OK) != 0) {
+    return false;
+  }
+  std::shared_ptr<memory::allocation::Allocation> mapping =
+      memory::allocation::AllocateMemoryMapFileAllocation(filename);
+  const char* begin = static_cast<const char*>(mapping->ptr());
+  const char* end = begin + mapping->size();
+  const char* pos = begin;
+  auto invalid = [&](const std::string& reason) {
+    LOG(WARNING) << "Ignore the aligned params file " << filename << ": "
+                 << reason;
+    return false;
+  };
+  if (mapping->size() < sizeof(kMmapParamsMagic) ||
+      memcmp(begin, kMmapParamsMagic, sizeof(kMmapParamsMagic)) != 0) {
+    return invalid("it is not an aligned params file of this version.");
+  }
+  pos += sizeof(kMmapParamsMagic);
+  uint64_t meta_bytes = 0;
+  if (!ReadPod(&pos, end, &meta_bytes) ||
+      meta_bytes > static_cast<uint64_t>(end - pos)) {
+    return invalid("it is truncated.");
+  }
+  const char* meta_end = pos + meta_bytes;
+  size_t data_begin = MmapParamsAlign(pos - begin + meta_bytes);
+
+  uint64_t file_fingerprint = 0;
+  uint64_t tensor_num = 0;
+  if (!ReadPod(&pos, meta_end, &file_fingerprint) ||
+      !ReadPod(&pos, meta_end, &tensor_num)) {
+    return invalid("it is truncated.");
+  }
+  if (file_fingerprint != fingerprint) {
+    return invalid("it is created from other params or program.");
+  }
+
+  struct TensorMeta {
+    int32_t dtype;
+    std::vector<int64_t> dims;
+    framework::LoD lod;
+    uint64_t offset;
+    uint64_t bytes;
+  };
+  std::unordered_map<std::string, TensorMeta> metas;
+  for (uint64_t i = 0; i < tensor_num; ++i) {
+    uint64_t name_len = 0;
+    if (!ReadPod(&pos, meta_end, &name_len) ||
+        name_len > static_cast<uint64_t>(meta_end - pos)) {
+      return invalid("it is truncated.");
+    }
+    std::string name(pos, name_len);
+    pos += name_len;
+    auto& meta = metas[name];
+    uint64_t size = 0;
+    bool read = ReadPod(&pos, meta_end, &meta.dtype) &&
+                ReadPod(&pos, meta_end, &size) &&
+                size <= static_cast<uint64_t>(meta_end - pos);
+    if (read) {
+      meta.dims.resize(size);
+      for (auto& dim : meta.dims) {
+        read = read && ReadPod(&pos, meta_end, &dim);
+      }
+      read = read && ReadPod(&pos, meta_end, &size) &&
+             size <= static_cast<uint64_t>(meta_end - pos);
+    }
+    if (read) {
+      meta.lod.resize(size);
+      for (auto& level : meta.lod) {
+        read = read && ReadPod(&pos, meta_end, &size) &&
+               size <= static_cast<uint64_t>(meta_end - pos);
+        if (!read) {
+          break;
+        }
+        level.resize(size);
+        for (auto& offset : level) {
+          read = read && ReadPod(&pos, meta_end, &offset);
+        }
+      }
+      read = read && ReadPod(&pos, meta_end, &meta.offset) &&
+             ReadPod(&pos, meta_end, &meta.bytes);
+    }
+    if (!read || meta.offset > mapping->size() ||
+        meta.bytes > mapping->size() ||
+        data_begin + meta.offset + meta.bytes > mapping->size()) {
+      return invalid("it is truncated.");
+    }
+  }
+
+  // check all the tensors before changing the scope
+  const auto& block = main_program.Block(0);
+  for (auto& name : names) {
+    auto iter = metas.find(name);
+    if (iter == metas.end()) {
+      return invalid("persistable " + name + " is not found.");
+    }
+    auto& meta = iter->second;
+    auto* var = block.FindVar(name);
+    if (var != nullptr &&
+        static_cast<int32_t>(var->GetDataType()) != meta.dtype) {
+      return invalid("the dtype of " + name + " does not match the program.");
+    }
+    auto shape = var != nullptr ? var->GetShape() : std::vector<int64_t>();
+    bool known_shape = var != nullptr &&
+                       std::all_of(shape.begin(), shape.end(),
+                                   [](int64_t dim) { return dim >= 0; });
+    if (known_shape && shape != meta.dims) {
+      return invalid("the shape of " + name + " does not match the program.");
+    }
+    auto dtype = static_cast<framework::proto::VarType::Type>(meta.dtype);
+    int64_t numel = phi::product(phi::make_ddim(meta.dims));
+    if (numel < 0 ||
+        static_cast<uint64_t>(numel) * framework::SizeOfType(dtype) !=
+            meta.bytes) {
+      return invalid("the size of " + name + " does not match its shape.");
+    }
+  }
+
+  for (auto& name : names) {
+    auto& meta = metas[name];
+    auto* tensor = scope->Var(name)->GetMutable<framework::LoDTensor>();
+    tensor->Resize(phi::make_ddim(meta.dims));
+    tensor->set_lod(meta.lod);
+    auto dtype = framework::TransToPhiDataType(
+        static_cast<framework::proto::VarType::Type>(meta.dtype));
+    if (meta.bytes == 0) {
+      tensor->set_type(dtype);
+      continue;
+    }
+    tensor->ResetHolderWithType(
+        std::make_shared<memory::allocation::MemoryMapSliceAllocation>(
+            mapping, data_begin + meta.offset, meta.bytes),
+        dtype);
+  }
+  VLOG(3) << "Mapped " << names.size() << " params from " << filename;
+  return true;
+#endif
+}
+
+bool LoadPersistablesWithMmap(framework::Scope* scope,
+                              const framework::ProgramDesc& main_program,
+                              const std::string& dirname,
+                              const std::string& param_filename,
+                              const std::string& mmap_params_file,
+                              const std::function<void()>& load_params) {
+#ifdef _WIN32
+  return false;
+#endif
+  std::vector<std::string> names;
+  if (!CollectMmapParams(main_program, &names)) {
+    return false;
+  }
+  std::vector<std::string> source_files;
+  if (!param_filename.empty()) {
+    source_files.push_back(param_filename);
+  } else {
+    for (auto& name : names) {
+      source_files.push_back(dirname + "/" + name);
+    }
+  }
+  uint64_t fingerprint =
+      MmapParamsFingerprint(main_program, names, source_files);
+  if (LoadMmapParams(scope, main_program, names, fingerprint,
+                     mmap_params_file)) {
+    return true;
+  }
+  // the first load creates the file, and maps it at once to free the copies
+  VLOG(3) << "Create " << mmap_params_file << " from the params";
+  load_params();
+  SaveMmapParams(*scope, names, fingerprint, mmap_params_file);
+  if (!LoadMmapParams(scope, main_program, names, fingerprint,
+                      mmap_params_file)) {
+    // the params do not match the program, keep the loaded copies
+    LOG(WARNING) << "Can not map the params from " << mmap_params_file
+                 << ", use the loaded params.";
+  }
+  return true;
+}
+
+std::unique_ptr<framework::ProgramDesc> LoadWithMmapParams(
+    framework::Executor* executor, framework::Scope* scope,
+    const std::string& dirname, const std::string& prog_filename,
+    const std::string& param_filename, const std::string& mmap_params_file) {
+  std::string program_desc_str;
+  ReadBinaryFile(prog_filename.empty() ? dirname + "/__model__" : prog_filename,
+                 &program_desc_str);
+
+  std::unique_ptr<framework::ProgramDesc> main_program(
+      new framework::ProgramDesc(program_desc_str));
+  PADDLE_ENFORCE_EQ(
+      framework::IsProgramVersionSupported(main_program->Version()), true,
+      platform::errors::Unavailable("Model version %ld is not supported.",
+                                    main_program->Version()));
+
+  auto load_params = [&]() {
+    LoadPersistables(executor, scope, *main_program, dirname, param_filename,
+                     false /* model_from_memory */);
+  };
+  if (!LoadPersistablesWithMmap(scope, *main_program, dirname, param_filename,
+                                mmap_params_file, load_params)) {
+    load_params();
+  }
+  return main_program;
+}
+
 void SaveVars(const framework::Scope& scope,
               const std::vector<std::string>& vars, const std::string& dirname,
               bool predicate) {
@@ -14,6 +14,7 @@ limitations under the License. */
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -46,6 +47,43 @@ std::unique_ptr<framework::ProgramDesc> LoadFromMemory(
     framework::Executor* executor, framework::Scope* scope,
     const std::string& prog_buffer, const std::string& param_buffer);
 
+// Same as Load, but the persistables are mapped from mmap_params_file, see
+// LoadPersistablesWithMmap. The program is dirname/__model__ if prog_filename
+// is empty.
+std::unique_ptr<framework::ProgramDesc> LoadWithMmapParams(
+    framework::Executor* executor, framework::Scope* scope,
+    const std::string& dirname, const std::string& prog_filename,
+    const std::string& param_filename, const std::string& mmap_params_file);
+
+// Loads the persistables of main_program by mapping the aligned params file,
+// so the tensors alias the pages shared through the page cache. The params
+// are param_filename, or the files under dirname if it is empty. If the file
+// does not exist or does not match the params and the program, the
+// persistables are loaded by load_params first, and then saved to the file
+// and mapped. Returns false without loading anything if some persistable is
+// not a LoDTensor.
+bool LoadPersistablesWithMmap(framework::Scope* scope,
+                              const framework::ProgramDesc& main_program,
+                              const std::string& dirname,
+                              const std::string& param_filename,
+                              const std::string& mmap_params_file,
+                              const std::function<void()>& load_params);
+
+// Save the tensors to an aligned params file, which can be mapped.
+// fingerprint identifies the params the tensors are loaded from.
+void SaveMmapParams(const framework::Scope& scope,
+                    const std::vector<std::string>& names,
+                    uint64_t fingerprint, const std::string& filename);
+
+// Map the tensors from an aligned params file. Returns false and leaves the
+// scope unchanged if the file does not exist, is truncated, is saved with
+// another fingerprint, or some tensor is missing or does not match the dtype
+// and shape of its var in main_program.
+bool LoadMmapParams(framework::Scope* scope,
+                    const framework::ProgramDesc& main_program,
+                    const std::vector<std::string>& names,
+                    uint64_t fingerprint, const std::string& filename);
+
 // Save the variables from a scope to disk.
 void SaveVars(const framework::Scope& scope,
               const std::vector<std::string>& vars, const std::string& dirname,
@@ -0,0 +1,164 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/inference/io.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+namespace paddle {
+namespace inference {
+
+static void AddParam(framework::ProgramDesc* program, framework::Scope* scope,
+                     const std::string& name,
+                     const std::vector<int64_t>& shape) {
+  auto* var = program->MutableBlock(0)->Var(name);
+  var->SetType(framework::proto::VarType::LOD_TENSOR);
+  var->SetDataType(framework::proto::VarType::FP32);
+  var->SetShape(shape);
+  var->SetPersistable(true);
+
+  auto* tensor = scope->Var(name)->GetMutable<framework::LoDTensor>();
+  auto* data =
+      tensor->mutable_data<float>(phi::make_ddim(shape), platform::CPUPlace());
+  for (int64_t i = 0; i < tensor->numel(); ++i) {
+    data[i] = static_cast<float>(i) + 0.5f * name.size();
+  }
+}
+
+static void ExpectSameTensor(const framework::Scope& expected,
+                             const framework::Scope& actual,
+                             const std::string& name) {
+  auto& expected_tensor = expected.FindVar(name)->Get<framework::LoDTensor>();
+  auto& actual_tensor = actual.FindVar(name)->Get<framework::LoDTensor>();
+  ASSERT_EQ(expected_tensor.dims(), actual_tensor.dims());
+  ASSERT_EQ(expected_tensor.dtype(), actual_tensor.dtype());
+  for (int64_t i = 0; i < expected_tensor.numel(); ++i) {
+    EXPECT_EQ(expected_tensor.data<float>()[i], actual_tensor.data<float>()[i]);
+  }
+}
+
+TEST(MmapParams, save_and_load) {
+  std::string filename =
+      "/tmp/paddle_mmap_params_test_" + std::to_string(getpid());
+  framework::ProgramDesc program;
+  framework::Scope scope;
+  AddParam(&program, &scope, "fc_w", {16, 300});
+  AddParam(&program, &scope, "fc_b", {300});
+  AddParam(&program, &scope, "empty", {0, 8});
+  std::vector<std::string> names = {"empty", "fc_b", "fc_w"};
+  SaveMmapParams(scope, names, 1, filename);
+
+  framework::Scope mapped_scope;
+  ASSERT_TRUE(LoadMmapParams(&mapped_scope, program, names, 1, filename));
+  for (auto& name : names) {
+    ExpectSameTensor(scope, mapped_scope, name);
+  }
+  auto& empty = mapped_scope.FindVar("empty")->Get<framework::LoDTensor>();
+  EXPECT_EQ(empty.numel(), 0);
+
+  // a stale file is ignored and leaves the scope unchanged
+  framework::Scope stale_scope;
+  EXPECT_FALSE(LoadMmapParams(&stale_scope, program, names, 2, filename));
+  EXPECT_EQ(stale_scope.FindVar("fc_w"), nullptr);
+
+  // the shape of the program changes without changing the names
+  framework::ProgramDesc reshaped_program(program);
+  reshaped_program.MutableBlock(0)->FindVar("fc_w")->SetShape({32, 150});
+  EXPECT_FALSE(
+      LoadMmapParams(&stale_scope, reshaped_program, names, 1, filename));
+
+  // a persistable renamed
+  std::vector<std::string> renamed = {"empty", "fc_b", "fc_w_0"};
+  EXPECT_FALSE(LoadMmapParams(&stale_scope, program, renamed, 1, filename));
+  EXPECT_EQ(stale_scope.LocalVarNames().size(), 0UL);
+
+  // a truncated file
+  std::string truncated_filename = filename + ".truncated";
+  {
+    auto* fp = fopen(filename.c_str(), "rb");
+    ASSERT_NE(fp, nullptr);
+    std::vector<char> content(4096 + 100);
+    size_t len = fread(content.data(), 1, content.size(), fp);
+    fclose(fp);
+    fp = fopen(truncated_filename.c_str(), "wb");
+    ASSERT_NE(fp, nullptr);
+    fwrite(content.data(), 1, len, fp);
+    fclose(fp);
+  }
+  EXPECT_FALSE(
+      LoadMmapParams(&stale_scope, program, names, 1, truncated_filename));
+
+  // a missing file
+  EXPECT_FALSE(
+      LoadMmapParams(&stale_scope, program, names, 1, filename + ".missing"));
+
+  remove(filename.c_str());
+  remove(truncated_filename.c_str());
+}
+
+TEST(MmapParams, regenerate_stale_file) {
+  std::string filename =
+      "/tmp/paddle_mmap_params_regenerate_test_" + std::to_string(getpid());
+  std::string param_filename = filename + ".params";
+  framework::ProgramDesc program;
+  framework::Scope old_scope;
+  AddParam(&program, &old_scope, "fc_w", {4, 5});
+  int load_count = 0;
+  auto load_old = [&]() { ++load_count; };
+
+  // the params file only provides the fingerprint here
+  auto* fp = fopen(param_filename.c_str(), "wb");
+  ASSERT_NE(fp, nullptr);
+  fputs("v1", fp);
+  fclose(fp);
+  ASSERT_TRUE(LoadPersistablesWithMmap(&old_scope, program, "", param_filename,
+                                       filename, load_old));
+  EXPECT_EQ(load_count, 1);
+  framework::Scope mapped_scope;
+  ASSERT_TRUE(LoadPersistablesWithMmap(&mapped_scope, program, "",
+                                       param_filename, filename, load_old));
+  EXPECT_EQ(load_count, 1);
+  ExpectSameTensor(old_scope, mapped_scope, "fc_w");
+
+  // the model is updated with the same names, so the file is created again
+  framework::Scope new_scope;
+  auto load_new = [&]() {
+    ++load_count;
+    auto* tensor = new_scope.Var("fc_w")->GetMutable<framework::LoDTensor>();
+    auto* data = tensor->mutable_data<float>(phi::make_ddim({4, 5}),
+                                             platform::CPUPlace());
+    for (int64_t i = 0; i < tensor->numel(); ++i) {
+      data[i] = -1.0f * i;
+    }
+  };
+  fp = fopen(param_filename.c_str(), "wb");
+  ASSERT_NE(fp, nullptr);
+  fputs("version 2", fp);
+  fclose(fp);
+  ASSERT_TRUE(LoadPersistablesWithMmap(&new_scope, program, "", param_filename,
+                                       filename, load_new));
+  EXPECT_EQ(load_count, 2);
+  auto& tensor = new_scope.FindVar("fc_w")->Get<framework::LoDTensor>();
+  EXPECT_EQ(tensor.data<float>()[3], -3.0f);
+
+  remove(filename.c_str());
+  remove(param_filename.c_str());
+}
+
+}  // namespace inference
+}  // namespace paddle
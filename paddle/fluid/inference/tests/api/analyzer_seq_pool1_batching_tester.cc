@@ -0,0 +1,150 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "paddle/fluid/inference/tests/api/analyzer_seq_pool1_tester_helper.h"
+#include "paddle/fluid/inference/tests/api/tester_helper.h"
+
+DEFINE_int32(batching_max_batch_size, 32,
+             "The max batch size of BatchingPredictor.");
+DEFINE_int32(batching_max_wait_time_us, 1000,
+             "The max wait time of the requests in BatchingPredictor.");
+DEFINE_int32(batching_num_predictors, 1,
+             "The number of predictors in BatchingPredictor.");
+
+namespace paddle {
+namespace inference {
+namespace analysis {
+namespace seq_pool1_tester {
+
+struct BenchmarkResult {
+  double throughput;
+  double latency_p50;
+  double latency_p99;
+};
+
+// Runs the requests of batch size 1 from FLAGS_num_threads clients, and
+// returns the outputs of each input
+BenchmarkResult RunBenchmark(
+    const paddle_infer::services::BatchingOptions &options,
+    const std::vector<std::vector<PaddleTensor>> &inputs,
+    std::vector<std::vector<PaddleTensor>> *outputs) {
+  AnalysisConfig cfg;
+  SetConfig(&cfg);
+  paddle_infer::services::BatchingPredictor predictor(cfg, options);
+
+  outputs->assign(inputs.size(), {});
+  std::vector<std::vector<double>> latencies(FLAGS_num_threads);
+  std::vector<std::thread> threads;
+  Timer total_timer;
+  total_timer.tic();
+  for (int tid = 0; tid < FLAGS_num_threads; ++tid) {
+    threads.emplace_back([&, tid]() {
+      Timer timer;
+      for (int r = 0; r < FLAGS_repeat; ++r) {
+        for (size_t i = tid; i < inputs.size(); i += FLAGS_num_threads) {
+          std::vector<PaddleTensor> request_outputs;
+          timer.tic();
+          ASSERT_TRUE(predictor.Run(inputs[i], &request_outputs));
+          latencies[tid].push_back(timer.toc());
+          (*outputs)[i] = std::move(request_outputs);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  double total_time = total_timer.toc();
+
+  std::vector<double> all_latencies;
+  for (auto &thread_latencies : latencies) {
+    all_latencies.insert(all_latencies.end(), thread_latencies.begin(),
+                         thread_latencies.end());
+  }
+  std::sort(all_latencies.begin(), all_latencies.end());
+  BenchmarkResult result;
+  result.throughput = all_latencies.size() * 1000.0 / total_time;
+  result.latency_p50 = all_latencies[all_latencies.size() / 2];
+  result.latency_p99 = all_latencies[all_latencies.size() * 99 / 100];
+  return result;
+}
+
+void PrintResult(const char *title, const BenchmarkResult &result) {
+  LOG(INFO) << title << ": throughput " << std::fixed << std::setprecision(2)
+            << result.throughput << " requests/s, latency p50 "
+            << result.latency_p50 << " ms, p99 " << result.latency_p99
+            << " ms";
+}
+
+// Compares the requests running one by one and merged by BatchingPredictor
+TEST(Analyzer_seq_pool1_batching, profile) {
+  DataRecord data(FLAGS_infer_data, 1);
+  std::vector<std::vector<PaddleTensor>> inputs(data.batched_data.size());
+  for (auto &input : inputs) {
+    PrepareInputs(&input, &data);
+  }
+  LOG(INFO) << "number of requests: " << inputs.size() << ", clients "
+            << FLAGS_num_threads;
+
+  // max_batch_size 1 never merges, the same as a predictor pool
+  paddle_infer::services::BatchingOptions unbatched_options;
+  unbatched_options.max_batch_size = 1;
+  unbatched_options.max_wait_time_us = 0;
+  unbatched_options.num_predictors = FLAGS_num_threads;
+  std::vector<std::vector<PaddleTensor>> unbatched_outputs;
+  auto unbatched = RunBenchmark(unbatched_options, inputs, &unbatched_outputs);
+
+  paddle_infer::services::BatchingOptions batched_options;
+  batched_options.max_batch_size = FLAGS_batching_max_batch_size;
+  batched_options.max_wait_time_us = FLAGS_batching_max_wait_time_us;
+  batched_options.num_predictors = FLAGS_batching_num_predictors;
+  std::vector<std::vector<PaddleTensor>> batched_outputs;
+  auto batched = RunBenchmark(batched_options, inputs, &batched_outputs);
+
+  PrintResult("unbatched", unbatched);
+  PrintResult("batched", batched);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    CompareResult(batched_outputs[i], unbatched_outputs[i]);
+  }
+}
+
+// The requests whose LoD does not match their rows are rejected before
+// being merged with the others
+TEST(Analyzer_seq_pool1_batching, invalid_lod) {
+  DataRecord data(FLAGS_infer_data, 1);
+  std::vector<PaddleTensor> inputs;
+  PrepareInputs(&inputs, &data);
+  AnalysisConfig cfg;
+  SetConfig(&cfg);
+  paddle_infer::services::BatchingOptions options;
+  paddle_infer::services::BatchingPredictor predictor(cfg, options);
+  std::vector<PaddleTensor> outputs;
+  ASSERT_TRUE(predictor.Run(inputs, &outputs));
+
+  auto empty_lod = inputs;
+  empty_lod[0].lod[0].clear();
+  EXPECT_FALSE(predictor.Run(empty_lod, &outputs));
+
+  auto short_lod = inputs;
+  short_lod[0].lod[0].back() -= 1;
+  EXPECT_FALSE(predictor.Run(short_lod, &outputs));
+}
+
+}  // namespace seq_pool1_tester
+}  // namespace analysis
+}  // namespace inference
+}  // namespace paddle
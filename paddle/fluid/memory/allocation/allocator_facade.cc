@@ -21,8 +21,11 @@
 #include "paddle/fluid/memory/allocation/auto_growth_best_fit_allocator.h"
 #include "paddle/fluid/memory/allocation/cpu_allocator.h"
 #include "paddle/fluid/memory/allocation/naive_best_fit_allocator.h"
+#include "paddle/fluid/memory/allocation/numa_allocator.h"
 #include "paddle/fluid/memory/allocation/retry_allocator.h"
 #include "paddle/fluid/memory/allocation/stat_allocator.h"
+#include "paddle/fluid/memory/allocation/thread_cached_cpu_allocator.h"
+#include "paddle/fluid/platform/cpu_info.h"
 #include "paddle/fluid/platform/enforce.h"
 #include "paddle/fluid/platform/place.h"
 
@@ -93,6 +96,21 @@ PADDLE_DEFINE_EXPORTED_bool(use_cuda_managed_memory, false,
                             "managed memory, only available for auto_growth "
                             "strategy");
 
+PADDLE_DEFINE_EXPORTED_bool(
+    use_thread_cached_cpu_allocator, false,
+    "Whether to serve small CPU allocations from per-thread caches instead "
+    "of locking the buddy allocator on every allocation.");
+
+PADDLE_DEFINE_EXPORTED_uint64(
+    thread_cached_cpu_allocator_cache_size, 4 << 20,
+    "The maximum bytes cached by one thread when "
+    "FLAGS_use_thread_cached_cpu_allocator is on.");
+
+PADDLE_DEFINE_EXPORTED_bool(
+    use_numa_cpu_allocator, false,
+    "Whether to allocate CPU memory from the NUMA node of the requesting "
+    "thread. Only takes effect on linux machines with more than one node.");
+
 DECLARE_string(allocator_strategy);
 
 namespace paddle {
@@ -170,7 +188,7 @@ class AllocatorFacadePrivate {
 
     switch (strategy_) {
       case AllocatorStrategy::kNaiveBestFit: {
-        InitNaiveBestFitCPUAllocator();
+        InitCPUAllocator();
 #ifdef PADDLE_WITH_IPU
         for (int dev_id = 0; dev_id < platform::GetIPUDeviceCount(); ++dev_id) {
           InitNaiveBestFitIPUAllocator(platform::IPUPlace(dev_id));
@@ -213,7 +231,7 @@ class AllocatorFacadePrivate {
       }
 
       case AllocatorStrategy::kAutoGrowth: {
-        InitNaiveBestFitCPUAllocator();
+        InitCPUAllocator();
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
         allow_free_idle_chunk_ = allow_free_idle_chunk;
         for (int dev_id = 0; dev_id < platform::GetGPUDeviceCount(); ++dev_id) {
@@ -279,7 +297,7 @@ class AllocatorFacadePrivate {
       }
 
       case AllocatorStrategy::kThreadLocal: {
-        InitNaiveBestFitCPUAllocator();
+        InitCPUAllocator();
 #ifdef PADDLE_WITH_XPU
         for (int dev_id = 0; dev_id < platform::GetXPUDeviceCount(); ++dev_id) {
           InitNaiveBestFitXPUAllocator(platform::XPUPlace(dev_id));
@@ -471,6 +489,23 @@ class AllocatorFacadePrivate {
         std::make_shared<NaiveBestFitAllocator>(platform::CPUPlace());
   }
 
+  void InitCPUAllocator() {
+    if (FLAGS_use_numa_cpu_allocator && platform::NumaNodeCount() > 1) {
+      // chunks are only reserved address space until the pages are touched
+      allocators_[platform::CPUPlace()] =
+          std::make_shared<NumaCPUAllocator>(64, 64 << 20);
+    } else {
+      InitNaiveBestFitCPUAllocator();
+    }
+    if (FLAGS_use_thread_cached_cpu_allocator) {
+      // spans and large allocations still come from the underlying allocator
+      allocators_[platform::CPUPlace()] =
+          std::make_shared<ThreadCachedCPUAllocator>(
+              allocators_[platform::CPUPlace()],
+              FLAGS_thread_cached_cpu_allocator_cache_size);
+    }
+  }
+
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
   void InitNaiveBestFitCUDAPinnedAllocator() {
     allocators_[platform::CUDAPinnedPlace()] =
@@ -904,8 +939,11 @@ class AllocatorFacadePrivate {
 
   void WrapStatAllocator() {
     for (auto& pair : allocators_) {
-      // Now memory stats is only supported for GPU
-      if (platform::is_gpu_place(pair.first)) {
+      // Now memory stats is only supported for GPU and the thread cached
+      // CPU allocator
+      if (platform::is_gpu_place(pair.first) ||
+          (platform::is_cpu_place(pair.first) &&
+           FLAGS_use_thread_cached_cpu_allocator)) {
         pair.second = std::make_shared<StatAllocator>(pair.second);
       }
     }
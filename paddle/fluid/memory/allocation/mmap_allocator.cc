@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <random>
 #include <string>
 
@@ -233,6 +234,39 @@ std::shared_ptr<MemoryMapWriterAllocation> AllocateMemoryMapWriterAllocation(
   return std::make_shared<MemoryMapWriterAllocation>(ptr, size, ipc_name);
 }
 
+MemoryMapFileAllocation::~MemoryMapFileAllocation() {
+  if (this->ptr() == nullptr) {
+    return;
+  }
+  PADDLE_ENFORCE_NE(
+      munmap(this->ptr(), this->size()), -1,
+      platform::errors::Unavailable("could not unmap the file %s",
+                                    this->filename()));
+}
+
+std::shared_ptr<MemoryMapFileAllocation> AllocateMemoryMapFileAllocation(
+    const std::string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  PADDLE_ENFORCE_NE(fd, -1, platform::errors::Unavailable(
+                                "Failed to open file %s.", filename));
+  struct stat sb;
+  PADDLE_ENFORCE_EQ(
+      fstat(fd, &sb), 0,
+      platform::errors::Unavailable("Failed to get the size of %s.", filename));
+  size_t size = static_cast<size_t>(sb.st_size);
+  void *ptr = nullptr;
+  if (size > 0) {
+    // writable but private, so the writes are copied on write
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  PADDLE_ENFORCE_NE(ptr, MAP_FAILED,
+                    platform::errors::Unavailable(
+                        "Memory map failed when mapping file %s.", filename));
+  VLOG(4) << "mmap file: " << filename << ", size: " << size;
+  return std::make_shared<MemoryMapFileAllocation>(ptr, size, filename);
+}
+
 std::shared_ptr<MemoryMapReaderAllocation> RebuildMemoryMapReaderAllocation(
     const std::string &ipc_name, size_t size) {
   int flags = O_RDWR | O_CREAT;
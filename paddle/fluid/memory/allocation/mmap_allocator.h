@@ -131,6 +131,39 @@ std::shared_ptr<MemoryMapWriterAllocation> AllocateMemoryMapWriterAllocation(
 std::shared_ptr<MemoryMapReaderAllocation> RebuildMemoryMapReaderAllocation(
     const std::string &ipc_name, size_t size);
 
+class MemoryMapFileAllocation : public Allocation {
+ public:
+  explicit MemoryMapFileAllocation(void *ptr, size_t size,
+                                   std::string filename)
+      : Allocation(ptr, size, platform::CPUPlace()),
+        filename_(std::move(filename)) {}
+
+  inline const std::string &filename() const { return filename_; }
+
+  ~MemoryMapFileAllocation() override;
+
+ private:
+  std::string filename_;
+};
+
+// Maps a regular file privately: the pages are shared with other processes
+// through the page cache, copied on write, and the file is never modified.
+std::shared_ptr<MemoryMapFileAllocation> AllocateMemoryMapFileAllocation(
+    const std::string &filename);
+
+// A part of a mapped file, which keeps the mapping alive
+class MemoryMapSliceAllocation : public Allocation {
+ public:
+  MemoryMapSliceAllocation(std::shared_ptr<Allocation> mapping, size_t offset,
+                           size_t size)
+      : Allocation(static_cast<char *>(mapping->ptr()) + offset, size,
+                   platform::CPUPlace()),
+        mapping_(std::move(mapping)) {}
+
+ private:
+  std::shared_ptr<Allocation> mapping_;
+};
+
 class MemoryMapFdSet {
  public:
   static MemoryMapFdSet &Instance();  // NOLINT
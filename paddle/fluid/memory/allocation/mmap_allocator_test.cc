@@ -16,6 +16,8 @@
 
 #include "paddle/fluid/memory/allocation/mmap_allocator.h"
 
+#include <vector>
+
 #include "gtest/gtest.h"
 
 namespace paddle {
@@ -45,6 +47,34 @@ TEST(MemoryMapAllocation, test_allocation_base) {
   }
 }
 
+TEST(MemoryMapAllocation, test_file_allocation) {
+  std::string filename = "/tmp/paddle_mmap_file_allocation_test";
+  std::vector<int32_t> data(1024);
+  for (int32_t i = 0; i < 1024; ++i) {
+    data[i] = i;
+  }
+  FILE* fp = fopen(filename.c_str(), "wb");
+  ASSERT_NE(fp, nullptr);
+  ASSERT_EQ(fwrite(data.data(), sizeof(int32_t), data.size(), fp),
+            data.size());
+  fclose(fp);
+
+  auto mapping = AllocateMemoryMapFileAllocation(filename);
+  ASSERT_EQ(mapping->size(), data.size() * sizeof(int32_t));
+  MemoryMapSliceAllocation slice(mapping, 512 * sizeof(int32_t),
+                                 512 * sizeof(int32_t));
+  mapping.reset();
+  auto* ptr = static_cast<int32_t*>(slice.ptr());
+  for (int32_t i = 0; i < 512; ++i) {
+    ASSERT_EQ(ptr[i], 512 + i);
+  }
+  // the writes are private and never reach the file
+  ptr[0] = -1;
+  auto another = AllocateMemoryMapFileAllocation(filename);
+  ASSERT_EQ(static_cast<int32_t*>(another->ptr())[512], 512);
+  remove(filename.c_str());
+}
+
 }  // namespace allocation
 }  // namespace memory
 }  // namespace paddle
@@ -0,0 +1,118 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/numa_allocator.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "paddle/fluid/memory/allocation/auto_growth_best_fit_allocator.h"
+#include "paddle/fluid/platform/cpu_info.h"
+#include "paddle/fluid/platform/enforce.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+#ifdef __linux__
+static constexpr int kMpolPreferred = 1;
+static constexpr size_t kMaxNumaNodes = 1024;
+using NodeMaskWord = unsigned long;  // NOLINT
+static constexpr size_t kNodeMaskWordBits = 8 * sizeof(NodeMaskWord);
+
+static size_t PageAlignedSize(size_t size) {
+  static size_t page_size = sysconf(_SC_PAGESIZE);
+  return AlignedSize(size, page_size);
+}
+#endif
+
+phi::Allocation* NumaNodeAllocator::AllocateImpl(size_t size) {
+#ifdef __linux__
+  size_t aligned_size = PageAlignedSize(size);
+  void* ptr = mmap(nullptr, aligned_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    PADDLE_THROW_BAD_ALLOC(platform::errors::ResourceExhausted(
+        "Fail to mmap %ld bytes on NUMA node %d.", aligned_size, node_));
+  }
+  // no libnuma here, call mbind directly
+  NodeMaskWord nodemask[kMaxNumaNodes / kNodeMaskWordBits] = {0};
+  nodemask[node_ / kNodeMaskWordBits] = static_cast<NodeMaskWord>(1)
+                                        << (node_ % kNodeMaskWordBits);
+  if (syscall(SYS_mbind, ptr, aligned_size, kMpolPreferred, nodemask,
+              kMaxNumaNodes + 1, 0) != 0) {
+    VLOG(3) << "mbind to NUMA node " << node_ << " failed, errno " << errno;
+  }
+  return new Allocation(ptr, size, platform::CPUPlace());
+#else
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "NumaNodeAllocator is only supported on linux."));
+#endif
+}
+
+void NumaNodeAllocator::FreeImpl(phi::Allocation* allocation) {
+#ifdef __linux__
+  munmap(allocation->ptr(), PageAlignedSize(allocation->size()));
+#endif
+  delete allocation;
+}
+
+// Keeps the allocation of the node pool alive, so that it goes back to
+// that pool when freed by a thread on another node
+class NumaAllocation : public Allocation {
+ public:
+  explicit NumaAllocation(DecoratedAllocationPtr underlying_allocation)
+      : Allocation(underlying_allocation->ptr(),
+                   underlying_allocation->base_ptr(),
+                   underlying_allocation->size(),
+                   underlying_allocation->place()),
+        underlying_allocation_(std::move(underlying_allocation)) {}
+
+ private:
+  DecoratedAllocationPtr underlying_allocation_;
+};
+
+NumaCPUAllocator::NumaCPUAllocator(size_t alignment, size_t chunk_size) {
+  int node_num = platform::NumaNodeCount();
+  for (int node = 0; node < node_num; ++node) {
+    node_allocators_.emplace_back(std::make_shared<AutoGrowthBestFitAllocator>(
+        std::make_shared<NumaNodeAllocator>(node), alignment, chunk_size));
+  }
+  VLOG(1) << "NumaCPUAllocator created with " << node_num << " nodes";
+}
+
+phi::Allocation* NumaCPUAllocator::AllocateImpl(size_t size) {
+  int node = platform::CurrentNumaNode();
+  return new NumaAllocation(static_unique_ptr_cast<Allocation>(
+      node_allocators_[node]->Allocate(size)));
+}
+
+void NumaCPUAllocator::FreeImpl(phi::Allocation* allocation) {
+  delete allocation;
+}
+
+uint64_t NumaCPUAllocator::ReleaseImpl(const platform::Place& place) {
+  uint64_t bytes = 0;
+  for (auto& allocator : node_allocators_) {
+    bytes += allocator->Release(place);
+  }
+  return bytes;
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
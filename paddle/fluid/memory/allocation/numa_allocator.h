@@ -0,0 +1,63 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "paddle/fluid/memory/allocation/allocator.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+// Allocates page aligned memory by mmap and asks the kernel to place its
+// pages on one NUMA node (MPOL_PREFERRED, so it falls back to other nodes
+// instead of failing when the node is full).
+class NumaNodeAllocator : public Allocator {
+ public:
+  explicit NumaNodeAllocator(int node) : node_(node) {}
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+ protected:
+  phi::Allocation* AllocateImpl(size_t size) override;
+  void FreeImpl(phi::Allocation* allocation) override;
+
+ private:
+  int node_;
+};
+
+// CPU allocator with one auto growth pool per NUMA node. Every allocation
+// comes from the pool of the node the requesting thread is running on, and
+// is returned to the same pool wherever it is freed.
+class NumaCPUAllocator : public Allocator {
+ public:
+  NumaCPUAllocator(size_t alignment, size_t chunk_size);
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+ protected:
+  phi::Allocation* AllocateImpl(size_t size) override;
+  void FreeImpl(phi::Allocation* allocation) override;
+  uint64_t ReleaseImpl(const platform::Place& place) override;
+
+ private:
+  std::vector<std::shared_ptr<Allocator>> node_allocators_;
+};
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
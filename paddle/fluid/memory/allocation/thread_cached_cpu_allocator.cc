@@ -0,0 +1,327 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/thread_cached_cpu_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "glog/logging.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+// Classes are multiples of 64 bytes up to 512 bytes, then every power of two
+// interval is split into 4 classes, so the internal fragmentation is at most
+// 25%.
+size_t ThreadCachedCPUAllocator::SizeClassIndex(size_t size) {
+  if (size <= 8 * kMinClassSize) {
+    return (std::max<size_t>(size, 1) + kMinClassSize - 1) / kMinClassSize - 1;
+  }
+  size_t k = 9;  // size is in (2^k, 2^(k+1)]
+  while ((static_cast<size_t>(1) << (k + 1)) < size) {
+    ++k;
+  }
+  size_t step = static_cast<size_t>(1) << (k - 2);
+  size_t offset = size - (static_cast<size_t>(1) << k);
+  return 8 + (k - 9) * 4 + (offset + step - 1) / step - 1;
+}
+
+size_t ThreadCachedCPUAllocator::SizeClassSize(size_t index) {
+  if (index < 8) {
+    return (index + 1) * kMinClassSize;
+  }
+  size_t j = index - 8;
+  size_t k = 9 + j / 4;
+  return (static_cast<size_t>(1) << k) +
+         (j % 4 + 1) * (static_cast<size_t>(1) << (k - 2));
+}
+
+size_t ThreadCachedCPUAllocator::BatchSize(size_t index) {
+  return std::min<size_t>(
+      32, std::max<size_t>(2, 64 * 1024 / SizeClassSize(index)));
+}
+
+class ThreadCachedCPUAllocator::CentralCache {
+ public:
+  explicit CentralCache(const std::shared_ptr<Allocator>& underlying_allocator)
+      : underlying_allocator_(underlying_allocator),
+        classes_(new SizeClass[SizeClassNum()]) {}
+
+  // Moves a batch of free blocks of the class into list
+  void FetchBatch(size_t index, std::vector<void*>* list) {
+    size_t num = BatchSize(index);
+    auto& size_class = classes_[index];
+    std::lock_guard<std::mutex> guard(size_class.mutex);
+    if (size_class.free_blocks.size() < num) {
+      AllocateSpan(index, &size_class);
+    }
+    auto& free_blocks = size_class.free_blocks;
+    num = std::min(num, free_blocks.size());
+    list->insert(list->end(), free_blocks.end() - num, free_blocks.end());
+    free_blocks.resize(free_blocks.size() - num);
+  }
+
+  // Moves the last num blocks of list back
+  void ReturnBatch(size_t index, std::vector<void*>* list, size_t num) {
+    num = std::min(num, list->size());
+    auto& size_class = classes_[index];
+    std::lock_guard<std::mutex> guard(size_class.mutex);
+    size_class.free_blocks.insert(size_class.free_blocks.end(),
+                                  list->end() - num, list->end());
+    list->resize(list->size() - num);
+  }
+
+  void ReturnBlock(size_t index, void* ptr) {
+    auto& size_class = classes_[index];
+    std::lock_guard<std::mutex> guard(size_class.mutex);
+    size_class.free_blocks.push_back(ptr);
+  }
+
+  // Returns the spans whose blocks are all free to the underlying allocator
+  uint64_t ReleaseIdleSpans() {
+    uint64_t bytes = 0;
+    for (size_t index = 0; index < SizeClassNum(); ++index) {
+      auto& size_class = classes_[index];
+      std::lock_guard<std::mutex> guard(size_class.mutex);
+      auto& free_blocks = size_class.free_blocks;
+      auto& spans = size_class.spans;
+      if (free_blocks.empty()) {
+        continue;
+      }
+      size_t block_size = SizeClassSize(index);
+      std::sort(free_blocks.begin(), free_blocks.end());
+      std::vector<char> released(free_blocks.size(), 0);
+      size_t span_num = 0;
+      for (size_t i = 0; i < spans.size(); ++i) {
+        char* begin = static_cast<char*>(spans[i]->ptr());
+        char* end = begin + spans[i]->size() / block_size * block_size;
+        auto first = std::lower_bound(free_blocks.begin(), free_blocks.end(),
+                                      static_cast<void*>(begin));
+        auto last = std::lower_bound(first, free_blocks.end(),
+                                     static_cast<void*>(end));
+        if (static_cast<size_t>(last - first) ==
+            static_cast<size_t>(end - begin) / block_size) {
+          std::fill(released.begin() + (first - free_blocks.begin()),
+                    released.begin() + (last - free_blocks.begin()), 1);
+          bytes += spans[i]->size();
+          spans[i].reset();
+        } else {
+          spans[span_num++] = std::move(spans[i]);
+        }
+      }
+      spans.erase(spans.begin() + span_num, spans.end());
+      size_t block_num = 0;
+      for (size_t i = 0; i < free_blocks.size(); ++i) {
+        if (!released[i]) {
+          free_blocks[block_num++] = free_blocks[i];
+        }
+      }
+      free_blocks.resize(block_num);
+    }
+    VLOG(10) << "ThreadCachedCPUAllocator released " << bytes << " bytes";
+    return bytes;
+  }
+
+ private:
+  struct SizeClass {
+    std::mutex mutex;
+    std::vector<void*> free_blocks;
+    std::vector<DecoratedAllocationPtr> spans;
+  };
+
+  void AllocateSpan(size_t index, SizeClass* size_class) {
+    size_t block_size = SizeClassSize(index);
+    size_t span_size = std::max(kSpanSize, block_size * BatchSize(index));
+    size_class->spans.emplace_back(static_unique_ptr_cast<Allocation>(
+        underlying_allocator_->Allocate(span_size)));
+    char* ptr = static_cast<char*>(size_class->spans.back()->ptr());
+    size_t block_num = span_size / block_size;
+    // reversed so that FetchBatch hands out the lower addresses first
+    for (size_t i = block_num; i > 0; --i) {
+      size_class->free_blocks.push_back(ptr + (i - 1) * block_size);
+    }
+  }
+
+  std::shared_ptr<Allocator> underlying_allocator_;
+  std::unique_ptr<SizeClass[]> classes_;
+};
+
+class ThreadCachedCPUAllocator::ThreadCache {
+ public:
+  ThreadCache(uint64_t owner_id,
+              const std::shared_ptr<CentralCache>& central_cache,
+              size_t max_cached_size)
+      : owner_id_(owner_id),
+        central_cache_(central_cache),
+        max_cached_size_(max_cached_size),
+        lists_(SizeClassNum()) {}
+
+  ~ThreadCache() {
+    auto central_cache = central_cache_.lock();
+    if (central_cache) {
+      Flush(central_cache.get());
+    }
+  }
+
+  uint64_t owner_id() const { return owner_id_; }
+  bool expired() const { return central_cache_.expired(); }
+
+  void* Pop(size_t index, CentralCache* central_cache) {
+    auto& list = lists_[index];
+    if (list.empty()) {
+      central_cache->FetchBatch(index, &list);
+      cached_size_ += list.size() * SizeClassSize(index);
+    }
+    void* ptr = list.back();
+    list.pop_back();
+    cached_size_ -= SizeClassSize(index);
+    return ptr;
+  }
+
+  void Push(size_t index, void* ptr, CentralCache* central_cache) {
+    auto& list = lists_[index];
+    list.push_back(ptr);
+    cached_size_ += SizeClassSize(index);
+    size_t batch_size = BatchSize(index);
+    if (list.size() > 2 * batch_size) {
+      central_cache->ReturnBatch(index, &list, batch_size);
+      cached_size_ -= batch_size * SizeClassSize(index);
+    }
+    if (cached_size_ > max_cached_size_) {
+      Scavenge(central_cache);
+    }
+  }
+
+  // Gives half of every list back to the transfer cache
+  void Scavenge(CentralCache* central_cache) {
+    for (size_t index = 0; index < lists_.size(); ++index) {
+      size_t num = (lists_[index].size() + 1) / 2;
+      central_cache->ReturnBatch(index, &lists_[index], num);
+      cached_size_ -= num * SizeClassSize(index);
+    }
+  }
+
+  void Flush(CentralCache* central_cache) {
+    for (size_t index = 0; index < lists_.size(); ++index) {
+      central_cache->ReturnBatch(index, &lists_[index], lists_[index].size());
+    }
+    cached_size_ = 0;
+  }
+
+ private:
+  uint64_t owner_id_;
+  std::weak_ptr<CentralCache> central_cache_;
+  size_t max_cached_size_;
+  size_t cached_size_{0};
+  std::vector<std::vector<void*>> lists_;
+};
+
+namespace {
+
+static std::atomic<uint64_t> g_thread_cached_allocator_id{0};
+
+// trivially destructible, so it stays readable after the holder below is
+// destroyed when the thread exits
+static thread_local bool tls_thread_exiting = false;
+
+struct ThreadCacheHolder {
+  ~ThreadCacheHolder() { tls_thread_exiting = true; }
+  std::vector<std::unique_ptr<ThreadCachedCPUAllocator::ThreadCache>> caches;
+};
+
+}  // namespace
+
+ThreadCachedCPUAllocator::ThreadCachedCPUAllocator(
+    const std::shared_ptr<Allocator>& underlying_allocator,
+    size_t thread_cache_size)
+    : id_(g_thread_cached_allocator_id.fetch_add(1)),
+      thread_cache_size_(thread_cache_size),
+      underlying_allocator_(underlying_allocator),
+      central_cache_(std::make_shared<CentralCache>(underlying_allocator)) {}
+
+ThreadCachedCPUAllocator::~ThreadCachedCPUAllocator() {}
+
+// Returns nullptr when called by a thread whose caches are being destroyed
+ThreadCachedCPUAllocator::ThreadCache*
+ThreadCachedCPUAllocator::GetThreadCache() {
+  if (UNLIKELY(tls_thread_exiting)) {
+    return nullptr;
+  }
+  static thread_local ThreadCacheHolder holder;
+  for (auto& cache : holder.caches) {
+    if (cache->owner_id() == id_) {
+      return cache.get();
+    }
+  }
+  // drop the caches of destroyed allocators
+  holder.caches.erase(
+      std::remove_if(holder.caches.begin(), holder.caches.end(),
+                     [](const std::unique_ptr<ThreadCache>& cache) {
+                       return cache->expired();
+                     }),
+      holder.caches.end());
+  holder.caches.emplace_back(
+      new ThreadCache(id_, central_cache_, thread_cache_size_));
+  return holder.caches.back().get();
+}
+
+phi::Allocation* ThreadCachedCPUAllocator::AllocateImpl(size_t size) {
+  if (size > kMaxCachedSize) {
+    return underlying_allocator_->Allocate(size).release();
+  }
+  size_t index = SizeClassIndex(size);
+  void* ptr = nullptr;
+  auto* thread_cache = GetThreadCache();
+  if (LIKELY(thread_cache != nullptr)) {
+    ptr = thread_cache->Pop(index, central_cache_.get());
+  } else {
+    std::vector<void*> list;
+    central_cache_->FetchBatch(index, &list);
+    ptr = list.back();
+    list.pop_back();
+    central_cache_->ReturnBatch(index, &list, list.size());
+  }
+  return new Allocation(ptr, size, platform::CPUPlace());
+}
+
+void ThreadCachedCPUAllocator::FreeImpl(phi::Allocation* allocation) {
+  size_t size = allocation->size();
+  if (size > kMaxCachedSize) {
+    underlying_allocator_->Free(allocation);
+    return;
+  }
+  size_t index = SizeClassIndex(size);
+  auto* thread_cache = GetThreadCache();
+  if (LIKELY(thread_cache != nullptr)) {
+    thread_cache->Push(index, allocation->ptr(), central_cache_.get());
+  } else {
+    central_cache_->ReturnBlock(index, allocation->ptr());
+  }
+  delete allocation;
+}
+
+uint64_t ThreadCachedCPUAllocator::ReleaseImpl(const platform::Place& place) {
+  auto* thread_cache = GetThreadCache();
+  if (thread_cache != nullptr) {
+    thread_cache->Flush(central_cache_.get());
+  }
+  uint64_t bytes = central_cache_->ReleaseIdleSpans();
+  return bytes + underlying_allocator_->Release(place);
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
@@ -0,0 +1,83 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "paddle/fluid/memory/allocation/allocator.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+/**
+ * ThreadCachedCPUAllocator serves small CPU allocations from per-thread
+ * size-class free lists, so the hot path takes no lock at all.
+ *
+ * - Requests up to kMaxCachedSize are rounded to one of the size classes.
+ *   Each thread keeps a free list per class; a miss moves a batch of blocks
+ *   from the central transfer cache of that class, and a list that grows
+ *   too long gives a batch back. Only the transfer cache takes a lock, once
+ *   per batch.
+ * - The transfer cache carves blocks out of spans allocated by the
+ *   underlying allocator. Spans whose blocks are all back in the transfer
+ *   cache are returned to the underlying allocator by Release().
+ * - Larger requests go to the underlying allocator directly.
+ *
+ * A block freed by another thread goes into that thread's cache, and the
+ * cache of an exiting thread is flushed back to the transfer cache.
+ */
+class ThreadCachedCPUAllocator : public Allocator {
+ public:
+  static constexpr size_t kMinClassSize = 64;
+  static constexpr size_t kMaxCachedSize = 256 * 1024;
+  static constexpr size_t kSpanSize = 256 * 1024;
+
+  // thread_cache_size is the maximum bytes cached by one thread
+  ThreadCachedCPUAllocator(
+      const std::shared_ptr<Allocator>& underlying_allocator,
+      size_t thread_cache_size);
+  ~ThreadCachedCPUAllocator();
+
+  bool IsAllocThreadSafe() const override { return true; }
+
+  static size_t SizeClassIndex(size_t size);
+  static size_t SizeClassSize(size_t index);
+  static size_t SizeClassNum() { return SizeClassIndex(kMaxCachedSize) + 1; }
+  // number of blocks moved between a thread cache and the transfer cache
+  static size_t BatchSize(size_t index);
+
+  class CentralCache;
+  class ThreadCache;
+
+ protected:
+  phi::Allocation* AllocateImpl(size_t size) override;
+  void FreeImpl(phi::Allocation* allocation) override;
+  uint64_t ReleaseImpl(const platform::Place& place) override;
+
+ private:
+  ThreadCache* GetThreadCache();
+
+  uint64_t id_;
+  size_t thread_cache_size_;
+  std::shared_ptr<Allocator> underlying_allocator_;
+  std::shared_ptr<CentralCache> central_cache_;
+};
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
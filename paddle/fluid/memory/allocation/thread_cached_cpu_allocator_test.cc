@@ -0,0 +1,143 @@
+// Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/memory/allocation/thread_cached_cpu_allocator.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace paddle {
+namespace memory {
+namespace allocation {
+
+class RecordedCPUAllocator : public Allocator {
+ public:
+  bool IsAllocThreadSafe() const override { return true; }
+  size_t AllocatedSize() const { return allocated_size_; }
+
+ protected:
+  phi::Allocation *AllocateImpl(size_t size) override {
+    allocated_size_ += size;
+    return new Allocation(malloc(size), size, platform::CPUPlace());
+  }
+
+  void FreeImpl(phi::Allocation *allocation) override {
+    allocated_size_ -= allocation->size();
+    free(allocation->ptr());
+    delete allocation;
+  }
+
+ private:
+  std::atomic<size_t> allocated_size_{0};
+};
+
+TEST(ThreadCachedCPUAllocator, size_class) {
+  size_t class_num = ThreadCachedCPUAllocator::SizeClassNum();
+  size_t prev_size = 0;
+  for (size_t i = 0; i < class_num; ++i) {
+    size_t size = ThreadCachedCPUAllocator::SizeClassSize(i);
+    ASSERT_GT(size, prev_size);
+    ASSERT_EQ(size % ThreadCachedCPUAllocator::kMinClassSize, 0UL);
+    ASSERT_EQ(ThreadCachedCPUAllocator::SizeClassIndex(size), i);
+    ASSERT_EQ(ThreadCachedCPUAllocator::SizeClassIndex(prev_size + 1), i);
+    // internal fragmentation is at most 25%
+    ASSERT_LE(size - (prev_size + 1), (prev_size + 1) / 4 + 64);
+    prev_size = size;
+  }
+  ASSERT_EQ(prev_size, ThreadCachedCPUAllocator::kMaxCachedSize);
+}
+
+TEST(ThreadCachedCPUAllocator, reuse_and_release) {
+  auto recorded_allocator = std::make_shared<RecordedCPUAllocator>();
+  auto allocator = std::make_shared<ThreadCachedCPUAllocator>(
+      recorded_allocator, 1 << 20);
+
+  void *ptr = nullptr;
+  {
+    auto allocation = allocator->Allocate(100);
+    ptr = allocation->ptr();
+    ASSERT_EQ(allocation->size(), 100UL);
+  }
+  size_t reserved = recorded_allocator->AllocatedSize();
+  ASSERT_EQ(reserved, ThreadCachedCPUAllocator::kSpanSize);
+  {
+    // served by the thread cache without touching the underlying allocator
+    auto allocation = allocator->Allocate(128);
+    ASSERT_EQ(allocation->ptr(), ptr);
+    ASSERT_EQ(recorded_allocator->AllocatedSize(), reserved);
+  }
+  {
+    // large request goes to the underlying allocator directly
+    size_t size = ThreadCachedCPUAllocator::kMaxCachedSize + 1;
+    auto allocation = allocator->Allocate(size);
+    ASSERT_EQ(recorded_allocator->AllocatedSize(), reserved + size);
+  }
+  ASSERT_EQ(recorded_allocator->AllocatedSize(), reserved);
+
+  ASSERT_EQ(allocator->Release(platform::CPUPlace()), reserved);
+  ASSERT_EQ(recorded_allocator->AllocatedSize(), 0UL);
+}
+
+TEST(ThreadCachedCPUAllocator, multi_thread) {
+  auto recorded_allocator = std::make_shared<RecordedCPUAllocator>();
+  auto allocator = std::make_shared<ThreadCachedCPUAllocator>(
+      recorded_allocator, 256 * 1024);
+
+  std::vector<std::thread> threads;
+  // allocations freed by another thread
+  std::vector<std::vector<AllocationPtr>> handoff(8);
+  for (size_t t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      std::vector<AllocationPtr> allocations;
+      for (size_t i = 0; i < 2000; ++i) {
+        size_t size = (i * 997 + t * 131) % (64 * 1024) + 1;
+        allocations.emplace_back(allocator->Allocate(size));
+        memset(allocations.back()->ptr(), static_cast<int>(t), size);
+        if (i % 3 == 0) {
+          allocations.erase(allocations.begin() + (i % allocations.size()));
+        }
+      }
+      for (auto &allocation : allocations) {
+        auto *p = static_cast<unsigned char *>(allocation->ptr());
+        for (size_t j = 0; j < allocation->size(); ++j) {
+          ASSERT_EQ(p[j], t);
+        }
+      }
+      handoff[t] = std::move(allocations);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+  for (size_t t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] { handoff[(t + 1) % 8].clear(); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  // every thread cache was flushed on thread exit
+  allocator->Release(platform::CPUPlace());
+  ASSERT_EQ(recorded_allocator->AllocatedSize(), 0UL);
+}
+
+}  // namespace allocation
+}  // namespace memory
+}  // namespace paddle
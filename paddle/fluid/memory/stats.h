@@ -167,6 +167,8 @@ void StatUpdate(const std::string& stat_type, int dev_id, int64_t increment);
 // To add a new STAT type, declare here and register in stats.cc
 MEMORY_STAT_DECLARE(Allocated);
 MEMORY_STAT_DECLARE(Reserved);
+// CPU memory is recorded with device id 0
+MEMORY_STAT_DECLARE(HostAllocated);
 
 }  // namespace memory
 }  // namespace paddle
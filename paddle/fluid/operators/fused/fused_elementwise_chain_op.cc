@@ -0,0 +1,341 @@
+/* Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/phi/kernels/funcs/activation_functor.h"
+#include "paddle/phi/kernels/funcs/eigen/common.h"
+#include "paddle/phi/kernels/funcs/eigen/eigen_function.h"
+#include "paddle/phi/kernels/funcs/elementwise_functor.h"
+
+namespace paddle {
+namespace operators {
+
+using LoDTensor = framework::LoDTensor;
+
+// the tile is small enough to stay in L1 cache between stages
+static constexpr int64_t kChainTileSize = 2048;
+static constexpr size_t kChainStageAttrNum = 3;
+
+enum class ChainStageKind {
+  kRelu,
+  kSigmoid,
+  kTanh,
+  kExp,
+  kSqrt,
+  kSquare,
+  kSilu,
+  kLeakyRelu,
+  kScale,
+  kAdd,
+  kSub,
+  kMul,
+  kDiv,
+};
+
+static ChainStageKind GetChainStageKind(const std::string &type) {
+  static const std::unordered_map<std::string, ChainStageKind> kinds = {
+      {"relu", ChainStageKind::kRelu},
+      {"sigmoid", ChainStageKind::kSigmoid},
+      {"tanh", ChainStageKind::kTanh},
+      {"exp", ChainStageKind::kExp},
+      {"sqrt", ChainStageKind::kSqrt},
+      {"square", ChainStageKind::kSquare},
+      {"silu", ChainStageKind::kSilu},
+      {"leaky_relu", ChainStageKind::kLeakyRelu},
+      {"scale", ChainStageKind::kScale},
+      {"elementwise_add", ChainStageKind::kAdd},
+      {"elementwise_sub", ChainStageKind::kSub},
+      {"elementwise_mul", ChainStageKind::kMul},
+      {"elementwise_div", ChainStageKind::kDiv}};
+  auto iter = kinds.find(type);
+  if (iter == kinds.end()) {
+    PADDLE_THROW(platform::errors::Unimplemented(
+        "%s is not supported by fused_elementwise_chain.", type));
+  }
+  return iter->second;
+}
+
+static bool IsBinaryChainStage(ChainStageKind kind) {
+  return kind == ChainStageKind::kAdd || kind == ChainStageKind::kSub ||
+         kind == ChainStageKind::kMul || kind == ChainStageKind::kDiv;
+}
+
+template <typename T>
+struct ChainStage {
+  ChainStageKind kind;
+  bool chain_is_x;
+  const T *other;
+  int64_t other_numel;
+  float attrs[kChainStageAttrNum];
+};
+
+template <typename T, typename Functor>
+static void UnaryTile(const Functor &functor, const T *in, T *out,
+                      int64_t len) {
+  typename phi::EigenVector<T>::ConstType in_t(in, len);
+  typename phi::EigenVector<T>::Type out_t(out, len);
+  functor(Eigen::DefaultDevice(), in_t, out_t);
+}
+
+template <typename T, typename Functor>
+static void BinaryTile(const Functor &functor, const ChainStage<T> &stage,
+                       const T *in, T *out, int64_t begin, int64_t len) {
+  const T *other = stage.other;
+  int64_t j = begin % stage.other_numel;
+  if (stage.chain_is_x) {
+    for (int64_t k = 0; k < len; ++k) {
+      out[k] = functor(in[k], other[j]);
+      j = j + 1 == stage.other_numel ? 0 : j + 1;
+    }
+  } else {
+    for (int64_t k = 0; k < len; ++k) {
+      out[k] = functor(other[j], in[k]);
+      j = j + 1 == stage.other_numel ? 0 : j + 1;
+    }
+  }
+}
+
+template <typename T>
+static void RunChainStage(const ChainStage<T> &stage, const T *in, T *out,
+                          int64_t begin, int64_t len) {
+  switch (stage.kind) {
+    case ChainStageKind::kRelu:
+      UnaryTile(phi::funcs::ReluCPUFunctor<T>(), in, out, len);
+      break;
+    case ChainStageKind::kSigmoid:
+      UnaryTile(phi::funcs::SigmoidFunctor<T>(), in, out, len);
+      break;
+    case ChainStageKind::kTanh:
+      UnaryTile(phi::funcs::TanhFunctor<T>(), in, out, len);
+      break;
+    case ChainStageKind::kExp:
+      UnaryTile(phi::funcs::ExpFunctor<T>(), in, out, len);
+      break;
+    case ChainStageKind::kSqrt:
+      UnaryTile(phi::funcs::SqrtFunctor<T>(), in, out, len);
+      break;
+    case ChainStageKind::kSquare:
+      UnaryTile(phi::funcs::SquareFunctor<T>(), in, out, len);
+      break;
+    case ChainStageKind::kSilu:
+      UnaryTile(phi::funcs::SiluFunctor<T>(), in, out, len);
+      break;
+    case ChainStageKind::kLeakyRelu: {
+      phi::funcs::LeakyReluFunctor<T> functor;
+      functor.alpha = stage.attrs[0];
+      UnaryTile(functor, in, out, len);
+      break;
+    }
+    case ChainStageKind::kScale: {
+      typename phi::EigenVector<T>::ConstType in_t(in, len);
+      typename phi::EigenVector<T>::Type out_t(out, len);
+      phi::funcs::EigenScale<Eigen::DefaultDevice, T>::Eval(
+          Eigen::DefaultDevice(), out_t, in_t, static_cast<T>(stage.attrs[0]),
+          static_cast<T>(stage.attrs[1]), stage.attrs[2] != 0);
+      break;
+    }
+    case ChainStageKind::kAdd:
+      BinaryTile(phi::funcs::AddFunctor<T>(), stage, in, out, begin, len);
+      break;
+    case ChainStageKind::kSub:
+      BinaryTile(phi::funcs::SubtractFunctor<T>(), stage, in, out, begin, len);
+      break;
+    case ChainStageKind::kMul:
+      BinaryTile(phi::funcs::MultiplyFunctor<T>(), stage, in, out, begin, len);
+      break;
+    case ChainStageKind::kDiv:
+      BinaryTile(phi::funcs::DivideFunctor<T>(), stage, in, out, begin, len);
+      break;
+  }
+}
+
+// Whether y broadcasts to x along the trailing dims, e.g. [N, C] and [C]
+static bool IsTrailingBroadcast(const framework::DDim &x_dims,
+                                const framework::DDim &y_dims) {
+  int y_begin = 0;
+  while (y_begin < y_dims.size() && y_dims[y_begin] == 1) {
+    ++y_begin;
+  }
+  int y_rank = y_dims.size() - y_begin;
+  if (y_rank > x_dims.size()) {
+    return false;
+  }
+  for (int i = 0; i < y_rank; ++i) {
+    if (y_dims[y_begin + i] != x_dims[x_dims.size() - y_rank + i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+class FusedElementwiseChainOp : public framework::OperatorBase {
+ public:
+  FusedElementwiseChainOp(const std::string &type,
+                          const framework::VariableNameMap &inputs,
+                          const framework::VariableNameMap &outputs,
+                          const framework::AttributeMap &attrs)
+      : OperatorBase(type, inputs, outputs, attrs) {}
+
+ private:
+  void RunImpl(const framework::Scope &scope,
+               const platform::Place &place) const override {
+    PADDLE_ENFORCE_EQ(
+        platform::is_cpu_place(place), true,
+        platform::errors::Unimplemented(
+            "fused_elementwise_chain only supports CPUPlace, but got %s.",
+            place));
+    auto *x_var = scope.FindVar(Input("X"));
+    PADDLE_ENFORCE_NOT_NULL(x_var, platform::errors::NotFound(
+                                       "Input(X) of fused_elementwise_chain "
+                                       "is not found in scope."));
+    auto &x = x_var->Get<LoDTensor>();
+    auto dtype = framework::TransToProtoVarType(x.dtype());
+    if (dtype == framework::proto::VarType::FP32) {
+      RunChain<float>(scope, x);
+    } else if (dtype == framework::proto::VarType::FP64) {
+      RunChain<double>(scope, x);
+    } else {
+      PADDLE_THROW(platform::errors::Unimplemented(
+          "fused_elementwise_chain does not support data type %s.",
+          framework::DataTypeToString(dtype)));
+    }
+  }
+
+  template <typename T>
+  void RunChain(const framework::Scope &scope, const LoDTensor &x) const {
+    auto &types = Attr<std::vector<std::string>>("functor_list");
+    auto &chain_is_x = Attr<std::vector<int>>("chain_is_x");
+    auto &stage_attrs = Attr<std::vector<float>>("stage_attrs");
+    auto y_names = Inputs("Y");
+    PADDLE_ENFORCE_EQ(
+        chain_is_x.size() == types.size() &&
+            stage_attrs.size() == types.size() * kChainStageAttrNum,
+        true, platform::errors::InvalidArgument(
+                  "The attributes of fused_elementwise_chain do not match "
+                  "the functor_list."));
+
+    int64_t numel = x.numel();
+    std::vector<ChainStage<T>> stages(types.size());
+    size_t y_index = 0;
+    for (size_t i = 0; i < types.size(); ++i) {
+      auto &stage = stages[i];
+      stage.kind = GetChainStageKind(types[i]);
+      stage.chain_is_x = chain_is_x[i];
+      std::copy_n(stage_attrs.begin() + i * kChainStageAttrNum,
+                  kChainStageAttrNum, stage.attrs);
+      if (!IsBinaryChainStage(stage.kind)) {
+        continue;
+      }
+      PADDLE_ENFORCE_LT(y_index, y_names.size(),
+                        platform::errors::InvalidArgument(
+                            "fused_elementwise_chain lacks Input(Y) for %s.",
+                            types[i]));
+      auto &y = scope.FindVar(y_names[y_index++])->Get<LoDTensor>();
+      PADDLE_ENFORCE_EQ(
+          y.dtype(), x.dtype(),
+          platform::errors::InvalidArgument(
+              "The data types of the inputs of fused_elementwise_chain "
+              "should be the same."));
+      PADDLE_ENFORCE_EQ(
+          y.numel() > 0 && IsTrailingBroadcast(x.dims(), y.dims()), true,
+          platform::errors::InvalidArgument(
+              "fused_elementwise_chain can not broadcast the input of "
+              "shape [%s] to [%s].",
+              y.dims(), x.dims()));
+      stage.other = y.data<T>();
+      stage.other_numel = y.numel();
+    }
+
+    auto *out = scope.FindVar(Output("Out"))->GetMutable<LoDTensor>();
+    out->Resize(x.dims());
+    out->set_lod(x.lod());
+    const T *x_data = x.data<T>();
+    T *out_data = out->mutable_data<T>(platform::CPUPlace());
+    // every tile runs through all stages while it is in cache, the first
+    // stage reads x and the others work inplace on out
+    for (int64_t begin = 0; begin < numel; begin += kChainTileSize) {
+      int64_t len = std::min(kChainTileSize, numel - begin);
+      const T *in = x_data + begin;
+      T *tile = out_data + begin;
+      for (auto &stage : stages) {
+        RunChainStage(stage, in, tile, begin, len);
+        in = tile;
+      }
+    }
+  }
+};
+
+class FusedElementwiseChainOpInferShape : public framework::InferShapeBase {
+ public:
+  void operator()(framework::InferShapeContext *ctx) const override {
+    OP_INOUT_CHECK(ctx->HasInput("X"), "Input", "X", "FusedElementwiseChain");
+    OP_INOUT_CHECK(ctx->HasOutput("Out"), "Output", "Out",
+                   "FusedElementwiseChain");
+    ctx->SetOutputDim("Out", ctx->GetInputDim("X"));
+    ctx->ShareLoD("X", "Out");
+  }
+};
+
+class FusedElementwiseChainOpMaker : public framework::OpProtoAndCheckerMaker {
+ public:
+  void Make() override {
+    AddInput("X", "(LoDTensor) The input of the first op in the chain.");
+    AddInput("Y",
+             "(vector<LoDTensor>) The other inputs of the binary ops in the "
+             "chain, in order. Each of them has the same shape as X, or "
+             "broadcasts to X along the trailing dims.")
+        .AsDuplicable()
+        .AsDispensable();
+    AddOutput("Out", "(LoDTensor) The output of the last op in the chain.");
+    AddAttr<std::vector<std::string>>(
+        "functor_list",
+        "The op types in the chain, one of relu, sigmoid, tanh, exp, sqrt, "
+        "square, silu, leaky_relu, scale, elementwise_add, elementwise_sub, "
+        "elementwise_mul and elementwise_div.");
+    AddAttr<std::vector<int>>(
+        "chain_is_x",
+        "For every op, whether the result of the previous op is its X "
+        "(otherwise Y) of a binary op.");
+    AddAttr<std::vector<float>>(
+        "stage_attrs",
+        "3 attributes for every op: [alpha, 0, 0] for leaky_relu, "
+        "[scale, bias, bias_after_scale] for scale, unused otherwise.");
+    AddComment(R"DOC(
+FusedElementwiseChain Operator.
+
+Runs a chain of elementwise and activation ops on CPU, such as
+elementwise_add -> relu -> scale, in one pass over the data. The data is
+processed in tiles small enough to stay in cache through all the ops, and
+the intermediate results are never materialized.
+
+It is created by the new executor and should not be configured by users
+directly.
+)DOC");
+  }
+};
+
+}  // namespace operators
+}  // namespace paddle
+
+namespace ops = paddle::operators;
+REGISTER_OPERATOR(
+    fused_elementwise_chain, ops::FusedElementwiseChainOp,
+    ops::FusedElementwiseChainOpMaker, ops::FusedElementwiseChainOpInferShape,
+    paddle::framework::EmptyGradOpMaker<paddle::framework::OpDesc>,
+    paddle::framework::EmptyGradOpMaker<paddle::imperative::OpBase>);
@@ -30,7 +30,14 @@ limitations under the License. */
 #include <unistd.h>
 #endif  // _WIN32
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
 #include "paddle/fluid/platform/flags.h"
 
 DECLARE_double(fraction_of_cpu_memory_to_use);
@@ -124,6 +131,111 @@ size_t NPUPinnedMaxChunkSize() {
   return NPUPinnedMaxAllocSize() / 256;
 }
 
+namespace {
+
+struct NumaTopology {
+  std::vector<std::vector<int>> node_cpus;
+  std::vector<int> cpu_node;
+};
+
+#ifdef __linux__
+// Parses a cpulist like "0-15,32-47"
+std::vector<int> ParseCpuList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  std::stringstream ss(cpu_list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty()) continue;
+    size_t dash = range.find('-');
+    int first = std::stoi(range.substr(0, dash));
+    int last =
+        dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+#endif
+
+NumaTopology LoadNumaTopology() {
+  NumaTopology topology;
+#ifdef __linux__
+  for (int node = 0;; ++node) {
+    std::ifstream fin("/sys/devices/system/node/node" + std::to_string(node) +
+                      "/cpulist");
+    if (!fin.good()) break;
+    std::string cpu_list;
+    std::getline(fin, cpu_list);
+    topology.node_cpus.push_back(ParseCpuList(cpu_list));
+    for (int cpu : topology.node_cpus.back()) {
+      if (cpu >= static_cast<int>(topology.cpu_node.size())) {
+        topology.cpu_node.resize(cpu + 1, 0);
+      }
+      topology.cpu_node[cpu] = node;
+    }
+  }
+#endif
+  if (topology.node_cpus.empty()) {
+    topology.node_cpus.resize(1);
+  }
+  return topology;
+}
+
+const NumaTopology& GetNumaTopology() {
+  static NumaTopology topology = LoadNumaTopology();
+  return topology;
+}
+
+}  // namespace
+
+int NumaNodeCount() {
+  return static_cast<int>(GetNumaTopology().node_cpus.size());
+}
+
+int NumaNodeOfCpu(int cpu) {
+  const auto& cpu_node = GetNumaTopology().cpu_node;
+  if (cpu < 0 || cpu >= static_cast<int>(cpu_node.size())) {
+    return 0;
+  }
+  return cpu_node[cpu];
+}
+
+std::vector<int> NumaNodeCpus(int node) {
+  const auto& node_cpus = GetNumaTopology().node_cpus;
+  if (node < 0 || node >= static_cast<int>(node_cpus.size())) {
+    return {};
+  }
+  return node_cpus[node];
+}
+
+int CurrentNumaNode() {
+#ifdef __linux__
+  return NumaNodeOfCpu(sched_getcpu());
+#else
+  return 0;
+#endif
+}
+
+bool BindCurrentThreadToNumaNode(int node) {
+#ifdef __linux__
+  auto cpus = NumaNodeCpus(node);
+  if (cpus.empty()) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpu_set);
+    }
+  }
+  return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else
+  return false;
+#endif
+}
+
 #ifdef PADDLE_WITH_XBYAK
 static Xbyak::util::Cpu cpu;
 bool MayIUse(const cpu_isa_t cpu_isa) {
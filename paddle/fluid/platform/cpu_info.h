@@ -15,6 +15,7 @@ limitations under the License. */
 #pragma once
 
 #include <stddef.h>
+#include <vector>
 
 #ifdef _WIN32
 #if defined(__AVX2__)
@@ -82,6 +83,21 @@ size_t NPUPinnedMinChunkSize();
 //! Get the maximum chunk size for buddy allocator.
 size_t NPUPinnedMaxChunkSize();
 
+//! Get the number of NUMA nodes, 1 if NUMA is not available.
+int NumaNodeCount();
+
+//! Get the NUMA node of a cpu, 0 if unknown.
+int NumaNodeOfCpu(int cpu);
+
+//! Get the cpus of a NUMA node.
+std::vector<int> NumaNodeCpus(int node);
+
+//! Get the NUMA node of the cpu the calling thread is running on.
+int CurrentNumaNode();
+
+//! Bind the calling thread to the cpus of a NUMA node.
+bool BindCurrentThreadToNumaNode(int node);
+
 typedef enum {
   isa_any,
   sse42,
@@ -30,3 +30,16 @@ TEST(CpuMemoryUsage, Print) {
                                        use_percent, memory_size)
             << std::endl;
 }
+
+TEST(CpuInfo, NumaTopology) {
+  int node_num = paddle::platform::NumaNodeCount();
+  ASSERT_GE(node_num, 1);
+  for (int node = 0; node < node_num; ++node) {
+    for (int cpu : paddle::platform::NumaNodeCpus(node)) {
+      ASSERT_EQ(paddle::platform::NumaNodeOfCpu(cpu), node);
+    }
+  }
+  int node = paddle::platform::CurrentNumaNode();
+  ASSERT_GE(node, 0);
+  ASSERT_LT(node, node_num);
+}
@@ -718,6 +718,20 @@ PADDLE_DEFINE_EXPORTED_bool(allreduce_record_one_event, false,
                             "events. Currently, only fuse allreduce supports "
                             "this. Otherwise, the precision may be wrong.");
 
+/**
+ * Operator related FLAG
+ * Name: FLAGS_embedding_sparse_grad_merge_rows
+ * Since Version: 2.3
+ * Value Range: bool, default=false
+ * Example: FLAGS_embedding_sparse_grad_merge_rows=true makes the sparse
+ *          gradient of embedding on CPU have unique rows.
+ * Note: The duplicated ids are merged by adding their gradients, so the
+ *       optimizers need not merge them again.
+ */
+PADDLE_DEFINE_EXPORTED_bool(embedding_sparse_grad_merge_rows, false,
+                            "It controls whether the sparse gradient of "
+                            "embedding on CPU merges the duplicated rows.");
+
 #ifdef PADDLE_WITH_CINN
 /*
  * CINN related FLAG
@@ -762,6 +776,10 @@ DEFINE_bool(enable_slotrecord_reset_shrink, false,
             "enable slotrecord obejct reset shrink memory, default false");
 DEFINE_bool(enable_ins_parser_file, false,
             "enable parser ins file , default false");
+PADDLE_DEFINE_EXPORTED_bool(
+    enable_slotrecord_binary_file, false,
+    "load the binary slot record files converted by "
+    "Dataset.convert_to_binary instead of text, default false");
 
 /**
  * ProcessGroupNCCL related FLAG
@@ -249,6 +249,8 @@ void BindDataset(py::module *m) {
            py::call_guard<py::gil_scoped_release>())
       .def("wait_preload_done", &framework::Dataset::WaitPreLoadDone,
            py::call_guard<py::gil_scoped_release>())
+      .def("convert_to_binary", &framework::Dataset::ConvertToBinary,
+           py::call_guard<py::gil_scoped_release>())
       .def("release_memory", &framework::Dataset::ReleaseMemory,
            py::call_guard<py::gil_scoped_release>())
       .def("local_shuffle", &framework::Dataset::LocalShuffle,
@@ -206,12 +206,14 @@ void BindGraphPyClient(py::module* m) {
       .def(py::init<>())
       .def("load_edge_file", &GraphPyClient::load_edge_file)
       .def("load_node_file", &GraphPyClient::load_node_file)
+      .def("build_csr", &GraphPyClient::build_csr)
       .def("set_up", &GraphPyClient::set_up)
       .def("add_table_feat_conf", &GraphPyClient::add_table_feat_conf)
       .def("pull_graph_list", &GraphPyClient::pull_graph_list)
       .def("start_client", &GraphPyClient::start_client)
       .def("batch_sample_neighboors", &GraphPyClient::batch_sample_neighbors)
       .def("batch_sample_neighbors", &GraphPyClient::batch_sample_neighbors)
+      .def("sample_k_hop", &GraphPyClient::sample_k_hop)
       .def("use_neighbors_sample_cache",
            &GraphPyClient::use_neighbors_sample_cache)
       .def("remove_graph_node", &GraphPyClient::remove_graph_node)
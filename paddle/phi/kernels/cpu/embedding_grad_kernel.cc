@@ -18,6 +18,9 @@
 #include "paddle/phi/backends/cpu/cpu_context.h"
 #include "paddle/phi/common/data_type.h"
 #include "paddle/phi/core/kernel_registry.h"
+#include "paddle/phi/kernels/funcs/blas/blas.h"
+
+DECLARE_bool(embedding_sparse_grad_merge_rows);
 
 namespace phi {
 
@@ -63,30 +66,46 @@ struct EmbeddingGradCPUFunctor {
         if (padding_idx_ != kNoPadding && ids_data[i] == padding_idx_) {
           // the gradient of padding_idx should be 0, already done by memset, so
           // do nothing.
-        } else {
-          PADDLE_ENFORCE_LT(
-              ids_data[i],
-              N,
-              phi::errors::InvalidArgument(
-                  "Variable value (input) of "
-                  "OP(paddle.nn.functional.embedding) "
-                  "expected >= 0 and < %ld, but got %ld. Please check input "
-                  "value.",
-                  N,
-                  ids_data[i]));
-          PADDLE_ENFORCE_GE(
-              ids_data[i],
-              0,
-              phi::errors::InvalidArgument(
-                  "Variable value (input) of "
-                  "OP(paddle.nn.functional.embedding) "
-                  "expected >= 0 and < %ld, but got %ld. Please check input "
-                  "value.",
-                  N,
-                  ids_data[i]));
-          for (int j = 0; j < D; ++j) {
-            d_table_data[ids_data[i] * D + j] += d_output_data[i * D + j];
-          }
+          continue;
+        }
+        PADDLE_ENFORCE_LT(
+            ids_data[i],
+            N,
+            phi::errors::InvalidArgument(
+                "Variable value (input) of "
+                "OP(paddle.nn.functional.embedding) "
+                "expected >= 0 and < %ld, but got %ld. Please check input "
+                "value.",
+                N,
+                ids_data[i]));
+        PADDLE_ENFORCE_GE(
+            ids_data[i],
+            0,
+            phi::errors::InvalidArgument(
+                "Variable value (input) of "
+                "OP(paddle.nn.functional.embedding) "
+                "expected >= 0 and < %ld, but got %ld. Please check input "
+                "value.",
+                N,
+                ids_data[i]));
+      }
+
+      // the gradients of the same id are added by one thread, in the order of
+      // their positions
+      std::vector<int64_t> unique_ids, offsets, positions;
+      GroupIds(ids, padding_idx_, &unique_ids, &offsets, &positions);
+      auto unique_num = static_cast<int64_t>(unique_ids.size());
+      auto blas = phi::funcs::GetBlas<Context, T>(dev_ctx_);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for if (ids_num * D >= kEmbeddingParallelNumel)
+#endif
+      for (int64_t i = 0; i < unique_num; ++i) {
+        auto* d_table_row = d_table_data + unique_ids[i] * D;
+        for (int64_t k = offsets[i]; k < offsets[i + 1]; ++k) {
+          blas.AXPY(static_cast<int>(D),
+                    static_cast<T>(1),
+                    d_output_data + positions[k] * D,
+                    d_table_row);
         }
       }
     }
@@ -146,31 +165,66 @@ struct EmbeddingSparseGradCPUFunctor {
     // paddings makes no sense and we don't deal with it in backward.
     auto* d_table = weight_grad_;
     auto* d_output = &out_grad_;
-    d_table->set_rows(ids);
-
-    auto* d_table_value = d_table->mutable_value();
-    d_table_value->Resize({ids_num, table_dim[1]});
-
-    dev_ctx_.template Alloc<T>(d_table_value);
-
-    d_table->set_height(table_dim[0]);
-
-    auto* d_output_data = d_output->template data<T>();
-    auto* d_table_data = d_table_value->template data<T>();
 
     auto d_output_dims = d_output->dims();
     auto d_output_dims_2d =
         flatten_to_2d(d_output_dims, d_output_dims.size() - 1);
-    PADDLE_ENFORCE_EQ(d_table_value->dims(),
+    PADDLE_ENFORCE_EQ(phi::make_ddim({ids_num, table_dim[1]}),
                       d_output_dims_2d,
                       phi::errors::InvalidArgument(
                           "ShapeError: The shape of lookup_table@Grad and "
                           "output@Grad should be same. "
                           "But received lookup_table@Grad's shape = [%s], "
                           "output@Grad's shape = [%s].",
-                          d_table_value->dims(),
+                          phi::make_ddim({ids_num, table_dim[1]}),
                           d_output_dims_2d));
-    memcpy(d_table_data, d_output_data, sizeof(T) * d_output->numel());
+
+    if (!FLAGS_embedding_sparse_grad_merge_rows) {
+      d_table->set_rows(ids);
+
+      auto* d_table_value = d_table->mutable_value();
+      d_table_value->Resize({ids_num, table_dim[1]});
+
+      dev_ctx_.template Alloc<T>(d_table_value);
+
+      d_table->set_height(table_dim[0]);
+
+      auto* d_output_data = d_output->template data<T>();
+      auto* d_table_data = d_table_value->template data<T>();
+      memcpy(d_table_data, d_output_data, sizeof(T) * d_output->numel());
+      return;
+    }
+
+    // merge the gradients of the same ids, so the rows are unique
+    std::vector<int64_t> unique_ids, offsets, positions;
+    GroupIds(ids, kNoPadding, &unique_ids, &offsets, &positions);
+    auto unique_num = static_cast<int64_t>(unique_ids.size());
+    int64_t D = table_dim[1];
+
+    auto* d_table_value = d_table->mutable_value();
+    d_table_value->Resize({unique_num, D});
+    dev_ctx_.template Alloc<T>(d_table_value);
+    d_table->set_height(table_dim[0]);
+
+    auto* d_output_data = d_output->template data<T>();
+    auto* d_table_data = d_table_value->template data<T>();
+    auto blas = phi::funcs::GetBlas<Context, T>(dev_ctx_);
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for if (ids_num * D >= kEmbeddingParallelNumel)
+#endif
+    for (int64_t i = 0; i < unique_num; ++i) {
+      auto* d_table_row = d_table_data + i * D;
+      memcpy(d_table_row,
+             d_output_data + positions[offsets[i]] * D,
+             sizeof(T) * D);
+      for (int64_t k = offsets[i] + 1; k < offsets[i + 1]; ++k) {
+        blas.AXPY(static_cast<int>(D),
+                  static_cast<T>(1),
+                  d_output_data + positions[k] * D,
+                  d_table_row);
+      }
+    }
+    d_table->set_rows(unique_ids);
   }
 
  private:
@@ -49,27 +49,45 @@ struct EmbeddingCPUFunctor {
     auto* output = out_->data<T>();
 
     for (int64_t i = 0; i < ids_numel; ++i) {
+      if (padding_idx_ != kNoPadding && ids[i] == padding_idx_) {
+        continue;
+      }
+      PADDLE_ENFORCE_LT(
+          ids[i],
+          row_number,
+          phi::errors::InvalidArgument(
+              "Variable value (input) of OP(fluid.layers.embedding) "
+              "expected >= 0 and < %ld, but got %ld. Please check input "
+              "value.",
+              row_number,
+              ids[i]));
+      PADDLE_ENFORCE_GE(
+          ids[i],
+          0,
+          phi::errors::InvalidArgument(
+              "Variable value (input) of OP(fluid.layers.embedding) "
+              "expected >= 0 and < %ld, but got %ld. Please check input "
+              "value.",
+              row_number,
+              ids[i]));
+    }
+
+    // the ids are checked above, since no exception can be thrown in the
+    // parallel loop
+    constexpr int64_t kPrefetchDistance = 8;
+#ifdef PADDLE_WITH_MKLML
+#pragma omp parallel for if (ids_numel * row_width >= kEmbeddingParallelNumel)
+#endif
+    for (int64_t i = 0; i < ids_numel; ++i) {
+      if (i + kPrefetchDistance < ids_numel) {
+        int64_t next_id = ids[i + kPrefetchDistance];
+        if (padding_idx_ == kNoPadding || next_id != padding_idx_) {
+          PrefetchRow(table + next_id * row_width, row_width);
+        }
+      }
       if (padding_idx_ != kNoPadding && ids[i] == padding_idx_) {
         memset(output + i * row_width, 0, row_width * sizeof(T));
       } else {
-        PADDLE_ENFORCE_LT(
-            ids[i],
-            row_number,
-            phi::errors::InvalidArgument(
-                "Variable value (input) of OP(fluid.layers.embedding) "
-                "expected >= 0 and < %ld, but got %ld. Please check input "
-                "value.",
-                row_number,
-                ids[i]));
-        PADDLE_ENFORCE_GE(
-            ids[i],
-            0,
-            phi::errors::InvalidArgument(
-                "Variable value (input) of OP(fluid.layers.embedding) "
-                "expected >= 0 and < %ld, but got %ld. Please check input "
-                "value.",
-                row_number,
-                ids[i]));
         memcpy(output + i * row_width,
                table + ids[i] * row_width,
                row_width * sizeof(T));
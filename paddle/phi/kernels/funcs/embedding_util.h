@@ -14,11 +14,17 @@
 
 #pragma once
 
+#include <algorithm>
+#include <numeric>
+
 #include "paddle/phi/core/dense_tensor.h"
 
 namespace phi {
 constexpr int64_t kNoPadding = -1;
 
+// The lookup and the gradient run in parallel when they have more elements
+constexpr int64_t kEmbeddingParallelNumel = 1 << 16;
+
 template <typename InT, typename OutT>
 static std::vector<OutT> CopyIdsToVector(const DenseTensor &ids) {
   auto numel = ids.numel();
@@ -34,4 +40,51 @@ static std::vector<OutT> CopyIdsToVector(const DenseTensor &ids) {
   return ret;
 }
 
+// Groups the positions of the same ids, skipping padding_idx. The unique ids
+// are sorted, and the positions of unique_ids[i] are
+// positions[offsets[i], offsets[i + 1]) in ascending order.
+static inline void GroupIds(const std::vector<int64_t> &ids,
+                            int64_t padding_idx,
+                            std::vector<int64_t> *unique_ids,
+                            std::vector<int64_t> *offsets,
+                            std::vector<int64_t> *positions) {
+  positions->resize(ids.size());
+  std::iota(positions->begin(), positions->end(), 0);
+  if (padding_idx != kNoPadding) {
+    positions->erase(std::remove_if(positions->begin(),
+                                    positions->end(),
+                                    [&](int64_t pos) {
+                                      return ids[pos] == padding_idx;
+                                    }),
+                     positions->end());
+  }
+  std::stable_sort(
+      positions->begin(), positions->end(), [&](int64_t a, int64_t b) {
+        return ids[a] < ids[b];
+      });
+
+  unique_ids->clear();
+  offsets->clear();
+  for (size_t i = 0; i < positions->size(); ++i) {
+    int64_t id = ids[(*positions)[i]];
+    if (unique_ids->empty() || unique_ids->back() != id) {
+      unique_ids->push_back(id);
+      offsets->push_back(i);
+    }
+  }
+  offsets->push_back(positions->size());
+}
+
+// Prefetches a row of the table to hide the latency of the random access
+template <typename T>
+inline void PrefetchRow(const T *row, int64_t row_width) {
+#if defined(__GNUC__) || defined(__clang__)
+  const char *begin = reinterpret_cast<const char *>(row);
+  const char *end = reinterpret_cast<const char *>(row + row_width);
+  for (const char *line = begin; line < end; line += 64) {
+    __builtin_prefetch(line);
+  }
+#endif
+}
+
 }  // namespace phi
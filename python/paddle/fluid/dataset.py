@@ -766,6 +766,31 @@ class InMemoryDataset(DatasetBase):
             self.psgpu.set_dataset(self.dataset)
             self.psgpu.load_into_memory(is_shuffle)
 
+    def convert_to_binary(self, output_dir):
+        """
+        Convert the text files in filelist to binary slot record files in
+        output_dir, named by the input file name and a hash of its path. The
+        binary files are loaded without parsing when
+        FLAGS_enable_slotrecord_binary_file is set, with the same used slots.
+        Only SlotRecordInMemoryDataFeed supports it.
+
+        Args:
+            output_dir(str): the directory of the binary files, local or hdfs
+
+        Examples:
+            .. code-block:: python
+
+              # required: skiptest
+              import paddle.fluid as fluid
+              dataset = fluid.DatasetFactory().create_dataset("InMemoryDataset")
+              dataset.set_feed_type("SlotRecordInMemoryDataFeed")
+              filelist = ["a.txt", "b.txt"]
+              dataset.set_filelist(filelist)
+              dataset.convert_to_binary("binary_data")
+        """
+        self._prepare_to_run()
+        self.dataset.convert_to_binary(output_dir)
+
     @deprecated(
         since="2.0.0",
         update_to="paddle.distributed.InMemoryDataset.preload_into_memory")
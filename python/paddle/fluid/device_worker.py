@@ -422,6 +422,8 @@ class DownpourSGD(DeviceWorker):
         if opt_info["stat_var_names"]:
             for i in opt_info["stat_var_names"]:
                 downpour.stat_var_names.extend([i])
+        downpour.pull_sparse_prefetch_depth = opt_info.get(
+            "pull_sparse_prefetch_depth", 0)
 
         for i in worker.get_desc().dense_table:
             if i.table_id in dense_table_set:
@@ -689,6 +689,89 @@ class TestDataset(unittest.TestCase):
             os.remove("./test_queue_dataset_run_b.txt")
 
 
+    def test_slot_record_binary_convert(self):
+        """
+        Testcase for converting slot record files to binary and loading
+        them, compared with the records loaded from text.
+        """
+        dirs = ["test_slot_record_binary_a", "test_slot_record_binary_b"]
+        output_dir = "test_slot_record_binary_out"
+        for d in dirs + [output_dir]:
+            if os.path.exists(d):
+                shutil.rmtree(d)
+            os.mkdir(d)
+        # the input files share the same base name
+        with open(os.path.join(dirs[0], "part-0"), "w") as f:
+            data = "1 1 2 3 4 1 0.5\n"
+            data += "3 5 6 7 1 8 2 1.5 2.5\n"
+            data += "1 9 1 10 1 3.5\n"
+            f.write(data)
+        with open(os.path.join(dirs[1], "part-0"), "w") as f:
+            data = "2 11 12 2 13 14 1 4.5\n"
+            data += "1 15 3 16 17 18 3 5.5 6.5 7.5\n"
+            f.write(data)
+        text_files = [os.path.join(d, "part-0") for d in dirs]
+
+        main_program = fluid.Program()
+        startup_program = fluid.Program()
+        with fluid.program_guard(main_program, startup_program):
+            slots_vars = [
+                fluid.layers.data(
+                    name="slot1", shape=[1], dtype="int64", lod_level=1),
+                fluid.layers.data(
+                    name="slot2", shape=[1], dtype="int64", lod_level=1),
+                fluid.layers.data(
+                    name="slot3", shape=[1], dtype="float32", lod_level=1),
+            ]
+
+        def create_dataset(filelist):
+            dataset = fluid.DatasetFactory().create_dataset("InMemoryDataset")
+            dataset.set_feed_type("SlotRecordInMemoryDataFeed")
+            dataset.set_batch_size(2)
+            dataset.set_thread(1)
+            dataset.set_pipe_command("cat")
+            dataset.set_use_var(slots_vars)
+            dataset.set_filelist(filelist)
+            return dataset
+
+        def load_records(filelist, binary):
+            fluid.set_flags({"FLAGS_enable_slotrecord_binary_file": binary})
+            dataset = create_dataset(filelist)
+            dataset.load_into_memory()
+            data_loader = fluid.io.DataLoader.from_dataset(
+                dataset, fluid.cpu_places(1), False)
+            records = []
+            for data in data_loader():
+                slots = []
+                for var in slots_vars:
+                    tensor = data[0][var.name]
+                    values = np.array(tensor).flatten().tolist()
+                    offsets = tensor.lod()[0]
+                    slots.append([
+                        values[offsets[i]:offsets[i + 1]]
+                        for i in range(len(offsets) - 1)
+                    ])
+                records.extend(zip(*slots))
+            dataset.release_memory()
+            return sorted(records)
+
+        create_dataset(text_files).convert_to_binary(output_dir)
+        binary_files = [
+            os.path.join(output_dir, name)
+            for name in sorted(os.listdir(output_dir))
+        ]
+        self.assertEqual(len(binary_files), 2)
+
+        try:
+            text_records = load_records(text_files, False)
+            binary_records = load_records(binary_files, True)
+        finally:
+            fluid.set_flags({"FLAGS_enable_slotrecord_binary_file": False})
+            for d in dirs + [output_dir]:
+                shutil.rmtree(d)
+        self.assertEqual(len(text_records), 5)
+        self.assertEqual(text_records, binary_records)
+
 class TestDatasetWithDataLoader(TestDataset):
     """
     Test Dataset With Data Loader class. TestCases.
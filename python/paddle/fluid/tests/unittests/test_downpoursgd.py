@@ -17,9 +17,12 @@ from __future__ import print_function
 
 import paddle
 import paddle.fluid as fluid
+import numpy as np
 import os
+import shutil
 import signal
 import subprocess
+import tempfile
 import time
 import unittest
 import sys
@@ -34,6 +37,11 @@ from paddle.fluid.trainer_factory import TrainerFactory
 cache_path = os.path.expanduser('~/.cache/paddle/dataset')
 
 
+def _pslib_available():
+    # the Heter wrapper is only bound in builds with pslib
+    return hasattr(fluid.core, "Heter")
+
+
 class TestListenAndServOp(unittest.TestCase):
     """This class is Test Listen And ServOp."""
 
@@ -215,6 +223,194 @@ class TestListenAndServOp(unittest.TestCase):
             trainer._set_program(main_program)
             trainer._gen_trainer_desc()
 
+    def test_downpour_prefetch_work(self):
+        """test DownpourSGD with pull sparse prefetch."""
+        if sys.platform == 'win32' or sys.platform == 'sys.platform':
+            pass
+        else:
+            if not os.path.exists('{}/{}'.format(cache_path,
+                                                 'fleet_desc.prototxt')):
+                cmd = "wget --no-check-certificate https://pslib.bj.bcebos.com/fleet_desc.prototxt -P {}/".format(
+                    cache_path)
+                os.system(cmd)
+            x = fluid.layers.data(name='x', shape=[1], dtype='int64')
+            x_emb = fluid.layers.embedding(
+                input=x, size=[1, 2], is_distributed=True)
+            y_predict = fluid.layers.fc(input=x_emb, size=1, act=None)
+            y = fluid.layers.data(name='y', shape=[1], dtype='float32')
+            cost = fluid.layers.square_error_cost(input=y_predict, label=y)
+            avg_cost = fluid.layers.mean(cost)
+
+            ps_param = pslib.PSParameter()
+            with open("{}/fleet_desc.prototxt".format(cache_path)) as f:
+                text_format.Merge(f.read(), ps_param)
+            exe = fluid.Executor(fluid.CPUPlace())
+            exe.run(fluid.default_startup_program())
+
+            for depth in [0, 2]:
+                opt_info = {}
+                main_program = fluid.default_main_program()
+                program_id = str(id(avg_cost.block.program))
+                program_configs = {}
+                program_configs[program_id] = {
+                    "pull_sparse": [0],
+                    "push_sparse": [0]
+                }
+                program_configs[program_id]["pull_dense"] = [1]
+                program_configs[program_id]["push_dense"] = [1]
+
+                worker_skipped_ops = ["lookup_table", "lookup_table_grad"]
+                opt_info["program_configs"] = program_configs
+                opt_info["trainer"] = "DistMultiTrainer"
+                opt_info["device_worker"] = "DownpourSGD"
+                opt_info["optimizer"] = "DownpourSGD"
+                opt_info["fleet_desc"] = ps_param
+                opt_info["worker_skipped_ops"] = worker_skipped_ops
+                opt_info["use_cvm"] = False
+                opt_info["scale_datanorm"] = -1
+                opt_info["dump_slot"] = False
+                opt_info["stat_var_names"] = []
+                opt_info["pull_sparse_prefetch_depth"] = depth
+                worker = DownpourWorker(None)
+                worker.get_desc().CopyFrom(ps_param.trainer_param[0])
+                opt_info["program_id_to_worker"] = {program_id: worker}
+
+                main_program._fleet_opt = opt_info
+                trainer = TrainerFactory()._create_trainer(
+                    main_program._fleet_opt)
+                trainer._set_program(main_program)
+                trainer._gen_trainer_desc()
+                self.assertEqual(trainer.proto_desc.downpour_param.
+                                 pull_sparse_prefetch_depth, depth)
+
+    @unittest.skipIf(not _pslib_available(), "pslib is not compiled in")
+    def test_downpour_prefetch_train(self):
+        """test that prefetched pulls train the same as blocking pulls."""
+        work_dir = tempfile.mkdtemp()
+        # every line is an instance of 2 feasigns, the batches of 4
+        # instances span 10 batches
+        with open(os.path.join(work_dir, "data.txt"), "w") as f:
+            for i in range(40):
+                f.write("2 {} {} 1 {}\n".format(i % 7 + 1, i % 5 + 10,
+                                                 i % 2))
+        env = dict(os.environ)
+        env["PADDLE_TRAINER_ENDPOINTS"] = "127.0.0.1:36011"
+        env["PADDLE_PSERVERS_IP_PORT_LIST"] = "127.0.0.1:36012"
+        env["PADDLE_TRAINERS_NUM"] = "1"
+        env["POD_IP"] = "127.0.0.1"
+        server_env = dict(env)
+        server_env["TRAINING_ROLE"] = "PSERVER"
+        server_env["PADDLE_PSERVER_ID"] = "0"
+        server_env["PADDLE_PORT"] = "36012"
+        trainer_env = dict(env)
+        trainer_env["TRAINING_ROLE"] = "TRAINER"
+        trainer_env["PADDLE_TRAINER_ID"] = "0"
+        trainer_env["PADDLE_PORT"] = "36011"
+
+        cmd = [
+            sys.executable, os.path.abspath(__file__), "downpour_prefetch",
+            work_dir
+        ]
+        server = subprocess.Popen(cmd, env=server_env)
+        trainer = subprocess.Popen(cmd, env=trainer_env)
+        try:
+            trainer_ret = trainer.wait(timeout=600)
+            server_ret = server.wait(timeout=60)
+        finally:
+            for proc in [trainer, server]:
+                if proc.poll() is None:
+                    proc.kill()
+                    proc.wait()
+        self.assertEqual(trainer_ret, 0)
+        self.assertEqual(server_ret, 0)
+
+        result = np.load(os.path.join(work_dir, "result.npz"))
+        self.assertNotEqual(result["emb_sum_0"][0], 0)
+        self.assertTrue(np.allclose(result["loss_sum_2"], result["loss_sum_0"]))
+        self.assertTrue(np.allclose(result["emb_sum_2"], result["emb_sum_0"]))
+        shutil.rmtree(work_dir)
+
+
+def _run_downpour_prefetch(work_dir):
+    """Runs the pserver or the trainer of test_downpour_prefetch_train by
+    TRAINING_ROLE. The trainer trains a pass with blocking pulls and a pass
+    with prefetch depth 2 on a frozen sparse table, then saves the summed
+    loss and the summed pulled embeddings of both passes."""
+    from paddle.fluid.incubate.fleet.parameter_server.pslib import fleet
+    from paddle.fluid.incubate.fleet.base.role_maker import GeneralRoleMaker
+
+    fleet.init(GeneralRoleMaker(path=os.path.join(work_dir, "gloo")))
+    train_program = fluid.Program()
+    startup_program = fluid.Program()
+    scope = fluid.Scope()
+    with fluid.program_guard(train_program, startup_program):
+        show = fluid.layers.data(
+            name="show", shape=[-1, 1], dtype="int64", lod_level=1,
+            append_batch_size=False)
+        click = fluid.layers.data(
+            name="click", shape=[-1, 1], dtype="int64", lod_level=1,
+            append_batch_size=False)
+        emb = fluid.layers.embedding(
+            input=show, size=[1, 2], is_sparse=True, is_distributed=True,
+            param_attr=fluid.ParamAttr(name="embedding"))
+        bow = fluid.layers.sequence_pool(input=emb, pool_type='sum')
+        pred = fluid.layers.fc(input=bow, size=1, act=None)
+        label = fluid.layers.cast(click, dtype='float32')
+        cost = fluid.layers.mean(
+            fluid.layers.square_error_cost(input=pred, label=label))
+        # the per batch values are summed into persistable vars
+        loss_sum = fluid.layers.create_global_var(
+            shape=[1], value=0.0, dtype='float32', persistable=True,
+            name="loss_sum")
+        emb_sum = fluid.layers.create_global_var(
+            shape=[1], value=0.0, dtype='float32', persistable=True,
+            name="emb_sum")
+        fluid.layers.assign(
+            fluid.layers.elementwise_add(loss_sum, cost), loss_sum)
+        fluid.layers.assign(
+            fluid.layers.elementwise_add(emb_sum, fluid.layers.reduce_sum(bow)),
+            emb_sum)
+        # nothing is updated, so the pulled values do not depend on the
+        # pushes the prefetch runs ahead of
+        optimizer = fleet.distributed_optimizer(
+            fluid.optimizer.SGD(learning_rate=0.0),
+            strategy={
+                "embedding": {
+                    "sparse_accessor_class": "DownpourSparseValueAccessor",
+                    "sparse_optimizer": "naive",
+                    "sparse_learning_rate": 0.0
+                }
+            })
+        optimizer.minimize([cost], [scope])
+
+    if fleet.is_server():
+        fleet.run_server()
+        fleet.stop_worker()
+        return
+
+    exe = fluid.Executor(fluid.CPUPlace())
+    exe.run(startup_program, scope=scope)
+    fleet.init_worker()
+    dataset = paddle.distributed.InMemoryDataset()
+    dataset.init(batch_size=4, thread_num=1, use_var=[show, click])
+    dataset.set_filelist([os.path.join(work_dir, "data.txt")])
+    dataset.load_into_memory()
+    result = {}
+    for depth in [0, 2]:
+        train_program._fleet_opt["pull_sparse_prefetch_depth"] = depth
+        for name in ["loss_sum", "emb_sum"]:
+            scope.find_var(name).get_tensor().set(
+                np.zeros([1], dtype="float32"), fluid.CPUPlace())
+        exe.train_from_dataset(train_program, dataset, scope, thread=1)
+        for name in ["loss_sum", "emb_sum"]:
+            result["{}_{}".format(name, depth)] = np.array(
+                scope.find_var(name).get_tensor())
+    np.savez(os.path.join(work_dir, "result.npz"), **result)
+    fleet.stop_worker()
+
 
 if __name__ == "__main__":
-    unittest.main()
+    if len(sys.argv) == 3 and sys.argv[1] == "downpour_prefetch":
+        _run_downpour_prefetch(sys.argv[2])
+    else:
+        unittest.main()
@@ -0,0 +1,171 @@
+#  Copyright (c) 2022 PaddlePaddle Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+from __future__ import print_function
+import unittest
+import numpy as np
+import paddle
+import paddle.fluid as fluid
+import paddle.fluid.core as core
+import paddle.nn.functional as F
+from op_test import OpTest
+
+paddle.enable_static()
+
+UNARY_OPS = {
+    "relu": F.relu,
+    "sigmoid": F.sigmoid,
+    "tanh": paddle.tanh,
+    "exp": paddle.exp,
+    "sqrt": paddle.sqrt,
+    "square": paddle.square,
+    "silu": F.silu,
+}
+
+BINARY_OPS = {
+    "elementwise_add": paddle.add,
+    "elementwise_sub": paddle.subtract,
+    "elementwise_mul": paddle.multiply,
+    "elementwise_div": paddle.divide,
+}
+
+
+def run_unfused_chain(x, ys, functors, chain_is_x, stage_attrs):
+    """Runs the ops of the chain one by one in dygraph."""
+    with fluid.dygraph.guard(fluid.CPUPlace()):
+        out = paddle.to_tensor(x)
+        y_iter = iter(ys)
+        for i, functor in enumerate(functors):
+            attrs = stage_attrs[3 * i:3 * i + 3]
+            if functor in BINARY_OPS:
+                y = paddle.to_tensor(next(y_iter))
+                lhs, rhs = (out, y) if chain_is_x[i] else (y, out)
+                out = BINARY_OPS[functor](lhs, rhs)
+            elif functor == "leaky_relu":
+                out = F.leaky_relu(out, attrs[0])
+            elif functor == "scale":
+                out = paddle.scale(out, attrs[0], attrs[1], attrs[2] != 0)
+            else:
+                out = UNARY_OPS[functor](out)
+        return out.numpy()
+
+
+class TestFusedElementwiseChainOp(OpTest):
+    def setUp(self):
+        self.op_type = "fused_elementwise_chain"
+        self.init_dtype()
+        # 4 * 2085 elements, the last tile is shorter than 2048
+        self.shape = [4, 2085]
+        self.init_chain()
+
+        x = np.random.uniform(0.1, 1, self.shape).astype(self.dtype)
+        ys = [
+            np.random.uniform(0.1, 1, shape).astype(self.dtype)
+            for shape in self.y_shapes
+        ]
+        chain_is_x = [int(v) for v in self.chain_is_x]
+        stage_attrs = []
+        for functor in self.functors:
+            stage_attrs += self.stage_attrs.get(functor, [0., 0., 0.])
+
+        self.inputs = {'X': x}
+        if ys:
+            self.inputs['Y'] = [('y%d' % i, y) for i, y in enumerate(ys)]
+        self.attrs = {
+            'functor_list': self.functors,
+            'chain_is_x': chain_is_x,
+            'stage_attrs': stage_attrs,
+        }
+        self.outputs = {
+            'Out': run_unfused_chain(x, ys, self.functors, chain_is_x,
+                                     stage_attrs)
+        }
+
+    def init_dtype(self):
+        self.dtype = np.float32
+
+    def init_chain(self):
+        self.functors = ["elementwise_add", "relu", "scale"]
+        self.chain_is_x = [True, True, True]
+        self.y_shapes = [self.shape]
+        self.stage_attrs = {"scale": [2., 0.5, 1.]}
+
+    def test_check_output(self):
+        self.check_output_with_place(core.CPUPlace(), check_dygraph=False)
+
+
+class TestFusedElementwiseChainOpAllFunctors(TestFusedElementwiseChainOp):
+    def init_chain(self):
+        self.functors = [
+            "elementwise_add", "sigmoid", "tanh", "exp", "sqrt", "square",
+            "silu", "leaky_relu", "scale", "elementwise_sub",
+            "elementwise_mul", "elementwise_div", "relu"
+        ]
+        self.chain_is_x = [True] * len(self.functors)
+        # the previous result is Y of the sub
+        self.chain_is_x[self.functors.index("elementwise_sub")] = False
+        self.y_shapes = [self.shape, self.shape, self.shape, self.shape]
+        self.stage_attrs = {
+            "leaky_relu": [0.1, 0., 0.],
+            "scale": [-3., 0.5, 0.]
+        }
+
+
+class TestFusedElementwiseChainOpBroadcast(TestFusedElementwiseChainOp):
+    def init_chain(self):
+        self.functors = [
+            "elementwise_mul", "elementwise_add", "tanh", "elementwise_div"
+        ]
+        self.chain_is_x = [True, True, True, False]
+        self.y_shapes = [[2085], [1, 2085], [4, 2085]]
+        self.stage_attrs = {}
+
+
+class TestFusedElementwiseChainOpShortTail(TestFusedElementwiseChainOp):
+    def init_chain(self):
+        # a single tile shorter than 2048
+        self.shape = [3, 37]
+        self.functors = ["silu", "elementwise_sub", "leaky_relu"]
+        self.chain_is_x = [True, True, True]
+        self.y_shapes = [[37]]
+        self.stage_attrs = {"leaky_relu": [0.2, 0., 0.]}
+
+
+class TestFusedElementwiseChainOpFP64(TestFusedElementwiseChainOpAllFunctors):
+    def init_dtype(self):
+        self.dtype = np.float64
+
+
+def create_test_functor_class(functor):
+    class TestFunctor(TestFusedElementwiseChainOp):
+        def init_chain(self):
+            self.functors = [functor, "scale"]
+            self.chain_is_x = [True, True]
+            self.y_shapes = [[2085]] if functor in BINARY_OPS else []
+            self.stage_attrs = {
+                "leaky_relu": [0.3, 0., 0.],
+                "scale": [1.5, -0.2, 1.]
+            }
+
+    cls_name = "TestFusedElementwiseChainOp_{}".format(functor)
+    TestFunctor.__name__ = cls_name
+    globals()[cls_name] = TestFunctor
+
+
+for functor in list(UNARY_OPS.keys()) + ["leaky_relu"] + list(
+        BINARY_OPS.keys()):
+    create_test_functor_class(functor)
+
+if __name__ == "__main__":
+    unittest.main()
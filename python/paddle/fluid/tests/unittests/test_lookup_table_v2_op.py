@@ -235,6 +235,22 @@ class TestLookupTableIsSparse(unittest.TestCase):
             w_grad1, w_grad2, rtol=tolerance, atol=tolerance)
 
 
+class TestLookupTableIsSparseMergeRows(TestLookupTableIsSparse):
+    def init_data(self):
+        self.x_data = np.array([[1, 3, 1, 4, 3]]).astype("int64")
+        self.y_data = np.array([[0.1, 0.3, 0.1, 0.4, 0.3]]).astype("float32")
+
+    def test_w_grad(self):
+        self.w_data = np.random.random(size=(10, 16)).astype("float32")
+        w_grad = self.get_w_grad(False)
+        paddle.set_flags({'FLAGS_embedding_sparse_grad_merge_rows': True})
+        try:
+            w_grad_with_sparse = self.get_w_grad(True)
+        finally:
+            paddle.set_flags({'FLAGS_embedding_sparse_grad_merge_rows': False})
+        self.check_grad(w_grad, w_grad_with_sparse)
+
+
 class TestLookupTableApi(unittest.TestCase):
     def test_api(self):
         x = fluid.layers.data(name='x', shape=[20], dtype='int64')